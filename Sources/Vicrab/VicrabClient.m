@@ -493,13 +493,16 @@ withCompletionHandler:(_Nullable VicrabRequestOperationFinished)completionHandle
         [VicrabLog logWithMessage:@"VicrabCrash has not been initialized, call startCrashHandlerWithError" andLevel:kVicrabLogLevelError];
         return;
     }
-    [VicrabCrash.sharedInstance reportUserException:name
-                                         reason:reason
-                                       language:language
-                                     lineOfCode:lineOfCode
-                                     stackTrace:stackTrace
-                                  logAllThreads:logAllThreads
-                               terminateProgram:terminateProgram];
+    BOOL isWritten = [VicrabCrash.sharedInstance reportUserException:name
+                                                          reason:reason
+                                                        language:language
+                                                      lineOfCode:lineOfCode
+                                                      stackTrace:stackTrace
+                                                   logAllThreads:logAllThreads
+                                                terminateProgram:terminateProgram];
+    if (!isWritten) {
+        [VicrabLog logWithMessage:@"User exception was counted into an earlier report or dropped by the rate limit" andLevel:kVicrabLogLevelDebug];
+    }
     [installation sendAllReports];
 }
 
@@ -508,13 +511,19 @@ withCompletionHandler:(_Nullable VicrabRequestOperationFinished)completionHandle
         [VicrabLog logWithMessage:@"VicrabCrash has not been initialized, call startCrashHandlerWithError" andLevel:kVicrabLogLevelError];
         return;
     }
-    [VicrabCrash.sharedInstance reportUserException:@"VICRAB_SNAPSHOT"
-                                         reason:@"VICRAB_SNAPSHOT"
-                                       language:@""
-                                     lineOfCode:@""
-                                     stackTrace:[[NSArray alloc] init]
-                                  logAllThreads:NO
-                               terminateProgram:NO];
+    BOOL isWritten = [VicrabCrash.sharedInstance reportUserExceptionBypassingRateLimit:@"VICRAB_SNAPSHOT"
+                                                                            reason:@"VICRAB_SNAPSHOT"
+                                                                          language:@""
+                                                                        lineOfCode:@""
+                                                                        stackTrace:[[NSArray alloc] init]
+                                                                     logAllThreads:NO];
+    if (!isWritten) {
+        [VicrabLog logWithMessage:@"Could not snapshot stacktrace" andLevel:kVicrabLogLevelError];
+        self._snapshotThreads = nil;
+        self._debugMeta = nil;
+        snapshotCompleted();
+        return;
+    }
     [installation sendAllReportsWithCompletion:^(NSArray *filteredReports, BOOL completed, NSError *error) {
         snapshotCompleted();
     }];
@@ -107,6 +107,7 @@ NS_ASSUME_NONNULL_BEGIN
     [serializedData setValue:systemInfo[@"usableMemory"] forKey:@"usable_memory"];
     [serializedData setValue:systemInfo[@"memorySize"] forKey:@"memory_size"];
     [serializedData setValue:systemInfo[@"storageSize"] forKey:@"storage_size"];
+    [serializedData setValue:systemInfo[@"freeStorage"] forKey:@"free_storage"];
     [serializedData setValue:systemInfo[@"bootTime"] forKey:@"boot_time"];
     [serializedData setValue:systemInfo[@"timezone"] forKey:@"timezone"];
 
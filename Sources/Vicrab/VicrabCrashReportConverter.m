@@ -113,7 +113,27 @@ static inline NSString *hexAddress(NSNumber *value) {
 }
 
 - (NSDictionary<NSString *, id <NSSecureCoding>> *_Nullable)convertExtra {
-    return self.userContext[@"extra"];
+    NSNumber *occurrences = self.exceptionContext[@"user_reported"][@"occurrences"];
+    NSDictionary *exceptionStats = self.exceptionContext[@"cpp_exception_stats"];
+    NSArray *recentEvents = self.report[@"recent_events"];
+    NSArray *resourceSamples = self.systemContext[@"memory"][@"samples"];
+    if ((nil == occurrences || occurrences.intValue <= 1) && nil == exceptionStats && nil == recentEvents && nil == resourceSamples) {
+        return self.userContext[@"extra"];
+    }
+    NSMutableDictionary *extra = [NSMutableDictionary dictionaryWithDictionary:self.userContext[@"extra"]];
+    if (occurrences.intValue > 1) {
+        extra[@"occurrences"] = occurrences;
+    }
+    if (nil != exceptionStats) {
+        extra[@"cpp_exception_stats"] = exceptionStats;
+    }
+    if (nil != recentEvents) {
+        extra[@"recent_events"] = recentEvents;
+    }
+    if (nil != resourceSamples) {
+        extra[@"resource_samples"] = resourceSamples;
+    }
+    return extra;
 }
 
 - (NSDictionary<NSString *, NSString *> *_Nullable)convertTags {
@@ -165,6 +185,7 @@ static inline NSString *hexAddress(NSNumber *value) {
     [deviceContext setValue:self.systemContext[@"memory"][@"usable"] forKey:@"usable_memory"];
     [deviceContext setValue:self.systemContext[@"memory"][@"free"] forKey:@"free_memory"];
     [deviceContext setValue:self.systemContext[@"storage"] forKey:@"storage_size"];
+    [deviceContext setValue:self.systemContext[@"free_storage"] forKey:@"free_storage"];
     [deviceContext setValue:self.systemContext[@"machine"] forKey:@"model"];
     [deviceContext setValue:self.systemContext[@"model"] forKey:@"model_id"];
     context.deviceContext = deviceContext;
@@ -318,6 +339,15 @@ static inline NSString *hexAddress(NSNumber *value) {
                                                                                       self.exceptionContext[@"signal"][@"signal"],
                                                                                       self.exceptionContext[@"signal"][@"code"]]
                                                       type:self.exceptionContext[@"signal"][@"name"]];
+    } else if ([exceptionType isEqualToString:@"hang"]) {
+        exception = [[VicrabException alloc] initWithValue:[NSString stringWithFormat:@"%@", self.exceptionContext[@"reason"]]
+                                                      type:@"App Hanging"];
+    } else if ([exceptionType isEqualToString:@"cpp_exception_stats"]) {
+        exception = [[VicrabException alloc] initWithValue:[NSString stringWithFormat:@"%@", self.exceptionContext[@"reason"]]
+                                                      type:@"C++ Exception Statistics"];
+    } else if ([exceptionType isEqualToString:@"unexpected_termination"]) {
+        exception = [[VicrabException alloc] initWithValue:[NSString stringWithFormat:@"%@", self.exceptionContext[@"reason"]]
+                                                      type:@"Unexpected Termination"];
     } else if ([exceptionType isEqualToString:@"user"]) {
         NSString *exceptionReason = [NSString stringWithFormat:@"%@", self.exceptionContext[@"reason"]];
         exception = [[VicrabException alloc] initWithValue:exceptionReason
@@ -385,6 +415,10 @@ static inline NSString *hexAddress(NSNumber *value) {
 
 - (VicrabMechanism *_Nullable)extractMechanism {
     VicrabMechanism *mechanism = [[VicrabMechanism alloc] initWithType:[self.exceptionContext objectForKey:@"type"]];
+    if ([[self.exceptionContext objectForKey:@"type"] isEqualToString:@"hang"] ||
+        [[self.exceptionContext objectForKey:@"type"] isEqualToString:@"cpp_exception_stats"]) {
+        mechanism.handled = @(YES);
+    }
     if (nil != [self.exceptionContext objectForKey:@"mach"]) {
         mechanism.handled = @(NO);
 
@@ -30,9 +30,12 @@
 #include "VicrabCrashMonitorType.h"
 
 #include "VicrabCrashMonitor_Deadlock.h"
+#include "VicrabCrashMonitor_Hang.h"
 #include "VicrabCrashMonitor_MachException.h"
 #include "VicrabCrashMonitor_CPPException.h"
+#include "VicrabCrashMonitor_CPPExceptionStats.h"
 #include "VicrabCrashMonitor_NSException.h"
+#include "VicrabCrashMonitor_Profiler.h"
 #include "VicrabCrashMonitor_Signal.h"
 #include "VicrabCrashMonitor_System.h"
 #include "VicrabCrashMonitor_User.h"
@@ -86,10 +89,24 @@ static Monitor g_monitors[] =
         .getAPI = vicrabcrashcm_zombie_getAPI,
     },
 #endif
+#if VicrabCrashCRASH_HOST_APPLE
+    {
+        .monitorType = VicrabCrashMonitorTypeMainThreadHang,
+        .getAPI = vicrabcrashcm_hang_getAPI,
+    },
+#endif
+    {
+        .monitorType = VicrabCrashMonitorTypeProfiler,
+        .getAPI = vicrabcrashcm_profiler_getAPI,
+    },
     {
         .monitorType = VicrabCrashMonitorTypeCPPException,
         .getAPI = vicrabcrashcm_cppexception_getAPI,
     },
+    {
+        .monitorType = VicrabCrashMonitorTypeCPPExceptionStats,
+        .getAPI = vicrabcrashcm_cppexceptionstats_getAPI,
+    },
     {
         .monitorType = VicrabCrashMonitorTypeUserReported,
         .getAPI = vicrabcrashcm_user_getAPI,
@@ -231,6 +248,7 @@ bool vicrabcrashcm_notifyFatalExceptionCaptured(bool isAsyncSafeEnvironment)
 void vicrabcrashcm_handleException(struct VicrabCrash_MonitorContext* context)
 {
     context->requiresAsyncSafety = g_requiresAsyncSafety;
+    context->isFatal = g_handlingFatalException;
     if(g_crashedDuringExceptionHandling)
     {
         context->crashedDuringCrashHandling = true;
@@ -255,3 +273,15 @@ void vicrabcrashcm_handleException(struct VicrabCrash_MonitorContext* context)
         }
     }
 }
+
+void vicrabcrashcm_addContextualInfo(struct VicrabCrash_MonitorContext* context, VicrabCrashMonitorType monitorTypes)
+{
+    for(int i = 0; i < g_monitorsCount; i++)
+    {
+        Monitor* monitor = &g_monitors[i];
+        if((monitor->monitorType & monitorTypes) && isMonitorEnabled(monitor))
+        {
+            addContextualInfoToEvent(monitor, context);
+        }
+    }
+}
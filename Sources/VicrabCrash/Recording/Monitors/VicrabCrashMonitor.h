@@ -90,6 +90,15 @@ bool vicrabcrashcm_notifyFatalExceptionCaptured(bool isAsyncSafeEnvironment);
  */
 void vicrabcrashcm_handleException(struct VicrabCrash_MonitorContext* context);
 
+/** Fill in what some of the active monitors add to events, without raising
+ * an event.
+ *
+ * @param context The context to fill in.
+ *
+ * @param monitorTypes The monitors to ask.
+ */
+void vicrabcrashcm_addContextualInfo(struct VicrabCrash_MonitorContext* context, VicrabCrashMonitorType monitorTypes);
+
 
 #ifdef __cplusplus
 }
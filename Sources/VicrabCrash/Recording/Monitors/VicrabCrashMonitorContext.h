@@ -38,6 +38,69 @@ extern "C" {
 #include <stdbool.h>
 #include <stdint.h>
 
+struct VicrabCrashConsoleCapture;
+
+/** Characters reserved for a user report's occurrence count, so that
+ * duplicates can update it in place.
+ */
+#define VicrabCrashCM_OCCURRENCES_WIDTH 10
+
+/** Most resource samples carried by a context. */
+#define VicrabCrashCM_MAX_RESOURCE_SAMPLES 12
+
+/** Memory, storage and CPU figures sampled in the background. */
+typedef struct
+{
+    /** When the sample was taken, in seconds since 1970. */
+    double timestamp;
+    uint64_t freeMemory;
+    uint64_t usableMemory;
+    uint64_t freeStorage;
+    /** Fraction of CPU time the system was busy since the previous sample. */
+    double cpuLoad;
+} VicrabCrash_ResourceSample;
+
+/** A thread's backtrace, captured before the report is written. */
+typedef struct
+{
+    VicrabCrashThread thread;
+    const uintptr_t* backtrace;
+    int backtraceLength;
+    /** Report this thread as the one that caused the event. */
+    bool crashed;
+} VicrabCrashCapturedThread;
+
+/** How often C++ exceptions of one type were thrown from one place. */
+typedef struct
+{
+    /** The exception's type name, as reported by its type_info. */
+    const char* name;
+    /** The return address into the function that threw. */
+    uintptr_t address;
+    /** Sampled throws. */
+    uint32_t count;
+} VicrabCrashThrowSiteCount;
+
+/** A node of a sampled call tree. A node's parent always comes before it. */
+typedef struct
+{
+    uintptr_t address;
+    /** Index of the parent node, or -1 for a root. */
+    int32_t parent;
+    /** Samples in which this was the innermost frame. */
+    uint32_t selfCount;
+    /** Samples that passed through this frame. */
+    uint32_t totalCount;
+} VicrabCrashProfileNode;
+
+/** A distinct backtrace seen while a thread was hung, and how often. */
+typedef struct
+{
+    const uintptr_t* backtrace;
+    int backtraceLength;
+    int count;
+} VicrabCrashHangSample;
+
 typedef struct VicrabCrash_MonitorContext
 {
     /** Unique identifier for this event. */
@@ -60,6 +123,12 @@ typedef struct VicrabCrash_MonitorContext
     /** If true, a second crash occurred while handling a crash. */
     bool crashedDuringCrashHandling;
 
+    /** If true, the app will not survive this event (its monitor called
+     * vicrabcrashcm_notifyFatalExceptionCaptured()). False for non-fatal
+     * user reports, hangs and statistics.
+     */
+    bool isFatal;
+
     /** If true, the registers contain valid information about the crash. */
     bool registersAreValid;
 
@@ -87,6 +156,12 @@ typedef struct VicrabCrash_MonitorContext
      */
     void* stackCursor;
 
+    /** Threads captured at the time of the event, for reports that are written
+     * later. If set, these are written instead of inspecting live threads.
+     */
+    const VicrabCrashCapturedThread* capturedThreads;
+    int capturedThreadCount;
+
     struct
     {
         /** The mach exception type. */
@@ -136,8 +211,68 @@ typedef struct VicrabCrash_MonitorContext
 
         /** The user-supplied JSON encoded stack trace. */
         const char* customStackTrace;
+
+        /** How many times this exception has been seen (0 = don't record). */
+        int occurrences;
     } userException;
 
+    struct
+    {
+        /** How long the main thread was unresponsive. */
+        uint64_t durationNanoseconds;
+
+        /** Distinct backtraces sampled during the hang, most frequent first. */
+        const VicrabCrashHangSample* samples;
+
+        /** Number of entries in samples. */
+        int sampleCount;
+
+        /** Total number of samples taken. */
+        int totalSampleCount;
+    } hang;
+
+    struct
+    {
+        /** The sampled call tree (NULL = no profile). */
+        const VicrabCrashProfileNode* nodes;
+
+        /** Number of entries in nodes. */
+        int nodeCount;
+
+        /** Samples aggregated into the tree. */
+        int sampleCount;
+
+        /** Samples lost because the ring or the tree was full. */
+        int droppedSampleCount;
+
+        /** The sampling rate. */
+        int samplesPerSecond;
+
+        /** Time covered by the samples. */
+        uint64_t durationNanoseconds;
+    } profile;
+
+    struct
+    {
+        /** Sampled throws, most frequent first. */
+        const VicrabCrashThrowSiteCount* sites;
+
+        /** Number of entries in sites. */
+        int siteCount;
+
+        /** Only one in this many throws was sampled. */
+        int sampleInterval;
+
+        /** All throws, sampled or not. */
+        uint64_t throwCount;
+
+        /** Sampled throws that didn't fit in the table. */
+        uint64_t droppedCount;
+
+        /** Time covered by the counts. */
+        uint64_t durationNanoseconds;
+    } CPPExceptionStats;
+
     struct
     {
         /** Total active time elapsed since the last crash. */
@@ -213,6 +348,12 @@ typedef struct VicrabCrash_MonitorContext
         uint64_t memorySize;
         uint64_t freeMemory;
         uint64_t usableMemory;
+        uint64_t freeStorage;
+        double cpuLoad;
+
+        /** The most recent resource samples, oldest first. */
+        VicrabCrash_ResourceSample resourceSamples[VicrabCrashCM_MAX_RESOURCE_SAMPLES];
+        int resourceSampleCount;
     } System;
 
     struct
@@ -230,6 +371,16 @@ typedef struct VicrabCrash_MonitorContext
     /** Full path to the console log, if any. */
     const char* consoleLogPath;
 
+    /** Console output captured in memory, if any. It may belong to another
+     * process, so only read it with vicrabcrashmem functions. */
+    const struct VicrabCrashConsoleCapture* consoleCapture;
+
+    /** If not NULL, receives the path of the report written for this event. */
+    char* reportPathBuffer;
+
+    /** Size of reportPathBuffer. */
+    int reportPathBufferLength;
+
 } VicrabCrash_MonitorContext;
 
 
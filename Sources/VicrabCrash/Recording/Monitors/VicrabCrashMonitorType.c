@@ -44,6 +44,9 @@ static const struct
     MONITORTYPE(VicrabCrashMonitorTypeSystem),
     MONITORTYPE(VicrabCrashMonitorTypeApplicationState),
     MONITORTYPE(VicrabCrashMonitorTypeZombie),
+    MONITORTYPE(VicrabCrashMonitorTypeMainThreadHang),
+    MONITORTYPE(VicrabCrashMonitorTypeProfiler),
+    MONITORTYPE(VicrabCrashMonitorTypeCPPExceptionStats),
 };
 static const int g_monitorTypesCount = sizeof(g_monitorTypes) / sizeof(*g_monitorTypes);
 
@@ -69,6 +69,15 @@ typedef enum
 
     /* Keeps track of zombies, and injects the last zombie NSException. */
     VicrabCrashMonitorTypeZombie             = 0x100,
+
+    /* Detects and reports (non-fatal) periods where the main thread is unresponsive. */
+    VicrabCrashMonitorTypeMainThreadHang     = 0x200,
+
+    /* Periodically samples thread stacks and injects the aggregated call tree. */
+    VicrabCrashMonitorTypeProfiler           = 0x400,
+
+    /* Counts caught and uncaught C++ throws, and periodically reports the totals. */
+    VicrabCrashMonitorTypeCPPExceptionStats  = 0x800,
 } VicrabCrashMonitorType;
 
 #define VicrabCrashMonitorTypeAll              \
@@ -81,12 +90,18 @@ typedef enum
     VicrabCrashMonitorTypeUserReported       | \
     VicrabCrashMonitorTypeSystem             | \
     VicrabCrashMonitorTypeApplicationState   | \
-    VicrabCrashMonitorTypeZombie               \
+    VicrabCrashMonitorTypeZombie             | \
+    VicrabCrashMonitorTypeMainThreadHang     | \
+    VicrabCrashMonitorTypeProfiler           | \
+    VicrabCrashMonitorTypeCPPExceptionStats    \
 )
 
 #define VicrabCrashMonitorTypeExperimental     \
 (                                          \
-    VicrabCrashMonitorTypeMainThreadDeadlock   \
+    VicrabCrashMonitorTypeMainThreadDeadlock | \
+    VicrabCrashMonitorTypeMainThreadHang     | \
+    VicrabCrashMonitorTypeProfiler           | \
+    VicrabCrashMonitorTypeCPPExceptionStats    \
 )
 
 #define VicrabCrashMonitorTypeDebuggerUnsafe   \
@@ -37,8 +37,11 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 #include <unistd.h>
 
@@ -47,8 +50,13 @@
 #pragma mark - Constants -
 // ============================================================================
 
+/** Version of the legacy JSON state file. */
 #define kFormatVersion 1
 
+/** "VCAS" */
+#define kStateFileMagic 0x53414356
+#define kStateFileVersion 2
+
 #define kKeyFormatVersion "version"
 #define kKeyCrashedLastLaunch "crashedLastLaunch"
 #define kKeyActiveDurationSinceLastCrash "activeDurationSinceLastCrash"
@@ -59,12 +67,54 @@
 
 
 
+// ============================================================================
+#pragma mark - Types -
+// ============================================================================
+
+/** The part of the state that survives a relaunch. */
+typedef struct
+{
+    double activeDurationSinceLastCrash;
+    double backgroundDurationSinceLastCrash;
+    int32_t launchesSinceLastCrash;
+    int32_t sessionsSinceLastCrash;
+    int32_t crashedLastLaunch;
+    int32_t reserved;
+} PersistedState;
+
+/** One copy of the persisted state.
+ * The sequence is odd while the slot is being written, and twice the
+ * generation of the copy once it is complete.
+ */
+typedef struct
+{
+    _Atomic(uint32_t) sequence;
+    uint32_t reserved;
+    PersistedState state;
+} StateSlot;
+
+/** Layout of the state file. Saves alternate between the two slots, so a
+ * save that gets interrupted by a crash never damages the last good copy.
+ */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t reserved;
+    StateSlot slots[2];
+} StateFile;
+
+
 // ============================================================================
 #pragma mark - Globals -
 // ============================================================================
 
-/** Location where stat file is stored. */
-static const char* g_stateFilePath;
+/** The mapped state file, or NULL if it couldn't be mapped. */
+static StateFile* g_stateFile;
+
+/** Generation of the most recent save. */
+static _Atomic(uint32_t) g_stateGeneration;
 
 /** Current state. */
 static VicrabCrash_AppState g_state;
@@ -72,7 +122,7 @@ static VicrabCrash_AppState g_state;
 static volatile bool g_isEnabled = false;
 
 // ============================================================================
-#pragma mark - JSON Encoding -
+#pragma mark - JSON Decoding -
 // ============================================================================
 
 static int onBooleanElement(const char* const name, const bool value, void* const userData)
@@ -161,16 +211,6 @@ static int onEndData(__unused void* const userData)
 }
 
 
-/** Callback for adding JSON data.
- */
-static int addJSONData(const char* const data, const int length, void* const userData)
-{
-    const int fd = *((int*)userData);
-    const bool success = vicrabcrashfu_writeBytesToFD(fd, data, length);
-    return success ? VicrabCrashJSON_OK : VicrabCrashJSON_ERROR_CANNOT_ADD_DATA;
-}
-
-
 // ============================================================================
 #pragma mark - Utility -
 // ============================================================================
@@ -187,23 +227,15 @@ static double timeSince(double timeInSeconds)
     return getCurentTime() - timeInSeconds;
 }
 
-/** Load the persistent state portion of a crash context.
+/** Load the persistent state portion of a crash context from a legacy JSON
+ * state file.
  *
  * @param path The path to the file to read.
  *
  * @return true if the operation was successful.
  */
-bool loadState(const char* const path)
+static bool loadJSONState(const char* const path)
 {
-    // Stop if the file doesn't exist.
-    // This is expected on the first run of the app.
-    const int fd = open(path, O_RDONLY);
-    if(fd < 0)
-    {
-        return false;
-    }
-    close(fd);
-
     char* data;
     int length;
     if(!vicrabcrashfu_readEntireFile(path, &data, &length, 50000))
@@ -243,81 +275,167 @@ bool loadState(const char* const path)
     return true;
 }
 
-/** Save the persistent state portion of a crash context.
+static bool isValidStateFile(const StateFile* const file)
+{
+    return file->magic == kStateFileMagic &&
+           file->version == kStateFileVersion &&
+           file->size == sizeof(*file);
+}
+
+/** Store a copy of the persisted state in the next slot.
+ * This only touches mapped memory, so it is async-safe.
+ */
+static void writeSlot(const PersistedState* const state)
+{
+    // Taking a fresh generation means a save that interrupts another one
+    // (a crash during a background transition) writes the other slot.
+    const uint32_t generation = atomic_fetch_add(&g_stateGeneration, 1) + 1;
+    StateSlot* slot = &g_stateFile->slots[generation & 1];
+
+    atomic_store_explicit(&slot->sequence, generation * 2 + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->state = *state;
+    atomic_store_explicit(&slot->sequence, generation * 2, memory_order_release);
+}
+
+/** Read the newest complete slot.
+ *
+ * @param file The state file.
  *
- * @param path The path to the file to create.
+ * @param state Receives the persisted state.
+ *
+ * @param generation Receives the generation of the copy that was read.
+ *
+ * @return true if a complete copy was found.
+ */
+static bool readSlot(const StateFile* const file, PersistedState* const state, uint32_t* const generation)
+{
+    bool found = false;
+    for(int i = 0; i < 2; i++)
+    {
+        const StateSlot* slot = &file->slots[i];
+        const uint32_t before = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        if((before & 1) != 0 || before == 0)
+        {
+            continue;
+        }
+        PersistedState copy = slot->state;
+        atomic_thread_fence(memory_order_acquire);
+        if(atomic_load_explicit(&slot->sequence, memory_order_relaxed) != before)
+        {
+            continue;
+        }
+        if(!found || before / 2 > *generation)
+        {
+            *state = copy;
+            *generation = before / 2;
+            found = true;
+        }
+    }
+    return found;
+}
+
+/** Load the persistent state portion of a crash context, migrating a legacy
+ * JSON state file to the binary layout.
+ *
+ * @param path The path to the file to read.
  *
  * @return true if the operation was successful.
  */
-bool saveState(const char* const path)
+static bool loadState(const char* const path)
 {
-    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    const int fd = open(path, O_RDWR | O_CREAT, 0644);
     if(fd < 0)
     {
-        VicrabCrashLOG_ERROR("Could not open file %s for writing: %s",
-                    path,
-                    strerror(errno));
+        VicrabCrashLOG_ERROR("Could not open file %s: %s", path, strerror(errno));
         return false;
     }
 
-    VicrabCrashJSONEncodeContext JSONContext;
-    vicrabcrashjson_beginEncode(&JSONContext,
-                       true,
-                       addJSONData,
-                       &fd);
-
-    int result;
-    if((result = vicrabcrashjson_beginObject(&JSONContext, NULL)) != VicrabCrashJSON_OK)
+    struct stat st;
+    if(fstat(fd, &st) != 0)
     {
-        goto done;
-    }
-    if((result = vicrabcrashjson_addIntegerElement(&JSONContext,
-                                          kKeyFormatVersion,
-                                          kFormatVersion)) != VicrabCrashJSON_OK)
-    {
-        goto done;
-    }
-    // Record this launch crashed state into "crashed last launch" field.
-    if((result = vicrabcrashjson_addBooleanElement(&JSONContext,
-                                          kKeyCrashedLastLaunch,
-                                          g_state.crashedThisLaunch)) != VicrabCrashJSON_OK)
-    {
-        goto done;
+        VicrabCrashLOG_ERROR("Could not stat file %s: %s", path, strerror(errno));
+        close(fd);
+        return false;
     }
-    if((result = vicrabcrashjson_addFloatingPointElement(&JSONContext,
-                                                kKeyActiveDurationSinceLastCrash,
-                                                g_state.activeDurationSinceLastCrash)) != VicrabCrashJSON_OK)
+
+    bool isMigrating = false;
+    if(st.st_size != (off_t)sizeof(StateFile))
     {
-        goto done;
+        // An empty file is expected on the first run of the app.
+        isMigrating = st.st_size > 0 && loadJSONState(path);
+        if(ftruncate(fd, 0) != 0 || ftruncate(fd, (off_t)sizeof(StateFile)) != 0)
+        {
+            VicrabCrashLOG_ERROR("Could not size file %s: %s", path, strerror(errno));
+            close(fd);
+            return false;
+        }
     }
-    if((result = vicrabcrashjson_addFloatingPointElement(&JSONContext,
-                                                kKeyBackgroundDurationSinceLastCrash,
-                                                g_state.backgroundDurationSinceLastCrash)) != VicrabCrashJSON_OK)
+
+    void* mapping = mmap(NULL, sizeof(StateFile), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED)
     {
-        goto done;
+        VicrabCrashLOG_ERROR("Could not map file %s: %s", path, strerror(errno));
+        return false;
     }
-    if((result = vicrabcrashjson_addIntegerElement(&JSONContext,
-                                          kKeyLaunchesSinceLastCrash,
-                                          g_state.launchesSinceLastCrash)) != VicrabCrashJSON_OK)
+    g_stateFile = mapping;
+
+    PersistedState state;
+    uint32_t generation = 0;
+    if(isValidStateFile(g_stateFile) && readSlot(g_stateFile, &state, &generation))
     {
-        goto done;
+        g_state.activeDurationSinceLastCrash = state.activeDurationSinceLastCrash;
+        g_state.backgroundDurationSinceLastCrash = state.backgroundDurationSinceLastCrash;
+        g_state.launchesSinceLastCrash = state.launchesSinceLastCrash;
+        g_state.sessionsSinceLastCrash = state.sessionsSinceLastCrash;
+        g_state.crashedLastLaunch = state.crashedLastLaunch != 0;
+        atomic_store(&g_stateGeneration, generation);
+        return true;
     }
-    if((result = vicrabcrashjson_addIntegerElement(&JSONContext,
-                                          kKeySessionsSinceLastCrash,
-                                          g_state.sessionsSinceLastCrash)) != VicrabCrashJSON_OK)
+
+    memset(g_stateFile, 0, sizeof(*g_stateFile));
+    g_stateFile->magic = kStateFileMagic;
+    g_stateFile->version = kStateFileVersion;
+    g_stateFile->size = sizeof(*g_stateFile);
+    atomic_store(&g_stateGeneration, 0);
+    if(isMigrating)
     {
-        goto done;
+        VicrabCrashLOG_INFO("%s: Migrated JSON state", path);
+        state = (PersistedState)
+        {
+            .activeDurationSinceLastCrash = g_state.activeDurationSinceLastCrash,
+            .backgroundDurationSinceLastCrash = g_state.backgroundDurationSinceLastCrash,
+            .launchesSinceLastCrash = g_state.launchesSinceLastCrash,
+            .sessionsSinceLastCrash = g_state.sessionsSinceLastCrash,
+            .crashedLastLaunch = g_state.crashedLastLaunch,
+        };
+        writeSlot(&state);
     }
-    result = vicrabcrashjson_endEncode(&JSONContext);
+    return isMigrating;
+}
 
-done:
-    close(fd);
-    if(result != VicrabCrashJSON_OK)
+/** Save the persistent state portion of a crash context.
+ * This only stores to the mapped state file and makes no system calls.
+ *
+ * @return true if the operation was successful.
+ */
+static bool saveState(void)
+{
+    if(g_stateFile == NULL)
     {
-        VicrabCrashLOG_ERROR("%s: %s",
-                    path, vicrabcrashjson_stringForError(result));
         return false;
     }
+    PersistedState state =
+    {
+        .activeDurationSinceLastCrash = g_state.activeDurationSinceLastCrash,
+        .backgroundDurationSinceLastCrash = g_state.backgroundDurationSinceLastCrash,
+        .launchesSinceLastCrash = g_state.launchesSinceLastCrash,
+        .sessionsSinceLastCrash = g_state.sessionsSinceLastCrash,
+        // Record this launch crashed state into "crashed last launch" field.
+        .crashedLastLaunch = g_state.crashedThisLaunch,
+    };
+    writeSlot(&state);
     return true;
 }
 
@@ -328,9 +446,13 @@ done:
 
 void vicrabcrashstate_initialize(const char* const stateFilePath)
 {
-    g_stateFilePath = strdup(stateFilePath);
+    if(g_stateFile != NULL)
+    {
+        munmap(g_stateFile, sizeof(*g_stateFile));
+        g_stateFile = NULL;
+    }
     memset(&g_state, 0, sizeof(g_state));
-    loadState(g_stateFilePath);
+    loadState(stateFilePath);
 }
 
 bool vicrabcrashstate_reset()
@@ -354,7 +476,7 @@ bool vicrabcrashstate_reset()
         g_state.sessionsSinceLastCrash++;
         g_state.applicationIsInForeground = true;
 
-        return saveState(g_stateFilePath);
+        return saveState();
     }
     return false;
 }
@@ -381,8 +503,6 @@ void vicrabcrashstate_notifyAppInForeground(const bool isInForeground)
 {
     if(g_isEnabled)
     {
-        const char* const stateFilePath = g_stateFilePath;
-
         g_state.applicationIsInForeground = isInForeground;
         if(isInForeground)
         {
@@ -395,7 +515,7 @@ void vicrabcrashstate_notifyAppInForeground(const bool isInForeground)
         else
         {
             g_state.appStateTransitionTime = getCurentTime();
-            saveState(stateFilePath);
+            saveState();
         }
     }
 }
@@ -404,11 +524,9 @@ void vicrabcrashstate_notifyAppTerminate(void)
 {
     if(g_isEnabled)
     {
-        const char* const stateFilePath = g_stateFilePath;
-
         const double duration = timeSince(g_state.appStateTransitionTime);
         g_state.backgroundDurationSinceLastCrash += duration;
-        saveState(stateFilePath);
+        saveState();
     }
 }
 
@@ -416,8 +534,6 @@ void vicrabcrashstate_notifyAppCrash(void)
 {
     if(g_isEnabled)
     {
-        const char* const stateFilePath = g_stateFilePath;
-
         const double duration = timeSince(g_state.appStateTransitionTime);
         if(g_state.applicationIsActive)
         {
@@ -430,7 +546,7 @@ void vicrabcrashstate_notifyAppCrash(void)
             g_state.backgroundDurationSinceLastCrash += duration;
         }
         g_state.crashedThisLaunch = true;
-        saveState(stateFilePath);
+        saveState();
     }
 }
 
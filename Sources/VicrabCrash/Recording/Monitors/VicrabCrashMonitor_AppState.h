@@ -89,6 +89,10 @@ typedef struct
 
 
 /** Initialize the state monitor.
+ *
+ * The state is kept in a small memory-mapped file, so saving it (including
+ * from a crash handler) is a handful of stores with no system calls.
+ * A state file in the old JSON format is converted on load.
  *
  * @param stateFilePath Where to store on-disk representation of state.
  */
@@ -23,26 +23,47 @@
 //
 
 #include "VicrabCrashMonitor_CPPException.h"
+#include "VicrabCrashMonitor_CPPExceptionStats.h"
 #include "VicrabCrashMonitorContext.h"
 #include "VicrabCrashID.h"
 #include "VicrabCrashThread.h"
 #include "VicrabCrashMachineContext.h"
+#include "VicrabCrashStackCursor_Backtrace.h"
 #include "VicrabCrashStackCursor_SelfThread.h"
 
 //#define VicrabCrashLogger_LocalLevel TRACE
 #include "VicrabCrashLogger.h"
 
+#include <atomic>
 #include <cxxabi.h>
 #include <dlfcn.h>
+#include <exception>
+#include <pthread.h>
+#include <string>
+#include <system_error>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <typeinfo>
 
 
-#define STACKTRACE_BUFFER_LENGTH 30
+#define STACKTRACE_BUFFER_LENGTH 64
 #define DESCRIPTION_BUFFER_LENGTH 1000
 
+/** Throw sites remembered at once. Must be a power of 2. */
+#define THROW_SITE_SLOT_COUNT 64
+
+/** Slots examined for a thread before it takes over its first choice. */
+#define THROW_SITE_PROBE_LENGTH 4
+
+#define MAX_FORMATTERS 64
+
+/** Initial size of the demangler's buffer. It grows if needed. */
+#define DEMANGLE_BUFFER_LENGTH 512
+
+/** Nested exceptions described below the outermost one. */
+#define MAX_NESTED_EXCEPTIONS 4
+
 
 // Compiler hints for "if" statements
 #define likely_if(x) if(__builtin_expect(x,1))
@@ -56,18 +77,123 @@
 /** True if this handler has been installed. */
 static volatile bool g_isEnabled = false;
 
-/** True if the handler should capture the next stack trace. */
-static bool g_captureNextStackTrace = false;
-
 static std::terminate_handler g_originalTerminateHandler;
 
 static char g_eventID[37];
 
 static VicrabCrash_MonitorContext g_monitorContext;
 
-// TODO: Thread local storage is not supported < ios 9.
-// Find some other way to do thread local. Maybe storage with lookup by tid?
 static VicrabCrashStackCursor g_stackCursor;
+static uintptr_t g_throwSiteBacktrace[STACKTRACE_BUFFER_LENGTH];
+
+/** The most recent throw site of a thread.
+ * Thread local storage is not supported < ios 9, so slots are looked up by
+ * thread instead. A thread whose slots are taken evicts another thread's.
+ */
+typedef struct
+{
+    std::atomic<VicrabCrashThread> thread;
+    /** Odd while the slot is being written. */
+    std::atomic<uint32_t> sequence;
+    int backtraceLength;
+    uintptr_t backtrace[STACKTRACE_BUFFER_LENGTH];
+} ThrowSite;
+
+static ThrowSite g_throwSites[THROW_SITE_SLOT_COUNT];
+
+typedef struct
+{
+    const std::type_info* type;
+    VicrabCrashCPPExceptionFormatter format;
+} Formatter;
+
+/** Entries are only ever appended, and published by g_formatterCount. */
+static Formatter g_formatters[MAX_FORMATTERS];
+static std::atomic<int> g_formatterCount;
+static pthread_mutex_t g_formattersMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t g_defaultFormattersOnce = PTHREAD_ONCE_INIT;
+
+/** Allocated up front, since __cxa_demangle wants a malloc'd buffer. */
+static char* g_demangleBuffer;
+static size_t g_demangleBufferLength;
+
+
+// ============================================================================
+#pragma mark - Throw Sites -
+// ============================================================================
+
+static inline uint32_t firstSlotForThread(VicrabCrashThread thread)
+{
+    return (uint32_t)(((uint64_t)thread * 0x9E3779B97F4A7C15ULL) >> 32) & (THROW_SITE_SLOT_COUNT - 1);
+}
+
+static ThrowSite* slotForThread(VicrabCrashThread thread)
+{
+    const uint32_t first = firstSlotForThread(thread);
+    for(uint32_t i = 0; i < THROW_SITE_PROBE_LENGTH; i++)
+    {
+        ThrowSite* slot = &g_throwSites[(first + i) & (THROW_SITE_SLOT_COUNT - 1)];
+        if(slot->thread.load(std::memory_order_relaxed) == thread)
+        {
+            return slot;
+        }
+    }
+    for(uint32_t i = 0; i < THROW_SITE_PROBE_LENGTH; i++)
+    {
+        ThrowSite* slot = &g_throwSites[(first + i) & (THROW_SITE_SLOT_COUNT - 1)];
+        VicrabCrashThread unowned = 0;
+        if(slot->thread.compare_exchange_strong(unowned, thread, std::memory_order_relaxed))
+        {
+            return slot;
+        }
+    }
+    return &g_throwSites[first];
+}
+
+/** Remember where the calling thread is throwing from. Only walks frame
+ * pointers, since most exceptions are caught and their throw site never used.
+ */
+static __attribute__((noinline)) void recordThrowSite(int skipEntries)
+{
+    const VicrabCrashThread thisThread = vicrabcrashthread_self();
+    ThrowSite* slot = slotForThread(thisThread);
+
+    // Give up if another thread is evicting this slot right now.
+    uint32_t sequence = slot->sequence.load(std::memory_order_relaxed);
+    if((sequence & 1) != 0 ||
+       !slot->sequence.compare_exchange_strong(sequence, sequence + 1, std::memory_order_acquire))
+    {
+        return;
+    }
+    slot->thread.store(thisThread, std::memory_order_relaxed);
+    slot->backtraceLength = vicrabcrashsc_copyFramePointerBacktrace(slot->backtrace,
+                                                                    STACKTRACE_BUFFER_LENGTH,
+                                                                    skipEntries + 1);
+    slot->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+/** Copy the calling thread's most recent throw site.
+ *
+ * @return The number of addresses copied, or 0 if it has been overwritten.
+ */
+static int copyThrowSite(uintptr_t* backtrace)
+{
+    const VicrabCrashThread thisThread = vicrabcrashthread_self();
+    ThrowSite* slot = slotForThread(thisThread);
+    const uint32_t sequence = slot->sequence.load(std::memory_order_acquire);
+    if((sequence & 1) != 0 || slot->thread.load(std::memory_order_relaxed) != thisThread)
+    {
+        return 0;
+    }
+    int length = slot->backtraceLength;
+    memcpy(backtrace, slot->backtrace, (size_t)length * sizeof(*backtrace));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if(slot->sequence.load(std::memory_order_relaxed) != sequence)
+    {
+        return 0;
+    }
+    return length;
+}
 
 
 // ============================================================================
@@ -82,10 +208,11 @@ extern "C"
 
     void __cxa_throw(void* thrown_exception, std::type_info* tinfo, void (*dest)(void*))
     {
-        if(g_captureNextStackTrace)
+        if(g_isEnabled)
         {
-            vicrabcrashsc_initSelfThread(&g_stackCursor, 1);
+            recordThrowSite(1);
         }
+        vicrabcrashcm_cppexceptionstats_countThrow(tinfo, (uintptr_t)__builtin_return_address(0));
 
         static cxa_throw_type orig_cxa_throw = NULL;
         unlikely_if(orig_cxa_throw == NULL)
@@ -97,6 +224,166 @@ extern "C"
     }
 }
 
+
+// ============================================================================
+#pragma mark - Formatters -
+// ============================================================================
+
+template<typename T> static void formatSigned(const void* exception, char* buffer, int bufferLength)
+{
+    snprintf(buffer, (size_t)bufferLength, "%lld", (long long)*(const T*)exception);
+}
+
+template<typename T> static void formatUnsigned(const void* exception, char* buffer, int bufferLength)
+{
+    snprintf(buffer, (size_t)bufferLength, "%llu", (unsigned long long)*(const T*)exception);
+}
+
+template<typename T> static void formatFloat(const void* exception, char* buffer, int bufferLength)
+{
+    snprintf(buffer, (size_t)bufferLength, "%Lf", (long double)*(const T*)exception);
+}
+
+static void formatCString(const void* exception, char* buffer, int bufferLength)
+{
+    snprintf(buffer, (size_t)bufferLength, "%s", *(const char* const*)exception);
+}
+
+static void formatString(const void* exception, char* buffer, int bufferLength)
+{
+    snprintf(buffer, (size_t)bufferLength, "%s", ((const std::string*)exception)->c_str());
+}
+
+static void formatSystemError(const void* exception, char* buffer, int bufferLength)
+{
+    const std::system_error* error = (const std::system_error*)exception;
+    snprintf(buffer, (size_t)bufferLength, "%s (%s: %d)", error->what(), error->code().category().name(), error->code().value());
+}
+
+static bool addFormatter(const std::type_info* type, VicrabCrashCPPExceptionFormatter format)
+{
+    pthread_mutex_lock(&g_formattersMutex);
+    int count = g_formatterCount.load(std::memory_order_relaxed);
+    bool isAdded = count < MAX_FORMATTERS;
+    if(isAdded)
+    {
+        g_formatters[count].type = type;
+        g_formatters[count].format = format;
+        g_formatterCount.store(count + 1, std::memory_order_release);
+    }
+    pthread_mutex_unlock(&g_formattersMutex);
+    return isAdded;
+}
+
+static void addDefaultFormatters()
+{
+    addFormatter(&typeid(char), formatSigned<char>);
+    addFormatter(&typeid(short), formatSigned<short>);
+    addFormatter(&typeid(int), formatSigned<int>);
+    addFormatter(&typeid(long), formatSigned<long>);
+    addFormatter(&typeid(long long), formatSigned<long long>);
+    addFormatter(&typeid(unsigned char), formatUnsigned<unsigned char>);
+    addFormatter(&typeid(unsigned short), formatUnsigned<unsigned short>);
+    addFormatter(&typeid(unsigned int), formatUnsigned<unsigned int>);
+    addFormatter(&typeid(unsigned long), formatUnsigned<unsigned long>);
+    addFormatter(&typeid(unsigned long long), formatUnsigned<unsigned long long>);
+    addFormatter(&typeid(float), formatFloat<float>);
+    addFormatter(&typeid(double), formatFloat<double>);
+    addFormatter(&typeid(long double), formatFloat<long double>);
+    addFormatter(&typeid(char*), formatCString);
+    addFormatter(&typeid(const char*), formatCString);
+    addFormatter(&typeid(std::string), formatString);
+    addFormatter(&typeid(std::system_error), formatSystemError);
+}
+
+/** Describe the exception with the formatter registered for its exact type.
+ * Searched newest first, so that apps can override the defaults.
+ */
+static bool formatWithFormatter(const std::type_info* type, const void* exception, char* buffer, int bufferLength)
+{
+    for(int i = g_formatterCount.load(std::memory_order_acquire) - 1; i >= 0; i--)
+    {
+        if(*g_formatters[i].type == *type)
+        {
+            g_formatters[i].format(exception, buffer, bufferLength);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void appendNestedExceptions(const std::exception& exception, char* buffer, int bufferLength)
+{
+    const std::nested_exception* nested = dynamic_cast<const std::nested_exception*>(&exception);
+    for(int depth = 0; depth < MAX_NESTED_EXCEPTIONS && nested != NULL && nested->nested_ptr() != NULL; depth++)
+    {
+        size_t length = strlen(buffer);
+        try
+        {
+            std::rethrow_exception(nested->nested_ptr());
+        }
+        catch(const std::exception& inner)
+        {
+            snprintf(buffer + length, (size_t)bufferLength - length, " <- %s", inner.what());
+            nested = dynamic_cast<const std::nested_exception*>(&inner);
+        }
+        catch(...)
+        {
+            snprintf(buffer + length, (size_t)bufferLength - length, " <- (unknown)");
+            nested = NULL;
+        }
+    }
+}
+
+/** Describe an exception without a formatter for its exact type, which can
+ * only be done by rethrowing it and catching a base class.
+ */
+static bool formatByRethrowing(char* buffer, int bufferLength)
+{
+    try
+    {
+        throw;
+    }
+    catch(const std::exception& exc)
+    {
+        snprintf(buffer, (size_t)bufferLength, "%s", exc.what());
+        appendNestedExceptions(exc, buffer, bufferLength);
+        return true;
+    }
+    catch(...)
+    {
+        return false;
+    }
+}
+
+/** The thrown object of the exception currently being handled. */
+static const void* currentExceptionObject()
+{
+    // Both libc++ and libstdc++ implement exception_ptr as a single pointer to
+    // the thrown object, which stays alive while the exception is handled.
+    std::exception_ptr exception = std::current_exception();
+    static_assert(sizeof(exception) == sizeof(void*), "Unexpected exception_ptr layout");
+    return *reinterpret_cast<void* const*>(&exception);
+}
+
+static const char* demangle(const char* name)
+{
+    int status = 0;
+    size_t length = g_demangleBufferLength;
+    char* demangled = __cxxabiv1::__cxa_demangle(name, g_demangleBuffer, &length, &status);
+    if(status != 0 || demangled == NULL)
+    {
+        return name;
+    }
+    // The buffer is reallocated if the name doesn't fit.
+    g_demangleBuffer = demangled;
+    if(length > g_demangleBufferLength)
+    {
+        g_demangleBufferLength = length;
+    }
+    return demangled;
+}
+
 static void CPPExceptionTerminate(void)
 {
     vicrabcrashmc_suspendEnvironment();
@@ -118,40 +405,35 @@ static void CPPExceptionTerminate(void)
         const char* description = descriptionBuff;
         descriptionBuff[0] = 0;
 
+        // Copy the throw site first, in case anything below throws as well.
+        int throwSiteLength = copyThrowSite(g_throwSiteBacktrace);
+
         VicrabCrashLOG_DEBUG("Discovering what kind of exception was thrown.");
-        g_captureNextStackTrace = false;
-        try
+        const void* exception = currentExceptionObject();
+        if(tinfo == NULL || exception == NULL ||
+           !formatWithFormatter(tinfo, exception, descriptionBuff, sizeof(descriptionBuff)))
         {
-            throw;
+            if(!formatByRethrowing(descriptionBuff, sizeof(descriptionBuff)))
+            {
+                description = NULL;
+            }
         }
-        catch(std::exception& exc)
+        if(name != NULL)
         {
-            strncpy(descriptionBuff, exc.what(), sizeof(descriptionBuff));
+            name = demangle(name);
         }
-#define CATCH_VALUE(TYPE, PRINTFTYPE) \
-catch(TYPE value)\
-{ \
-    snprintf(descriptionBuff, sizeof(descriptionBuff), "%" #PRINTFTYPE, value); \
-}
-        CATCH_VALUE(char,                 d)
-        CATCH_VALUE(short,                d)
-        CATCH_VALUE(int,                  d)
-        CATCH_VALUE(long,                ld)
-        CATCH_VALUE(long long,          lld)
-        CATCH_VALUE(unsigned char,        u)
-        CATCH_VALUE(unsigned short,       u)
-        CATCH_VALUE(unsigned int,         u)
-        CATCH_VALUE(unsigned long,       lu)
-        CATCH_VALUE(unsigned long long, llu)
-        CATCH_VALUE(float,                f)
-        CATCH_VALUE(double,               f)
-        CATCH_VALUE(long double,         Lf)
-        CATCH_VALUE(char*,                s)
-        catch(...)
+
+        if(throwSiteLength > 0)
         {
-            description = NULL;
+            vicrabcrashsc_initWithBacktrace(&g_stackCursor, g_throwSiteBacktrace, throwSiteLength, 0);
+        }
+        else
+        {
+            // The exception hasn't been unwound, so the throw site is still
+            // below us on the stack.
+            VicrabCrashLOG_DEBUG("No throw site recorded. Using the current stack.");
+            vicrabcrashsc_initSelfThread(&g_stackCursor, 0);
         }
-        g_captureNextStackTrace = g_isEnabled;
 
         // TODO: Should this be done here? Maybe better in the exception handler?
         VicrabCrashMC_NEW_CONTEXT(machineContext);
@@ -191,6 +473,13 @@ static void initialize()
     {
         isInitialized = true;
         vicrabcrashsc_initCursor(&g_stackCursor, NULL, NULL);
+        g_demangleBufferLength = DEMANGLE_BUFFER_LENGTH;
+        g_demangleBuffer = (char*)malloc(g_demangleBufferLength);
+        if(g_demangleBuffer == NULL)
+        {
+            g_demangleBufferLength = 0;
+        }
+        pthread_once(&g_defaultFormattersOnce, addDefaultFormatters);
     }
 }
 
@@ -210,7 +499,6 @@ static void setEnabled(bool isEnabled)
         {
             std::set_terminate(g_originalTerminateHandler);
         }
-        g_captureNextStackTrace = isEnabled;
     }
 }
 
@@ -219,12 +507,20 @@ static bool isEnabled()
     return g_isEnabled;
 }
 
+extern "C" bool vicrabcrashcm_cppexception_addFormatter(const void* typeInfo, VicrabCrashCPPExceptionFormatter formatter)
+{
+    // The defaults go first, so that they can be overridden.
+    pthread_once(&g_defaultFormattersOnce, addDefaultFormatters);
+    return addFormatter((const std::type_info*)typeInfo, formatter);
+}
+
 extern "C" VicrabCrashMonitorAPI* vicrabcrashcm_cppexception_getAPI()
 {
     static VicrabCrashMonitorAPI api =
     {
         .setEnabled = setEnabled,
-        .isEnabled = isEnabled
+        .isEnabled = isEnabled,
+        .addContextualInfoToEvent = NULL
     };
     return &api;
 }
@@ -31,6 +31,34 @@ extern "C" {
 
 #include "VicrabCrashMonitor.h"
 
+#include <stdbool.h>
+
+
+/** Describes a thrown C++ object in a crash report.
+ *
+ * @param exception The thrown object.
+ *
+ * @param buffer Receives the null terminated description.
+ *
+ * @param bufferLength The length of buffer.
+ */
+typedef void (*VicrabCrashCPPExceptionFormatter)(const void* exception, char* buffer, int bufferLength);
+
+/** Register a formatter for an exception type, replacing any earlier one.
+ * Formatters match the exact thrown type. Exceptions without one are
+ * described by what() if they derive from std::exception.
+ *
+ * Formatters for integers, floats, C strings, std::string and
+ * std::system_error are registered by default.
+ *
+ * @param typeInfo The type's std::type_info (&typeid(MyException)).
+ *
+ * @param formatter The formatter.
+ *
+ * @return false if too many formatters are registered.
+ */
+bool vicrabcrashcm_cppexception_addFormatter(const void* typeInfo, VicrabCrashCPPExceptionFormatter formatter);
+
 
 /** Access the Monitor API.
  */
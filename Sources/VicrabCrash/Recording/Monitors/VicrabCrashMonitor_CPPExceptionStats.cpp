@@ -0,0 +1,342 @@
+//
+//  VicrabCrashMonitor_CPPExceptionStats.cpp
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#include "VicrabCrashMonitor_CPPExceptionStats.h"
+#include "VicrabCrashMonitorContext.h"
+#include "VicrabCrashDate.h"
+#include "VicrabCrashID.h"
+#include "VicrabCrashMachineContext.h"
+#include "VicrabCrashStackCursor_Backtrace.h"
+#include "VicrabCrashThread.h"
+
+//#define VicrabCrashLogger_LocalLevel TRACE
+#include "VicrabCrashLogger.h"
+
+#include <atomic>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <typeinfo>
+
+
+/** Distinct (type, throw site) pairs counted. Must be a power of 2. */
+#define TABLE_SIZE 256
+
+/** Slots examined before a throw is counted as dropped. */
+#define MAX_PROBES 16
+
+#define DEFAULT_SAMPLE_INTERVAL 10
+#define DEFAULT_REPORT_INTERVAL 60.0
+
+
+typedef struct
+{
+    /** Hash of type and throwSite, or 0 if the slot is free. */
+    std::atomic<uint64_t> key;
+    /** Set once, after the key. NULL until then. */
+    std::atomic<const std::type_info*> type;
+    std::atomic<uintptr_t> throwSite;
+    std::atomic<uint32_t> count;
+} Entry;
+
+
+// ============================================================================
+#pragma mark - Globals -
+// ============================================================================
+
+static volatile bool g_isEnabled = false;
+
+static std::atomic<uint32_t> g_sampleInterval(DEFAULT_SAMPLE_INTERVAL);
+static std::atomic<uint64_t> g_throwCount;
+static std::atomic<uint64_t> g_droppedCount;
+static Entry g_table[TABLE_SIZE];
+
+/** Serializes enabling and configuring the monitor. */
+static pthread_mutex_t g_stateMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** Lets the reporter thread be woken up early to stop. */
+static pthread_mutex_t g_reporterMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_reporterCondition = PTHREAD_COND_INITIALIZER;
+static pthread_t g_reporterThread;
+static bool g_isReporterRunning;
+static bool g_shouldStopReporter;
+/** Only changed while the reporter thread isn't running. */
+static double g_reportInterval = DEFAULT_REPORT_INTERVAL;
+
+
+// ============================================================================
+#pragma mark - Counting -
+// ============================================================================
+
+static inline uint64_t hashThrow(const void* type, uintptr_t throwSite)
+{
+    uint64_t hash = (uint64_t)(uintptr_t)type * 0x9E3779B97F4A7C15ULL;
+    hash ^= (uint64_t)throwSite + 0x7F4A7C159E3779B9ULL + (hash << 6) + (hash >> 2);
+    hash ^= hash >> 29;
+    // 0 marks a free slot.
+    return hash | 1;
+}
+
+extern "C" void vicrabcrashcm_cppexceptionstats_countThrow(const void* type, uintptr_t throwSite)
+{
+    if(!g_isEnabled)
+    {
+        return;
+    }
+    uint64_t throwNumber = g_throwCount.fetch_add(1, std::memory_order_relaxed);
+    if(throwNumber % g_sampleInterval.load(std::memory_order_relaxed) != 0)
+    {
+        return;
+    }
+
+    const uint64_t key = hashThrow(type, throwSite);
+    for(uint32_t i = 0; i < MAX_PROBES; i++)
+    {
+        Entry* entry = &g_table[(key + i) & (TABLE_SIZE - 1)];
+        uint64_t entryKey = entry->key.load(std::memory_order_relaxed);
+        if(entryKey == 0 && entry->key.compare_exchange_strong(entryKey, key, std::memory_order_relaxed))
+        {
+            entry->throwSite.store(throwSite, std::memory_order_relaxed);
+            entry->type.store((const std::type_info*)type, std::memory_order_release);
+            entryKey = key;
+        }
+        if(entryKey == key)
+        {
+            entry->count.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+    g_droppedCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+// ============================================================================
+#pragma mark - Reporting -
+// ============================================================================
+
+/** Take the counts gathered since the last report and report them, and free
+ * the slots of throw sites that weren't seen since the previous one.
+ */
+static void reportCounts(uint64_t durationNanoseconds)
+{
+    // Most frequent first, so the first site is the representative one.
+    VicrabCrashThrowSiteCount sites[TABLE_SIZE];
+    int siteCount = 0;
+    for(int i = 0; i < TABLE_SIZE; i++)
+    {
+        Entry* entry = &g_table[i];
+        const std::type_info* type = entry->type.load(std::memory_order_acquire);
+        if(type == NULL)
+        {
+            continue;
+        }
+        uint32_t count = entry->count.exchange(0, std::memory_order_relaxed);
+        if(count == 0)
+        {
+            // Idle for a whole interval, so make room for other throw sites.
+            // A throw racing with this may be counted for the slot's next owner.
+            entry->type.store(NULL, std::memory_order_relaxed);
+            entry->key.store(0, std::memory_order_release);
+            continue;
+        }
+        VicrabCrashThrowSiteCount site = {type->name(), entry->throwSite.load(std::memory_order_relaxed), count};
+        int j = siteCount++;
+        for(; j > 0 && sites[j - 1].count < site.count; j--)
+        {
+            sites[j] = sites[j - 1];
+        }
+        sites[j] = site;
+    }
+    uint64_t throwCount = g_throwCount.exchange(0, std::memory_order_relaxed);
+    uint64_t droppedCount = g_droppedCount.exchange(0, std::memory_order_relaxed);
+    if(siteCount == 0)
+    {
+        return;
+    }
+
+    char reason[100];
+    snprintf(reason, sizeof(reason), "%llu C++ exceptions thrown in %llu s",
+             (unsigned long long)throwCount, (unsigned long long)(durationNanoseconds / 1000000000));
+
+    char eventID[37];
+    vicrabcrashid_generate(eventID);
+    VicrabCrashMC_NEW_CONTEXT(machineContext);
+    vicrabcrashmc_getContextForThread(vicrabcrashthread_self(), machineContext, false);
+    VicrabCrashStackCursor stackCursor;
+    vicrabcrashsc_initWithBacktrace(&stackCursor, &sites[0].address, 1, 0);
+    VicrabCrashCapturedThread thisThread;
+    memset(&thisThread, 0, sizeof(thisThread));
+    thisThread.thread = vicrabcrashthread_self();
+    thisThread.backtrace = &sites[0].address;
+    thisThread.backtraceLength = 1;
+    thisThread.crashed = true;
+
+    VicrabCrashLOG_DEBUG("Filling out context.");
+    VicrabCrash_MonitorContext context;
+    memset(&context, 0, sizeof(context));
+    context.crashType = VicrabCrashMonitorTypeCPPExceptionStats;
+    context.eventID = eventID;
+    context.registersAreValid = false;
+    context.offendingMachineContext = machineContext;
+    context.stackCursor = &stackCursor;
+    context.crashReason = reason;
+    context.exceptionName = sites[0].name;
+    context.capturedThreads = &thisThread;
+    context.capturedThreadCount = 1;
+    context.CPPExceptionStats.sites = sites;
+    context.CPPExceptionStats.siteCount = siteCount;
+    context.CPPExceptionStats.sampleInterval = (int)g_sampleInterval.load(std::memory_order_relaxed);
+    context.CPPExceptionStats.throwCount = throwCount;
+    context.CPPExceptionStats.droppedCount = droppedCount;
+    context.CPPExceptionStats.durationNanoseconds = durationNanoseconds;
+
+    vicrabcrashcm_handleException(&context);
+}
+
+static void* runReporter(__unused void* userData)
+{
+    pthread_mutex_lock(&g_reporterMutex);
+    uint64_t periodStart = vicrabcrashdate_monotonicNanoseconds();
+    while(!g_shouldStopReporter)
+    {
+        // Timed waits take wall clock time.
+        struct timespec wakeTime;
+        clock_gettime(CLOCK_REALTIME, &wakeTime);
+        uint64_t interval = (uint64_t)(g_reportInterval * 1000000000.0);
+        wakeTime.tv_sec += (time_t)(interval / 1000000000ULL);
+        wakeTime.tv_nsec += (long)(interval % 1000000000ULL);
+        if(wakeTime.tv_nsec >= 1000000000L)
+        {
+            wakeTime.tv_sec++;
+            wakeTime.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&g_reporterCondition, &g_reporterMutex, &wakeTime);
+        if(g_shouldStopReporter)
+        {
+            break;
+        }
+
+        uint64_t now = vicrabcrashdate_monotonicNanoseconds();
+        if(now - periodStart < interval)
+        {
+            continue;
+        }
+        pthread_mutex_unlock(&g_reporterMutex);
+        reportCounts(now - periodStart);
+        pthread_mutex_lock(&g_reporterMutex);
+        periodStart = now;
+    }
+    pthread_mutex_unlock(&g_reporterMutex);
+    return NULL;
+}
+
+/** Must be called with g_stateMutex held. */
+static void startReporter()
+{
+    if(g_reportInterval <= 0)
+    {
+        return;
+    }
+    g_shouldStopReporter = false;
+    int error = pthread_create(&g_reporterThread, NULL, &runReporter, NULL);
+    if(error != 0)
+    {
+        VicrabCrashLOG_ERROR("pthread_create: %s", strerror(error));
+        return;
+    }
+    g_isReporterRunning = true;
+}
+
+/** Must be called with g_stateMutex held. */
+static void stopReporter()
+{
+    if(!g_isReporterRunning)
+    {
+        return;
+    }
+    pthread_mutex_lock(&g_reporterMutex);
+    g_shouldStopReporter = true;
+    pthread_cond_signal(&g_reporterCondition);
+    pthread_mutex_unlock(&g_reporterMutex);
+    pthread_join(g_reporterThread, NULL);
+    g_isReporterRunning = false;
+}
+
+
+// ============================================================================
+#pragma mark - API -
+// ============================================================================
+
+static void setEnabled(bool isEnabled)
+{
+    pthread_mutex_lock(&g_stateMutex);
+    if(isEnabled != g_isEnabled)
+    {
+        g_isEnabled = isEnabled;
+        if(isEnabled)
+        {
+            VicrabCrashLOG_DEBUG("Starting C++ exception stats.");
+            startReporter();
+        }
+        else
+        {
+            VicrabCrashLOG_DEBUG("Stopping C++ exception stats.");
+            stopReporter();
+        }
+    }
+    pthread_mutex_unlock(&g_stateMutex);
+}
+
+static bool isEnabled()
+{
+    return g_isEnabled;
+}
+
+extern "C" VicrabCrashMonitorAPI* vicrabcrashcm_cppexceptionstats_getAPI()
+{
+    static VicrabCrashMonitorAPI api =
+    {
+        .setEnabled = setEnabled,
+        .isEnabled = isEnabled,
+        .addContextualInfoToEvent = NULL
+    };
+    return &api;
+}
+
+extern "C" void vicrabcrashcm_setCPPExceptionStatsOptions(int sampleInterval, double reportInterval)
+{
+    pthread_mutex_lock(&g_stateMutex);
+    g_sampleInterval.store(sampleInterval > 0 ? (uint32_t)sampleInterval : 1, std::memory_order_relaxed);
+    stopReporter();
+    g_reportInterval = reportInterval;
+    if(g_isEnabled)
+    {
+        startReporter();
+    }
+    pthread_mutex_unlock(&g_stateMutex);
+}
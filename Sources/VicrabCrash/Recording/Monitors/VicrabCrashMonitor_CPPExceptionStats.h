@@ -0,0 +1,76 @@
+//
+//  VicrabCrashMonitor_CPPExceptionStats.h
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+
+
+/* Counts C++ throws by exception type and throw site, whether or not they
+ * are caught, and periodically writes a non-fatal report with the totals.
+ */
+
+
+#ifndef HDR_VicrabCrashMonitor_CPPExceptionStats_h
+#define HDR_VicrabCrashMonitor_CPPExceptionStats_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "VicrabCrashMonitor.h"
+
+#include <stdint.h>
+
+
+/** Configure how throws are sampled and how often the totals are reported.
+ * Takes effect immediately if the monitor is running.
+ *
+ * @param sampleInterval Count one in this many throws. Default 10.
+ *
+ * @param reportInterval Seconds between reports. Nothing is reported for an
+ *                       interval without throws. Default 60.
+ */
+void vicrabcrashcm_setCPPExceptionStatsOptions(int sampleInterval, double reportInterval);
+
+/** Count a throw. Called for every throw by the C++ exception monitor's
+ * __cxa_throw hook. Returns immediately if the monitor isn't running.
+ *
+ * @param type The thrown type's std::type_info.
+ *
+ * @param throwSite The return address into the function that threw.
+ */
+void vicrabcrashcm_cppexceptionstats_countThrow(const void* type, uintptr_t throwSite);
+
+/** Access the Monitor API.
+ */
+VicrabCrashMonitorAPI* vicrabcrashcm_cppexceptionstats_getAPI(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HDR_VicrabCrashMonitor_CPPExceptionStats_h
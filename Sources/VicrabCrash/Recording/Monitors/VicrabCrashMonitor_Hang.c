@@ -0,0 +1,305 @@
+//
+//  VicrabCrashMonitor_Hang.c
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#include "VicrabCrashMonitor_Hang.h"
+#include "VicrabCrashMonitorContext.h"
+#include "VicrabCrashID.h"
+#include "VicrabCrashThread.h"
+#include "VicrabCrashStackCursor_Backtrace.h"
+#include "VicrabCrashStackCursor_MachineContext.h"
+#include "VicrabCrashSystemCapabilities.h"
+#include "VicrabCrashWatchdog.h"
+
+//#define VicrabCrashLogger_LocalLevel TRACE
+#include "VicrabCrashLogger.h"
+
+#if VicrabCrashCRASH_HOST_APPLE
+#include <dispatch/dispatch.h>
+#endif
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+
+/** Distinct backtraces kept per hang. Further distinct ones are only counted. */
+#define kMaxSamples 32
+
+/** Most frames kept per sampled backtrace. */
+#define kMaxSampleFrames 64
+
+/** Longest the main thread stays suspended for one sample. */
+#define kMaxSuspensionNanoseconds 2000000
+
+/** The sample interval stops growing here. */
+#define kMaxSampleIntervalNanoseconds 1000000000ULL
+
+#define kDefaultHangThreshold 0.25
+#define kDefaultSampleInterval 0.05
+
+
+typedef struct
+{
+    uintptr_t backtrace[kMaxSampleFrames];
+    int backtraceLength;
+    int count;
+} Sample;
+
+
+// ============================================================================
+#pragma mark - Globals -
+// ============================================================================
+
+static volatile bool g_isEnabled = false;
+
+static pthread_mutex_t g_watchdogMutex = PTHREAD_MUTEX_INITIALIZER;
+static VicrabCrashWatchdog* g_watchdog;
+
+static double g_hangThreshold = kDefaultHangThreshold;
+static double g_sampleInterval = kDefaultSampleInterval;
+
+static volatile VicrabCrashThread g_mainQueueThread;
+
+#if VicrabCrashCRASH_HOST_APPLE
+/** Only touched on the watchdog thread. */
+static Sample g_samples[kMaxSamples];
+static int g_sampleCount;
+static int g_totalSampleCount;
+#endif
+
+
+// ============================================================================
+#pragma mark - Sampling -
+// ============================================================================
+
+#if VicrabCrashCRASH_HOST_APPLE
+static void onHangStarted(__unused void* userData)
+{
+    g_sampleCount = 0;
+    g_totalSampleCount = 0;
+}
+
+static void onSample(__unused uint64_t elapsedNanoseconds, __unused void* userData)
+{
+    VicrabCrashThread mainThread = g_mainQueueThread;
+    if(mainThread == 0)
+    {
+        return;
+    }
+
+    uintptr_t backtrace[kMaxSampleFrames];
+    int length = vicrabcrashsc_copySuspendedBacktrace(mainThread, backtrace, kMaxSampleFrames, kMaxSuspensionNanoseconds);
+    if(length == 0)
+    {
+        return;
+    }
+    g_totalSampleCount++;
+
+    for(int i = 0; i < g_sampleCount; i++)
+    {
+        Sample* sample = &g_samples[i];
+        if(sample->backtraceLength == length && memcmp(sample->backtrace, backtrace, (size_t)length * sizeof(*backtrace)) == 0)
+        {
+            sample->count++;
+            return;
+        }
+    }
+    if(g_sampleCount < kMaxSamples)
+    {
+        Sample* sample = &g_samples[g_sampleCount++];
+        memcpy(sample->backtrace, backtrace, (size_t)length * sizeof(*backtrace));
+        sample->backtraceLength = length;
+        sample->count = 1;
+    }
+}
+
+static void onHangEnded(uint64_t durationNanoseconds, __unused void* userData)
+{
+    if(g_sampleCount == 0)
+    {
+        VicrabCrashLOG_DEBUG("Hang of %llu ms ended without samples", (unsigned long long)(durationNanoseconds / 1000000));
+        return;
+    }
+
+    // Most frequent first, so the first sample is the representative one.
+    VicrabCrashHangSample samples[kMaxSamples];
+    for(int i = 0; i < g_sampleCount; i++)
+    {
+        VicrabCrashHangSample sample = {g_samples[i].backtrace, g_samples[i].backtraceLength, g_samples[i].count};
+        int j = i;
+        for(; j > 0 && samples[j - 1].count < sample.count; j--)
+        {
+            samples[j] = samples[j - 1];
+        }
+        samples[j] = sample;
+    }
+
+    char reason[100];
+    snprintf(reason, sizeof(reason), "Main thread was unresponsive for %llu ms",
+             (unsigned long long)(durationNanoseconds / 1000000));
+
+    char eventID[37];
+    vicrabcrashid_generate(eventID);
+    VicrabCrashMC_NEW_CONTEXT(machineContext);
+    vicrabcrashmc_getContextForThread(vicrabcrashthread_self(), machineContext, false);
+    VicrabCrashStackCursor stackCursor;
+    vicrabcrashsc_initWithBacktrace(&stackCursor, samples[0].backtrace, samples[0].backtraceLength, 0);
+    VicrabCrashCapturedThread mainThread =
+    {
+        .thread = g_mainQueueThread,
+        .backtrace = samples[0].backtrace,
+        .backtraceLength = samples[0].backtraceLength,
+        .crashed = true,
+    };
+
+    VicrabCrashLOG_DEBUG("Filling out context.");
+    VicrabCrash_MonitorContext context;
+    memset(&context, 0, sizeof(context));
+    context.crashType = VicrabCrashMonitorTypeMainThreadHang;
+    context.eventID = eventID;
+    context.registersAreValid = false;
+    context.offendingMachineContext = machineContext;
+    context.stackCursor = &stackCursor;
+    context.crashReason = reason;
+    context.capturedThreads = &mainThread;
+    context.capturedThreadCount = 1;
+    context.hang.durationNanoseconds = durationNanoseconds;
+    context.hang.samples = samples;
+    context.hang.sampleCount = g_sampleCount;
+    context.hang.totalSampleCount = g_totalSampleCount;
+
+    vicrabcrashcm_handleException(&context);
+}
+#endif
+
+
+// ============================================================================
+#pragma mark - Watchdog -
+// ============================================================================
+
+#if VicrabCrashCRASH_HOST_APPLE
+static void answerPing(void* watchdog)
+{
+    g_mainQueueThread = vicrabcrashthread_self();
+    vicrabcrashwd_answer(watchdog);
+}
+
+static void postPing(VicrabCrashWatchdog* watchdog, __unused void* userData)
+{
+    dispatch_async_f(dispatch_get_main_queue(), watchdog, answerPing);
+}
+
+static uint64_t toNanoseconds(double seconds)
+{
+    return (uint64_t)(seconds * 1000000000.0);
+}
+#endif
+
+/** Must be called with g_watchdogMutex held. */
+static void startWatchdog()
+{
+    if(g_hangThreshold <= 0)
+    {
+        return;
+    }
+#if VicrabCrashCRASH_HOST_APPLE
+    VicrabCrashWatchdogConfig config =
+    {
+        .postPing = postPing,
+        .onHangStarted = onHangStarted,
+        .onSample = onSample,
+        .onHangEnded = onHangEnded,
+        // Pinging at half the threshold bounds how late a hang can be noticed.
+        .pingIntervalNanoseconds = toNanoseconds(g_hangThreshold / 2),
+        .hangThresholdNanoseconds = toNanoseconds(g_hangThreshold),
+        .sampleIntervalNanoseconds = toNanoseconds(g_sampleInterval),
+        .maxSampleIntervalNanoseconds = kMaxSampleIntervalNanoseconds,
+    };
+    g_watchdog = vicrabcrashwd_create(&config);
+#else
+    VicrabCrashLOG_WARN("Hang monitoring needs a main dispatch queue to watch.");
+#endif
+}
+
+/** Must be called with g_watchdogMutex held. */
+static void stopWatchdog()
+{
+    vicrabcrashwd_destroy(g_watchdog);
+    g_watchdog = NULL;
+}
+
+
+// ============================================================================
+#pragma mark - API -
+// ============================================================================
+
+static void setEnabled(bool isEnabled)
+{
+    pthread_mutex_lock(&g_watchdogMutex);
+    if(isEnabled != g_isEnabled)
+    {
+        g_isEnabled = isEnabled;
+        if(isEnabled)
+        {
+            VicrabCrashLOG_DEBUG("Starting hang monitor.");
+            startWatchdog();
+        }
+        else
+        {
+            VicrabCrashLOG_DEBUG("Stopping hang monitor.");
+            stopWatchdog();
+        }
+    }
+    pthread_mutex_unlock(&g_watchdogMutex);
+}
+
+static bool isEnabled()
+{
+    return g_isEnabled;
+}
+
+VicrabCrashMonitorAPI* vicrabcrashcm_hang_getAPI()
+{
+    static VicrabCrashMonitorAPI api =
+    {
+        .setEnabled = setEnabled,
+        .isEnabled = isEnabled
+    };
+    return &api;
+}
+
+void vicrabcrashcm_setHangThresholds(double hangThreshold, double sampleInterval)
+{
+    pthread_mutex_lock(&g_watchdogMutex);
+    g_hangThreshold = hangThreshold;
+    g_sampleInterval = sampleInterval;
+    if(g_isEnabled)
+    {
+        stopWatchdog();
+        startWatchdog();
+    }
+    pthread_mutex_unlock(&g_watchdogMutex);
+}
@@ -0,0 +1,67 @@
+//
+//  VicrabCrashMonitor_Hang.h
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+/* Detects periods where the main thread stops answering its run loop, samples
+ * its stack while it is blocked, and writes a non-fatal report once it
+ * responds again.
+ */
+
+
+#ifndef HDR_VicrabCrashMonitor_Hang_h
+#define HDR_VicrabCrashMonitor_Hang_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "VicrabCrashMonitor.h"
+
+#include <stdbool.h>
+
+
+/** Configure when the main thread counts as hung and how often it is sampled.
+ * Takes effect immediately if the monitor is running.
+ *
+ * @param hangThreshold Seconds the main thread must be unresponsive before it
+ *                      counts as a hang (0 = disabled). Default 0.25.
+ *
+ * @param sampleInterval Seconds between the first stack samples of a hang.
+ *                       The interval grows as the hang goes on. Default 0.05.
+ */
+void vicrabcrashcm_setHangThresholds(double hangThreshold, double sampleInterval);
+
+/** Access the Monitor API.
+ */
+VicrabCrashMonitorAPI* vicrabcrashcm_hang_getAPI(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HDR_VicrabCrashMonitor_Hang_h
@@ -0,0 +1,419 @@
+//
+//  VicrabCrashMonitor_Profiler.c
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#include "VicrabCrashMonitor_Profiler.h"
+#include "VicrabCrashMonitorContext.h"
+#include "VicrabCrashDate.h"
+#include "VicrabCrashMachineContext.h"
+#include "VicrabCrashRingBuffer.h"
+#include "VicrabCrashStackCursor_MachineContext.h"
+#include "VicrabCrashSystemCapabilities.h"
+#include "VicrabCrashThread.h"
+
+//#define VicrabCrashLogger_LocalLevel TRACE
+#include "VicrabCrashLogger.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+
+
+/** Most frames kept per sample. */
+#define kMaxSampleFrames 128
+
+/** Longest a thread stays suspended for one sample. */
+#define kMaxSuspensionNanoseconds 1000000
+
+/** Words in the sample ring. Holds about a second of deep main thread samples. */
+#define kRingCapacity 16384
+
+/** Distinct call tree nodes kept. The tree restarts once it is full. */
+#define kMaxNodes 4096
+
+/** The tree restarts after covering this much time, so that reports show
+ * recent activity rather than everything since launch.
+ */
+#define kWindowNanoseconds 60000000000ULL
+
+#define kDefaultSamplesPerSecond 100
+
+
+typedef struct
+{
+    uintptr_t address;
+    int32_t parent;
+    int32_t firstChild;
+    int32_t nextSibling;
+    uint32_t selfCount;
+    uint32_t totalCount;
+} TreeNode;
+
+
+// ============================================================================
+#pragma mark - Globals -
+// ============================================================================
+
+static volatile bool g_isEnabled = false;
+
+static pthread_mutex_t g_samplerMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t g_samplerThread;
+static bool g_isSamplerRunning;
+static atomic_bool g_shouldStopSampler;
+
+static int g_samplesPerSecond = kDefaultSamplesPerSecond;
+static bool g_sampleAllThreads = false;
+
+/** The options the running sampler was started with. */
+static int g_samplerSamplesPerSecond;
+#if VicrabCrashCRASH_HAS_THREADS_API
+static bool g_samplerSampleAllThreads;
+#endif
+
+/** Written by the sampler thread, read by whoever holds g_treeLock. */
+static uintptr_t g_ringStorage[kRingCapacity];
+static VicrabCrashRingBuffer g_ring;
+
+/** Guards the tree and the snapshot. Never waited on, so that a crashing
+ * thread can't deadlock on a suspended sampler.
+ */
+static atomic_flag g_treeLock = ATOMIC_FLAG_INIT;
+static TreeNode g_tree[kMaxNodes];
+static int g_treeNodeCount;
+static int32_t g_firstRoot = -1;
+static int g_treeSampleCount;
+static int g_treeDroppedCount;
+static uint32_t g_ringDroppedBase;
+static uint64_t g_treeStartTime;
+
+/** The tree as of the most recent event. */
+static VicrabCrashProfileNode g_snapshot[kMaxNodes];
+
+
+// ============================================================================
+#pragma mark - Call Tree -
+// ============================================================================
+
+#if VicrabCrashCRASH_HAS_THREADS_API
+/** Must be called with g_treeLock held. */
+static void resetTree(uint64_t now)
+{
+    g_treeNodeCount = 0;
+    g_firstRoot = -1;
+    g_treeSampleCount = 0;
+    g_treeDroppedCount = 0;
+    g_ringDroppedBase = atomic_load_explicit(&g_ring.droppedCount, memory_order_relaxed);
+    g_treeStartTime = now;
+}
+#endif
+
+/** Find the child of parent (-1 = root) with the given address, adding it if
+ * needed. Must be called with g_treeLock held and a free node available.
+ */
+static int32_t childWithAddress(int32_t parent, uintptr_t address)
+{
+    int32_t* link = parent < 0 ? &g_firstRoot : &g_tree[parent].firstChild;
+    for(int32_t index = *link; index >= 0; index = g_tree[index].nextSibling)
+    {
+        if(g_tree[index].address == address)
+        {
+            return index;
+        }
+    }
+
+    int32_t index = g_treeNodeCount++;
+    TreeNode* node = &g_tree[index];
+    node->address = address;
+    node->parent = parent;
+    node->firstChild = -1;
+    node->nextSibling = *link;
+    node->selfCount = 0;
+    node->totalCount = 0;
+    *link = index;
+    return index;
+}
+
+/** Add a backtrace (innermost frame first) to the tree.
+ * Must be called with g_treeLock held.
+ */
+static void addSample(const uintptr_t* backtrace, int length)
+{
+    if(length <= 0)
+    {
+        return;
+    }
+    if(g_treeNodeCount + length > kMaxNodes)
+    {
+        g_treeDroppedCount++;
+        return;
+    }
+
+    int32_t index = -1;
+    for(int i = length - 1; i >= 0; i--)
+    {
+        index = childWithAddress(index, backtrace[i]);
+        g_tree[index].totalCount++;
+    }
+    g_tree[index].selfCount++;
+    g_treeSampleCount++;
+}
+
+/** Move everything in the ring into the tree.
+ * Must be called with g_treeLock held.
+ */
+static void drainRing()
+{
+    uintptr_t backtrace[kMaxSampleFrames];
+    int length;
+    while((length = vicrabcrashring_read(&g_ring, backtrace, kMaxSampleFrames)) >= 0)
+    {
+        addSample(backtrace, length);
+    }
+}
+
+static bool tryLockTree()
+{
+    return !atomic_flag_test_and_set_explicit(&g_treeLock, memory_order_acquire);
+}
+
+static void unlockTree()
+{
+    atomic_flag_clear_explicit(&g_treeLock, memory_order_release);
+}
+
+
+// ============================================================================
+#pragma mark - Sampling -
+// ============================================================================
+
+#if VicrabCrashCRASH_HAS_THREADS_API
+static void sampleThread(VicrabCrashThread thread)
+{
+    uintptr_t backtrace[kMaxSampleFrames];
+    int length = vicrabcrashsc_copySuspendedBacktrace(thread, backtrace, kMaxSampleFrames, kMaxSuspensionNanoseconds);
+    if(length > 0)
+    {
+        vicrabcrashring_write(&g_ring, backtrace, length);
+    }
+}
+
+static void sampleThreads(VicrabCrashThread mainThread, bool sampleAllThreads)
+{
+    if(!sampleAllThreads)
+    {
+        sampleThread(mainThread);
+        return;
+    }
+
+    const VicrabCrashThread thisThread = vicrabcrashthread_self();
+    VicrabCrashMC_NEW_CONTEXT(machineContext);
+    vicrabcrashmc_getContextForThread(thisThread, machineContext, true);
+    int threadCount = vicrabcrashmc_getThreadCount(machineContext);
+    for(int i = 0; i < threadCount; i++)
+    {
+        VicrabCrashThread thread = vicrabcrashmc_getThreadAtIndex(machineContext, i);
+        if(thread != thisThread)
+        {
+            sampleThread(thread);
+        }
+    }
+}
+
+/** Fold the latest samples into the tree, unless an event is reading it. */
+static void aggregate()
+{
+    if(!tryLockTree())
+    {
+        return;
+    }
+    uint64_t now = vicrabcrashdate_monotonicNanoseconds();
+    if(now - g_treeStartTime >= kWindowNanoseconds || g_treeDroppedCount > 0)
+    {
+        VicrabCrashLOG_DEBUG("Restarting call tree after %d samples", g_treeSampleCount);
+        resetTree(now);
+    }
+    drainRing();
+    unlockTree();
+}
+
+static void* runSampler(__unused void* userData)
+{
+    const uint64_t interval = 1000000000ULL / (uint64_t)g_samplerSamplesPerSecond;
+    const bool sampleAllThreads = g_samplerSampleAllThreads;
+    const VicrabCrashThread mainThread = vicrabcrashthread_main();
+    uint64_t nextSampleTime = vicrabcrashdate_monotonicNanoseconds();
+    while(!atomic_load(&g_shouldStopSampler))
+    {
+        sampleThreads(mainThread, sampleAllThreads);
+        aggregate();
+
+        nextSampleTime += interval;
+        uint64_t now = vicrabcrashdate_monotonicNanoseconds();
+        if(nextSampleTime <= now)
+        {
+            // Fell behind (or was suspended). Skip the missed samples.
+            nextSampleTime = now + interval;
+        }
+        uint64_t remaining = nextSampleTime - now;
+        struct timespec sleepTime = {(time_t)(remaining / 1000000000ULL), (long)(remaining % 1000000000ULL)};
+        while(nanosleep(&sleepTime, &sleepTime) != 0 && errno == EINTR)
+        {
+        }
+    }
+    return NULL;
+}
+#endif
+
+/** Must be called with g_samplerMutex held. */
+static void startSampler()
+{
+    if(g_samplesPerSecond <= 0)
+    {
+        return;
+    }
+#if VicrabCrashCRASH_HAS_THREADS_API
+    g_samplerSamplesPerSecond = g_samplesPerSecond;
+    g_samplerSampleAllThreads = g_sampleAllThreads;
+    // Start the first window now, so an event before the first aggregation
+    // doesn't report a duration measured from boot. Events only hold the
+    // tree briefly.
+    while(!tryLockTree())
+    {
+    }
+    resetTree(vicrabcrashdate_monotonicNanoseconds());
+    unlockTree();
+    atomic_store(&g_shouldStopSampler, false);
+    int error = pthread_create(&g_samplerThread, NULL, &runSampler, NULL);
+    if(error != 0)
+    {
+        VicrabCrashLOG_ERROR("pthread_create: %s", strerror(error));
+        return;
+    }
+    g_isSamplerRunning = true;
+#else
+    VicrabCrashLOG_WARN("Profiling needs to be able to suspend threads.");
+#endif
+}
+
+/** Must be called with g_samplerMutex held. */
+static void stopSampler()
+{
+    if(!g_isSamplerRunning)
+    {
+        return;
+    }
+    atomic_store(&g_shouldStopSampler, true);
+    pthread_join(g_samplerThread, NULL);
+    g_isSamplerRunning = false;
+}
+
+
+// ============================================================================
+#pragma mark - API -
+// ============================================================================
+
+static void setEnabled(bool isEnabled)
+{
+    pthread_mutex_lock(&g_samplerMutex);
+    if(isEnabled != g_isEnabled)
+    {
+        g_isEnabled = isEnabled;
+        if(isEnabled)
+        {
+            VicrabCrashLOG_DEBUG("Starting profiler.");
+            static bool isRingInitialized = false;
+            if(!isRingInitialized)
+            {
+                vicrabcrashring_init(&g_ring, g_ringStorage, kRingCapacity);
+                isRingInitialized = true;
+            }
+            startSampler();
+        }
+        else
+        {
+            VicrabCrashLOG_DEBUG("Stopping profiler.");
+            stopSampler();
+        }
+    }
+    pthread_mutex_unlock(&g_samplerMutex);
+}
+
+static bool isEnabled()
+{
+    return g_isEnabled;
+}
+
+static void addContextualInfoToEvent(VicrabCrash_MonitorContext* eventContext)
+{
+    if(!g_isEnabled || !tryLockTree())
+    {
+        return;
+    }
+
+    drainRing();
+    for(int i = 0; i < g_treeNodeCount; i++)
+    {
+        g_snapshot[i].address = g_tree[i].address;
+        g_snapshot[i].parent = g_tree[i].parent;
+        g_snapshot[i].selfCount = g_tree[i].selfCount;
+        g_snapshot[i].totalCount = g_tree[i].totalCount;
+    }
+    uint32_t ringDropped = atomic_load_explicit(&g_ring.droppedCount, memory_order_relaxed) - g_ringDroppedBase;
+
+    eventContext->profile.nodes = g_treeNodeCount > 0 ? g_snapshot : NULL;
+    eventContext->profile.nodeCount = g_treeNodeCount;
+    eventContext->profile.sampleCount = g_treeSampleCount;
+    eventContext->profile.droppedSampleCount = g_treeDroppedCount + (int)ringDropped;
+    eventContext->profile.samplesPerSecond = g_samplerSamplesPerSecond;
+    eventContext->profile.durationNanoseconds = vicrabcrashdate_monotonicNanoseconds() - g_treeStartTime;
+    unlockTree();
+}
+
+VicrabCrashMonitorAPI* vicrabcrashcm_profiler_getAPI()
+{
+    static VicrabCrashMonitorAPI api =
+    {
+        .setEnabled = setEnabled,
+        .isEnabled = isEnabled,
+        .addContextualInfoToEvent = addContextualInfoToEvent
+    };
+    return &api;
+}
+
+void vicrabcrashcm_setProfilerOptions(int samplesPerSecond, bool sampleAllThreads)
+{
+    pthread_mutex_lock(&g_samplerMutex);
+    g_samplesPerSecond = samplesPerSecond;
+    g_sampleAllThreads = sampleAllThreads;
+    if(g_isEnabled)
+    {
+        stopSampler();
+        startSampler();
+    }
+    pthread_mutex_unlock(&g_samplerMutex);
+}
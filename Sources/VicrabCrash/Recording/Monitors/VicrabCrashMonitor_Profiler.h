@@ -0,0 +1,67 @@
+//
+//  VicrabCrashMonitor_Profiler.h
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+
+
+/* Periodically samples thread stacks and aggregates them into a call tree,
+ * which is added to every report written while the monitor is running.
+ */
+
+
+#ifndef HDR_VicrabCrashMonitor_Profiler_h
+#define HDR_VicrabCrashMonitor_Profiler_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "VicrabCrashMonitor.h"
+
+#include <stdbool.h>
+
+
+/** Configure how often and which threads the profiler samples.
+ * Takes effect immediately if the monitor is running.
+ *
+ * @param samplesPerSecond The sampling rate (0 = disabled). Default 100.
+ *
+ * @param sampleAllThreads If true, sample every thread rather than only the
+ *                         main thread. Default false.
+ */
+void vicrabcrashcm_setProfilerOptions(int samplesPerSecond, bool sampleAllThreads);
+
+/** Access the Monitor API.
+ */
+VicrabCrashMonitorAPI* vicrabcrashcm_profiler_getAPI(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HDR_VicrabCrashMonitor_Profiler_h
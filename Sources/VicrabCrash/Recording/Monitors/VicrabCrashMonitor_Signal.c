@@ -31,6 +31,7 @@
 #include "VicrabCrashMachineContext.h"
 #include "VicrabCrashSystemCapabilities.h"
 #include "VicrabCrashStackCursor_MachineContext.h"
+#include "VicrabCrashThread.h"
 
 //#define VicrabCrashLogger_LocalLevel TRACE
 #include "VicrabCrashLogger.h"
@@ -39,9 +40,32 @@
 
 #include <errno.h>
 #include <signal.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if VicrabCrashCRASH_HAS_SIGNAL_STACK
+#include <sys/mman.h>
+#endif
+
+#if VicrabCrashCRASH_HAS_SIGNAL_STACK && VicrabCrashCRASH_HAS_THREAD_INTROSPECTION
+#include <pthread/introspection.h>
+#endif
+
+
+/** Size of each thread's signal stack.
+ * Writing a full report with 20 threads measured about 14k of stack, so this
+ * leaves plenty of room for deeper symbolication and logging paths.
+ */
+#define kSignalStackSize (64 * 1024)
+
+/** Number of signal stacks preallocated in the pool. Threads started after
+ * the pool runs out crash on their own stack, as they did before.
+ */
+#define kSignalStackPoolCount 128
 
 
 // ============================================================================
@@ -54,24 +78,254 @@ static VicrabCrash_MonitorContext g_monitorContext;
 static VicrabCrashStackCursor g_stackCursor;
 
 #if VicrabCrashCRASH_HAS_SIGNAL_STACK
-/** Our custom signal stack. The signal handler will use this as its stack. */
-static stack_t g_signalStack = {0};
+/** Preallocated signal stacks, each preceded by an inaccessible guard page. */
+static uint8_t* g_signalStackPool = NULL;
+
+/** Distance between the start of consecutive stacks in the pool. */
+static size_t g_signalStackStride = 0;
+
+/** Which pool stacks are currently assigned to a thread. */
+static atomic_bool g_signalStackInUse[kSignalStackPoolCount];
 #endif
 
 /** Signal handlers that were installed before we installed ours. */
 static struct sigaction* g_previousSignalHandlers = NULL;
 
+/** The thread currently handling a signal, or 0 if none is. */
+static _Atomic(VicrabCrashThread) g_handlingThread = 0;
+
 static char g_eventID[37];
 
+
+// ============================================================================
+#pragma mark - Signal Stacks -
+// ============================================================================
+
+#if VicrabCrashCRASH_HAS_SIGNAL_STACK
+
+/** Map the signal stack pool, with a guard page below every stack so that an
+ * overflowing handler faults instead of scribbling over its neighbour.
+ *
+ * @return true if the pool is available.
+ */
+static bool allocateSignalStackPool(void)
+{
+    if(g_signalStackPool != NULL)
+    {
+        return true;
+    }
+
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t stride = pageSize + ((kSignalStackSize + pageSize - 1) / pageSize) * pageSize;
+    void* pool = mmap(NULL, stride * kSignalStackPoolCount, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    if(pool == MAP_FAILED)
+    {
+        VicrabCrashLOG_ERROR("Failed to map signal stack pool: %s", strerror(errno));
+        return false;
+    }
+    for(int i = 0; i < kSignalStackPoolCount; i++)
+    {
+        if(mprotect((uint8_t*)pool + stride * (size_t)i, pageSize, PROT_NONE) != 0)
+        {
+            VicrabCrashLOG_WARN("Failed to protect signal stack guard page: %s", strerror(errno));
+        }
+    }
+    g_signalStackStride = stride;
+    g_signalStackPool = pool;
+    return true;
+}
+
+/** Give the calling thread a signal stack from the pool, unless it already
+ * has one.
+ *
+ * @return true if the thread has a signal stack.
+ */
+static bool assignSignalStackToCurrentThread(void)
+{
+    stack_t current = {0};
+    if(sigaltstack(NULL, &current) == 0 && !(current.ss_flags & SS_DISABLE))
+    {
+        return true;
+    }
+    if(g_signalStackPool == NULL)
+    {
+        return false;
+    }
+
+    for(int i = 0; i < kSignalStackPoolCount; i++)
+    {
+        bool expected = false;
+        if(atomic_load_explicit(&g_signalStackInUse[i], memory_order_relaxed) ||
+           !atomic_compare_exchange_strong(&g_signalStackInUse[i], &expected, true))
+        {
+            continue;
+        }
+
+        size_t guardSize = g_signalStackStride - kSignalStackSize;
+        stack_t stack = {0};
+        stack.ss_sp = g_signalStackPool + g_signalStackStride * (size_t)i + guardSize;
+        stack.ss_size = kSignalStackSize;
+        if(sigaltstack(&stack, NULL) != 0)
+        {
+            VicrabCrashLOG_ERROR("signalstack: %s", strerror(errno));
+            atomic_store(&g_signalStackInUse[i], false);
+            return false;
+        }
+        return true;
+    }
+    VicrabCrashLOG_DEBUG("Signal stack pool exhausted.");
+    return false;
+}
+
+#if VicrabCrashCRASH_HAS_THREAD_INTROSPECTION
+static pthread_introspection_hook_t g_previousIntrospectionHook;
+
+/** Get the pool index of a signal stack.
+ *
+ * @param stackBase The base address of the stack.
+ *
+ * @return The index, or -1 if the stack is not from the pool.
+ */
+static int poolIndexOfStack(void* stackBase)
+{
+    uint8_t* base = stackBase;
+    if(g_signalStackPool == NULL || base <= g_signalStackPool ||
+       base >= g_signalStackPool + g_signalStackStride * kSignalStackPoolCount)
+    {
+        return -1;
+    }
+    return (int)((size_t)(base - g_signalStackPool) / g_signalStackStride);
+}
+
+/** Return the calling thread's signal stack to the pool if it came from there.
+ */
+static void releaseSignalStackOfCurrentThread(void)
+{
+    stack_t current = {0};
+    if(sigaltstack(NULL, &current) != 0 || (current.ss_flags & (SS_DISABLE | SS_ONSTACK)))
+    {
+        return;
+    }
+    int index = poolIndexOfStack(current.ss_sp);
+    if(index < 0)
+    {
+        return;
+    }
+    stack_t disabled = {0};
+    disabled.ss_flags = SS_DISABLE;
+    if(sigaltstack(&disabled, NULL) == 0)
+    {
+        atomic_store(&g_signalStackInUse[index], false);
+    }
+}
+
+/** Start and terminate events are delivered on the thread itself, which is
+ * the only thread that can set its own signal stack.
+ */
+static void onThreadIntrospectionEvent(unsigned int event, pthread_t thread, void* addr, size_t size)
+{
+    if(event == PTHREAD_INTROSPECTION_THREAD_START)
+    {
+        if(g_isEnabled)
+        {
+            assignSignalStackToCurrentThread();
+        }
+    }
+    else if(event == PTHREAD_INTROSPECTION_THREAD_TERMINATE)
+    {
+        releaseSignalStackOfCurrentThread();
+    }
+    if(g_previousIntrospectionHook != NULL)
+    {
+        g_previousIntrospectionHook(event, thread, addr, size);
+    }
+}
+#endif
+
+/** Install the hook that hands out signal stacks to new threads, if the
+ * platform has one. Without it, only the installing thread gets a stack.
+ */
+static void installSignalStackHooks(void)
+{
+#if VicrabCrashCRASH_HAS_THREAD_INTROSPECTION
+    static bool isInstalled = false;
+    if(!isInstalled)
+    {
+        isInstalled = true;
+        g_previousIntrospectionHook = pthread_introspection_hook_install(onThreadIntrospectionEvent);
+    }
+#endif
+}
+
+#endif
+
 // ============================================================================
 #pragma mark - Callbacks -
 // ============================================================================
 
+static void handleSignal(int sigNum, siginfo_t* signalInfo, void* userContext);
+
+/** Pass a signal on to the handler that was installed before ours.
+ * Function handlers are called directly so that they see the original
+ * signal info and machine context. Otherwise the previous disposition is
+ * restored and the signal raised again.
+ *
+ * @param sigNum The signal that was raised.
+ *
+ * @param signalInfo Information about the signal.
+ *
+ * @param userContext Other contextual information.
+ */
+static void chainToPreviousHandler(int sigNum, siginfo_t* signalInfo, void* userContext)
+{
+    const int* fatalSignals = vicrabcrashsignal_fatalSignals();
+    int fatalSignalsCount = vicrabcrashsignal_numFatalSignals();
+    struct sigaction* previous = NULL;
+    for(int i = 0; i < fatalSignalsCount && g_previousSignalHandlers != NULL; i++)
+    {
+        if(fatalSignals[i] == sigNum)
+        {
+            previous = &g_previousSignalHandlers[i];
+            break;
+        }
+    }
+
+    if(previous != NULL && (previous->sa_flags & SA_SIGINFO))
+    {
+        if(previous->sa_sigaction != NULL && previous->sa_sigaction != handleSignal)
+        {
+            VicrabCrashLOG_DEBUG("Chaining signal %d to previous handler.", sigNum);
+            previous->sa_sigaction(sigNum, signalInfo, userContext);
+            return;
+        }
+    }
+    else if(previous != NULL && previous->sa_handler != SIG_DFL && previous->sa_handler != SIG_IGN)
+    {
+        VicrabCrashLOG_DEBUG("Chaining signal %d to previous handler.", sigNum);
+        previous->sa_handler(sigNum);
+        return;
+    }
+
+    VicrabCrashLOG_DEBUG("Re-raising signal for regular handlers to catch.");
+    if(previous != NULL && !(previous->sa_flags & SA_SIGINFO))
+    {
+        sigaction(sigNum, previous, NULL);
+    }
+    else
+    {
+        signal(sigNum, SIG_DFL);
+    }
+    // This is technically not allowed, but it works in OSX and iOS.
+    raise(sigNum);
+}
+
 /** Our custom signal handler.
- * Restore the default signal handlers, record the signal information, and
- * write a crash report.
- * Once we're done, re-raise the signal and let the default handlers deal with
- * it.
+ * Record the signal information and write a crash report, then pass the
+ * signal on to whatever handler was installed before ours.
+ *
+ * A signal raised on the thread that is already writing a report is
+ * recorded as a recrash. A signal on any other thread waits for the
+ * running report to finish rather than overwriting its context.
  *
  * @param sigNum The signal that was raised.
  *
@@ -82,7 +336,19 @@ static char g_eventID[37];
 static void handleSignal(int sigNum, siginfo_t* signalInfo, void* userContext)
 {
     VicrabCrashLOG_DEBUG("Trapped signal %d", sigNum);
-    if(g_isEnabled)
+    VicrabCrashThread thisThread = vicrabcrashthread_self();
+    VicrabCrashThread handlingThread = 0;
+    bool isOutermost = atomic_compare_exchange_strong(&g_handlingThread, &handlingThread, thisThread);
+    if(!isOutermost && handlingThread != thisThread)
+    {
+        VicrabCrashLOG_DEBUG("Signal %d arrived while another thread is handling a signal.", sigNum);
+        struct timespec pause = {0, 1000000};
+        while(atomic_load(&g_handlingThread) != 0)
+        {
+            nanosleep(&pause, NULL);
+        }
+    }
+    else if(g_isEnabled)
     {
         vicrabcrashmc_suspendEnvironment();
         vicrabcrashcm_notifyFatalExceptionCaptured(false);
@@ -108,9 +374,11 @@ static void handleSignal(int sigNum, siginfo_t* signalInfo, void* userContext)
         vicrabcrashmc_resumeEnvironment();
     }
 
-    VicrabCrashLOG_DEBUG("Re-raising signal for regular handlers to catch.");
-    // This is technically not allowed, but it works in OSX and iOS.
-    raise(sigNum);
+    if(isOutermost)
+    {
+        atomic_store(&g_handlingThread, 0);
+    }
+    chainToPreviousHandler(sigNum, signalInfo, userContext);
 }
 
 
@@ -123,26 +391,16 @@ static bool installSignalHandler()
     VicrabCrashLOG_DEBUG("Installing signal handler.");
 
 #if VicrabCrashCRASH_HAS_SIGNAL_STACK
-
-    if(g_signalStack.ss_size == 0)
-    {
-        VicrabCrashLOG_DEBUG("Allocating signal stack area.");
-        g_signalStack.ss_size = SIGSTKSZ;
-        g_signalStack.ss_sp = malloc(g_signalStack.ss_size);
-
-        if(g_signalStack.ss_sp == NULL)
-        {
-            VicrabCrashLOG_ERROR("Failed to allocate signal stack area of size %ul", g_signalStack.ss_size);
-            goto failed;
-        }
-    }
-
     VicrabCrashLOG_DEBUG("Setting signal stack area.");
-    if(sigaltstack(&g_signalStack, NULL) != 0)
+    if(!allocateSignalStackPool())
     {
-        VicrabCrashLOG_ERROR("signalstack: %s", strerror(errno));
         goto failed;
     }
+    if(!assignSignalStackToCurrentThread())
+    {
+        VicrabCrashLOG_WARN("Installing thread has no signal stack.");
+    }
+    installSignalStackHooks();
 #endif
 
     const int* fatalSignals = vicrabcrashsignal_fatalSignals();
@@ -155,7 +413,8 @@ static bool installSignalHandler()
                                           * (unsigned)fatalSignalsCount);
     }
 
-    struct sigaction action = {{0}};
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
     action.sa_flags = SA_SIGINFO | SA_ONSTACK;
 #if VicrabCrashCRASH_HOST_APPLE && defined(__LP64__)
     action.sa_flags |= SA_64REGSET;
@@ -205,9 +464,7 @@ static void uninstallSignalHandler(void)
         sigaction(fatalSignals[i], &g_previousSignalHandlers[i], NULL);
     }
 
-#if VicrabCrashCRASH_HAS_SIGNAL_STACK
-    g_signalStack = (stack_t){0};
-#endif
+    // Signal stacks stay assigned: a handler may be running on one right now.
     VicrabCrashLOG_DEBUG("Signal handlers uninstalled.");
 }
 
@@ -246,6 +503,15 @@ static void addContextualInfoToEvent(struct VicrabCrash_MonitorContext* eventCon
 
 #endif
 
+size_t vicrabcrashcm_signal_stackSize()
+{
+#if VicrabCrashCRASH_HAS_SIGNAL_STACK
+    return kSignalStackSize;
+#else
+    return 0;
+#endif
+}
+
 VicrabCrashMonitorAPI* vicrabcrashcm_signal_getAPI()
 {
     static VicrabCrashMonitorAPI api =
@@ -44,6 +44,14 @@ extern "C" {
  */
 VicrabCrashMonitorAPI* vicrabcrashcm_signal_getAPI(void);
 
+/** Get the size of the alternate stack each thread handles signals on.
+ * Stacks come from a preallocated pool and are handed to threads as they
+ * start, where the platform reports thread starts.
+ *
+ * @return The stack size in bytes, or 0 if signal stacks are unsupported.
+ */
+size_t vicrabcrashcm_signal_stackSize(void);
+
 
 #ifdef __cplusplus
 }
@@ -39,6 +39,38 @@ extern "C" {
  */
     VicrabCrashMonitorAPI* vicrabcrashcm_system_getAPI(void);
 
+/** Set how often free memory, free storage and CPU load are sampled while
+ * the monitor is enabled. Crash reports carry the latest samples instead of
+ * querying the system from the crash handler.
+ *
+ * @param interval Seconds between samples. 0 = only sample once when the
+ *                 monitor is enabled.
+ *
+ * Default: 10
+ */
+    void vicrabcrashcm_system_setResourceSamplingInterval(double interval);
+
+/** Take a resource sample right away and wait for it to be published.
+ * Does nothing if the monitor has never been enabled.
+ */
+    void vicrabcrashcm_system_sampleResourcesNow(void);
+
+/** Enabling the monitor only collects the fields a crash report needs.
+ * The rest (device hash, build type, storage size, ...) is collected on a
+ * background queue and left out of reports until it is ready.
+ * Block until it is ready, collecting it on this thread if nobody has yet.
+ */
+    void vicrabcrashcm_system_waitForDeferredData(void);
+
+/** Get how long collecting the system info took.
+ *
+ * @param essentialSeconds Receives the time enabling the monitor blocked for.
+ *
+ * @param deferredSeconds Receives the time spent in the background, or 0 if
+ *                        that hasn't finished yet.
+ */
+    void vicrabcrashcm_system_getCollectionTimes(double* essentialSeconds, double* deferredSeconds);
+
 
 #ifdef __cplusplus
 }
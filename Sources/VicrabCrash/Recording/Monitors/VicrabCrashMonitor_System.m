@@ -44,8 +44,14 @@
 #endif
 #include <mach/mach.h>
 #include <mach-o/dyld.h>
+#include <stdatomic.h>
+#include <sys/mount.h>
 
 
+#define kDefaultResourceSamplingInterval 10.0
+
+#define kResourceSlotCount VicrabCrashCM_MAX_RESOURCE_SAMPLES
+
 typedef struct
 {
     const char* systemName;
@@ -83,6 +89,36 @@ static SystemData g_systemData;
 
 static volatile bool g_isEnabled = false;
 
+/** Set once the fields collected in the background have been stored in
+ * g_systemData. Until then, crash reports leave them out.
+ */
+static atomic_bool g_isDeferredDataReady;
+
+static dispatch_once_t g_deferredDataOnce;
+
+static double g_essentialCollectionTime;
+static double g_deferredCollectionTime;
+
+/** One resource sample. The sequence is odd while the slot is being written,
+ * and (n + 1) * 2 once it holds the nth sample.
+ */
+typedef struct
+{
+    _Atomic(uint32_t) sequence;
+    VicrabCrash_ResourceSample sample;
+} ResourceSlot;
+
+static ResourceSlot g_resourceSlots[kResourceSlotCount];
+
+/** Number of resource samples taken so far. */
+static _Atomic(uint32_t) g_resourceSampleCount;
+
+static double g_resourceSamplingInterval = kDefaultResourceSamplingInterval;
+static dispatch_queue_t g_resourceSamplingQueue;
+static dispatch_source_t g_resourceSamplingTimer;
+static const char* g_storagePath;
+static host_cpu_load_info_data_t g_previousCPULoad;
+
 
 // ============================================================================
 #pragma mark - Utility -
@@ -487,88 +523,284 @@ static uint64_t getStorageSize()
 }
 
 // ============================================================================
-#pragma mark - API -
+#pragma mark - Collection -
 // ============================================================================
 
-static void initialize()
+/** Collect the fields that a crash report can't do without, such as the
+ * binary UUID and CPU type needed for symbolication. These are cheap.
+ */
+static void collectEssentialData()
 {
-    static bool isInitialized = false;
-    if(!isInitialized)
-    {
-        isInitialized = true;
-
-        NSBundle* mainBundle = [NSBundle mainBundle];
-        NSDictionary* infoDict = [mainBundle infoDictionary];
-        const struct mach_header* header = _dyld_get_image_header(0);
+    NSBundle* mainBundle = [NSBundle mainBundle];
+    NSDictionary* infoDict = [mainBundle infoDictionary];
+    const struct mach_header* header = _dyld_get_image_header(0);
 
 #if VicrabCrashCRASH_HAS_UIDEVICE
-        g_systemData.systemName = cString([UIDevice currentDevice].systemName);
-        g_systemData.systemVersion = cString([UIDevice currentDevice].systemVersion);
+    g_systemData.systemName = cString([UIDevice currentDevice].systemName);
+    g_systemData.systemVersion = cString([UIDevice currentDevice].systemVersion);
 #else
 #if VicrabCrashCRASH_HOST_MAC
-        g_systemData.systemName = "macOS";
+    g_systemData.systemName = "macOS";
 #endif
 #if VicrabCrashCRASH_HOST_WATCH
-        g_systemData.systemName = "watchOS";
+    g_systemData.systemName = "watchOS";
 #endif
-        NSOperatingSystemVersion version = {0, 0, 0};
-        if(@available(macOS 10.10, *))
-        {
-            version = [NSProcessInfo processInfo].operatingSystemVersion;
-        }
-        NSString* systemVersion;
-        if(version.patchVersion == 0)
-        {
-            systemVersion = [NSString stringWithFormat:@"%d.%d", (int)version.majorVersion, (int)version.minorVersion];
-        }
-        else
-        {
-            systemVersion = [NSString stringWithFormat:@"%d.%d.%d", (int)version.majorVersion, (int)version.minorVersion, (int)version.patchVersion];
-        }
-        g_systemData.systemVersion = cString(systemVersion);
+    NSOperatingSystemVersion version = {0, 0, 0};
+    if(@available(macOS 10.10, *))
+    {
+        version = [NSProcessInfo processInfo].operatingSystemVersion;
+    }
+    NSString* systemVersion;
+    if(version.patchVersion == 0)
+    {
+        systemVersion = [NSString stringWithFormat:@"%d.%d", (int)version.majorVersion, (int)version.minorVersion];
+    }
+    else
+    {
+        systemVersion = [NSString stringWithFormat:@"%d.%d.%d", (int)version.majorVersion, (int)version.minorVersion, (int)version.patchVersion];
+    }
+    g_systemData.systemVersion = cString(systemVersion);
 #endif
-        if(isSimulatorBuild())
-        {
-            g_systemData.machine = cString([NSProcessInfo processInfo].environment[@"SIMULATOR_MODEL_IDENTIFIER"]);
-            g_systemData.model = "simulator";
-        }
-        else
-        {
+    if(isSimulatorBuild())
+    {
+        g_systemData.machine = cString([NSProcessInfo processInfo].environment[@"SIMULATOR_MODEL_IDENTIFIER"]);
+        g_systemData.model = "simulator";
+    }
+    else
+    {
 #if VicrabCrashCRASH_HOST_MAC
-            // MacOS has the machine in the model field, and no model
-            g_systemData.machine = stringSysctl("hw.model");
+        // MacOS has the machine in the model field, and no model
+        g_systemData.machine = stringSysctl("hw.model");
 #else
-            g_systemData.machine = stringSysctl("hw.machine");
-            g_systemData.model = stringSysctl("hw.model");
+        g_systemData.machine = stringSysctl("hw.machine");
+        g_systemData.model = stringSysctl("hw.model");
 #endif
-        }
+    }
+
+    g_systemData.kernelVersion = stringSysctl("kern.version");
+    g_systemData.osVersion = stringSysctl("kern.osversion");
+    g_systemData.bootTime = dateSysctl("kern.boottime");
+    g_systemData.appStartTime = dateString(time(NULL));
+    g_systemData.executablePath = cString(getExecutablePath());
+    g_systemData.executableName = cString(infoDict[@"CFBundleExecutable"]);
+    g_systemData.bundleID = cString(infoDict[@"CFBundleIdentifier"]);
+    g_systemData.bundleName = cString(infoDict[@"CFBundleName"]);
+    g_systemData.bundleVersion = cString(infoDict[@"CFBundleVersion"]);
+    g_systemData.bundleShortVersion = cString(infoDict[@"CFBundleShortVersionString"]);
+    g_systemData.appID = getAppUUID();
+    g_systemData.cpuArchitecture = getCurrentCPUArch();
+    g_systemData.cpuType = vicrabcrashsysctl_int32ForName("hw.cputype");
+    g_systemData.cpuSubType = vicrabcrashsysctl_int32ForName("hw.cpusubtype");
+    g_systemData.binaryCPUType = header->cputype;
+    g_systemData.binaryCPUSubType = header->cpusubtype;
+    g_systemData.processName = cString([NSProcessInfo processInfo].processName);
+    g_systemData.processID = [NSProcessInfo processInfo].processIdentifier;
+    g_systemData.parentProcessID = getppid();
+    g_systemData.memorySize = vicrabcrashsysctl_uint64ForName("hw.memsize");
+}
 
-        g_systemData.kernelVersion = stringSysctl("kern.version");
-        g_systemData.osVersion = stringSysctl("kern.osversion");
+/** Collect the fields that take file system access, image scans or hashing.
+ * Runs at most once, on whichever thread needs the data first.
+ */
+static void ensureDeferredData()
+{
+    dispatch_once(&g_deferredDataOnce, ^{
+        CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
         g_systemData.isJailbroken = isJailbroken();
-        g_systemData.bootTime = dateSysctl("kern.boottime");
-        g_systemData.appStartTime = dateString(time(NULL));
-        g_systemData.executablePath = cString(getExecutablePath());
-        g_systemData.executableName = cString(infoDict[@"CFBundleExecutable"]);
-        g_systemData.bundleID = cString(infoDict[@"CFBundleIdentifier"]);
-        g_systemData.bundleName = cString(infoDict[@"CFBundleName"]);
-        g_systemData.bundleVersion = cString(infoDict[@"CFBundleVersion"]);
-        g_systemData.bundleShortVersion = cString(infoDict[@"CFBundleShortVersionString"]);
-        g_systemData.appID = getAppUUID();
-        g_systemData.cpuArchitecture = getCurrentCPUArch();
-        g_systemData.cpuType = vicrabcrashsysctl_int32ForName("hw.cputype");
-        g_systemData.cpuSubType = vicrabcrashsysctl_int32ForName("hw.cpusubtype");
-        g_systemData.binaryCPUType = header->cputype;
-        g_systemData.binaryCPUSubType = header->cpusubtype;
         g_systemData.timezone = cString([NSTimeZone localTimeZone].abbreviation);
-        g_systemData.processName = cString([NSProcessInfo processInfo].processName);
-        g_systemData.processID = [NSProcessInfo processInfo].processIdentifier;
-        g_systemData.parentProcessID = getppid();
         g_systemData.deviceAppHash = getDeviceAndAppHash();
         g_systemData.buildType = getBuildType();
         g_systemData.storageSize = getStorageSize();
-        g_systemData.memorySize = vicrabcrashsysctl_uint64ForName("hw.memsize");
+        g_deferredCollectionTime = CFAbsoluteTimeGetCurrent() - startTime;
+        atomic_store_explicit(&g_isDeferredDataReady, true, memory_order_release);
+    });
+}
+
+
+// ============================================================================
+#pragma mark - Resource Sampling -
+// ============================================================================
+
+static uint64_t freeStorage(void)
+{
+    struct statfs st;
+    if(g_storagePath == NULL || statfs(g_storagePath, &st) != 0)
+    {
+        return 0;
+    }
+    return (uint64_t)st.f_bavail * st.f_bsize;
+}
+
+/** Get the fraction of CPU time that was spent busy since the last call.
+ */
+static double cpuLoad(void)
+{
+    host_cpu_load_info_data_t load;
+    mach_msg_type_number_t count = HOST_CPU_LOAD_INFO_COUNT;
+    kern_return_t kr = host_statistics(mach_host_self(), HOST_CPU_LOAD_INFO, (host_info_t)&load, &count);
+    if(kr != KERN_SUCCESS)
+    {
+        VicrabCrashLOG_ERROR(@"host_statistics: %s", mach_error_string(kr));
+        return 0;
     }
+
+    natural_t ticks[CPU_STATE_MAX];
+    for(int i = 0; i < CPU_STATE_MAX; i++)
+    {
+        ticks[i] = load.cpu_ticks[i] - g_previousCPULoad.cpu_ticks[i];
+    }
+    g_previousCPULoad = load;
+
+    double busy = (double)ticks[CPU_STATE_USER] + ticks[CPU_STATE_SYSTEM] + ticks[CPU_STATE_NICE];
+    double total = busy + ticks[CPU_STATE_IDLE];
+    return total > 0 ? busy / total : 0;
+}
+
+/** Take a resource sample and publish it.
+ * Only runs on the sampling queue, so there is a single writer.
+ */
+static void takeResourceSample(void)
+{
+    VicrabCrash_ResourceSample sample =
+    {
+        .timestamp = CFAbsoluteTimeGetCurrent() + kCFAbsoluteTimeIntervalSince1970,
+        .freeMemory = freeMemory(),
+        .usableMemory = usableMemory(),
+        .freeStorage = freeStorage(),
+        .cpuLoad = cpuLoad(),
+    };
+
+    uint32_t index = atomic_load_explicit(&g_resourceSampleCount, memory_order_relaxed);
+    ResourceSlot* slot = &g_resourceSlots[index % kResourceSlotCount];
+    atomic_store_explicit(&slot->sequence, index * 2 + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->sample = sample;
+    atomic_store_explicit(&slot->sequence, (index + 1) * 2, memory_order_release);
+    atomic_store_explicit(&g_resourceSampleCount, index + 1, memory_order_release);
+}
+
+/** Copy the published samples into a context, oldest first.
+ * This function is async-safe.
+ */
+static void copyResourceSamples(VicrabCrash_MonitorContext* eventContext)
+{
+    uint32_t count = atomic_load_explicit(&g_resourceSampleCount, memory_order_acquire);
+    uint32_t first = count > kResourceSlotCount ? count - kResourceSlotCount : 0;
+    int copied = 0;
+    for(uint32_t index = first; index < count; index++)
+    {
+        const ResourceSlot* slot = &g_resourceSlots[index % kResourceSlotCount];
+        uint32_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        if(sequence != (index + 1) * 2)
+        {
+            // Being overwritten by a newer sample.
+            continue;
+        }
+        VicrabCrash_ResourceSample sample = slot->sample;
+        atomic_thread_fence(memory_order_acquire);
+        if(atomic_load_explicit(&slot->sequence, memory_order_relaxed) != sequence)
+        {
+            continue;
+        }
+        eventContext->System.resourceSamples[copied++] = sample;
+    }
+    eventContext->System.resourceSampleCount = copied;
+
+    if(copied > 0)
+    {
+        const VicrabCrash_ResourceSample* latest = &eventContext->System.resourceSamples[copied - 1];
+        eventContext->System.freeMemory = latest->freeMemory;
+        eventContext->System.usableMemory = latest->usableMemory;
+        eventContext->System.freeStorage = latest->freeStorage;
+        eventContext->System.cpuLoad = latest->cpuLoad;
+    }
+}
+
+static void stopResourceSampling(void)
+{
+    if(g_resourceSamplingTimer != nil)
+    {
+        dispatch_source_cancel(g_resourceSamplingTimer);
+        g_resourceSamplingTimer = nil;
+    }
+}
+
+static void startResourceSampling(void)
+{
+    stopResourceSampling();
+    if(g_resourceSamplingQueue == nil)
+    {
+        g_resourceSamplingQueue = dispatch_queue_create("io.vicrab.crash.resource-sampling", DISPATCH_QUEUE_SERIAL);
+        g_storagePath = cString(NSHomeDirectory());
+    }
+    if(g_resourceSamplingInterval <= 0)
+    {
+        // Still leave one sample for reports to use.
+        dispatch_async(g_resourceSamplingQueue, ^{
+            takeResourceSample();
+        });
+        return;
+    }
+
+    uint64_t interval = (uint64_t)(g_resourceSamplingInterval * NSEC_PER_SEC);
+    g_resourceSamplingTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, g_resourceSamplingQueue);
+    dispatch_source_set_timer(g_resourceSamplingTimer, dispatch_time(DISPATCH_TIME_NOW, 0), interval, interval / 10);
+    dispatch_source_set_event_handler(g_resourceSamplingTimer, ^{
+        takeResourceSample();
+    });
+    dispatch_resume(g_resourceSamplingTimer);
+}
+
+
+// ============================================================================
+#pragma mark - API -
+// ============================================================================
+
+static void initialize()
+{
+    static bool isInitialized = false;
+    if(!isInitialized)
+    {
+        isInitialized = true;
+
+        CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+        collectEssentialData();
+        g_essentialCollectionTime = CFAbsoluteTimeGetCurrent() - startTime;
+
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0), ^{
+            ensureDeferredData();
+        });
+    }
+}
+
+void vicrabcrashcm_system_setResourceSamplingInterval(double interval)
+{
+    g_resourceSamplingInterval = interval;
+    if(g_isEnabled)
+    {
+        startResourceSampling();
+    }
+}
+
+void vicrabcrashcm_system_sampleResourcesNow()
+{
+    if(g_resourceSamplingQueue != nil)
+    {
+        dispatch_sync(g_resourceSamplingQueue, ^{
+            takeResourceSample();
+        });
+    }
+}
+
+void vicrabcrashcm_system_waitForDeferredData()
+{
+    ensureDeferredData();
+}
+
+void vicrabcrashcm_system_getCollectionTimes(double* essentialSeconds, double* deferredSeconds)
+{
+    *essentialSeconds = g_essentialCollectionTime;
+    *deferredSeconds = atomic_load_explicit(&g_isDeferredDataReady, memory_order_acquire) ? g_deferredCollectionTime : 0;
 }
 
 static void setEnabled(bool isEnabled)
@@ -579,6 +811,11 @@ static void setEnabled(bool isEnabled)
         if(isEnabled)
         {
             initialize();
+            startResourceSampling();
+        }
+        else
+        {
+            stopResourceSampling();
         }
     }
 }
@@ -599,7 +836,6 @@ static void addContextualInfoToEvent(VicrabCrash_MonitorContext* eventContext)
         COPY_REFERENCE(model);
         COPY_REFERENCE(kernelVersion);
         COPY_REFERENCE(osVersion);
-        COPY_REFERENCE(isJailbroken);
         COPY_REFERENCE(bootTime);
         COPY_REFERENCE(appStartTime);
         COPY_REFERENCE(executablePath);
@@ -614,16 +850,20 @@ static void addContextualInfoToEvent(VicrabCrash_MonitorContext* eventContext)
         COPY_REFERENCE(cpuSubType);
         COPY_REFERENCE(binaryCPUType);
         COPY_REFERENCE(binaryCPUSubType);
-        COPY_REFERENCE(timezone);
         COPY_REFERENCE(processName);
         COPY_REFERENCE(processID);
         COPY_REFERENCE(parentProcessID);
-        COPY_REFERENCE(deviceAppHash);
-        COPY_REFERENCE(buildType);
-        COPY_REFERENCE(storageSize);
         COPY_REFERENCE(memorySize);
-        eventContext->System.freeMemory = freeMemory();
-        eventContext->System.usableMemory = usableMemory();
+        // Never wait for the background collection here: this can run in a crash handler.
+        if(atomic_load_explicit(&g_isDeferredDataReady, memory_order_acquire))
+        {
+            COPY_REFERENCE(isJailbroken);
+            COPY_REFERENCE(timezone);
+            COPY_REFERENCE(deviceAppHash);
+            COPY_REFERENCE(buildType);
+            COPY_REFERENCE(storageSize);
+        }
+        copyResourceSamples(eventContext);
     }
 }
 
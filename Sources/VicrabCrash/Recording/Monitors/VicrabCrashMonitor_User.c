@@ -26,34 +26,418 @@
 #include "VicrabCrashMonitorContext.h"
 #include "VicrabCrashID.h"
 #include "VicrabCrashThread.h"
+#include "VicrabCrashStackCursor_Backtrace.h"
+#include "VicrabCrashStackCursor_MachineContext.h"
 #include "VicrabCrashStackCursor_SelfThread.h"
+#include "VicrabCrashDate.h"
+#include "VicrabCrashFileUtils.h"
+#include "VicrabCrashReportFields.h"
 
 //#define VicrabCrashLogger_LocalLevel TRACE
 #include "VicrabCrashLogger.h"
 
+#include <errno.h>
+#include <execinfo.h>
+#include <fcntl.h>
 #include <memory.h>
+#include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+/** Most frames kept per thread in an asynchronous report. */
+#define kMaxCapturedFrames 128
+
+/** Longest a thread stays suspended while its backtrace is copied. */
+#define kMaxSuspensionNanoseconds 2000000
+
+/** Most reports waiting for the background writer. More are dropped. */
+#define kMaxPendingReports 8
+
+/** Frames above the reporting function that identify where a report came from. */
+#define kFingerprintFrames 8
+
+/** Distinct exceptions remembered for deduplication. */
+#define kMaxRecentReports 16
+
+/** Reports that may be written in a burst before rate limiting starts. */
+#define kDefaultMaxReportBurst 10
+
+/** Rate at which the report burst allowance refills. */
+#define kDefaultReportsPerSecond (1.0 / 6.0)
+
+/** A recently written report that later duplicates are counted into. */
+typedef struct
+{
+    uint64_t fingerprint;
+    /** Bumped whenever the slot is reused, to detect stale writers. */
+    unsigned generation;
+    int occurrences;
+    /** Offset of the occurrence count in the report file (0 = not found yet). */
+    long occurrencesOffset;
+    /** Empty while the report is still being written. */
+    char reportPath[VicrabCrashFU_MAX_PATH_LENGTH];
+} RecentReport;
+
+/** Identifies the recent report slot that a new report will fill in. */
+typedef struct
+{
+    int index;
+    unsigned generation;
+} RecentReportTicket;
+
+/** Everything an asynchronous report needs, copied off the calling thread. */
+typedef struct PendingReport
+{
+    struct PendingReport* next;
+    char eventID[37];
+    char* name;
+    char* reason;
+    char* language;
+    char* lineOfCode;
+    char* stackTrace;
+    VicrabCrashUserReportCompletion onCompletion;
+    void* userData;
+    struct VicrabCrashMachineContext* machineContext;
+    uintptr_t callingThreadBacktrace[kMaxCapturedFrames];
+    int callingThreadBacktraceLength;
+    VicrabCrashCapturedThread* capturedThreads;
+    int capturedThreadCount;
+    uintptr_t* backtraces;
+    RecentReportTicket ticket;
+} PendingReport;
 
 
 /** Context to fill with crash information. */
 
 static volatile bool g_isEnabled = false;
 
+static pthread_mutex_t g_pendingReportsMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_pendingReportsCondition = PTHREAD_COND_INITIALIZER;
+static PendingReport* g_pendingReportsHead;
+static PendingReport* g_pendingReportsTail;
+static int g_pendingReportsCount;
+static pthread_once_t g_writerThreadOnce = PTHREAD_ONCE_INIT;
+
+static pthread_mutex_t g_recentReportsMutex = PTHREAD_MUTEX_INITIALIZER;
+/** Held while a report file's occurrence count is read or written. */
+static pthread_mutex_t g_occurrencesFileMutex = PTHREAD_MUTEX_INITIALIZER;
+static RecentReport g_recentReports[kMaxRecentReports];
+static int g_nextRecentReport;
+static int g_maxReportBurst = kDefaultMaxReportBurst;
+static double g_reportsPerSecond = kDefaultReportsPerSecond;
+static double g_reportTokens = kDefaultMaxReportBurst;
+static uint64_t g_lastTokenRefill;
+
+
+// ============================================================================
+#pragma mark - Deduplication -
+// ============================================================================
+
+/** Hash the exception name and the frames leading up to the report (FNV-1a).
+ */
+static uint64_t fingerprintReport(const char* name, const uintptr_t* frames, int frameCount)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for(const char* ch = name == NULL ? "" : name; *ch != '\0'; ch++)
+    {
+        hash = (hash ^ (uint8_t)*ch) * 1099511628211ULL;
+    }
+    for(int i = 0; i < frameCount && i < kFingerprintFrames; i++)
+    {
+        uintptr_t frame = frames[i];
+        for(size_t byte = 0; byte < sizeof(frame); byte++)
+        {
+            hash = (hash ^ (uint8_t)(frame >> (byte * 8))) * 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+/** Find where the occurrence count of the user report in a report file starts.
+ *
+ * @return The file offset, or 0 if it could not be found.
+ */
+static long findOccurrencesOffset(const char* reportPath)
+{
+    char* data = NULL;
+    int length = 0;
+    if(!vicrabcrashfu_readEntireFile(reportPath, &data, &length, 0))
+    {
+        return 0;
+    }
+
+    long offset = 0;
+    const char* const key = "\"" VicrabCrashField_Occurrences "\"";
+    for(const char* match = strstr(data, key); match != NULL; match = strstr(match + 1, key))
+    {
+        // The count comes first in the user_reported object.
+        const char* before = match - 1;
+        while(before > data && (*before == ' ' || *before == '\n'))
+        {
+            before--;
+        }
+        if(*before != '{')
+        {
+            continue;
+        }
+        const char* value = match + strlen(key);
+        while(*value == ' ' || *value == ':')
+        {
+            value++;
+        }
+        if(data + length - value >= VicrabCrashCM_OCCURRENCES_WIDTH)
+        {
+            offset = value - data;
+        }
+        break;
+    }
+    free(data);
+    return offset;
+}
+
+/** Overwrite the occurrence count in a recent report's file with its latest
+ * value. File access is serialized by g_occurrencesFileMutex instead of
+ * g_recentReportsMutex, so reporting threads never wait on disk I/O.
+ *
+ * @return false if the report file is gone.
+ */
+static bool updateOccurrences(RecentReportTicket ticket)
+{
+    char reportPath[VicrabCrashFU_MAX_PATH_LENGTH];
+    bool isFileGone = false;
+    pthread_mutex_lock(&g_occurrencesFileMutex);
+
+    pthread_mutex_lock(&g_recentReportsMutex);
+    RecentReport* report = &g_recentReports[ticket.index];
+    bool isCurrent = report->generation == ticket.generation && report->occurrences > 0;
+    long occurrencesOffset = report->occurrencesOffset;
+    memcpy(reportPath, report->reportPath, sizeof(reportPath));
+    pthread_mutex_unlock(&g_recentReportsMutex);
+    if(!isCurrent || reportPath[0] == '\0')
+    {
+        goto done;
+    }
+
+    int fd = open(reportPath, O_WRONLY);
+    if(fd < 0)
+    {
+        isFileGone = true;
+        goto done;
+    }
+    if(occurrencesOffset == 0)
+    {
+        occurrencesOffset = findOccurrencesOffset(reportPath);
+    }
+
+    pthread_mutex_lock(&g_recentReportsMutex);
+    isCurrent = report->generation == ticket.generation && report->occurrences > 0;
+    if(isCurrent)
+    {
+        report->occurrencesOffset = occurrencesOffset;
+    }
+    int occurrences = report->occurrences;
+    pthread_mutex_unlock(&g_recentReportsMutex);
+
+    if(isCurrent && occurrencesOffset != 0)
+    {
+        char buffer[VicrabCrashCM_OCCURRENCES_WIDTH + 1];
+        snprintf(buffer, sizeof(buffer), "%-*d", VicrabCrashCM_OCCURRENCES_WIDTH, occurrences);
+        if(pwrite(fd, buffer, VicrabCrashCM_OCCURRENCES_WIDTH, occurrencesOffset) != VicrabCrashCM_OCCURRENCES_WIDTH)
+        {
+            VicrabCrashLOG_ERROR("Could not update %s: %s", reportPath, strerror(errno));
+        }
+    }
+    close(fd);
+
+done:
+    pthread_mutex_unlock(&g_occurrencesFileMutex);
+    return !isFileGone;
+}
+
+/** Forget a recent report whose file has been sent and deleted. */
+static void forgetRecentReport(RecentReportTicket ticket)
+{
+    pthread_mutex_lock(&g_recentReportsMutex);
+    RecentReport* report = &g_recentReports[ticket.index];
+    if(report->generation == ticket.generation)
+    {
+        report->occurrences = 0;
+    }
+    pthread_mutex_unlock(&g_recentReportsMutex);
+}
+
+/** Take one report from the burst allowance, refilling it for the time passed.
+ * Must be called with g_recentReportsMutex held.
+ */
+static bool takeReportToken()
+{
+    if(g_maxReportBurst <= 0)
+    {
+        return true;
+    }
+    uint64_t now = vicrabcrashdate_monotonicNanoseconds();
+    if(g_lastTokenRefill != 0)
+    {
+        g_reportTokens += (double)(now - g_lastTokenRefill) / 1000000000.0 * g_reportsPerSecond;
+        if(g_reportTokens > g_maxReportBurst)
+        {
+            g_reportTokens = g_maxReportBurst;
+        }
+    }
+    g_lastTokenRefill = now;
+    if(g_reportTokens < 1.0)
+    {
+        return false;
+    }
+    g_reportTokens -= 1.0;
+    return true;
+}
 
-void vicrabcrashcm_reportUserException(const char* name,
+/** Count a repeat of a recently reported exception into its report.
+ *
+ * @return true if it was counted, false if there is no such report (any more).
+ */
+static bool countDuplicate(uint64_t fingerprint)
+{
+    RecentReportTicket duplicate = {-1, 0};
+    bool isBeingWritten = false;
+    pthread_mutex_lock(&g_recentReportsMutex);
+    for(int i = 0; i < kMaxRecentReports; i++)
+    {
+        RecentReport* report = &g_recentReports[i];
+        if(report->occurrences > 0 && report->fingerprint == fingerprint)
+        {
+            report->occurrences++;
+            VicrabCrashLOG_DEBUG("Duplicate user report (%d occurrences)", report->occurrences);
+            // recordReportPath() applies the count once the report is written.
+            isBeingWritten = report->reportPath[0] == '\0';
+            duplicate.index = i;
+            duplicate.generation = report->generation;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_recentReportsMutex);
+
+    if(duplicate.index < 0)
+    {
+        return false;
+    }
+    if(isBeingWritten || updateOccurrences(duplicate))
+    {
+        return true;
+    }
+    // The report has already been sent and deleted.
+    forgetRecentReport(duplicate);
+    return false;
+}
+
+/** Decide whether an exception gets a report of its own.
+ *
+ * A repeat of a recently reported exception is counted into that report
+ * instead, and new reports beyond the rate limit are dropped.
+ *
+ * @param fingerprint The exception's fingerprint.
+ *
+ * @param ticket Receives the slot to pass to recordReportPath() once the
+ *               report is written.
+ *
+ * @return true if a new report should be written.
+ */
+static bool admitReport(uint64_t fingerprint, RecentReportTicket* ticket)
+{
+    if(countDuplicate(fingerprint))
+    {
+        return false;
+    }
+
+    pthread_mutex_lock(&g_recentReportsMutex);
+    bool shouldWrite = takeReportToken();
+    if(shouldWrite)
+    {
+        RecentReport* report = &g_recentReports[g_nextRecentReport];
+        g_nextRecentReport = (g_nextRecentReport + 1) % kMaxRecentReports;
+        report->fingerprint = fingerprint;
+        report->generation++;
+        report->occurrences = 1;
+        report->occurrencesOffset = 0;
+        report->reportPath[0] = '\0';
+        ticket->index = (int)(report - g_recentReports);
+        ticket->generation = report->generation;
+    }
+    pthread_mutex_unlock(&g_recentReportsMutex);
+
+    if(!shouldWrite)
+    {
+        VicrabCrashLOG_WARN("User report rate limit reached. Exception has not been recorded.");
+    }
+    return shouldWrite;
+}
+
+/** Remember where an admitted report was written, so that duplicates can be
+ * counted into it. Duplicates seen while it was being written are applied now.
+ */
+static void recordReportPath(RecentReportTicket ticket, const char* reportPath)
+{
+    bool hasDuplicates = false;
+    pthread_mutex_lock(&g_recentReportsMutex);
+    RecentReport* report = &g_recentReports[ticket.index];
+    if(report->generation == ticket.generation && report->occurrences > 0)
+    {
+        if(reportPath[0] == '\0')
+        {
+            report->occurrences = 0;
+        }
+        else
+        {
+            strncpy(report->reportPath, reportPath, sizeof(report->reportPath) - 1);
+            hasDuplicates = report->occurrences > 1;
+        }
+    }
+    pthread_mutex_unlock(&g_recentReportsMutex);
+
+    if(hasDuplicates && !updateOccurrences(ticket))
+    {
+        forgetRecentReport(ticket);
+    }
+}
+
+
+// ============================================================================
+#pragma mark - Synchronous Reports -
+// ============================================================================
+
+
+bool vicrabcrashcm_reportUserException(const char* name,
                               const char* reason,
                               const char* language,
                               const char* lineOfCode,
                               const char* stackTrace,
                               bool logAllThreads,
-                              bool terminateProgram)
+                              bool terminateProgram,
+                              bool bypassRateLimit)
 {
     if(!g_isEnabled)
     {
         VicrabCrashLOG_WARN("User-reported exception monitor is not installed. Exception has not been recorded.");
+        return false;
     }
     else
     {
+        // Fatal reports are always written.
+        RecentReportTicket ticket = {-1, 0};
+        if(!terminateProgram && !bypassRateLimit)
+        {
+            uintptr_t frames[kFingerprintFrames + 1];
+            int frameCount = backtrace((void**)frames, kFingerprintFrames + 1);
+            if(!admitReport(fingerprintReport(name, frames + 1, frameCount - 1), &ticket))
+            {
+                return false;
+            }
+        }
+
         if(logAllThreads)
         {
             vicrabcrashmc_suspendEnvironment();
@@ -84,6 +468,13 @@ void vicrabcrashcm_reportUserException(const char* name,
         context.userException.lineOfCode = lineOfCode;
         context.userException.customStackTrace = stackTrace;
         context.stackCursor = &stackCursor;
+        char reportPath[VicrabCrashFU_MAX_PATH_LENGTH] = "";
+        if(ticket.index >= 0)
+        {
+            context.userException.occurrences = 1;
+            context.reportPathBuffer = reportPath;
+            context.reportPathBufferLength = sizeof(reportPath);
+        }
 
         vicrabcrashcm_handleException(&context);
 
@@ -91,11 +482,298 @@ void vicrabcrashcm_reportUserException(const char* name,
         {
             vicrabcrashmc_resumeEnvironment();
         }
+        if(ticket.index >= 0)
+        {
+            recordReportPath(ticket, reportPath);
+        }
         if(terminateProgram)
         {
             abort();
         }
+        return true;
+    }
+}
+
+// ============================================================================
+#pragma mark - Asynchronous Reports -
+// ============================================================================
+
+static char* copyString(const char* string)
+{
+    return string == NULL ? NULL : strdup(string);
+}
+
+static void freePendingReport(PendingReport* report)
+{
+    free(report->name);
+    free(report->reason);
+    free(report->language);
+    free(report->lineOfCode);
+    free(report->stackTrace);
+    free(report->machineContext);
+    free(report->capturedThreads);
+    free(report->backtraces);
+    free(report);
+}
+
+/** Capture the backtraces of all threads in the machine context's thread list,
+ * in the same order, using the already captured one for the calling thread.
+ */
+static bool captureAllThreads(PendingReport* report, bool logAllThreads)
+{
+    const struct VicrabCrashMachineContext* context = report->machineContext;
+    const VicrabCrashThread thisThread = vicrabcrashthread_self();
+    int threadCount = logAllThreads ? vicrabcrashmc_getThreadCount(context) : 0;
+    if(threadCount <= 0)
+    {
+        report->capturedThreads = calloc(1, sizeof(*report->capturedThreads));
+        if(report->capturedThreads == NULL)
+        {
+            return false;
+        }
+        report->capturedThreads[0].thread = thisThread;
+        report->capturedThreads[0].backtrace = report->callingThreadBacktrace;
+        report->capturedThreads[0].backtraceLength = report->callingThreadBacktraceLength;
+        report->capturedThreadCount = 1;
+        return true;
     }
+
+    report->capturedThreads = calloc((size_t)threadCount, sizeof(*report->capturedThreads));
+    report->backtraces = malloc((size_t)threadCount * kMaxCapturedFrames * sizeof(*report->backtraces));
+    if(report->capturedThreads == NULL || report->backtraces == NULL)
+    {
+        return false;
+    }
+
+    for(int i = 0; i < threadCount; i++)
+    {
+        VicrabCrashCapturedThread* capturedThread = &report->capturedThreads[i];
+        capturedThread->thread = vicrabcrashmc_getThreadAtIndex(context, i);
+        if(capturedThread->thread == thisThread)
+        {
+            capturedThread->backtrace = report->callingThreadBacktrace;
+            capturedThread->backtraceLength = report->callingThreadBacktraceLength;
+        }
+        else
+        {
+            uintptr_t* backtrace = report->backtraces + i * kMaxCapturedFrames;
+            capturedThread->backtrace = backtrace;
+            capturedThread->backtraceLength = vicrabcrashsc_copySuspendedBacktrace(capturedThread->thread,
+                                                                                    backtrace,
+                                                                                    kMaxCapturedFrames,
+                                                                                    kMaxSuspensionNanoseconds);
+        }
+    }
+    report->capturedThreadCount = threadCount;
+    return true;
+}
+
+static void writePendingReport(PendingReport* report)
+{
+    VicrabCrashStackCursor stackCursor;
+    vicrabcrashsc_initWithBacktrace(&stackCursor,
+                                    report->callingThreadBacktrace,
+                                    report->callingThreadBacktraceLength,
+                                    0);
+
+    VicrabCrashLOG_DEBUG("Filling out context.");
+    VicrabCrash_MonitorContext context;
+    memset(&context, 0, sizeof(context));
+    context.crashType = VicrabCrashMonitorTypeUserReported;
+    context.eventID = report->eventID;
+    context.offendingMachineContext = report->machineContext;
+    context.registersAreValid = false;
+    context.crashReason = report->reason;
+    context.userException.name = report->name;
+    context.userException.language = report->language;
+    context.userException.lineOfCode = report->lineOfCode;
+    context.userException.customStackTrace = report->stackTrace;
+    context.stackCursor = &stackCursor;
+    context.capturedThreads = report->capturedThreads;
+    context.capturedThreadCount = report->capturedThreadCount;
+    char reportPath[VicrabCrashFU_MAX_PATH_LENGTH] = "";
+    context.userException.occurrences = 1;
+    context.reportPathBuffer = reportPath;
+    context.reportPathBufferLength = sizeof(reportPath);
+
+    vicrabcrashcm_handleException(&context);
+    if(report->ticket.index >= 0)
+    {
+        recordReportPath(report->ticket, reportPath);
+    }
+}
+
+static void notifyCompletion(VicrabCrashUserReportCompletion onCompletion, bool isWritten, void* userData)
+{
+    if(onCompletion != NULL)
+    {
+        onCompletion(isWritten, userData);
+    }
+}
+
+/** Tell the caller the report is done with, and whether it was recorded. */
+static void finishPendingReport(PendingReport* report, bool isWritten)
+{
+    notifyCompletion(report->onCompletion, isWritten, report->userData);
+    freePendingReport(report);
+}
+
+/** Give up on a report that was admitted but could not be queued. */
+static void abandonPendingReport(PendingReport* report)
+{
+    if(report->ticket.index >= 0)
+    {
+        recordReportPath(report->ticket, "");
+    }
+    finishPendingReport(report, false);
+}
+
+static void* writePendingReports(__unused void* const userData)
+{
+    for(;;)
+    {
+        pthread_mutex_lock(&g_pendingReportsMutex);
+        while(g_pendingReportsHead == NULL)
+        {
+            pthread_cond_wait(&g_pendingReportsCondition, &g_pendingReportsMutex);
+        }
+        PendingReport* report = g_pendingReportsHead;
+        g_pendingReportsHead = report->next;
+        if(g_pendingReportsHead == NULL)
+        {
+            g_pendingReportsTail = NULL;
+        }
+        g_pendingReportsCount--;
+        pthread_mutex_unlock(&g_pendingReportsMutex);
+
+        writePendingReport(report);
+        finishPendingReport(report, true);
+    }
+    return NULL;
+}
+
+static void startWriterThread()
+{
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int error = pthread_create(&thread, &attr, &writePendingReports, NULL);
+    if(error != 0)
+    {
+        VicrabCrashLOG_ERROR("pthread_create: %s", strerror(error));
+    }
+    pthread_attr_destroy(&attr);
+}
+
+static bool enqueuePendingReport(PendingReport* report)
+{
+    pthread_once(&g_writerThreadOnce, startWriterThread);
+
+    pthread_mutex_lock(&g_pendingReportsMutex);
+    bool isQueued = g_pendingReportsCount < kMaxPendingReports;
+    if(isQueued)
+    {
+        if(g_pendingReportsTail != NULL)
+        {
+            g_pendingReportsTail->next = report;
+        }
+        else
+        {
+            g_pendingReportsHead = report;
+        }
+        g_pendingReportsTail = report;
+        g_pendingReportsCount++;
+        pthread_cond_signal(&g_pendingReportsCondition);
+    }
+    pthread_mutex_unlock(&g_pendingReportsMutex);
+    return isQueued;
+}
+
+bool vicrabcrashcm_reportUserExceptionAsync(const char* name,
+                                            const char* reason,
+                                            const char* language,
+                                            const char* lineOfCode,
+                                            const char* stackTrace,
+                                            bool logAllThreads,
+                                            bool bypassRateLimit,
+                                            VicrabCrashUserReportCompletion onCompletion,
+                                            void* userData)
+{
+    if(!g_isEnabled)
+    {
+        VicrabCrashLOG_WARN("User-reported exception monitor is not installed. Exception has not been recorded.");
+        notifyCompletion(onCompletion, false, userData);
+        return false;
+    }
+
+    PendingReport* report = calloc(1, sizeof(*report));
+    if(report == NULL)
+    {
+        VicrabCrashLOG_ERROR("Could not allocate user report. Exception has not been recorded.");
+        notifyCompletion(onCompletion, false, userData);
+        return false;
+    }
+    report->onCompletion = onCompletion;
+    report->userData = userData;
+    // Frame 0 is this function, the same place the synchronous path starts.
+    report->callingThreadBacktraceLength = backtrace((void**)report->callingThreadBacktrace, kMaxCapturedFrames);
+    report->ticket.index = -1;
+    if(!bypassRateLimit)
+    {
+        uint64_t fingerprint = fingerprintReport(name,
+                                                 report->callingThreadBacktrace + 1,
+                                                 report->callingThreadBacktraceLength - 1);
+        if(!admitReport(fingerprint, &report->ticket))
+        {
+            finishPendingReport(report, false);
+            return false;
+        }
+    }
+
+    vicrabcrashid_generate(report->eventID);
+    report->name = copyString(name);
+    report->reason = copyString(reason);
+    report->language = copyString(language);
+    report->lineOfCode = copyString(lineOfCode);
+    report->stackTrace = copyString(stackTrace);
+    report->machineContext = malloc((size_t)vicrabcrashmc_contextSize());
+    if(report->machineContext == NULL)
+    {
+        VicrabCrashLOG_ERROR("Could not allocate user report. Exception has not been recorded.");
+        abandonPendingReport(report);
+        return false;
+    }
+    vicrabcrashmc_getContextForThread(vicrabcrashthread_self(), report->machineContext, true);
+
+    if(!captureAllThreads(report, logAllThreads))
+    {
+        VicrabCrashLOG_ERROR("Could not capture threads. Exception has not been recorded.");
+        abandonPendingReport(report);
+        return false;
+    }
+
+    if(!enqueuePendingReport(report))
+    {
+        VicrabCrashLOG_WARN("Too many user reports pending. Exception has not been recorded.");
+        abandonPendingReport(report);
+        return false;
+    }
+    return true;
+}
+
+// ============================================================================
+#pragma mark - API -
+// ============================================================================
+
+void vicrabcrashcm_setUserReportRateLimit(int maxBurst, double reportsPerSecond)
+{
+    pthread_mutex_lock(&g_recentReportsMutex);
+    g_maxReportBurst = maxBurst;
+    g_reportsPerSecond = reportsPerSecond;
+    g_reportTokens = maxBurst;
+    g_lastTokenRefill = 0;
+    pthread_mutex_unlock(&g_recentReportsMutex);
 }
 
 static void setEnabled(bool isEnabled)
@@ -54,14 +54,89 @@ extern "C" {
  *                      performance penalty, so it's best to use only on fatal errors.
  *
  * @param terminateProgram If true, do not return from this function call. Terminate the program instead.
+ *
+ * @param bypassRateLimit If true, always write a report of its own, even for a repeat of a recent
+ *                        exception or beyond the rate limit. For callers that depend on the report,
+ *                        such as stack snapshots.
+ *
+ * @return true if a report was written, false if the exception was counted into an earlier report,
+ *         dropped by the rate limit, or the monitor is not installed.
  */
-void vicrabcrashcm_reportUserException(const char* name,
+bool vicrabcrashcm_reportUserException(const char* name,
                               const char* reason,
                               const char* language,
                               const char* lineOfCode,
                               const char* stackTrace,
                               bool logAllThreads,
-                              bool terminateProgram);
+                              bool terminateProgram,
+                              bool bypassRateLimit);
+
+/** Called on the background writer thread once an asynchronous report has
+ * been handled.
+ *
+ * @param isWritten true if a report was written, false if it was counted into
+ *                  an earlier report or dropped.
+ *
+ * @param userData The userData passed with the report.
+ */
+typedef void (*VicrabCrashUserReportCompletion)(bool isWritten, void* userData);
+
+/** Report a custom, user defined exception without writing the report on the
+ * calling thread.
+ *
+ * The calling thread's backtrace is captured before this returns. If
+ * logAllThreads is true, every other thread is suspended one at a time, only
+ * long enough to copy its backtrace. Encoding and storing the report happen
+ * later on a background thread, so the report is not in the store yet when
+ * this function returns.
+ *
+ * @param name The exception name (for namespacing exception types).
+ *
+ * @param reason A description of why the exception occurred.
+ *
+ * @param language A unique language identifier.
+ *
+ * @param lineOfCode A copy of the offending line of code (NULL = ignore).
+ *
+ * @param stackTrace JSON encoded array containing stack trace information (one frame per array entry).
+ *
+ * @param logAllThreads If true, capture the backtraces of all threads.
+ *
+ * @param bypassRateLimit If true, skip deduplication and the rate limit.
+ *
+ * @param onCompletion Called exactly once, after the report has been written
+ *                     or as soon as it is known it will not be (NULL = ignore).
+ *
+ * @param userData Passed to onCompletion.
+ *
+ * @return true if the report was queued for writing, false if it was counted
+ *         into an earlier report or dropped.
+ */
+bool vicrabcrashcm_reportUserExceptionAsync(const char* name,
+                                            const char* reason,
+                                            const char* language,
+                                            const char* lineOfCode,
+                                            const char* stackTrace,
+                                            bool logAllThreads,
+                                            bool bypassRateLimit,
+                                            VicrabCrashUserReportCompletion onCompletion,
+                                            void* userData);
+
+/** Limit how fast non-fatal user reports are written.
+ *
+ * Reports of an exception that was already reported from the same place
+ * (same name and top frames) only increment the "occurrences" count of the
+ * existing report while it is still on disk. New reports may be written in a
+ * burst of up to maxBurst, after which they are allowed at reportsPerSecond
+ * and dropped otherwise.
+ *
+ * @param maxBurst The most reports written in a burst (0 = no rate limit).
+ *
+ * @param reportsPerSecond The rate at which the burst allowance refills.
+ *
+ * Default: 10 reports, refilling at one every 6 seconds.
+ */
+void vicrabcrashcm_setUserReportRateLimit(int maxBurst, double reportsPerSecond);
 
 /** Access the Monitor API.
  */
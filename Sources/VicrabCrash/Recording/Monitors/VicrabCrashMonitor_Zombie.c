@@ -26,15 +26,21 @@
 
 
 #include "VicrabCrashMonitor_Zombie.h"
+#include "VicrabCrashSystemCapabilities.h"
+
+#if VicrabCrashCRASH_HAS_OBJC
+
 #include "VicrabCrashMonitorContext.h"
 #include "VicrabCrashObjC.h"
 #include "VicrabCrashLogger.h"
 
 #include <objc/runtime.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 
 
-#define CACHE_SIZE 0x8000
+#define DEFAULT_CACHE_SIZE 0x8000
+#define MIN_CACHE_SIZE 0x100
 
 // Compiler hints for "if" statements
 #define likely_if(x) if(__builtin_expect(x,1))
@@ -49,6 +55,15 @@ typedef struct
 
 static volatile Zombie* g_zombieCache;
 static unsigned g_zombieHashMask;
+static unsigned g_cacheSize = DEFAULT_CACHE_SIZE;
+
+/** Only addresses whose sampling hash has these bits clear are cached. */
+static uintptr_t g_samplingMask;
+
+/** The last class checked for being an exception, with the answer in the
+ * low bit. One word, so racing deallocs always see a matching pair.
+ */
+static _Atomic(uintptr_t) g_exceptionClassMemo;
 
 static volatile bool g_isEnabled = false;
 
@@ -67,6 +82,28 @@ static inline unsigned hashIndex(const void* object)
     return objPtr & g_zombieHashMask;
 }
 
+static inline bool isSampled(const void* object)
+{
+    // Use different bits from hashIndex(), or sampled objects would crowd into
+    // a fraction of the cache.
+    likely_if(g_samplingMask == 0)
+    {
+        return true;
+    }
+    uintptr_t hash = ((uintptr_t)object >> 4) * (uintptr_t)0x9E3779B97F4A7C15ull;
+    return ((hash >> (sizeof(hash) * 8 - 8)) & g_samplingMask) == 0;
+}
+
+static unsigned roundUpToPowerOf2(unsigned value)
+{
+    unsigned result = 1;
+    while(result < value && result < 0x80000000u)
+    {
+        result <<= 1;
+    }
+    return result;
+}
+
 static bool copyStringIvar(const void* self, const char* ivarName, char* buffer, int bufferLength)
 {
     Class class = object_getClass((id)self);
@@ -111,21 +148,42 @@ static void storeException(const void* exception)
     copyStringIvar(exception, "reason", g_lastDeallocedException.reason, sizeof(g_lastDeallocedException.reason));
 }
 
+static inline bool isExceptionClass(Class class)
+{
+    uintptr_t memo = atomic_load_explicit(&g_exceptionClassMemo, memory_order_relaxed);
+    likely_if((memo & ~(uintptr_t)1) == (uintptr_t)class)
+    {
+        return (memo & 1) != 0;
+    }
+
+    bool isException = false;
+    for(Class current = class; current != nil; current = class_getSuperclass(current))
+    {
+        unlikely_if(current == g_lastDeallocedException.class)
+        {
+            isException = true;
+            break;
+        }
+    }
+    atomic_store_explicit(&g_exceptionClassMemo, (uintptr_t)class | isException, memory_order_relaxed);
+    return isException;
+}
+
 static inline void handleDealloc(const void* self)
 {
     volatile Zombie* cache = g_zombieCache;
     likely_if(cache != NULL)
     {
-        Zombie* zombie = (Zombie*)cache + hashIndex(self);
-        zombie->object = self;
         Class class = object_getClass((id)self);
-        zombie->className = class_getName(class);
-        for(; class != nil; class = class_getSuperclass(class))
+        likely_if(isSampled(self))
         {
-            unlikely_if(class == g_lastDeallocedException.class)
-            {
-                storeException(self);
-            }
+            Zombie* zombie = (Zombie*)cache + hashIndex(self);
+            zombie->object = self;
+            zombie->className = class_getName(class);
+        }
+        unlikely_if(isExceptionClass(class))
+        {
+            storeException(self);
         }
     }
 }
@@ -156,7 +214,7 @@ CREATE_ZOMBIE_HANDLER_INSTALLER(NSProxy)
 
 static void install()
 {
-    unsigned cacheSize = CACHE_SIZE;
+    unsigned cacheSize = g_cacheSize;
     g_zombieHashMask = cacheSize - 1;
     g_zombieCache = calloc(cacheSize, sizeof(*g_zombieCache));
     if(g_zombieCache == NULL)
@@ -167,6 +225,7 @@ static void install()
     }
 
     g_lastDeallocedException.class = objc_getClass("NSException");
+    atomic_store(&g_exceptionClassMemo, 0);
     g_lastDeallocedException.address = NULL;
     g_lastDeallocedException.name[0] = 0;
     g_lastDeallocedException.reason[0] = 0;
@@ -190,6 +249,25 @@ static void install()
 //    });
 //}
 
+void vicrabcrashzombie_setCacheSize(unsigned entryCount)
+{
+    if(g_zombieCache != NULL)
+    {
+        VicrabCrashLOG_WARN("The zombie cache is already allocated. Ignoring the new size.");
+        return;
+    }
+    g_cacheSize = roundUpToPowerOf2(entryCount < MIN_CACHE_SIZE ? MIN_CACHE_SIZE : entryCount);
+}
+
+void vicrabcrashzombie_setSamplingRate(unsigned oneIn)
+{
+    if(oneIn > 256)
+    {
+        oneIn = 256;
+    }
+    g_samplingMask = oneIn <= 1 ? 0 : roundUpToPowerOf2(oneIn) - 1;
+}
+
 const char* vicrabcrashzombie_className(const void* object)
 {
     volatile Zombie* cache = g_zombieCache;
@@ -249,3 +327,22 @@ VicrabCrashMonitorAPI* vicrabcrashcm_zombie_getAPI()
     };
     return &api;
 }
+
+#else
+
+#include <stddef.h>
+
+void vicrabcrashzombie_setCacheSize(__attribute__((unused)) unsigned entryCount)
+{
+}
+
+void vicrabcrashzombie_setSamplingRate(__attribute__((unused)) unsigned oneIn)
+{
+}
+
+const char* vicrabcrashzombie_className(__attribute__((unused)) const void* object)
+{
+    return NULL;
+}
+
+#endif // VicrabCrashCRASH_HAS_OBJC
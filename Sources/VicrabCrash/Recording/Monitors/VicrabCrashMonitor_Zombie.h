@@ -49,6 +49,26 @@ extern "C" {
 #include <stdbool.h>
 
 
+/** Set how many deallocated objects the zombie cache can remember.
+ * Must be called before the monitor is enabled; the cache is allocated once.
+ *
+ * @param entryCount Number of entries, rounded up to a power of 2
+ *                   (minimum 256). Each entry takes two pointers.
+ *
+ * Default: 32768
+ */
+void vicrabcrashzombie_setCacheSize(unsigned entryCount);
+
+/** Only remember about one in every N deallocated objects, to cut the
+ * overhead for allocation-heavy apps. Whether an object is tracked depends
+ * on its address only. Deallocated exceptions are always tracked.
+ *
+ * @param oneIn N, rounded up to a power of 2 (maximum 256). 1 = track all.
+ *
+ * Default: 1
+ */
+void vicrabcrashzombie_setSamplingRate(unsigned oneIn);
+
 /** Get the class of a deallocated object pointer, if it was tracked.
  *
  * @param object A pointer to a deallocated object.
@@ -29,19 +29,39 @@
 
 #include "VicrabCrashSystemCapabilities.h"
 
+#if VicrabCrashCRASH_HOST_APPLE
 #include <mach/mach.h>
 #include <mach-o/arch.h>
+#endif
 
 //#define VicrabCrashLogger_LocalLevel TRACE
 #include "VicrabCrashLogger.h"
 
 
+#if VicrabCrashCRASH_HOST_APPLE
 const char* vicrabcrashcpu_currentArch(void)
 {
     const NXArchInfo* archInfo = NXGetLocalArchInfo();
     return archInfo == NULL ? NULL : archInfo->name;
 }
+#else
+const char* vicrabcrashcpu_currentArch(void)
+{
+#if defined(__x86_64__)
+    return "x86_64";
+#elif defined(__aarch64__)
+    return "arm64";
+#elif defined(__i386__)
+    return "i386";
+#elif defined(__arm__)
+    return "armv7";
+#else
+    return NULL;
+#endif
+}
+#endif
 
+#if VicrabCrashCRASH_HOST_APPLE
 #if VicrabCrashCRASH_HAS_THREADS_API
 bool vicrabcrashcpu_i_fillState(const thread_t thread,
                        const thread_state_t state,
@@ -70,3 +90,4 @@ bool vicrabcrashcpu_i_fillState(__unused const thread_t thread,
 }
 
 #endif
+#endif // VicrabCrashCRASH_HOST_APPLE
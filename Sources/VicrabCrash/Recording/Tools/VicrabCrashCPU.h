@@ -143,6 +143,16 @@ int vicrabcrashcpu_stackGrowDirection(void);
  */
 void vicrabcrashcpu_getState(struct VicrabCrashMachineContext* destinationContext);
 
+/** Fetch only the registers needed to walk the stack (pc, sp, fp, lr).
+ * Unlike vicrabcrashcpu_getState(), this neither logs nor allocates, so it
+ * is safe to call while another thread is suspended.
+ *
+ * @param destinationContext The context to fill.
+ *
+ * @return true if the state was fetched.
+ */
+bool vicrabcrashcpu_getStackState(struct VicrabCrashMachineContext* destinationContext);
+
 /** Strip PAC from an instruction pointer.
  *
  * @param ip PAC encoded instruction pointer.
@@ -0,0 +1,272 @@
+//
+//  VicrabCrashCPU_Linux.c
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "VicrabCrashSystemCapabilities.h"
+
+#if VicrabCrashCRASH_HOST_LINUX && (defined (__x86_64__) || defined (__aarch64__))
+
+
+#include "VicrabCrashCPU.h"
+#include "VicrabCrashMachineContext.h"
+#include "VicrabCrashMachineContext_Linux.h"
+
+#include <stdlib.h>
+
+//#define VicrabCrashLogger_LocalLevel TRACE
+#include "VicrabCrashLogger.h"
+
+
+#if defined (__x86_64__)
+
+static const char* g_registerNames[] =
+{
+    "rax", "rbx", "rcx", "rdx",
+    "rdi", "rsi",
+    "rbp", "rsp",
+    "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15",
+    "rip", "rflags",
+    "cs", "fs", "gs"
+};
+
+static const int g_registerIndices[] =
+{
+    REG_RAX, REG_RBX, REG_RCX, REG_RDX,
+    REG_RDI, REG_RSI,
+    REG_RBP, REG_RSP,
+    REG_R8, REG_R9, REG_R10, REG_R11, REG_R12, REG_R13, REG_R14, REG_R15,
+    REG_RIP, REG_EFL,
+    REG_CSGSFS, REG_CSGSFS, REG_CSGSFS
+};
+
+static const char* g_exceptionRegisterNames[] =
+{
+    "trapno", "err", "faultvaddr"
+};
+
+static const int g_exceptionRegisterIndices[] =
+{
+    REG_TRAPNO, REG_ERR, REG_CR2
+};
+
+#define GREG(CONTEXT, INDEX) ((uint64_t)(CONTEXT)->machineContext.gregs[INDEX])
+
+uintptr_t vicrabcrashcpu_framePointer(const VicrabCrashMachineContext* const context)
+{
+    return (uintptr_t)GREG(context, REG_RBP);
+}
+
+uintptr_t vicrabcrashcpu_stackPointer(const VicrabCrashMachineContext* const context)
+{
+    return (uintptr_t)GREG(context, REG_RSP);
+}
+
+uintptr_t vicrabcrashcpu_instructionAddress(const VicrabCrashMachineContext* const context)
+{
+    return (uintptr_t)GREG(context, REG_RIP);
+}
+
+uintptr_t vicrabcrashcpu_linkRegister(__attribute__((unused)) const VicrabCrashMachineContext* const context)
+{
+    return 0;
+}
+
+uintptr_t vicrabcrashcpu_faultAddress(const VicrabCrashMachineContext* const context)
+{
+    return (uintptr_t)GREG(context, REG_CR2);
+}
+
+static uint64_t registerValue(const VicrabCrashMachineContext* const context, const int regNumber)
+{
+    uint64_t value = GREG(context, g_registerIndices[regNumber]);
+    // cs, gs and fs are packed into a single greg, 16 bits each.
+    switch(regNumber)
+    {
+        case 18:
+            return value & 0xffff;
+        case 19:
+            return (value >> 32) & 0xffff;
+        case 20:
+            return (value >> 16) & 0xffff;
+    }
+    return value;
+}
+
+static uint64_t exceptionRegisterValue(const VicrabCrashMachineContext* const context, const int regNumber)
+{
+    return GREG(context, g_exceptionRegisterIndices[regNumber]);
+}
+
+#elif defined (__aarch64__)
+
+static const char* g_registerNames[] =
+{
+     "x0",  "x1",  "x2",  "x3",  "x4",  "x5",  "x6",  "x7",
+     "x8",  "x9", "x10", "x11", "x12", "x13", "x14", "x15",
+    "x16", "x17", "x18", "x19", "x20", "x21", "x22", "x23",
+    "x24", "x25", "x26", "x27", "x28", "x29",
+    "fp", "lr", "sp", "pc", "cpsr"
+};
+
+static const char* g_exceptionRegisterNames[] =
+{
+    "far"
+};
+
+uintptr_t vicrabcrashcpu_framePointer(const VicrabCrashMachineContext* const context)
+{
+    return context->machineContext.regs[29];
+}
+
+uintptr_t vicrabcrashcpu_stackPointer(const VicrabCrashMachineContext* const context)
+{
+    return context->machineContext.sp;
+}
+
+uintptr_t vicrabcrashcpu_instructionAddress(const VicrabCrashMachineContext* const context)
+{
+    return context->machineContext.pc;
+}
+
+uintptr_t vicrabcrashcpu_linkRegister(const VicrabCrashMachineContext* const context)
+{
+    return context->machineContext.regs[30];
+}
+
+uintptr_t vicrabcrashcpu_faultAddress(const VicrabCrashMachineContext* const context)
+{
+    return context->machineContext.fault_address;
+}
+
+static uint64_t registerValue(const VicrabCrashMachineContext* const context, const int regNumber)
+{
+    if(regNumber <= 29)
+    {
+        return context->machineContext.regs[regNumber];
+    }
+
+    switch(regNumber)
+    {
+        case 30:
+            return context->machineContext.regs[29];
+        case 31:
+            return context->machineContext.regs[30];
+        case 32:
+            return context->machineContext.sp;
+        case 33:
+            return context->machineContext.pc;
+        case 34:
+            return context->machineContext.pstate;
+    }
+    return 0;
+}
+
+static uint64_t exceptionRegisterValue(const VicrabCrashMachineContext* const context,
+                                       __attribute__((unused)) const int regNumber)
+{
+    return context->machineContext.fault_address;
+}
+
+#endif
+
+static const int g_registerNamesCount =
+sizeof(g_registerNames) / sizeof(*g_registerNames);
+
+static const int g_exceptionRegisterNamesCount =
+sizeof(g_exceptionRegisterNames) / sizeof(*g_exceptionRegisterNames);
+
+
+void vicrabcrashcpu_getState(__attribute__((unused)) VicrabCrashMachineContext* context)
+{
+    // Register state is only available from a signal's user context, which
+    // vicrabcrashmc_getContextForSignal() has already copied.
+}
+
+bool vicrabcrashcpu_getStackState(__attribute__((unused)) VicrabCrashMachineContext* context)
+{
+    return false;
+}
+
+int vicrabcrashcpu_numRegisters(void)
+{
+    return g_registerNamesCount;
+}
+
+const char* vicrabcrashcpu_registerName(const int regNumber)
+{
+    if(regNumber < vicrabcrashcpu_numRegisters())
+    {
+        return g_registerNames[regNumber];
+    }
+    return NULL;
+}
+
+uint64_t vicrabcrashcpu_registerValue(const VicrabCrashMachineContext* const context, const int regNumber)
+{
+    if(regNumber >= 0 && regNumber < vicrabcrashcpu_numRegisters())
+    {
+        return registerValue(context, regNumber);
+    }
+
+    VicrabCrashLOG_ERROR("Invalid register number: %d", regNumber);
+    return 0;
+}
+
+int vicrabcrashcpu_numExceptionRegisters(void)
+{
+    return g_exceptionRegisterNamesCount;
+}
+
+const char* vicrabcrashcpu_exceptionRegisterName(const int regNumber)
+{
+    if(regNumber < vicrabcrashcpu_numExceptionRegisters())
+    {
+        return g_exceptionRegisterNames[regNumber];
+    }
+    VicrabCrashLOG_ERROR("Invalid register number: %d", regNumber);
+    return NULL;
+}
+
+uint64_t vicrabcrashcpu_exceptionRegisterValue(const VicrabCrashMachineContext* const context, const int regNumber)
+{
+    if(regNumber >= 0 && regNumber < vicrabcrashcpu_numExceptionRegisters())
+    {
+        return exceptionRegisterValue(context, regNumber);
+    }
+
+    VicrabCrashLOG_ERROR("Invalid register number: %d", regNumber);
+    return 0;
+}
+
+int vicrabcrashcpu_stackGrowDirection(void)
+{
+    return -1;
+}
+
+uintptr_t vicrabcrashcpu_normaliseInstructionPointer(uintptr_t ip)
+{
+    return ip;
+}
+
+#endif
@@ -25,13 +25,16 @@
 //
 
 
-#if defined (__x86_64__)
+#include "VicrabCrashSystemCapabilities.h"
+
+#if defined (__x86_64__) && VicrabCrashCRASH_HOST_APPLE
 
 
 #include "VicrabCrashCPU.h"
 #include "VicrabCrashCPU_Apple.h"
 #include "VicrabCrashMachineContext.h"
 #include "VicrabCrashMachineContext_Apple.h"
+#include <mach/mach.h>
 
 #include <stdlib.h>
 
@@ -89,6 +92,12 @@ void vicrabcrashcpu_getState(VicrabCrashMachineContext* context)
     vicrabcrashcpu_i_fillState(thread, (thread_state_t)&machineContext->__es, x86_EXCEPTION_STATE64, x86_EXCEPTION_STATE64_COUNT);
 }
 
+bool vicrabcrashcpu_getStackState(VicrabCrashMachineContext* context)
+{
+    mach_msg_type_number_t stateCount = x86_THREAD_STATE64_COUNT;
+    return thread_get_state(context->thisThread, x86_THREAD_STATE64, (thread_state_t)&context->machineContext.__ss, &stateCount) == KERN_SUCCESS;
+}
+
 int vicrabcrashcpu_numRegisters(void)
 {
     return g_registerNamesCount;
@@ -23,9 +23,14 @@
 //
 
 #include "VicrabCrashDate.h"
+#include "VicrabCrashSystemCapabilities.h"
 #include <stdio.h>
 #include <time.h>
 
+#if VicrabCrashCRASH_HOST_APPLE
+#include <mach/mach_time.h>
+#endif
+
 void vicrabcrashdate_utcStringFromTimestamp(time_t timestamp, char* buffer21Chars)
 {
     struct tm result = {0};
@@ -38,3 +43,19 @@ void vicrabcrashdate_utcStringFromTimestamp(time_t timestamp, char* buffer21Char
              result.tm_min,
              result.tm_sec);
 }
+
+uint64_t vicrabcrashdate_monotonicNanoseconds(void)
+{
+#if VicrabCrashCRASH_HOST_APPLE
+    static mach_timebase_info_data_t timebase;
+    if(timebase.denom == 0)
+    {
+        mach_timebase_info(&timebase);
+    }
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+#endif
+}
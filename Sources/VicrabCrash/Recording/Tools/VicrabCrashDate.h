@@ -30,6 +30,7 @@ extern "C" {
 #endif
 
 
+#include <stdint.h>
 #include <sys/types.h>
 
 /** Convert a UNIX timestamp to an RFC3339 string representation.
@@ -40,6 +41,15 @@ extern "C" {
  */
 void vicrabcrashdate_utcStringFromTimestamp(time_t timestamp, char* buffer21Chars);
 
+/** Get the current value of a monotonic clock, in nanoseconds.
+ * The value has no meaning on its own; only use it to measure intervals.
+ *
+ * This function is async-safe.
+ *
+ * @return The current monotonic time in nanoseconds.
+ */
+uint64_t vicrabcrashdate_monotonicNanoseconds(void);
+
 #ifdef __cplusplus
 }
 #endif
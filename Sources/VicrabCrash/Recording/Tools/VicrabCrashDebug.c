@@ -30,16 +30,24 @@
 //#define VicrabCrashLogger_LocalLevel TRACE
 #include "VicrabCrashLogger.h"
 
+#include "VicrabCrashSystemCapabilities.h"
+
 #include <errno.h>
 #include <string.h>
-#include <sys/sysctl.h>
 #include <unistd.h>
+#if VicrabCrashCRASH_HOST_APPLE
+#include <sys/sysctl.h>
+#elif VicrabCrashCRASH_HOST_LINUX
+#include <fcntl.h>
+#include <stdlib.h>
+#endif
 
 
 /** Check if the current process is being traced or not.
  *
  * @return true if we're being traced.
  */
+#if VicrabCrashCRASH_HOST_APPLE
 bool vicrabcrashdebug_isBeingTraced(void)
 {
     struct kinfo_proc procInfo;
@@ -54,3 +62,29 @@ bool vicrabcrashdebug_isBeingTraced(void)
 
     return (procInfo.kp_proc.p_flag & P_TRACED) != 0;
 }
+#elif VicrabCrashCRASH_HOST_LINUX
+bool vicrabcrashdebug_isBeingTraced(void)
+{
+    char buffer[1024];
+    int fd = open("/proc/self/status", O_RDONLY);
+    if(fd < 0)
+    {
+        VicrabCrashLOG_ERROR("open /proc/self/status: %s", strerror(errno));
+        return false;
+    }
+    ssize_t bytesRead = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    if(bytesRead <= 0)
+    {
+        return false;
+    }
+    buffer[bytesRead] = '\0';
+
+    const char* tracerPid = strstr(buffer, "TracerPid:");
+    if(tracerPid == NULL)
+    {
+        return false;
+    }
+    return strtol(tracerPid + sizeof("TracerPid:") - 1, NULL, 10) != 0;
+}
+#endif
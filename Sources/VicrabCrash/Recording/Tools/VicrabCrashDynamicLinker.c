@@ -25,6 +25,9 @@
 //
 
 #include "VicrabCrashDynamicLinker.h"
+#include "VicrabCrashSystemCapabilities.h"
+
+#if VicrabCrashCRASH_HOST_APPLE
 
 #include <limits.h>
 #include <mach-o/dyld.h>
@@ -309,6 +312,12 @@ bool vicrabcrashdl_getBinaryImage(int index, VicrabCrashBinaryImage* buffer)
         return false;
     }
 
+    return vicrabcrashdl_getBinaryImageForHeader(header, _dyld_get_image_name((unsigned)index), buffer);
+}
+
+bool vicrabcrashdl_getBinaryImageForHeader(const void* const headerPtr, const char* const imageName, VicrabCrashBinaryImage* buffer)
+{
+    const struct mach_header* header = (const struct mach_header*)headerPtr;
     uintptr_t cmdPtr = firstCmdAfterHeader(header);
     if(cmdPtr == 0)
     {
@@ -367,7 +376,7 @@ bool vicrabcrashdl_getBinaryImage(int index, VicrabCrashBinaryImage* buffer)
     buffer->address = (uintptr_t)header;
     buffer->vmAddress = imageVmAddr;
     buffer->size = imageSize;
-    buffer->name = _dyld_get_image_name((unsigned)index);
+    buffer->name = imageName;
     buffer->uuid = uuid;
     buffer->cpuType = header->cputype;
     buffer->cpuSubType = header->cpusubtype;
@@ -377,3 +386,5 @@ bool vicrabcrashdl_getBinaryImage(int index, VicrabCrashBinaryImage* buffer)
 
     return true;
 }
+
+#endif // VicrabCrashCRASH_HOST_APPLE
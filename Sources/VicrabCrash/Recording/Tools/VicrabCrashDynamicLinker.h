@@ -64,6 +64,18 @@ int vicrabcrashdl_imageCount(void);
  */
 bool vicrabcrashdl_getBinaryImage(int index, VicrabCrashBinaryImage* buffer);
 
+/** Get information about a binary image based on its mach header.
+ *
+ * @param header The image's mach header.
+ *
+ * @param imageName The image's name (as reported by dyld or dladdr).
+ *
+ * @param buffer A structure to hold the information.
+ *
+ * @return True if the image was successfully queried.
+ */
+bool vicrabcrashdl_getBinaryImageForHeader(const void* const header, const char* const imageName, VicrabCrashBinaryImage* buffer);
+
 /** Find a loaded binary image with the specified name.
  *
  * @param imageName The image name to look for.
@@ -0,0 +1,267 @@
+//
+//  VicrabCrashDynamicLinker_Linux.c
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "VicrabCrashDynamicLinker.h"
+#include "VicrabCrashSystemCapabilities.h"
+
+#if VicrabCrashCRASH_HOST_LINUX
+
+#include <elf.h>
+#include <errno.h>
+#include <link.h>
+#include <string.h>
+
+#include "VicrabCrashLogger.h"
+
+#define kGNUBuildIDNoteName "GNU"
+
+
+typedef struct
+{
+    int targetIndex;
+    int currentIndex;
+    const char* targetName;
+    bool exactMatch;
+    const struct dl_phdr_info* found;
+    VicrabCrashBinaryImage* buffer;
+} ImageSearch;
+
+
+/** The main executable is reported by the loader with an empty name. */
+static const char* imageNameForInfo(const struct dl_phdr_info* const info)
+{
+    if(info->dlpi_name == NULL || info->dlpi_name[0] == '\0')
+    {
+        return program_invocation_name;
+    }
+    return info->dlpi_name;
+}
+
+/** Get the address of an image's ELF header, which is mapped at the start of
+ * the loadable segment with file offset 0.
+ *
+ * @return The header address, or 0 if the image has no such segment.
+ */
+static uintptr_t headerAddressForInfo(const struct dl_phdr_info* const info)
+{
+    for(int i = 0; i < info->dlpi_phnum; i++)
+    {
+        const ElfW(Phdr)* phdr = &info->dlpi_phdr[i];
+        if(phdr->p_type == PT_LOAD && phdr->p_offset == 0)
+        {
+            return (uintptr_t)(info->dlpi_addr + phdr->p_vaddr);
+        }
+    }
+    return 0;
+}
+
+/** Find the GNU build ID note in a PT_NOTE segment.
+ *
+ * @return A pointer to the build ID bytes, or NULL if the segment has none.
+ */
+static const uint8_t* buildIDInNoteSegment(const uint8_t* notes, const uint64_t segmentSize, uint32_t* const length)
+{
+    const uint8_t* const end = notes + segmentSize;
+    while(notes + sizeof(ElfW(Nhdr)) <= end)
+    {
+        const ElfW(Nhdr)* note = (const ElfW(Nhdr)*)notes;
+        const uint8_t* name = notes + sizeof(*note);
+        const uint8_t* desc = name + ((note->n_namesz + 3) & ~3u);
+        if(note->n_type == NT_GNU_BUILD_ID &&
+           note->n_namesz == sizeof(kGNUBuildIDNoteName) &&
+           memcmp(name, kGNUBuildIDNoteName, sizeof(kGNUBuildIDNoteName)) == 0)
+        {
+            *length = note->n_descsz;
+            return desc;
+        }
+        notes = desc + ((note->n_descsz + 3) & ~3u);
+    }
+    return NULL;
+}
+
+static int countImages(__attribute__((unused)) struct dl_phdr_info* info,
+                       __attribute__((unused)) size_t size,
+                       void* data)
+{
+    (*(int*)data)++;
+    return 0;
+}
+
+static int findImage(struct dl_phdr_info* info, __attribute__((unused)) size_t size, void* data)
+{
+    ImageSearch* search = data;
+    int index = search->currentIndex++;
+    if(search->targetName != NULL)
+    {
+        const char* name = imageNameForInfo(info);
+        bool matches = search->exactMatch ? strcmp(name, search->targetName) == 0
+                                          : strstr(name, search->targetName) != NULL;
+        if(!matches)
+        {
+            return 0;
+        }
+    }
+    else if(index != search->targetIndex)
+    {
+        return 0;
+    }
+
+    search->targetIndex = index;
+    const uintptr_t header = headerAddressForInfo(info);
+    if(header == 0 || search->buffer == NULL)
+    {
+        return 1;
+    }
+    search->found = info;
+    vicrabcrashdl_getBinaryImageForHeader((const void*)header, imageNameForInfo(info), search->buffer);
+    return 1;
+}
+
+int vicrabcrashdl_imageCount()
+{
+    int count = 0;
+    dl_iterate_phdr(countImages, &count);
+    return count;
+}
+
+bool vicrabcrashdl_getBinaryImage(int index, VicrabCrashBinaryImage* buffer)
+{
+    ImageSearch search = { .targetIndex = index, .buffer = buffer };
+    dl_iterate_phdr(findImage, &search);
+    return search.found != NULL;
+}
+
+bool vicrabcrashdl_getBinaryImageForHeader(const void* const headerPtr, const char* const imageName, VicrabCrashBinaryImage* buffer)
+{
+    const ElfW(Ehdr)* header = (const ElfW(Ehdr)*)headerPtr;
+    if(memcmp(header->e_ident, ELFMAG, SELFMAG) != 0)
+    {
+        return false;
+    }
+
+    const ElfW(Phdr)* phdrs = (const ElfW(Phdr)*)((uintptr_t)header + header->e_phoff);
+    uintptr_t loadBias = 0;
+    for(int i = 0; i < header->e_phnum; i++)
+    {
+        if(phdrs[i].p_type == PT_LOAD && phdrs[i].p_offset == 0)
+        {
+            loadBias = (uintptr_t)header - phdrs[i].p_vaddr;
+            break;
+        }
+    }
+
+    // Size is the span of all loadable segments.
+    // The build ID takes the place of the Mach-O UUID.
+    uint64_t imageVmAddr = UINT64_MAX;
+    uint64_t imageEnd = 0;
+    const uint8_t* uuid = NULL;
+    for(int i = 0; i < header->e_phnum; i++)
+    {
+        const ElfW(Phdr)* phdr = &phdrs[i];
+        if(phdr->p_type == PT_LOAD)
+        {
+            if(phdr->p_vaddr < imageVmAddr)
+            {
+                imageVmAddr = phdr->p_vaddr;
+            }
+            if(phdr->p_vaddr + phdr->p_memsz > imageEnd)
+            {
+                imageEnd = phdr->p_vaddr + phdr->p_memsz;
+            }
+        }
+        else if(phdr->p_type == PT_NOTE && uuid == NULL)
+        {
+            uint32_t length = 0;
+            const uint8_t* buildID = buildIDInNoteSegment((const uint8_t*)(loadBias + phdr->p_vaddr), phdr->p_memsz, &length);
+            // The report holds 16 UUID bytes; shorter IDs aren't usable.
+            if(buildID != NULL && length >= 16)
+            {
+                uuid = buildID;
+            }
+        }
+    }
+    if(imageEnd == 0)
+    {
+        return false;
+    }
+
+    buffer->address = (uintptr_t)header;
+    buffer->vmAddress = imageVmAddr;
+    buffer->size = imageEnd - imageVmAddr;
+    buffer->name = imageName;
+    buffer->uuid = uuid;
+    buffer->cpuType = header->e_machine;
+    buffer->cpuSubType = 0;
+    buffer->majorVersion = 0;
+    buffer->minorVersion = 0;
+    buffer->revisionVersion = 0;
+
+    return true;
+}
+
+uint32_t vicrabcrashdl_imageNamed(const char* const imageName, bool exactMatch)
+{
+    if(imageName != NULL)
+    {
+        ImageSearch search = { .targetIndex = -1, .targetName = imageName, .exactMatch = exactMatch };
+        if(dl_iterate_phdr(findImage, &search) != 0)
+        {
+            return (uint32_t)search.targetIndex;
+        }
+    }
+    return UINT32_MAX;
+}
+
+const uint8_t* vicrabcrashdl_imageUUID(const char* const imageName, bool exactMatch)
+{
+    if(imageName != NULL)
+    {
+        VicrabCrashBinaryImage image;
+        ImageSearch search = { .targetIndex = -1, .targetName = imageName, .exactMatch = exactMatch, .buffer = &image };
+        dl_iterate_phdr(findImage, &search);
+        if(search.found != NULL)
+        {
+            return image.uuid;
+        }
+    }
+    return NULL;
+}
+
+bool vicrabcrashdl_dladdr(const uintptr_t address, Dl_info* const info)
+{
+    // glibc's dladdr takes the loader lock. There is no lock-free equivalent,
+    // so this is only as async-safe as the loader happens to be at crash time.
+    if(dladdr((const void*)address, info) == 0)
+    {
+        info->dli_fname = NULL;
+        info->dli_fbase = NULL;
+        info->dli_sname = NULL;
+        info->dli_saddr = NULL;
+        return false;
+    }
+    return true;
+}
+
+#endif // VicrabCrashCRASH_HOST_LINUX
@@ -34,7 +34,11 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
@@ -79,6 +83,30 @@ static void writeFmtArgsToLog(const char* fmt, va_list args);
  */
 static void flushLog(void);
 
+/** Queue an entry for the background writer instead of writing it now.
+ *
+ * @param level The level name, or NULL for a basic entry.
+ *
+ * @param file The source file (basic entries: NULL).
+ *
+ * @param line The source line (basic entries: 0).
+ *
+ * @param function The function name (basic entries: NULL).
+ *
+ * @param fmt The format string.
+ *
+ * @param args The variable arguments.
+ *
+ * @return false if the caller must write the entry itself, because deferred
+ *         writing is off or the entry's slot is still in use.
+ */
+static bool deferEntry(const char* level,
+                       const char* file,
+                       int line,
+                       const char* function,
+                       const char* fmt,
+                       va_list args);
+
 
 static inline const char* lastPathEntry(const char* const path)
 {
@@ -148,6 +176,650 @@ static inline void setLogFD(int fd)
     g_fd = fd;
 }
 
+// ===========================================================================
+#pragma mark - Deferred Writing -
+// ===========================================================================
+
+/** Number of entries the ring holds. Must be a power of two. */
+#define kLogRingSize 128
+
+/** Most arguments an entry can capture, counting '*' widths and precisions. */
+#define kMaxLogArgs 12
+
+/** Space in each entry for copies of its string arguments. */
+#define kLogStringSpace 256
+
+typedef enum
+{
+    ArgInt,
+    ArgLong,
+    ArgLongLong,
+    ArgIntMax,
+    ArgSize,
+    ArgPtrDiff,
+    ArgDouble,
+    ArgPointer,
+    ArgString,
+} ArgType;
+
+/** One log entry, with its arguments captured but not yet formatted.
+ * The level, file, function and format strings are the literals supplied by
+ * the logging macros, so only their addresses are kept. String arguments
+ * are copied into strings, since they may be gone by the time the entry is
+ * written.
+ */
+typedef struct
+{
+    /** 2 * ticket + 1 while being written, 2 * ticket + 2 once complete. */
+    _Atomic uint64_t sequence;
+    const char* level;
+    const char* file;
+    const char* function;
+    const char* fmt;
+    int line;
+    /** If true, strings holds the whole formatted message and fmt is unused. */
+    bool isPreformatted;
+    int argCount;
+    uint64_t args[kMaxLogArgs];
+    char strings[kLogStringSpace];
+} LogRecord;
+
+static LogRecord g_ring[kLogRingSize];
+/** Tickets handed out to writers of the ring. */
+static _Atomic uint64_t g_ringHead;
+/** The oldest ticket not yet written out. */
+static _Atomic uint64_t g_ringTail;
+/** Entries overwritten before they could be written out. */
+static _Atomic uint64_t g_droppedCount;
+
+static atomic_bool g_isDeferring;
+static atomic_bool g_shouldStopWriter;
+static pthread_t g_writerThread;
+/** Held while changing the writer thread, and by the writer while writing. */
+static pthread_mutex_t g_writerMutex = PTHREAD_MUTEX_INITIALIZER;
+/** Set when the writer has been woken and hasn't started writing yet, so
+ * that a burst of entries costs one wake-up.
+ */
+static atomic_bool g_isWakeupPending;
+static bool g_isWakeupCreated;
+
+// The writer sleeps on a semaphore, which entries signal from any context.
+// Both kinds of semaphore can be signalled from a signal handler.
+#if VicrabCrashCRASH_HOST_APPLE
+#include <mach/mach.h>
+#include <mach/semaphore.h>
+
+static semaphore_t g_writerWakeup;
+
+static bool createWakeup(void)
+{
+    return semaphore_create(mach_task_self(), &g_writerWakeup, SYNC_POLICY_FIFO, 0) == KERN_SUCCESS;
+}
+
+static void signalWakeup(void)
+{
+    semaphore_signal(g_writerWakeup);
+}
+
+static void waitForWakeup(void)
+{
+    // An interrupted wait just means an extra pass over the ring.
+    semaphore_wait(g_writerWakeup);
+}
+#else
+#include <semaphore.h>
+
+static sem_t g_writerWakeup;
+
+static bool createWakeup(void)
+{
+    return sem_init(&g_writerWakeup, 0, 0) == 0;
+}
+
+static void signalWakeup(void)
+{
+    sem_post(&g_writerWakeup);
+}
+
+static void waitForWakeup(void)
+{
+    while(sem_wait(&g_writerWakeup) != 0 && errno == EINTR)
+    {
+    }
+}
+#endif
+
+static inline void wakeWriter(void)
+{
+    if(!atomic_exchange(&g_isWakeupPending, true))
+    {
+        signalWakeup();
+    }
+}
+
+/** Parse one conversion specification.
+ *
+ * @param fmt Points to the '%' that starts the conversion.
+ *
+ * @param argTypes Receives the types of the arguments the conversion consumes.
+ *                 Must have room for 3.
+ *
+ * @param argCount Receives the number of arguments the conversion consumes.
+ *
+ * @return The character after the conversion, or NULL if it can't be deferred.
+ */
+static const char* parseConversion(const char* fmt, ArgType* argTypes, int* argCount)
+{
+    const char* ptr = fmt + 1;
+    *argCount = 0;
+    if(*ptr == '%')
+    {
+        return ptr + 1;
+    }
+    while(*ptr == '-' || *ptr == '+' || *ptr == ' ' || *ptr == '#' || *ptr == '0' || *ptr == '\'')
+    {
+        ptr++;
+    }
+    if(*ptr == '*')
+    {
+        argTypes[(*argCount)++] = ArgInt;
+        ptr++;
+    }
+    while(*ptr >= '0' && *ptr <= '9')
+    {
+        ptr++;
+    }
+    if(*ptr == '.')
+    {
+        ptr++;
+        if(*ptr == '*')
+        {
+            argTypes[(*argCount)++] = ArgInt;
+            ptr++;
+        }
+        while(*ptr >= '0' && *ptr <= '9')
+        {
+            ptr++;
+        }
+    }
+
+    ArgType integerType = ArgInt;
+    switch(*ptr)
+    {
+        case 'h':
+            ptr += ptr[1] == 'h' ? 2 : 1;
+            break;
+        case 'l':
+            integerType = ptr[1] == 'l' ? ArgLongLong : ArgLong;
+            ptr += ptr[1] == 'l' ? 2 : 1;
+            break;
+        case 'q':
+            integerType = ArgLongLong;
+            ptr++;
+            break;
+        case 'j':
+            integerType = ArgIntMax;
+            ptr++;
+            break;
+        case 'z':
+            integerType = ArgSize;
+            ptr++;
+            break;
+        case 't':
+            integerType = ArgPtrDiff;
+            ptr++;
+            break;
+        case 'L':
+            return NULL;
+        default:
+            break;
+    }
+
+    switch(*ptr)
+    {
+        case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+            argTypes[(*argCount)++] = integerType;
+            break;
+        case 'c':
+            argTypes[(*argCount)++] = ArgInt;
+            break;
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+            argTypes[(*argCount)++] = ArgDouble;
+            break;
+        case 'p':
+            argTypes[(*argCount)++] = ArgPointer;
+            break;
+        case 's':
+            if(integerType != ArgInt)
+            {
+                return NULL;
+            }
+            argTypes[(*argCount)++] = ArgString;
+            break;
+        default:
+            return NULL;
+    }
+    return ptr + 1;
+}
+
+/** Copy an entry's arguments into its record.
+ *
+ * @return false if the format string has something that can't be deferred.
+ */
+static bool captureArgs(LogRecord* const record, const char* const fmt, va_list args)
+{
+    int stringsUsed = 0;
+    record->argCount = 0;
+    const char* ptr = fmt;
+    while(*ptr != '\0')
+    {
+        if(*ptr != '%')
+        {
+            ptr++;
+            continue;
+        }
+        ArgType argTypes[3];
+        int argCount;
+        ptr = parseConversion(ptr, argTypes, &argCount);
+        unlikely_if(ptr == NULL || record->argCount + argCount > kMaxLogArgs)
+        {
+            return false;
+        }
+        for(int i = 0; i < argCount; i++)
+        {
+            uint64_t* const arg = &record->args[record->argCount++];
+            switch(argTypes[i])
+            {
+                case ArgInt:
+                    *arg = (uint64_t)va_arg(args, int);
+                    break;
+                case ArgLong:
+                    *arg = (uint64_t)va_arg(args, long);
+                    break;
+                case ArgLongLong:
+                    *arg = (uint64_t)va_arg(args, long long);
+                    break;
+                case ArgIntMax:
+                    *arg = (uint64_t)va_arg(args, intmax_t);
+                    break;
+                case ArgSize:
+                    *arg = (uint64_t)va_arg(args, size_t);
+                    break;
+                case ArgPtrDiff:
+                    *arg = (uint64_t)va_arg(args, ptrdiff_t);
+                    break;
+                case ArgDouble:
+                {
+                    double value = va_arg(args, double);
+                    memcpy(arg, &value, sizeof(*arg));
+                    break;
+                }
+                case ArgPointer:
+                    *arg = (uint64_t)(uintptr_t)va_arg(args, void*);
+                    break;
+                case ArgString:
+                {
+                    const char* string = va_arg(args, const char*);
+                    if(string == NULL)
+                    {
+                        string = "(null)";
+                    }
+                    unlikely_if(stringsUsed >= kLogStringSpace)
+                    {
+                        return false;
+                    }
+                    *arg = (uint64_t)stringsUsed;
+                    char* dst = record->strings + stringsUsed;
+                    char* const dstEnd = record->strings + kLogStringSpace - 1;
+                    while(*string != '\0' && dst < dstEnd)
+                    {
+                        *dst++ = *string++;
+                    }
+                    *dst++ = '\0';
+                    stringsUsed = (int)(dst - record->strings);
+                    break;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static bool deferEntry(const char* const level,
+                       const char* const file,
+                       const int line,
+                       const char* const function,
+                       const char* const fmt,
+                       va_list args)
+{
+    unlikely_if(!atomic_load_explicit(&g_isDeferring, memory_order_relaxed))
+    {
+        return false;
+    }
+
+    // Only take a ticket whose slot the writer from the previous lap has
+    // finished with. If it hasn't (it was interrupted, or the ring wrapped
+    // all the way around while it was writing), write the entry directly
+    // rather than share the slot with it.
+    uint64_t ticket = atomic_load_explicit(&g_ringHead, memory_order_relaxed);
+    LogRecord* record;
+    for(;;)
+    {
+        record = &g_ring[ticket & (kLogRingSize - 1)];
+        const uint64_t previous = ticket < kLogRingSize ? 0 : (ticket - kLogRingSize) * 2 + 2;
+        unlikely_if(atomic_load_explicit(&record->sequence, memory_order_acquire) != previous)
+        {
+            const uint64_t head = atomic_load_explicit(&g_ringHead, memory_order_relaxed);
+            if(head == ticket)
+            {
+                return false;
+            }
+            ticket = head;
+            continue;
+        }
+        if(atomic_compare_exchange_weak_explicit(&g_ringHead, &ticket, ticket + 1,
+                                                 memory_order_relaxed, memory_order_relaxed))
+        {
+            break;
+        }
+    }
+    atomic_store_explicit(&record->sequence, ticket * 2 + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    record->level = level;
+    record->file = file;
+    record->function = function;
+    record->line = line;
+    record->fmt = fmt;
+    record->isPreformatted = false;
+    unlikely_if(fmt == NULL)
+    {
+        record->isPreformatted = true;
+        strcpy(record->strings, "(null)");
+    }
+    else
+    {
+        va_list argsCopy;
+        va_copy(argsCopy, args);
+        unlikely_if(!captureArgs(record, fmt, argsCopy))
+        {
+            record->isPreformatted = true;
+            vsnprintf(record->strings, sizeof(record->strings), fmt, args);
+        }
+        va_end(argsCopy);
+    }
+
+    atomic_store_explicit(&record->sequence, ticket * 2 + 2, memory_order_release);
+    wakeWriter();
+    return true;
+}
+
+/** Format one value with a single-conversion format string. */
+static int formatArg(char* const dst,
+                     const int size,
+                     const char* const spec,
+                     const int* const stars,
+                     const int starCount,
+                     const ArgType type,
+                     const uint64_t arg,
+                     const char* const strings)
+{
+#define FORMAT_WITH(VALUE) \
+    (starCount == 0 ? snprintf(dst, (size_t)size, spec, VALUE) : \
+     starCount == 1 ? snprintf(dst, (size_t)size, spec, stars[0], VALUE) : \
+                      snprintf(dst, (size_t)size, spec, stars[0], stars[1], VALUE))
+
+    switch(type)
+    {
+        case ArgInt:
+            return FORMAT_WITH((int)arg);
+        case ArgLong:
+            return FORMAT_WITH((long)arg);
+        case ArgLongLong:
+            return FORMAT_WITH((long long)arg);
+        case ArgIntMax:
+            return FORMAT_WITH((intmax_t)arg);
+        case ArgSize:
+            return FORMAT_WITH((size_t)arg);
+        case ArgPtrDiff:
+            return FORMAT_WITH((ptrdiff_t)arg);
+        case ArgDouble:
+        {
+            double value;
+            memcpy(&value, &arg, sizeof(value));
+            return FORMAT_WITH(value);
+        }
+        case ArgPointer:
+            return FORMAT_WITH((void*)(uintptr_t)arg);
+        case ArgString:
+            return FORMAT_WITH(arg < kLogStringSpace ? strings + arg : "");
+    }
+    return 0;
+#undef FORMAT_WITH
+}
+
+/** Format a record the same way the immediate path would have.
+ *
+ * @return The length of the formatted line.
+ */
+static int formatRecord(LogRecord* const record, char* const buffer, const int bufferSize)
+{
+    record->strings[kLogStringSpace - 1] = '\0';
+    int length = 0;
+#define APPENDED(RESULT) \
+    do \
+    { \
+        int appended = (RESULT); \
+        if(appended > 0) \
+        { \
+            length += appended; \
+        } \
+        if(length >= bufferSize - 1) \
+        { \
+            length = bufferSize - 1; \
+        } \
+    } while(0)
+
+    if(record->level != NULL)
+    {
+        APPENDED(snprintf(buffer, (size_t)bufferSize, "%s: %s (%u): %s: ",
+                          record->level, lastPathEntry(record->file), record->line, record->function));
+    }
+
+    if(record->isPreformatted)
+    {
+        APPENDED(snprintf(buffer + length, (size_t)(bufferSize - length), "%s", record->strings));
+    }
+    else
+    {
+        int argIndex = 0;
+        const char* ptr = record->fmt;
+        while(*ptr != '\0' && length < bufferSize - 1)
+        {
+            if(*ptr != '%')
+            {
+                buffer[length++] = *ptr++;
+                continue;
+            }
+            ArgType argTypes[3];
+            int argCount;
+            const char* const specEnd = parseConversion(ptr, argTypes, &argCount);
+            unlikely_if(specEnd == NULL)
+            {
+                break;
+            }
+            char spec[32];
+            const int specLength = (int)(specEnd - ptr);
+            unlikely_if(specLength >= (int)sizeof(spec) || argIndex + argCount > record->argCount)
+            {
+                break;
+            }
+            memcpy(spec, ptr, (size_t)specLength);
+            spec[specLength] = '\0';
+            ptr = specEnd;
+            if(argCount == 0)
+            {
+                buffer[length++] = '%';
+                continue;
+            }
+            int stars[2] = {0, 0};
+            for(int i = 0; i < argCount - 1; i++)
+            {
+                stars[i] = (int)record->args[argIndex++];
+            }
+            APPENDED(formatArg(buffer + length, bufferSize - length, spec, stars, argCount - 1,
+                               argTypes[argCount - 1], record->args[argIndex++], record->strings));
+        }
+    }
+#undef APPENDED
+
+    buffer[length++] = '\n';
+    buffer[length] = '\0';
+    return length;
+}
+
+/** Write out everything in the ring.
+ *
+ * @param skipIncomplete If true, don't wait for entries that are still being
+ *                       written. Their writer may never finish (it may be the
+ *                       thread that crashed).
+ */
+static void drainRing(bool skipIncomplete)
+{
+    char batch[VicrabCrashLOGGER_CBufferSize * 4];
+    int batchLength = 0;
+    LogRecord record;
+    for(;;)
+    {
+        uint64_t tail = atomic_load_explicit(&g_ringTail, memory_order_acquire);
+        const uint64_t head = atomic_load_explicit(&g_ringHead, memory_order_acquire);
+        if(tail >= head)
+        {
+            break;
+        }
+        if(head - tail > kLogRingSize)
+        {
+            const uint64_t oldest = head - kLogRingSize;
+            if(atomic_compare_exchange_strong(&g_ringTail, &tail, oldest))
+            {
+                atomic_fetch_add(&g_droppedCount, oldest - tail);
+            }
+            continue;
+        }
+
+        LogRecord* const slot = &g_ring[tail & (kLogRingSize - 1)];
+        const uint64_t expected = tail * 2 + 2;
+        const uint64_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        bool isComplete = sequence == expected;
+        if(sequence < expected && !skipIncomplete)
+        {
+            break;
+        }
+        if(isComplete)
+        {
+            memcpy(&record, slot, sizeof(record));
+            atomic_thread_fence(memory_order_acquire);
+            isComplete = atomic_load_explicit(&slot->sequence, memory_order_relaxed) == expected;
+        }
+        if(!atomic_compare_exchange_strong(&g_ringTail, &tail, tail + 1))
+        {
+            // Someone else wrote this one out.
+            continue;
+        }
+        if(!isComplete)
+        {
+            atomic_fetch_add(&g_droppedCount, 1);
+            continue;
+        }
+
+        if(batchLength > (int)sizeof(batch) - VicrabCrashLOGGER_CBufferSize)
+        {
+            writeToLog(batch);
+            batchLength = 0;
+        }
+        batchLength += formatRecord(&record, batch + batchLength, VicrabCrashLOGGER_CBufferSize);
+    }
+
+    const uint64_t droppedCount = atomic_exchange(&g_droppedCount, 0);
+    if(droppedCount > 0 && batchLength < (int)sizeof(batch) - VicrabCrashLOGGER_CBufferSize)
+    {
+        batchLength += snprintf(batch + batchLength, VicrabCrashLOGGER_CBufferSize,
+                                "VicrabCrashLogger: %llu entries dropped\n", (unsigned long long)droppedCount);
+    }
+    if(batchLength > 0)
+    {
+        writeToLog(batch);
+    }
+}
+
+static void* runWriter(__unused void* userData)
+{
+    while(!atomic_load(&g_shouldStopWriter))
+    {
+        waitForWakeup();
+        // Entries completed from here on wake us again, even if this pass
+        // stops at one that is still being written.
+        atomic_exchange(&g_isWakeupPending, false);
+
+        pthread_mutex_lock(&g_writerMutex);
+        drainRing(false);
+        pthread_mutex_unlock(&g_writerMutex);
+    }
+    return NULL;
+}
+
+/** A forked child has no writer thread, so it goes back to writing directly.
+ * Its copy of the semaphore may not work either, so make a new one if needed.
+ */
+static void onForkChild(void)
+{
+    atomic_store(&g_isDeferring, false);
+    g_isWakeupCreated = false;
+}
+
+bool vicrabcrashlog_setDeferredWriting(bool shouldDefer)
+{
+    bool success = true;
+    pthread_mutex_lock(&g_writerMutex);
+    if(shouldDefer != atomic_load(&g_isDeferring))
+    {
+        if(shouldDefer)
+        {
+            static bool isForkHandlerInstalled = false;
+            if(!isForkHandlerInstalled)
+            {
+                pthread_atfork(NULL, NULL, onForkChild);
+                isForkHandlerInstalled = true;
+            }
+            if(!g_isWakeupCreated)
+            {
+                g_isWakeupCreated = createWakeup();
+            }
+            atomic_store(&g_shouldStopWriter, false);
+            atomic_store(&g_isWakeupPending, false);
+            success = g_isWakeupCreated && pthread_create(&g_writerThread, NULL, &runWriter, NULL) == 0;
+            atomic_store(&g_isDeferring, success);
+        }
+        else
+        {
+            atomic_store(&g_isDeferring, false);
+            atomic_store(&g_shouldStopWriter, true);
+            signalWakeup();
+            pthread_mutex_unlock(&g_writerMutex);
+            pthread_join(g_writerThread, NULL);
+            pthread_mutex_lock(&g_writerMutex);
+            drainRing(true);
+        }
+    }
+    pthread_mutex_unlock(&g_writerMutex);
+    return success;
+}
+
+void vicrabcrashlog_flush(void)
+{
+    drainRing(true);
+}
+
 bool vicrabcrashlog_setLogFilename(const char* filename, bool overwrite)
 {
     static int fd = -1;
@@ -170,10 +842,19 @@ bool vicrabcrashlog_setLogFilename(const char* filename, bool overwrite)
         }
     }
 
+    // Don't swap the descriptor out from under the background writer.
+    pthread_mutex_lock(&g_writerMutex);
     setLogFD(fd);
+    pthread_mutex_unlock(&g_writerMutex);
     return true;
 }
 
+int vicrabcrashlog_getLogFileDescriptor(void)
+{
+    return g_fd;
+}
+
+
 #else // if VicrabCrashLogger_CBufferSize <= 0
 
 static FILE* g_file = NULL;
@@ -245,6 +926,32 @@ bool vicrabcrashlog_setLogFilename(const char* filename, bool overwrite)
     return true;
 }
 
+int vicrabcrashlog_getLogFileDescriptor(void)
+{
+    return g_file != NULL ? fileno(g_file) : -1;
+}
+
+static bool deferEntry(__unused const char* level,
+                       __unused const char* file,
+                       __unused int line,
+                       __unused const char* function,
+                       __unused const char* fmt,
+                       __unused va_list args)
+{
+    return false;
+}
+
+bool vicrabcrashlog_setDeferredWriting(__unused bool shouldDefer)
+{
+    // Only the async-safe logger can defer.
+    return false;
+}
+
+void vicrabcrashlog_flush(void)
+{
+    flushLog();
+}
+
 #endif
 
 bool vicrabcrashlog_clearLogFile()
@@ -261,6 +968,11 @@ void i_vicrabcrashlog_logCBasic(const char* const fmt, ...)
 {
     va_list args;
     va_start(args,fmt);
+    likely_if(deferEntry(NULL, NULL, 0, NULL, fmt, args))
+    {
+        va_end(args);
+        return;
+    }
     writeFmtArgsToLog(fmt, args);
     va_end(args);
     writeToLog("\n");
@@ -273,9 +985,14 @@ void i_vicrabcrashlog_logC(const char* const level,
                   const char* const function,
                   const char* const fmt, ...)
 {
-    writeFmtToLog("%s: %s (%u): %s: ", level, lastPathEntry(file), line, function);
     va_list args;
     va_start(args,fmt);
+    likely_if(deferEntry(level, file, line, function, fmt, args))
+    {
+        va_end(args);
+        return;
+    }
+    writeFmtToLog("%s: %s (%u): %s: ", level, lastPathEntry(file), line, function);
     writeFmtArgsToLog(fmt, args);
     va_end(args);
     writeToLog("\n");
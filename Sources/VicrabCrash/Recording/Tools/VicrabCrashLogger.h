@@ -261,6 +261,36 @@ bool vicrabcrashlog_setLogFilename(const char* filename, bool overwrite);
 /** Clear the log file. */
 bool vicrabcrashlog_clearLogFile(void);
 
+/** Get the descriptor of the log file, so that a forked child that closes
+ * what it inherited can keep logging to it.
+ *
+ * @return The descriptor, or -1 if there is no log file.
+ */
+int vicrabcrashlog_getLogFileDescriptor(void);
+
+/** Queue entries from the C logger in memory and have a background thread
+ * format and write them, rather than writing each entry as it is logged.
+ * Logging then costs a few stores, even from a signal handler, plus a wake-up
+ * of the background thread if it is idle. It sleeps until there is something
+ * to write.
+ *
+ * Entries from the Objective-C logger are always written immediately, so they
+ * may appear ahead of C entries logged just before them.
+ *
+ * Only available if VicrabCrashLogger_CBufferSize > 0.
+ *
+ * @param shouldDefer If true, defer writing. If false, stop the background
+ *                    thread and write out anything still queued.
+ *
+ * @return true if the requested mode is in effect.
+ */
+bool vicrabcrashlog_setDeferredWriting(bool shouldDefer);
+
+/** Write out all queued entries now. Async-safe (if VicrabCrashLogger_CBufferSize > 0).
+ * Entries that another thread is in the middle of logging are skipped.
+ */
+void vicrabcrashlog_flush(void);
+
 /** Tests if the logger would print at the specified level.
  *
  * @param LEVEL The level to test for. One of:
@@ -23,10 +23,13 @@
 //
 
 #include "VicrabCrashMach.h"
+#include "VicrabCrashSystemCapabilities.h"
 
-#include <mach/mach.h>
 #include <stdlib.h>
 
+#if VicrabCrashCRASH_HOST_APPLE
+#include <mach/mach.h>
+
 #define RETURN_NAME_FOR_ENUM(A) case A: return #A
 
 const char* vicrabcrashmach_exceptionName(const int64_t exceptionType)
@@ -172,3 +175,28 @@ int vicrabcrashmach_signalForMachException(const int exception,
     }
     return 0;
 }
+
+#else
+
+const char* vicrabcrashmach_exceptionName(__attribute__((unused)) const int64_t exceptionType)
+{
+    return NULL;
+}
+
+const char* vicrabcrashmach_kernelReturnCodeName(__attribute__((unused)) const int64_t returnCode)
+{
+    return NULL;
+}
+
+int vicrabcrashmach_machExceptionForSignal(__attribute__((unused)) const int sigNum)
+{
+    return 0;
+}
+
+int vicrabcrashmach_signalForMachException(__attribute__((unused)) const int exception,
+                                  __attribute__((unused)) const int64_t code)
+{
+    return 0;
+}
+
+#endif // VicrabCrashCRASH_HOST_APPLE
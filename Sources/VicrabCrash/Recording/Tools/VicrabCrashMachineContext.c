@@ -24,18 +24,31 @@
 // THE SOFTWARE.
 //
 
+#include "VicrabCrashSystemCapabilities.h"
+#if VicrabCrashCRASH_HOST_APPLE
 #include "VicrabCrashMachineContext_Apple.h"
+#include "VicrabCrashCPU_Apple.h"
+#elif VicrabCrashCRASH_HOST_LINUX
+#include "VicrabCrashMachineContext_Linux.h"
+#endif
 #include "VicrabCrashMachineContext.h"
-#include "VicrabCrashSystemCapabilities.h"
 #include "VicrabCrashCPU.h"
-#include "VicrabCrashCPU_Apple.h"
 #include "VicrabCrashStackCursor_MachineContext.h"
 
+#if VicrabCrashCRASH_HOST_APPLE
 #include <mach/mach.h>
+#elif VicrabCrashCRASH_HOST_LINUX
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 //#define VicrabCrashLogger_LocalLevel TRACE
 #include "VicrabCrashLogger.h"
 
+#if VicrabCrashCRASH_HOST_APPLE
 #ifdef __arm64__
     #define UC_MCONTEXT uc_mcontext64
     typedef ucontext64_t SignalUserContext;
@@ -43,6 +56,20 @@
     #define UC_MCONTEXT uc_mcontext
     typedef ucontext_t SignalUserContext;
 #endif
+#elif VicrabCrashCRASH_HOST_LINUX
+/** Layout of the records returned by getdents64. glibc doesn't export it. */
+struct linux_dirent64
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+/** The Linux context stores threads as VicrabCrashThread (see VicrabCrashMachineContext_Linux.h). */
+typedef VicrabCrashThread thread_t;
+#endif
 
 static VicrabCrashThread g_reservedThreads[10];
 static int g_reservedThreadsMaxIndex = sizeof(g_reservedThreads) / sizeof(g_reservedThreads[0]) - 1;
@@ -60,6 +87,7 @@ static inline bool isStackOverflow(const VicrabCrashMachineContext* const contex
     return stackCursor.state.hasGivenUp;
 }
 
+#if VicrabCrashCRASH_HOST_APPLE
 static inline bool getThreadList(VicrabCrashMachineContext* context)
 {
     const task_t thisTask = mach_task_self();
@@ -95,6 +123,49 @@ static inline bool getThreadList(VicrabCrashMachineContext* context)
 
     return true;
 }
+#elif VicrabCrashCRASH_HOST_LINUX
+/** Read the thread ids from /proc/self/task.
+ * Uses the raw getdents64 syscall since opendir() allocates.
+ */
+static inline bool getThreadList(VicrabCrashMachineContext* context)
+{
+    VicrabCrashLOG_DEBUG("Getting thread list");
+    int fd = open("/proc/self/task", O_RDONLY | O_DIRECTORY);
+    if(fd < 0)
+    {
+        VicrabCrashLOG_ERROR("Could not open /proc/self/task");
+        return false;
+    }
+
+    int maxThreadCount = sizeof(context->allThreads) / sizeof(context->allThreads[0]);
+    int threadCount = 0;
+    char buffer[4096];
+    long bytesRead;
+    while((bytesRead = syscall(SYS_getdents64, fd, buffer, sizeof(buffer))) > 0)
+    {
+        for(long offset = 0; offset < bytesRead;)
+        {
+            struct linux_dirent64* entry = (struct linux_dirent64*)(buffer + offset);
+            offset += entry->d_reclen;
+            if(entry->d_name[0] < '0' || entry->d_name[0] > '9')
+            {
+                continue;
+            }
+            if(threadCount >= maxThreadCount)
+            {
+                VicrabCrashLOG_ERROR("Thread count is higher than maximum of %d", maxThreadCount);
+                break;
+            }
+            context->allThreads[threadCount++] = (VicrabCrashThread)strtoul(entry->d_name, NULL, 10);
+        }
+    }
+    close(fd);
+    context->threadCount = threadCount;
+    VicrabCrashLOG_TRACE("Got %d threads", context->threadCount);
+
+    return true;
+}
+#endif
 
 int vicrabcrashmc_contextSize()
 {
@@ -127,11 +198,23 @@ bool vicrabcrashmc_getContextForThread(VicrabCrashThread thread, VicrabCrashMach
     return true;
 }
 
+bool vicrabcrashmc_getContextForSuspendedThread(VicrabCrashThread thread, VicrabCrashMachineContext* destinationContext)
+{
+    memset(destinationContext, 0, sizeof(*destinationContext));
+    destinationContext->thisThread = (thread_t)thread;
+    return vicrabcrashcpu_getStackState(destinationContext);
+}
+
 bool vicrabcrashmc_getContextForSignal(void* signalUserContext, VicrabCrashMachineContext* destinationContext)
 {
     VicrabCrashLOG_DEBUG("Get context from signal user context and put into %p.", destinationContext);
+#if VicrabCrashCRASH_HOST_APPLE
     _STRUCT_MCONTEXT* sourceContext = ((SignalUserContext*)signalUserContext)->UC_MCONTEXT;
     memcpy(&destinationContext->machineContext, sourceContext, sizeof(destinationContext->machineContext));
+#elif VicrabCrashCRASH_HOST_LINUX
+    const mcontext_t* sourceContext = &((ucontext_t*)signalUserContext)->uc_mcontext;
+    memcpy(&destinationContext->machineContext, sourceContext, sizeof(destinationContext->machineContext));
+#endif
     destinationContext->thisThread = (thread_t)vicrabcrashthread_self();
     destinationContext->isCrashedContext = true;
     destinationContext->isSignalContext = true;
@@ -166,6 +249,9 @@ static inline bool isThreadInList(thread_t thread, VicrabCrashThread* list, int
 }
 #endif
 
+/** The thread that suspended all others, or 0 while they are running. */
+static volatile VicrabCrashThread g_suspendingThread = 0;
+
 void vicrabcrashmc_suspendEnvironment()
 {
 #if VicrabCrashCRASH_HAS_THREADS_API
@@ -201,6 +287,7 @@ void vicrabcrashmc_suspendEnvironment()
     }
     vm_deallocate(thisTask, (vm_address_t)threads, sizeof(thread_t) * numThreads);
 
+    g_suspendingThread = (VicrabCrashThread)thisThread;
     VicrabCrashLOG_DEBUG("Suspend complete.");
 #endif
 }
@@ -209,6 +296,7 @@ void vicrabcrashmc_resumeEnvironment()
 {
 #if VicrabCrashCRASH_HAS_THREADS_API
     VicrabCrashLOG_DEBUG("Resuming environment.");
+    g_suspendingThread = 0;
     kern_return_t kr;
     const task_t thisTask = mach_task_self();
     const thread_t thisThread = (thread_t)vicrabcrashthread_self();
@@ -244,6 +332,37 @@ void vicrabcrashmc_resumeEnvironment()
 #endif
 }
 
+bool vicrabcrashmc_isEnvironmentSuspended()
+{
+    return g_suspendingThread != 0 && g_suspendingThread == vicrabcrashthread_self();
+}
+
+bool vicrabcrashmc_suspendThread(__unused VicrabCrashThread thread)
+{
+#if VicrabCrashCRASH_HAS_THREADS_API
+    kern_return_t kr = thread_suspend((thread_t)thread);
+    if(kr != KERN_SUCCESS)
+    {
+        VicrabCrashLOG_ERROR("thread_suspend (%08x): %s", thread, mach_error_string(kr));
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void vicrabcrashmc_resumeThread(__unused VicrabCrashThread thread)
+{
+#if VicrabCrashCRASH_HAS_THREADS_API
+    kern_return_t kr = thread_resume((thread_t)thread);
+    if(kr != KERN_SUCCESS)
+    {
+        VicrabCrashLOG_ERROR("thread_resume (%08x): %s", thread, mach_error_string(kr));
+    }
+#endif
+}
+
 int vicrabcrashmc_getThreadCount(const VicrabCrashMachineContext* const context)
 {
     return context->threadCount;
@@ -286,7 +405,12 @@ static inline bool isSignalContext(const VicrabCrashMachineContext* const contex
 
 bool vicrabcrashmc_canHaveCPUState(const VicrabCrashMachineContext* const context)
 {
+#if VicrabCrashCRASH_HOST_LINUX
+    // Other threads' registers can't be read without ptrace.
+    return isSignalContext(context);
+#else
     return !isContextForCurrentThread(context) || isSignalContext(context);
+#endif
 }
 
 bool vicrabcrashmc_hasValidExceptionRegisters(const VicrabCrashMachineContext* const context)
@@ -43,6 +43,28 @@ void vicrabcrashmc_suspendEnvironment(void);
  */
 void vicrabcrashmc_resumeEnvironment(void);
 
+/** Check whether the calling thread has suspended all other (non-reserved)
+ * threads with vicrabcrashmc_suspendEnvironment(), so that the memory map
+ * can't change under it.
+ *
+ * @return false if it hasn't, or if this host can't suspend threads.
+ */
+bool vicrabcrashmc_isEnvironmentSuspended(void);
+
+/** Suspend a single thread.
+ *
+ * @param thread The thread to suspend. Must not be the calling thread.
+ *
+ * @return true if the thread was suspended.
+ */
+bool vicrabcrashmc_suspendThread(VicrabCrashThread thread);
+
+/** Resume a thread suspended with vicrabcrashmc_suspendThread().
+ *
+ * @param thread The thread to resume.
+ */
+void vicrabcrashmc_resumeThread(VicrabCrashThread thread);
+
 /** Create a new machine context on the stack.
  * This macro creates a storage object on the stack, as well as a pointer of type
  * struct VicrabCrashMachineContext* in the current scope, which points to the storage object.
@@ -73,6 +95,17 @@ int vicrabcrashmc_contextSize(void);
  */
 bool vicrabcrashmc_getContextForThread(VicrabCrashThread thread, struct VicrabCrashMachineContext* destinationContext, bool isCrashedContext);
 
+/** Fill in the stack registers of a thread that the caller has suspended.
+ * Nothing else in the context is filled. This neither logs nor allocates, so
+ * it cannot deadlock on a lock held by the suspended thread.
+ *
+ * @param thread The suspended thread.
+ * @param destinationContext The context to fill.
+ *
+ * @return true if successful.
+ */
+bool vicrabcrashmc_getContextForSuspendedThread(VicrabCrashThread thread, struct VicrabCrashMachineContext* destinationContext);
+
 /** Fill in a machine context from a signal handler.
  * A signal handler context is always assumed to be a crashed context.
  *
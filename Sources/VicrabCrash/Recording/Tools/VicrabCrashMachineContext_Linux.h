@@ -0,0 +1,57 @@
+//
+//  VicrabCrashMachineContext_Linux.h
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#ifndef HDR_VicrabCrashMachineContext_Linux_h
+#define HDR_VicrabCrashMachineContext_Linux_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "VicrabCrashThread.h"
+#include <stdbool.h>
+#include <ucontext.h>
+
+/** On Linux a thread is identified by its kernel thread id, and the only
+ * register state available is the one the kernel hands to a signal handler.
+ */
+typedef struct VicrabCrashMachineContext
+{
+    VicrabCrashThread thisThread;
+    VicrabCrashThread allThreads[100];
+    int threadCount;
+    bool isCrashedContext;
+    bool isCurrentThread;
+    bool isStackOverflow;
+    bool isSignalContext;
+    mcontext_t machineContext;
+} VicrabCrashMachineContext;
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HDR_VicrabCrashMachineContext_Linux_h
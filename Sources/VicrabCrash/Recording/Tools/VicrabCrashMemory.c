@@ -29,10 +29,24 @@
 
 //#define VicrabCrashLogger_LocalLevel TRACE
 #include "VicrabCrashLogger.h"
+#include "VicrabCrashMachineContext.h"
 
+#include "VicrabCrashSystemCapabilities.h"
+#include "VicrabCrashThread.h"
+
+#include <stdint.h>
+#include <unistd.h>
+
+#if VicrabCrashCRASH_HOST_APPLE
 #include <mach/mach.h>
+#elif VicrabCrashCRASH_HOST_LINUX
+#include <fcntl.h>
+#include <string.h>
+#include <sys/uio.h>
+#endif
 
 
+#if VicrabCrashCRASH_HOST_APPLE
 static inline int copySafely(const void* restrict const src, void* restrict const dst, const int byteCount)
 {
     vm_size_t bytesCopied = 0;
@@ -47,6 +61,328 @@ static inline int copySafely(const void* restrict const src, void* restrict cons
     }
     return (int)bytesCopied;
 }
+#elif VicrabCrashCRASH_HOST_LINUX
+/** The process whose memory is read, or 0 for our own. */
+static int g_targetProcess = 0;
+
+/** process_vm_readv() against our own pid fails with EFAULT on unmapped
+ * memory rather than faulting, the same contract as vm_read_overwrite().
+ */
+static inline int copySafely(const void* restrict const src, void* restrict const dst, const int byteCount)
+{
+    struct iovec local = { .iov_base = dst, .iov_len = (size_t)byteCount };
+    struct iovec remote = { .iov_base = (void*)src, .iov_len = (size_t)byteCount };
+    pid_t pid = g_targetProcess != 0 ? g_targetProcess : getpid();
+    ssize_t bytesCopied = process_vm_readv(pid, &local, 1, &remote, 1, 0);
+    if(bytesCopied != byteCount)
+    {
+        return 0;
+    }
+    return (int)bytesCopied;
+}
+#endif
+
+
+// ============================================================================
+#pragma mark - Readability Cache -
+// ============================================================================
+
+/** Number of memory regions remembered by the cache. */
+#define kRegionCacheSize 64
+
+typedef struct
+{
+    uintptr_t start;
+    uintptr_t end;
+    bool isReadable;
+} Region;
+
+/** The cache is only consulted by the thread that turned it on. */
+static bool g_isCacheEnabled = false;
+static VicrabCrashThread g_cacheThread;
+
+static Region g_regionCache[kRegionCacheSize];
+static int g_regionCacheCount;
+static int g_regionCacheNext;
+static uintptr_t g_pageSize;
+
+#if VicrabCrashCRASH_HOST_LINUX
+/** Enough for most processes. Bigger maps turn the cache off. */
+#define kMaxMappedRegions 4096
+
+/** The parsed maps file, in ascending order. */
+static Region g_mappedRegions[kMaxMappedRegions];
+static int g_mappedRegionCount;
+static bool g_isMapLoaded;
+#endif
+
+static inline bool isUsingCache(void)
+{
+    return g_isCacheEnabled && g_cacheThread == vicrabcrashthread_self();
+}
+
+static void invalidateCache(void)
+{
+    g_regionCacheCount = 0;
+    g_regionCacheNext = 0;
+#if VicrabCrashCRASH_HOST_LINUX
+    g_isMapLoaded = false;
+#endif
+}
+
+#if VicrabCrashCRASH_HOST_APPLE
+/** Ask the kernel for the region containing an address.
+ */
+static bool queryRegion(const uintptr_t address, Region* const region)
+{
+    vm_address_t regionAddress = (vm_address_t)address;
+    vm_size_t regionSize = 0;
+    vm_region_basic_info_data_64_t info;
+    mach_msg_type_number_t count = VM_REGION_BASIC_INFO_COUNT_64;
+    mach_port_t objectName = MACH_PORT_NULL;
+    kern_return_t kr = vm_region_64(mach_task_self(),
+                                    &regionAddress,
+                                    &regionSize,
+                                    VM_REGION_BASIC_INFO_64,
+                                    (vm_region_info_t)&info,
+                                    &count,
+                                    &objectName);
+    if(kr == KERN_INVALID_ADDRESS)
+    {
+        // Nothing is mapped at or after this address.
+        *region = (Region){ .start = address & ~(g_pageSize - 1), .end = UINTPTR_MAX, .isReadable = false };
+        return true;
+    }
+    if(kr != KERN_SUCCESS)
+    {
+        return false;
+    }
+    if(regionAddress > address)
+    {
+        // vm_region() skipped ahead to the next mapped region.
+        *region = (Region){ .start = address & ~(g_pageSize - 1), .end = regionAddress, .isReadable = false };
+        return true;
+    }
+    *region = (Region)
+    {
+        .start = regionAddress,
+        .end = regionAddress + regionSize,
+        .isReadable = (info.protection & VM_PROT_READ) != 0,
+    };
+    return true;
+}
+#elif VicrabCrashCRASH_HOST_LINUX
+static const char* parseHex(const char* ptr, const char* end, uintptr_t* value)
+{
+    uintptr_t result = 0;
+    for(; ptr < end; ptr++)
+    {
+        char ch = *ptr;
+        if(ch >= '0' && ch <= '9') result = (result << 4) | (uintptr_t)(ch - '0');
+        else if(ch >= 'a' && ch <= 'f') result = (result << 4) | (uintptr_t)(ch - 'a' + 10);
+        else break;
+    }
+    *value = result;
+    return ptr;
+}
+
+/** Parse one "start-end perms ..." line of a maps file.
+ */
+static void addMappedRegion(const char* line, const char* end)
+{
+    Region region;
+    const char* ptr = parseHex(line, end, &region.start);
+    if(ptr >= end || *ptr != '-')
+    {
+        return;
+    }
+    ptr = parseHex(ptr + 1, end, &region.end);
+    if(ptr + 1 >= end || *ptr != ' ')
+    {
+        return;
+    }
+    region.isReadable = ptr[1] == 'r';
+    if(g_mappedRegionCount < kMaxMappedRegions)
+    {
+        g_mappedRegions[g_mappedRegionCount] = region;
+    }
+    g_mappedRegionCount++;
+}
+
+/** Read the maps file of the target process. Only uses async-safe calls.
+ */
+static bool loadMappedRegions(void)
+{
+    // Build "/proc/<pid>/maps" by hand, since snprintf isn't async-safe.
+    char path[64] = "/proc/";
+    char* pos = path + strlen(path);
+    char digits[16];
+    int digitCount = 0;
+    unsigned pid = (unsigned)(g_targetProcess != 0 ? g_targetProcess : (int)getpid());
+    do
+    {
+        digits[digitCount++] = (char)('0' + pid % 10);
+        pid /= 10;
+    } while(pid != 0);
+    while(digitCount > 0)
+    {
+        *pos++ = digits[--digitCount];
+    }
+    strcpy(pos, "/maps");
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+    {
+        return false;
+    }
+
+    char buffer[4096];
+    int used = 0;
+    g_mappedRegionCount = 0;
+    for(;;)
+    {
+        ssize_t bytesRead = read(fd, buffer + used, sizeof(buffer) - (size_t)used);
+        if(bytesRead <= 0)
+        {
+            break;
+        }
+        used += (int)bytesRead;
+        int lineStart = 0;
+        for(int i = 0; i < used; i++)
+        {
+            if(buffer[i] == '\n')
+            {
+                addMappedRegion(buffer + lineStart, buffer + i);
+                lineStart = i + 1;
+            }
+        }
+        used -= lineStart;
+        memmove(buffer, buffer + lineStart, (size_t)used);
+        if(used == (int)sizeof(buffer))
+        {
+            // A line longer than the buffer; its start was already parsed.
+            used = 0;
+        }
+    }
+    close(fd);
+    g_isMapLoaded = g_mappedRegionCount <= kMaxMappedRegions;
+    return g_isMapLoaded;
+}
+
+/** Look up the region containing an address in the parsed maps file.
+ */
+static bool queryRegion(const uintptr_t address, Region* const region)
+{
+    if(!g_isMapLoaded && !loadMappedRegions())
+    {
+        return false;
+    }
+    int low = 0;
+    int high = g_mappedRegionCount;
+    while(low < high)
+    {
+        int mid = (low + high) / 2;
+        if(g_mappedRegions[mid].end <= address)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    if(low < g_mappedRegionCount && g_mappedRegions[low].start <= address)
+    {
+        *region = g_mappedRegions[low];
+        return true;
+    }
+    // In the gap before the next region.
+    *region = (Region)
+    {
+        .start = low > 0 ? g_mappedRegions[low - 1].end : 0,
+        .end = low < g_mappedRegionCount ? g_mappedRegions[low].start : UINTPTR_MAX,
+        .isReadable = false,
+    };
+    return true;
+}
+#endif
+
+/** Find the region containing an address, asking the kernel only on a miss.
+ */
+static bool lookupRegion(const uintptr_t address, Region* const region)
+{
+    for(int i = 0; i < g_regionCacheCount; i++)
+    {
+        const Region* cached = &g_regionCache[i];
+        if(address >= cached->start && address < cached->end)
+        {
+            *region = *cached;
+            return true;
+        }
+    }
+    if(!queryRegion(address, region))
+    {
+        return false;
+    }
+    g_regionCache[g_regionCacheNext] = *region;
+    g_regionCacheNext = (g_regionCacheNext + 1) % kRegionCacheSize;
+    if(g_regionCacheCount < kRegionCacheSize)
+    {
+        g_regionCacheCount++;
+    }
+    return true;
+}
+
+/** Get how many bytes are readable according to the cached memory map.
+ *
+ * @return The readable byte count, or -1 if the map couldn't be read.
+ */
+static int cachedReadableBytes(const void* const memory, const int byteCount)
+{
+    const uintptr_t start = (uintptr_t)memory;
+    uintptr_t end = start + (uintptr_t)byteCount;
+    if(end < start)
+    {
+        end = UINTPTR_MAX;
+    }
+    uintptr_t current = start;
+    while(current < end)
+    {
+        Region region;
+        if(!lookupRegion(current, &region))
+        {
+            return -1;
+        }
+        if(!region.isReadable || region.end <= current)
+        {
+            break;
+        }
+        current = region.end;
+    }
+    return (int)((current < end ? current : end) - start);
+}
+
+/** Copy memory, skipping the kernel when the cache knows it's unreadable.
+ */
+static int copyWithCache(const void* restrict const src, void* restrict const dst, const int byteCount)
+{
+    if(isUsingCache())
+    {
+        int readable = cachedReadableBytes(src, byteCount);
+        if(readable >= 0 && readable < byteCount)
+        {
+            return 0;
+        }
+        int bytesCopied = copySafely(src, dst, byteCount);
+        if(bytesCopied != byteCount && readable == byteCount)
+        {
+            // The map changed under us.
+            invalidateCache();
+        }
+        return bytesCopied;
+    }
+    return copySafely(src, dst, byteCount);
+}
+
 
 static inline int copyMaxPossible(const void* restrict const src, void* restrict const dst, const int byteCount)
 {
@@ -57,6 +393,19 @@ static inline int copyMaxPossible(const void* restrict const src, void* restrict
 
     int bytesCopied = 0;
 
+    if(isUsingCache())
+    {
+        int readable = cachedReadableBytes(src, byteCount);
+        if(readable == 0)
+        {
+            return 0;
+        }
+        if(readable > 0 && copyWithCache(src, dst, readable) == readable)
+        {
+            return readable;
+        }
+    }
+
     // Short-circuit if no memory is readable
     if(copySafely(src, dst, 1) != 1)
     {
@@ -98,6 +447,15 @@ static inline int copyMaxPossible(const void* restrict const src, void* restrict
 static char g_memoryTestBuffer[10240];
 static inline bool isMemoryReadable(const void* const memory, const int byteCount)
 {
+    if(isUsingCache())
+    {
+        int readable = cachedReadableBytes(memory, byteCount);
+        if(readable >= 0)
+        {
+            return readable == byteCount;
+        }
+    }
+
     const int testBufferSize = sizeof(g_memoryTestBuffer);
     int bytesRemaining = byteCount;
 
@@ -115,6 +473,15 @@ static inline bool isMemoryReadable(const void* const memory, const int byteCoun
 
 int vicrabcrashmem_maxReadableBytes(const void* const memory, const int tryByteCount)
 {
+    if(isUsingCache())
+    {
+        int readable = cachedReadableBytes(memory, tryByteCount);
+        if(readable >= 0)
+        {
+            return readable;
+        }
+    }
+
     const int testBufferSize = sizeof(g_memoryTestBuffer);
     const uint8_t* currentPosition = memory;
     int bytesRemaining = tryByteCount;
@@ -144,5 +511,35 @@ int vicrabcrashmem_copyMaxPossible(const void* restrict const src, void* restric
 
 bool vicrabcrashmem_copySafely(const void* restrict const src, void* restrict const dst, const int byteCount)
 {
-    return copySafely(src, dst, byteCount);
+    return copyWithCache(src, dst, byteCount);
+}
+
+void vicrabcrashmem_beginCachedProbing(void)
+{
+    if(!vicrabcrashmc_isEnvironmentSuspended())
+    {
+        // Other threads may be unmapping memory. Keep asking the kernel.
+        return;
+    }
+    g_pageSize = (uintptr_t)getpagesize();
+    invalidateCache();
+    g_cacheThread = vicrabcrashthread_self();
+    g_isCacheEnabled = true;
+}
+
+void vicrabcrashmem_endCachedProbing(void)
+{
+    g_isCacheEnabled = false;
+    invalidateCache();
+}
+
+bool vicrabcrashmem_setTargetProcess(int pid)
+{
+#if VicrabCrashCRASH_HOST_LINUX
+    g_targetProcess = pid;
+    invalidateCache();
+    return true;
+#else
+    return pid == 0;
+#endif
 }
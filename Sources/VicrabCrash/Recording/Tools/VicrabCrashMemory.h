@@ -84,6 +84,32 @@ bool vicrabcrashmem_copySafely(const void* restrict const src, void* restrict co
  */
 int vicrabcrashmem_copyMaxPossible(const void* restrict const src, void* restrict const dst, int byteCount);
 
+/** Answer readability probes on this thread from a cache of the memory map,
+ * so that most of them need no system call. The map is read a region at a
+ * time (Apple) or once (Linux), and is re-read when a copy from a region it
+ * lists as readable fails.
+ *
+ * The cache assumes the memory map doesn't change until
+ * vicrabcrashmem_endCachedProbing() is called, so it is only turned on if this
+ * thread has suspended all others (see vicrabcrashmc_isEnvironmentSuspended()).
+ * Otherwise this does nothing and every probe goes to the kernel.
+ */
+void vicrabcrashmem_beginCachedProbing(void);
+
+/** Go back to asking the kernel for every probe.
+ */
+void vicrabcrashmem_endCachedProbing(void);
+
+/** Read another process's memory instead of our own. All other functions in
+ * this module then take addresses in that process.
+ * Only supported on Linux, where the target must allow us to ptrace it.
+ *
+ * @param pid The process to read from, or 0 for this process.
+ *
+ * @return true if the target was set.
+ */
+bool vicrabcrashmem_setTargetProcess(int pid);
+
 #ifdef __cplusplus
 }
 #endif
@@ -26,10 +26,16 @@
 
 
 #include "VicrabCrashObjC.h"
+#include "VicrabCrashSystemCapabilities.h"
+
+#if VicrabCrashCRASH_HAS_OBJC
+
 #include "VicrabCrashObjCApple.h"
 
+#include "VicrabCrashMachineContext.h"
 #include "VicrabCrashMemory.h"
 #include "VicrabCrashString.h"
+#include "VicrabCrashThread.h"
 
 #include "VicrabCrashLogger.h"
 
@@ -48,6 +54,7 @@ typedef unsigned int NSUInteger;
 #include <CoreGraphics/CGBase.h>
 #include <inttypes.h>
 #include <objc/runtime.h>
+#include <stdatomic.h>
 
 
 #define kMaxNameLength 128
@@ -150,6 +157,89 @@ static int g_taggedClassDataCount = sizeof(g_taggedClassData) / sizeof(*g_tagged
 static const char* g_blockBaseClassName = "NSBlock";
 
 
+//======================================================================
+#pragma mark - Class Cache -
+//======================================================================
+
+/** Must be a power of 2. */
+#define kClassCacheSize 256
+
+/** How many slots to probe before giving up on caching a class. */
+#define kClassCacheMaxProbes 8
+
+typedef struct
+{
+    /** A class that passed isValidClass(). Written once per report. */
+    _Atomic(const void*) class;
+    /** The class's entry in g_classData, or NULL if not looked up yet. */
+    _Atomic(ClassData*) data;
+} ClassCacheEntry;
+
+static ClassCacheEntry g_classCache[kClassCacheSize];
+
+/** The cache is only consulted by the thread that turned it on. */
+static bool g_isClassCacheEnabled = false;
+static VicrabCrashThread g_classCacheThread;
+
+static inline bool isUsingClassCache(void)
+{
+    return g_isClassCacheEnabled && g_classCacheThread == vicrabcrashthread_self();
+}
+
+static inline uint32_t classCacheHome(const void* class)
+{
+    uintptr_t bits = (uintptr_t)class >> 3;
+    return (uint32_t)(bits ^ (bits >> 9)) & (kClassCacheSize - 1);
+}
+
+/** Find the cache entry for a class.
+ *
+ * @param class The class to look up.
+ *
+ * @param shouldInsert If true, claim an empty slot when the class isn't cached.
+ *
+ * @return The entry, or NULL if not cached (or there was no room, or the
+ *         cache is off).
+ */
+static ClassCacheEntry* getClassCacheEntry(const void* class, bool shouldInsert)
+{
+    if(!isUsingClassCache())
+    {
+        return NULL;
+    }
+    uint32_t index = classCacheHome(class);
+    for(int i = 0; i < kClassCacheMaxProbes; i++)
+    {
+        ClassCacheEntry* entry = &g_classCache[index];
+        const void* cached = atomic_load_explicit(&entry->class, memory_order_acquire);
+        likely_if(cached == class)
+        {
+            return entry;
+        }
+        if(cached == NULL)
+        {
+            if(!shouldInsert)
+            {
+                return NULL;
+            }
+            if(atomic_compare_exchange_strong_explicit(&entry->class, &cached, class,
+                                                       memory_order_acq_rel, memory_order_acquire) ||
+               cached == class)
+            {
+                return entry;
+            }
+        }
+        index = (index + 1) & (kClassCacheSize - 1);
+    }
+    return NULL;
+}
+
+static inline bool isCachedValidClass(const void* class)
+{
+    return class != NULL && getClassCacheEntry(class, false) != NULL;
+}
+
+
 //======================================================================
 #pragma mark - Utility -
 //======================================================================
@@ -378,7 +468,7 @@ static CFAbsoluteTime extractTaggedNSDate(const void* const object)
  *
  * @return The associated class data.
  */
-static ClassData* getClassData(const void* class)
+static ClassData* getClassDataUncached(const void* class)
 {
     const char* className = getClassName(class);
     for(ClassData* data = g_classData;; data++)
@@ -399,6 +489,22 @@ static ClassData* getClassData(const void* class)
     }
 }
 
+static ClassData* getClassData(const void* class)
+{
+    ClassCacheEntry* entry = getClassCacheEntry(class, false);
+    if(entry == NULL)
+    {
+        return getClassDataUncached(class);
+    }
+    ClassData* data = atomic_load_explicit(&entry->data, memory_order_acquire);
+    unlikely_if(data == NULL)
+    {
+        data = getClassDataUncached(class);
+        atomic_store_explicit(&entry->data, data, memory_order_release);
+    }
+    return data;
+}
+
 static inline const ClassData* getClassDataFromObject(const void* object)
 {
     if(isTaggedPointer(object))
@@ -607,6 +713,10 @@ static bool hasValidIsaPointer(const void* object) {
 static inline bool isValidClass(const void* classPtr)
 {
     const class_t* class = classPtr;
+    likely_if(isCachedValidClass(class))
+    {
+        return true;
+    }
     if(!vicrabcrashmem_isMemoryReadable(class, sizeof(*class)))
     {
         return false;
@@ -623,6 +733,7 @@ static inline bool isValidClass(const void* classPtr)
     {
         return false;
     }
+    getClassCacheEntry(class, true);
     return true;
 }
 
@@ -654,6 +765,33 @@ static inline bool isValidObject(const void* objectPtr)
 #pragma mark - Basic Objective-C Queries -
 //======================================================================
 
+static void clearClassCache(void)
+{
+    for(int i = 0; i < kClassCacheSize; i++)
+    {
+        atomic_store_explicit(&g_classCache[i].data, NULL, memory_order_relaxed);
+        atomic_store_explicit(&g_classCache[i].class, NULL, memory_order_release);
+    }
+}
+
+void vicrabcrashobjc_beginClassCache(void)
+{
+    if(!vicrabcrashmc_isEnvironmentSuspended())
+    {
+        // Other threads may be loading or freeing classes. Check every time.
+        return;
+    }
+    clearClassCache();
+    g_classCacheThread = vicrabcrashthread_self();
+    g_isClassCacheEnabled = true;
+}
+
+void vicrabcrashobjc_endClassCache(void)
+{
+    g_isClassCacheEnabled = false;
+    clearClassCache();
+}
+
 const void* vicrabcrashobjc_isaPointer(const void* const objectOrClassPtr)
 {
     return getIsaPointer(objectOrClassPtr);
@@ -725,7 +863,7 @@ bool vicrabcrashobjc_isKindOfClass(const void* const classPtr, const char* const
             return true;
         }
         class = class->superclass;
-        if(!containsValidROData(class))
+        if(!isCachedValidClass(class) && !containsValidROData(class))
         {
             return false;
         }
@@ -746,7 +884,7 @@ const void* vicrabcrashobjc_baseClass(const void* const classPtr)
         }
         subClass = superClass;
         superClass = superClass->superclass;
-        if(!containsValidROData(superClass))
+        if(!isCachedValidClass(superClass) && !containsValidROData(superClass))
         {
             return NULL;
         }
@@ -1738,3 +1876,174 @@ VicrabCrashObjCClassType vicrabcrashobjc_objectClassType(const void* object)
 //NSSimpleCString
 //NSString
 //NSURL
+
+#else
+
+// No Objective-C runtime on this platform: nothing is ever an object.
+
+#include <stddef.h>
+
+void vicrabcrashobjc_beginClassCache(void)
+{
+}
+
+void vicrabcrashobjc_endClassCache(void)
+{
+}
+
+bool vicrabcrashobjc_isTaggedPointer(__attribute__((unused)) const void* const pointer)
+{
+    return false;
+}
+
+bool vicrabcrashobjc_isValidTaggedPointer(__attribute__((unused)) const void* const pointer)
+{
+    return false;
+}
+
+VicrabCrashObjCType vicrabcrashobjc_objectType(__attribute__((unused)) const void* objectOrClassPtr)
+{
+    return VicrabCrashObjCTypeUnknown;
+}
+
+bool vicrabcrashobjc_isValidObject(__attribute__((unused)) const void* object)
+{
+    return false;
+}
+
+const void* vicrabcrashobjc_isaPointer(__attribute__((unused)) const void* objectOrClassPtr)
+{
+    return NULL;
+}
+
+const void* vicrabcrashobjc_superClass(__attribute__((unused)) const void* classPtr)
+{
+    return NULL;
+}
+
+const void* vicrabcrashobjc_baseClass(__attribute__((unused)) const void* const classPtr)
+{
+    return NULL;
+}
+
+bool vicrabcrashobjc_isMetaClass(__attribute__((unused)) const void* classPtr)
+{
+    return false;
+}
+
+bool vicrabcrashobjc_isRootClass(__attribute__((unused)) const void* classPtr)
+{
+    return false;
+}
+
+const char* vicrabcrashobjc_className(__attribute__((unused)) const void* classPtr)
+{
+    return NULL;
+}
+
+const char* vicrabcrashobjc_objectClassName(__attribute__((unused)) const void* objectPtr)
+{
+    return NULL;
+}
+
+bool vicrabcrashobjc_isClassNamed(__attribute__((unused)) const void* const classPtr, __attribute__((unused)) const char* const className)
+{
+    return false;
+}
+
+bool vicrabcrashobjc_isKindOfClass(__attribute__((unused)) const void* classPtr, __attribute__((unused)) const char* className)
+{
+    return false;
+}
+
+int vicrabcrashobjc_ivarCount(__attribute__((unused)) const void* classPtr)
+{
+    return 0;
+}
+
+int vicrabcrashobjc_ivarList(__attribute__((unused)) const void* classPtr, __attribute__((unused)) VicrabCrashObjCIvar* dstIvars, __attribute__((unused)) int ivarsCount)
+{
+    return 0;
+}
+
+bool vicrabcrashobjc_ivarNamed(__attribute__((unused)) const void* const classPtr, __attribute__((unused)) const char* name, __attribute__((unused)) VicrabCrashObjCIvar* dst)
+{
+    return false;
+}
+
+bool vicrabcrashobjc_ivarValue(__attribute__((unused)) const void* objectPtr, __attribute__((unused)) int ivarIndex, __attribute__((unused)) void* dst)
+{
+    return false;
+}
+
+uintptr_t vicrabcrashobjc_taggedPointerPayload(__attribute__((unused)) const void* taggedObjectPtr)
+{
+    return 0;
+}
+
+int vicrabcrashobjc_getDescription(__attribute__((unused)) void* object, __attribute__((unused)) char* buffer, __attribute__((unused)) int bufferLength)
+{
+    return 0;
+}
+
+VicrabCrashObjCClassType vicrabcrashobjc_objectClassType(__attribute__((unused)) const void* object)
+{
+    return VicrabCrashObjCClassTypeUnknown;
+}
+
+bool vicrabcrashobjc_numberIsFloat(__attribute__((unused)) const void* object)
+{
+    return false;
+}
+
+double vicrabcrashobjc_numberAsFloat(__attribute__((unused)) const void* object)
+{
+    return 0;
+}
+
+int64_t vicrabcrashobjc_numberAsInteger(__attribute__((unused)) const void* object)
+{
+    return 0;
+}
+
+double vicrabcrashobjc_dateContents(__attribute__((unused)) const void* datePtr)
+{
+    return 0;
+}
+
+int vicrabcrashobjc_copyURLContents(__attribute__((unused)) const void* nsurl, __attribute__((unused)) char* dst, __attribute__((unused)) int maxLength)
+{
+    return 0;
+}
+
+int vicrabcrashobjc_stringLength(__attribute__((unused)) const void* const stringPtr)
+{
+    return 0;
+}
+
+int vicrabcrashobjc_copyStringContents(__attribute__((unused)) const void* string, __attribute__((unused)) char* dst, __attribute__((unused)) int maxLength)
+{
+    return 0;
+}
+
+int vicrabcrashobjc_arrayCount(__attribute__((unused)) const void* arrayPtr)
+{
+    return 0;
+}
+
+int vicrabcrashobjc_arrayContents(__attribute__((unused)) const void* arrayPtr, __attribute__((unused)) uintptr_t* contents, __attribute__((unused)) int count)
+{
+    return 0;
+}
+
+bool vicrabcrashobjc_dictionaryFirstEntry(__attribute__((unused)) const void* dict, __attribute__((unused)) uintptr_t* key, __attribute__((unused)) uintptr_t* value)
+{
+    return false;
+}
+
+int vicrabcrashobjc_dictionaryCount(__attribute__((unused)) const void* dict)
+{
+    return 0;
+}
+
+#endif // VicrabCrashCRASH_HAS_OBJC
@@ -83,6 +83,18 @@ bool vicrabcrashobjc_isTaggedPointer(const void* const pointer);
  */
 bool vicrabcrashobjc_isValidTaggedPointer(const void* const pointer);
 
+/** Remember, on this thread, which classes have been validated, so that
+ * objects sharing a class don't re-check its class data.
+ * This assumes the Objective-C runtime is frozen until
+ * vicrabcrashobjc_endClassCache() is called, so it is only turned on if this
+ * thread has suspended all others (see vicrabcrashmc_isEnvironmentSuspended()).
+ */
+void vicrabcrashobjc_beginClassCache(void);
+
+/** Forget which classes have been validated and check every class again.
+ */
+void vicrabcrashobjc_endClassCache(void);
+
 /** Query a pointer to see what kind of object it points to.
  * If the pointer points to a class, this method will verify that its basic
  * class data and ivars are valid,
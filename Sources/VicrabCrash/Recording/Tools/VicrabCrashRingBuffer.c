@@ -0,0 +1,81 @@
+//
+//  VicrabCrashRingBuffer.c
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#include "VicrabCrashRingBuffer.h"
+
+
+// Each record is stored as its length followed by its words, wrapping around
+// the end of the storage.
+
+void vicrabcrashring_init(VicrabCrashRingBuffer* ring, uintptr_t* storage, uint32_t capacity)
+{
+    ring->words = storage;
+    ring->capacity = capacity;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->droppedCount, 0);
+}
+
+bool vicrabcrashring_write(VicrabCrashRingBuffer* ring, const uintptr_t* words, int count)
+{
+    const uint32_t mask = ring->capacity - 1;
+    const uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    const uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if(count < 0 || (uint32_t)count + 1 > ring->capacity - (head - tail))
+    {
+        atomic_fetch_add_explicit(&ring->droppedCount, 1, memory_order_relaxed);
+        return false;
+    }
+
+    ring->words[head & mask] = (uintptr_t)count;
+    for(int i = 0; i < count; i++)
+    {
+        ring->words[(head + 1 + (uint32_t)i) & mask] = words[i];
+    }
+    atomic_store_explicit(&ring->head, head + 1 + (uint32_t)count, memory_order_release);
+    return true;
+}
+
+int vicrabcrashring_read(VicrabCrashRingBuffer* ring, uintptr_t* words, int maxCount)
+{
+    const uint32_t mask = ring->capacity - 1;
+    const uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    const uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if(head == tail)
+    {
+        return -1;
+    }
+
+    const uint32_t count = (uint32_t)ring->words[tail & mask];
+    const uint32_t copyCount = count < (uint32_t)maxCount ? count : (uint32_t)maxCount;
+    for(uint32_t i = 0; i < copyCount; i++)
+    {
+        words[i] = ring->words[(tail + 1 + i) & mask];
+    }
+    atomic_store_explicit(&ring->tail, tail + 1 + count, memory_order_release);
+    return (int)copyCount;
+}
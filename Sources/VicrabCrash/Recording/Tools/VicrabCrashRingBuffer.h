@@ -0,0 +1,102 @@
+//
+//  VicrabCrashRingBuffer.h
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+/* Lock-free, single-producer single-consumer ring of variable-length records.
+ *
+ * Writing and reading are async-safe, so the producer may be a signal handler
+ * or a thread that has other threads suspended. A record that doesn't fit is
+ * dropped rather than making the producer wait.
+ */
+
+
+#ifndef HDR_VicrabCrashRingBuffer_h
+#define HDR_VicrabCrashRingBuffer_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+
+typedef struct
+{
+    uintptr_t* words;
+    /** Capacity in words. Always a power of two. */
+    uint32_t capacity;
+    /** Total words ever written. Only advanced by the producer. */
+    _Atomic uint32_t head;
+    /** Total words ever read. Only advanced by the consumer. */
+    _Atomic uint32_t tail;
+    /** Records dropped because the ring was full. */
+    _Atomic uint32_t droppedCount;
+} VicrabCrashRingBuffer;
+
+/** Initialize a ring buffer over caller-provided storage.
+ *
+ * @param ring The ring buffer to initialize.
+ *
+ * @param storage The storage for the ring's words.
+ *
+ * @param capacity The number of words in storage. Must be a power of two.
+ */
+void vicrabcrashring_init(VicrabCrashRingBuffer* ring, uintptr_t* storage, uint32_t capacity);
+
+/** Append a record. Producer only.
+ *
+ * @param ring The ring buffer.
+ *
+ * @param words The record's words.
+ *
+ * @param count The number of words in the record.
+ *
+ * @return false if the record was dropped because the ring is full.
+ */
+bool vicrabcrashring_write(VicrabCrashRingBuffer* ring, const uintptr_t* words, int count);
+
+/** Remove the oldest record. Consumer only.
+ *
+ * @param ring The ring buffer.
+ *
+ * @param words Receives the record's words. A record longer than maxCount is
+ *              truncated.
+ *
+ * @param maxCount The number of words that fit in words.
+ *
+ * @return The number of words copied, or -1 if the ring is empty.
+ */
+int vicrabcrashring_read(VicrabCrashRingBuffer* ring, uintptr_t* words, int maxCount);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HDR_VicrabCrashRingBuffer_h
@@ -34,6 +34,7 @@ extern "C" {
 #include "VicrabCrashMachineContext.h"
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <sys/types.h>
 
 #define VicrabCrashSC_CONTEXT_SIZE 100
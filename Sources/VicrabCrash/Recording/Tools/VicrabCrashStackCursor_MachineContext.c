@@ -26,6 +26,8 @@
 #include "VicrabCrashStackCursor_MachineContext.h"
 
 #include "VicrabCrashCPU.h"
+#include "VicrabCrashDate.h"
+#include "VicrabCrashMachineContext.h"
 #include "VicrabCrashMemory.h"
 
 #include <stdlib.h>
@@ -138,3 +140,41 @@ void vicrabcrashsc_initWithMachineContext(VicrabCrashStackCursor *cursor, int ma
     context->maxStackDepth = maxStackDepth;
     context->instructionAddress = cursor->stackEntry.address;
 }
+
+int vicrabcrashsc_copySuspendedBacktrace(VicrabCrashThread thread, uintptr_t* backtrace, int maxLength, uint64_t maxNanoseconds)
+{
+    if(!vicrabcrashmc_suspendThread(thread))
+    {
+        return 0;
+    }
+
+    // Nothing in here may allocate or log: the thread could be holding the lock.
+    const uint64_t deadline = vicrabcrashdate_monotonicNanoseconds() + maxNanoseconds;
+    VicrabCrashMC_NEW_CONTEXT(machineContext);
+    if(!vicrabcrashmc_getContextForSuspendedThread(thread, machineContext))
+    {
+        vicrabcrashmc_resumeThread(thread);
+        return 0;
+    }
+    VicrabCrashStackCursor stackCursor;
+    vicrabcrashsc_initWithMachineContext(&stackCursor, maxLength, machineContext);
+
+    int length = 0;
+    bool isCutShort = false;
+    while(length < maxLength && stackCursor.advanceCursor(&stackCursor))
+    {
+        backtrace[length++] = stackCursor.stackEntry.address;
+        if((length & 15) == 0 && vicrabcrashdate_monotonicNanoseconds() > deadline)
+        {
+            isCutShort = true;
+            break;
+        }
+    }
+
+    vicrabcrashmc_resumeThread(thread);
+    if(isCutShort)
+    {
+        VicrabCrashLOG_DEBUG("Backtrace of thread %x cut short at %d frames", thread, length);
+    }
+    return length;
+}
@@ -43,6 +43,22 @@ extern "C" {
  */
 void vicrabcrashsc_initWithMachineContext(VicrabCrashStackCursor *cursor, int maxStackDepth, const struct VicrabCrashMachineContext* machineContext);
 
+/** Copy the backtrace of another thread, suspending only that thread and only
+ * for as long as the walk takes.
+ *
+ * @param thread The thread whose backtrace to copy.
+ *
+ * @param backtrace Receives the instruction addresses.
+ *
+ * @param maxLength The most frames to copy.
+ *
+ * @param maxNanoseconds How long the thread may stay suspended before the
+ *                       walk is cut short.
+ *
+ * @return The number of frames copied (0 if the thread could not be suspended).
+ */
+int vicrabcrashsc_copySuspendedBacktrace(VicrabCrashThread thread, uintptr_t* backtrace, int maxLength, uint64_t maxNanoseconds);
+
 
 #ifdef __cplusplus
 }
@@ -25,7 +25,9 @@
 
 #include "VicrabCrashStackCursor_SelfThread.h"
 #include "VicrabCrashStackCursor_Backtrace.h"
+#include "VicrabCrashSystemCapabilities.h"
 #include <execinfo.h>
+#include <pthread.h>
 
 //#define VicrabCrashLogger_LocalLevel TRACE
 #include "VicrabCrashLogger.h"
@@ -44,3 +46,57 @@ void vicrabcrashsc_initSelfThread(VicrabCrashStackCursor *cursor, int skipEntrie
     int backtraceLength = backtrace((void**)context->backtrace, MAX_BACKTRACE_LENGTH);
     vicrabcrashsc_initWithBacktrace(cursor, context->backtrace, backtraceLength, skipEntries + 1);
 }
+
+#if VicrabCrashCRASH_HOST_APPLE
+/** A frame as laid out by the frame pointer ABI on all supported architectures. */
+typedef struct FramePointerEntry
+{
+    const struct FramePointerEntry* previous;
+    uintptr_t returnAddress;
+} FramePointerEntry;
+#endif
+
+__attribute__((noinline))
+int vicrabcrashsc_copyFramePointerBacktrace(uintptr_t* addresses, int maxLength, int skipEntries)
+{
+#if VicrabCrashCRASH_HOST_APPLE
+    // Apple platforms always keep frame pointers, so the chain can be trusted
+    // as long as it stays within this thread's stack.
+    pthread_t thread = pthread_self();
+    const uintptr_t stackTop = (uintptr_t)pthread_get_stackaddr_np(thread);
+    const uintptr_t stackBottom = stackTop - pthread_get_stacksize_np(thread);
+    const FramePointerEntry* frame = __builtin_frame_address(0);
+    int length = 0;
+    while(length < maxLength &&
+          (uintptr_t)frame >= stackBottom &&
+          (uintptr_t)frame + sizeof(*frame) <= stackTop &&
+          ((uintptr_t)frame & (sizeof(uintptr_t) - 1)) == 0 &&
+          frame->returnAddress != 0)
+    {
+        if(skipEntries > 0)
+        {
+            skipEntries--;
+        }
+        else
+        {
+            addresses[length++] = frame->returnAddress;
+        }
+        if(frame->previous <= frame)
+        {
+            break;
+        }
+        frame = frame->previous;
+    }
+    return length;
+#else
+    // Frame pointers are commonly omitted elsewhere, so walking them isn't safe.
+    void* frames[MAX_BACKTRACE_LENGTH];
+    int frameCount = backtrace(frames, MAX_BACKTRACE_LENGTH);
+    int length = 0;
+    for(int i = skipEntries + 1; i < frameCount && length < maxLength; i++)
+    {
+        addresses[length++] = (uintptr_t)frames[i];
+    }
+    return length;
+#endif
+}
@@ -43,6 +43,21 @@ extern "C" {
  */
 void vicrabcrashsc_initSelfThread(VicrabCrashStackCursor *cursor, int skipEntries);
 
+/** Copy the current thread's return addresses by following its frame pointers.
+ *  This is much cheaper than a full backtrace and doesn't lock or allocate, but
+ *  misses frames of functions that don't set up a frame pointer.
+ *
+ * @param addresses Receives the return addresses, innermost first. The first
+ *                  one is in the function that called this one.
+ *
+ * @param maxLength The number of entries addresses has room for.
+ *
+ * @param skipEntries The number of stack entries to skip.
+ *
+ * @return The number of addresses copied.
+ */
+int vicrabcrashsc_copyFramePointerBacktrace(uintptr_t* addresses, int maxLength, int skipEntries);
+
 
 #ifdef __cplusplus
 }
@@ -59,43 +59,161 @@ static const int g_continuationByteCount[0x40] =
     3, 3, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 0, 0,
 };
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #include <arm_neon.h>
+    #define VicrabCrashSTRING_HAS_VECTOR 1
+#elif defined(__SSE2__)
+    #include <emmintrin.h>
+    #define VicrabCrashSTRING_HAS_VECTOR 1
+#else
+    #define VicrabCrashSTRING_HAS_VECTOR 0
+#endif
+
+/** Bytes examined per vector block. */
+#define kVectorSize 16
+
+/** Validate one character at *ptr using the scalar rules.
+ *
+ * @param memory The start of the string.
+ *
+ * @param pptr Points to the character to check. On return it points to the
+ *             last byte of that character.
+ *
+ * @param end The end of the searchable memory.
+ *
+ * @param minLength The minimum length to be considered a valid string.
+ *
+ * @return 1 if scanning should continue, 0 if the memory is not a valid
+ *         string, 2 if a valid terminator was found.
+ */
+static inline int validateCharacter(const unsigned char* const memory,
+                                    const unsigned char** const pptr,
+                                    const unsigned char* const end,
+                                    const int minLength)
+{
+    const unsigned char* ptr = *pptr;
+    unsigned char ch = *ptr;
+    unlikely_if(ch == 0)
+    {
+        return (ptr - memory) >= minLength ? 2 : 0;
+    }
+    unlikely_if(ch & 0x80)
+    {
+        unlikely_if((ch & 0xc0) != 0xc0)
+        {
+            return 0;
+        }
+        int continuationBytes = g_continuationByteCount[ch & 0x3f];
+        unlikely_if(continuationBytes == 0 || ptr + continuationBytes >= end)
+        {
+            return 0;
+        }
+        for(int i = 0; i < continuationBytes; i++)
+        {
+            ptr++;
+            unlikely_if((*ptr & 0xc0) != 0x80)
+            {
+                return 0;
+            }
+        }
+        *pptr = ptr;
+    }
+    else unlikely_if(ch < 0x20 && !g_printableControlChars[ch])
+    {
+        return 0;
+    }
+    return 1;
+}
+
+#if VicrabCrashSTRING_HAS_VECTOR
+/** Count how many bytes at the start of a block are printable ASCII
+ * (0x20-0x7f, tab, LF, or CR). Anything else (a terminator, a multibyte
+ * sequence or a control character) stops the count and is left to
+ * validateCharacter().
+ *
+ * @param ptr The block to examine. kVectorSize bytes must be readable.
+ *
+ * @return The length of the printable prefix (kVectorSize if all of it is).
+ */
+static inline int printableASCIIPrefixLength(const unsigned char* const ptr)
+{
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    uint8x16_t bytes = vld1q_u8(ptr);
+    uint8x16_t printable = vandq_u8(vcgeq_u8(bytes, vdupq_n_u8(0x20)),
+                                    vcltq_u8(bytes, vdupq_n_u8(0x80)));
+    printable = vorrq_u8(printable, vceqq_u8(bytes, vdupq_n_u8('\t')));
+    printable = vorrq_u8(printable, vceqq_u8(bytes, vdupq_n_u8('\n')));
+    printable = vorrq_u8(printable, vceqq_u8(bytes, vdupq_n_u8('\r')));
+    // Narrow each byte's mask to a nybble so the whole block fits in 64 bits.
+    uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(vmvnq_u8(printable)), 4);
+    uint64_t stopMask = vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+    likely_if(stopMask == 0)
+    {
+        return kVectorSize;
+    }
+    return __builtin_ctzll(stopMask) >> 2;
+#else
+    __m128i bytes = _mm_loadu_si128((const __m128i*)(const void*)ptr);
+    // Signed compare: 0x80-0xff are negative, so this selects 0x20-0x7f.
+    __m128i printable = _mm_cmpgt_epi8(bytes, _mm_set1_epi8(0x1f));
+    printable = _mm_or_si128(printable, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\t')));
+    printable = _mm_or_si128(printable, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n')));
+    printable = _mm_or_si128(printable, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\r')));
+    unsigned stopMask = ~(unsigned)_mm_movemask_epi8(printable) & 0xffff;
+    likely_if(stopMask == 0)
+    {
+        return kVectorSize;
+    }
+    return __builtin_ctz(stopMask);
+#endif
+}
+#endif
+
 bool vicrabcrashstring_isNullTerminatedUTF8String(const void* memory,
                                         int minLength,
                                         int maxLength)
 {
-    const unsigned char* ptr = memory;
+    const unsigned char* const start = memory;
+    const unsigned char* ptr = start;
     const unsigned char* const end = ptr + maxLength;
 
-    for(; ptr < end; ptr++)
+    while(ptr < end)
     {
-        unsigned char ch = *ptr;
-        unlikely_if(ch == 0)
-        {
-            return (ptr - (const unsigned char*)memory) >= minLength;
-        }
-        unlikely_if(ch & 0x80)
+#if VicrabCrashSTRING_HAS_VECTOR
+        likely_if(end - ptr >= kVectorSize)
         {
-            unlikely_if((ch & 0xc0) != 0xc0)
+            int printableLength = printableASCIIPrefixLength(ptr);
+            ptr += printableLength;
+            likely_if(printableLength == kVectorSize)
             {
-                return false;
-            }
-            int continuationBytes = g_continuationByteCount[ch & 0x3f];
-            unlikely_if(continuationBytes == 0 || ptr + continuationBytes >= end)
-            {
-                return false;
-            }
-            for(int i = 0; i < continuationBytes; i++)
-            {
-                ptr++;
-                unlikely_if((*ptr & 0xc0) != 0x80)
-                {
-                    return false;
-                }
+                continue;
             }
         }
-        else unlikely_if(ch < 0x20 && !g_printableControlChars[ch])
+#endif
+        int result = validateCharacter(start, &ptr, end, minLength);
+        unlikely_if(result != 1)
+        {
+            return result == 2;
+        }
+        ptr++;
+    }
+    return false;
+}
+
+bool vicrabcrashstring_isNullTerminatedUTF8StringScalar(const void* memory,
+                                              int minLength,
+                                              int maxLength)
+{
+    const unsigned char* const start = memory;
+    const unsigned char* ptr = start;
+    const unsigned char* const end = ptr + maxLength;
+
+    for(; ptr < end; ptr++)
+    {
+        int result = validateCharacter(start, &ptr, end, minLength);
+        unlikely_if(result != 1)
         {
-            return false;
+            return result == 2;
         }
     }
     return false;
@@ -43,9 +43,22 @@ extern "C" {
  * @param minLength The minimum length to be considered a valid string.
  *
  * @param maxLength The maximum length to be considered a valid string.
+ *                  All maxLength bytes must be readable.
  */
 bool vicrabcrashstring_isNullTerminatedUTF8String(const void* memory, int minLength, int maxLength);
 
+/** Byte-at-a-time version of vicrabcrashstring_isNullTerminatedUTF8String().
+ * The default version scans runs of printable ASCII a vector at a time;
+ * both must always agree. This one exists to check that they do.
+ *
+ * @param memory The memory location to test.
+ *
+ * @param minLength The minimum length to be considered a valid string.
+ *
+ * @param maxLength The maximum length to be considered a valid string.
+ */
+bool vicrabcrashstring_isNullTerminatedUTF8StringScalar(const void* memory, int minLength, int maxLength);
+
 /** Extract a hex value in the form "0x123456789abcdef" from a string.
  *
  * @param string The string to search.
@@ -0,0 +1,215 @@
+//
+//  VicrabCrashSymbolCache.c
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "VicrabCrashSymbolCache.h"
+#include "VicrabCrashDate.h"
+#include "VicrabCrashDynamicLinker.h"
+#include "VicrabCrashSystemCapabilities.h"
+
+//#define VicrabCrashLogger_LocalLevel TRACE
+#include "VicrabCrashLogger.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#if VicrabCrashCRASH_HOST_APPLE
+#include <mach-o/dyld.h>
+#endif
+
+
+/** How many slots to probe before evicting the home slot. */
+#define kMaxProbes 8
+
+typedef struct
+{
+    /** Per-entry sequence lock. Odd while the entry is being written. */
+    _Atomic(uint32_t) sequence;
+    uint32_t generation;
+    uintptr_t address;
+    bool found;
+    Dl_info info;
+} SymbolCacheEntry;
+
+static SymbolCacheEntry* g_entries;
+static uint32_t g_mask;
+static _Atomic(uint32_t) g_generation = 1;
+
+static _Atomic(uint64_t) g_hits;
+static _Atomic(uint64_t) g_misses;
+static _Atomic(uint64_t) g_missNanoseconds;
+
+
+static inline uint32_t slotForAddress(const uintptr_t address)
+{
+    uint64_t hash = (uint64_t)address * 0x9E3779B97F4A7C15ULL;
+    return (uint32_t)(hash >> 32) & g_mask;
+}
+
+static bool lookup(const uintptr_t address, const uint32_t generation, Dl_info* const info, bool* const found)
+{
+    uint32_t slot = slotForAddress(address);
+    for(int i = 0; i < kMaxProbes; i++, slot = (slot + 1) & g_mask)
+    {
+        SymbolCacheEntry* entry = &g_entries[slot];
+        uint32_t before = atomic_load_explicit(&entry->sequence, memory_order_acquire);
+        if(before == 0)
+        {
+            // Never written, so the address can't be further along the chain.
+            return false;
+        }
+        if(before & 1)
+        {
+            continue;
+        }
+        if(entry->address != address || entry->generation != generation)
+        {
+            continue;
+        }
+        Dl_info copy = entry->info;
+        bool copyFound = entry->found;
+        atomic_thread_fence(memory_order_acquire);
+        if(atomic_load_explicit(&entry->sequence, memory_order_relaxed) != before)
+        {
+            // Overwritten while we were reading it.
+            return false;
+        }
+        *info = copy;
+        *found = copyFound;
+        return true;
+    }
+    return false;
+}
+
+static void store(const uintptr_t address, const uint32_t generation, const Dl_info* const info, const bool found)
+{
+    const uint32_t home = slotForAddress(address);
+    uint32_t slot = home;
+    SymbolCacheEntry* target = &g_entries[home];
+    for(int i = 0; i < kMaxProbes; i++, slot = (slot + 1) & g_mask)
+    {
+        SymbolCacheEntry* entry = &g_entries[slot];
+        uint32_t sequence = atomic_load_explicit(&entry->sequence, memory_order_relaxed);
+        if(sequence == 0 || entry->generation != generation)
+        {
+            target = entry;
+            break;
+        }
+    }
+
+    uint32_t sequence = atomic_load_explicit(&target->sequence, memory_order_relaxed);
+    if((sequence & 1) ||
+       !atomic_compare_exchange_strong_explicit(&target->sequence, &sequence, sequence + 1,
+                                                memory_order_acquire, memory_order_relaxed))
+    {
+        // Someone else is writing this slot. Caching is best effort.
+        return;
+    }
+    target->address = address;
+    target->generation = generation;
+    target->found = found;
+    target->info = *info;
+    atomic_store_explicit(&target->sequence, sequence + 2, memory_order_release);
+}
+
+#if VicrabCrashCRASH_HOST_APPLE
+static void onImageRemoved(__unused const struct mach_header* header, __unused intptr_t slide)
+{
+    vicrabcrashsymcache_invalidate();
+}
+#endif
+
+void vicrabcrashsymcache_init(int capacity)
+{
+    if(g_entries != NULL || capacity <= 0)
+    {
+        return;
+    }
+
+    uint32_t size = 1;
+    while(size < (uint32_t)capacity)
+    {
+        size <<= 1;
+    }
+
+    SymbolCacheEntry* entries = calloc(size, sizeof(*entries));
+    if(entries == NULL)
+    {
+        VicrabCrashLOG_ERROR("Could not allocate symbol cache with %u entries", size);
+        return;
+    }
+    g_mask = size - 1;
+    g_entries = entries;
+    VicrabCrashLOG_DEBUG("Symbol cache initialized with %u entries", size);
+
+#if VicrabCrashCRASH_HOST_APPLE
+    // Symbol names point into image memory, so they go stale on unload.
+    _dyld_register_func_for_remove_image(onImageRemoved);
+#endif
+}
+
+bool vicrabcrashsymcache_dladdr(const uintptr_t address, Dl_info* const info)
+{
+    if(g_entries == NULL)
+    {
+        return vicrabcrashdl_dladdr(address, info);
+    }
+
+    const uint32_t generation = atomic_load_explicit(&g_generation, memory_order_acquire);
+    bool found = false;
+    if(lookup(address, generation, info, &found))
+    {
+        g_hits++;
+        return found;
+    }
+
+    const uint64_t startTime = vicrabcrashdate_monotonicNanoseconds();
+    found = vicrabcrashdl_dladdr(address, info);
+    g_missNanoseconds += vicrabcrashdate_monotonicNanoseconds() - startTime;
+    g_misses++;
+
+    store(address, generation, info, found);
+    return found;
+}
+
+void vicrabcrashsymcache_invalidate(void)
+{
+    g_generation++;
+}
+
+void vicrabcrashsymcache_getStats(VicrabCrashSymbolCacheStats* const stats)
+{
+    stats->hits = g_hits;
+    stats->misses = g_misses;
+    stats->missNanoseconds = g_missNanoseconds;
+    stats->savedNanoseconds = stats->misses == 0 ? 0 : stats->hits * (stats->missNanoseconds / stats->misses);
+    stats->capacity = g_entries == NULL ? 0 : (int)(g_mask + 1);
+}
+
+void vicrabcrashsymcache_resetStats(void)
+{
+    g_hits = 0;
+    g_misses = 0;
+    g_missNanoseconds = 0;
+}
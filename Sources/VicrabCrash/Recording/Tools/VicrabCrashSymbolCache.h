@@ -0,0 +1,107 @@
+//
+//  VicrabCrashSymbolCache.h
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+/* Fixed-size, async-safe cache mapping instruction addresses to symbols.
+ *
+ * The same return addresses (run loops, dispatch workers, thread start
+ * routines) show up in most thread backtraces. Resolving them through
+ * vicrabcrashdl_dladdr() means walking every image's load commands and symbol
+ * table, so each distinct address is only resolved once and subsequent
+ * lookups are answered from an open-addressed table.
+ */
+
+
+#ifndef HDR_VicrabCrashSymbolCache_h
+#define HDR_VicrabCrashSymbolCache_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <dlfcn.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct
+{
+    /** Number of lookups answered from the cache. */
+    uint64_t hits;
+
+    /** Number of lookups that had to go through vicrabcrashdl_dladdr(). */
+    uint64_t misses;
+
+    /** Total time spent resolving misses, in nanoseconds. */
+    uint64_t missNanoseconds;
+
+    /** Estimated time saved by cache hits (hits x average miss cost), in nanoseconds. */
+    uint64_t savedNanoseconds;
+
+    /** Number of slots in the cache (0 if not initialized). */
+    int capacity;
+} VicrabCrashSymbolCacheStats;
+
+/** Allocate the symbol cache.
+ * This must be called from a normal (non-signal) context, typically at install
+ * time. Calling it again after a successful initialization has no effect.
+ *
+ * @param capacity The number of entries to hold. Rounded up to a power of 2.
+ */
+void vicrabcrashsymcache_init(int capacity);
+
+/** Cached, async-safe version of vicrabcrashdl_dladdr().
+ * If the cache has not been initialized, this falls through to
+ * vicrabcrashdl_dladdr() directly.
+ *
+ * @param address The address to search for.
+ *
+ * @param info Gets filled out by this function.
+ *
+ * @return true if at least some information was found.
+ */
+bool vicrabcrashsymcache_dladdr(const uintptr_t address, Dl_info* const info);
+
+/** Mark every cached entry as stale (e.g. after an image was unloaded).
+ *
+ * This function is async-safe.
+ */
+void vicrabcrashsymcache_invalidate(void);
+
+/** Get the cache statistics gathered since the last reset.
+ *
+ * @param stats Gets filled out by this function.
+ */
+void vicrabcrashsymcache_getStats(VicrabCrashSymbolCacheStats* const stats);
+
+/** Reset the cache statistics (but not the cached entries).
+ */
+void vicrabcrashsymcache_resetStats(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HDR_VicrabCrashSymbolCache_h
@@ -24,7 +24,7 @@
 
 
 #include "VicrabCrashSymbolicator.h"
-#include "VicrabCrashDynamicLinker.h"
+#include "VicrabCrashSymbolCache.h"
 
 
 /** Remove any pointer tagging from an instruction address
@@ -55,7 +55,7 @@
 bool vicrabcrashsymbolicator_symbolicate(VicrabCrashStackCursor *cursor)
 {
     Dl_info symbolsBuffer;
-    if(vicrabcrashdl_dladdr(CALL_INSTRUCTION_FROM_RETURN_ADDRESS(cursor->stackEntry.address), &symbolsBuffer))
+    if(vicrabcrashsymcache_dladdr(CALL_INSTRUCTION_FROM_RETURN_ADDRESS(cursor->stackEntry.address), &symbolsBuffer))
     {
         cursor->stackEntry.imageAddress = (uintptr_t)symbolsBuffer.dli_fbase;
         cursor->stackEntry.imageName = symbolsBuffer.dli_fname;
@@ -25,6 +25,10 @@
 //
 
 
+#include "VicrabCrashSystemCapabilities.h"
+
+#if VicrabCrashCRASH_HOST_APPLE
+
 #include "VicrabCrashSysCtl.h"
 
 //#define VicrabCrashLogger_LocalLevel TRACE
@@ -282,3 +286,5 @@ bool vicrabcrashsysctl_getMacAddress(const char* const name,
 
     return true;
 }
+
+#endif // VicrabCrashCRASH_HOST_APPLE
@@ -33,12 +33,20 @@
 //#define VicrabCrashLogger_LocalLevel TRACE
 #include "VicrabCrashLogger.h"
 
+#if VicrabCrashCRASH_HOST_APPLE
 #include <dispatch/dispatch.h>
 #include <mach/mach.h>
 #include <pthread.h>
 #include <sys/sysctl.h>
+#elif VicrabCrashCRASH_HOST_LINUX
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 
+#if VicrabCrashCRASH_HOST_APPLE
 VicrabCrashThread vicrabcrashthread_self()
 {
     thread_t thread_self = mach_thread_self();
@@ -46,6 +54,11 @@ VicrabCrashThread vicrabcrashthread_self()
     return (VicrabCrashThread)thread_self;
 }
 
+VicrabCrashThread vicrabcrashthread_main()
+{
+    return (VicrabCrashThread)pthread_mach_thread_np(pthread_main_thread_np());
+}
+
 bool vicrabcrashthread_getThreadName(const VicrabCrashThread thread, char* const buffer, int bufLength)
 {
     // WARNING: This implementation is no longer async-safe!
@@ -53,4 +66,46 @@ bool vicrabcrashthread_getThreadName(const VicrabCrashThread thread, char* const
     const pthread_t pthread = pthread_from_mach_thread_np((thread_t)thread);
     return pthread_getname_np(pthread, buffer, (unsigned)bufLength) == 0;
 }
+#elif VicrabCrashCRASH_HOST_LINUX
+VicrabCrashThread vicrabcrashthread_self()
+{
+    return (VicrabCrashThread)syscall(SYS_gettid);
+}
+
+VicrabCrashThread vicrabcrashthread_main()
+{
+    // The main thread's ID is the process ID.
+    return (VicrabCrashThread)getpid();
+}
+
+bool vicrabcrashthread_getThreadName(const VicrabCrashThread thread, char* const buffer, int bufLength)
+{
+    if(bufLength <= 0)
+    {
+        return false;
+    }
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/task/%lu/comm", (unsigned long)thread);
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+    {
+        return false;
+    }
+    ssize_t bytesRead = read(fd, buffer, (size_t)bufLength - 1);
+    close(fd);
+    if(bytesRead <= 0)
+    {
+        return false;
+    }
+
+    // comm is newline terminated.
+    if(buffer[bytesRead - 1] == '\n')
+    {
+        bytesRead--;
+    }
+    buffer[bytesRead] = '\0';
+    return true;
+}
+#endif
 
@@ -34,6 +34,7 @@ extern "C" {
 
 #include <sys/types.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 
 typedef uintptr_t VicrabCrashThread;
@@ -60,6 +61,12 @@ bool vicrabcrashthread_getThreadName(const VicrabCrashThread thread, char* const
  */
 VicrabCrashThread vicrabcrashthread_self(void);
 
+/* Get the ID of the process's main thread.
+ *
+ * @return The main thread ID.
+ */
+VicrabCrashThread vicrabcrashthread_main(void);
+
 
 #ifdef __cplusplus
 }
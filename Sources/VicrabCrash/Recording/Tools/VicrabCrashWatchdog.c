@@ -0,0 +1,239 @@
+//
+//  VicrabCrashWatchdog.c
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#include "VicrabCrashWatchdog.h"
+
+#include "VicrabCrashDate.h"
+
+//#define VicrabCrashLogger_LocalLevel TRACE
+#include "VicrabCrashLogger.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+/** Samples taken at each sample interval before it doubles. */
+#define kSamplesPerInterval 8
+
+
+struct VicrabCrashWatchdog
+{
+    VicrabCrashWatchdogConfig config;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t condition;
+    /** The creator and any unanswered ping. */
+    int references;
+    bool isStopped;
+    bool isAnswered;
+    uint64_t pingTime;
+    uint64_t answerTime;
+};
+
+
+// ============================================================================
+#pragma mark - Utility -
+// ============================================================================
+
+static void release(VicrabCrashWatchdog* watchdog)
+{
+    pthread_mutex_lock(&watchdog->mutex);
+    bool isLastReference = --watchdog->references == 0;
+    pthread_mutex_unlock(&watchdog->mutex);
+    if(isLastReference)
+    {
+        pthread_cond_destroy(&watchdog->condition);
+        pthread_mutex_destroy(&watchdog->mutex);
+        free(watchdog);
+    }
+}
+
+/** Wait until the deadline passes, the watchdog is stopped, or (if
+ * untilAnswered) the ping is answered. Must be called with the mutex held.
+ */
+static void waitUntil(VicrabCrashWatchdog* watchdog, uint64_t deadline, bool untilAnswered)
+{
+    for(;;)
+    {
+        if(watchdog->isStopped || (untilAnswered && watchdog->isAnswered))
+        {
+            return;
+        }
+        uint64_t now = vicrabcrashdate_monotonicNanoseconds();
+        if(now >= deadline)
+        {
+            return;
+        }
+        // Timed waits take wall clock time, so convert the remaining interval.
+        uint64_t remaining = deadline - now;
+        struct timespec wakeTime;
+        clock_gettime(CLOCK_REALTIME, &wakeTime);
+        wakeTime.tv_sec += (time_t)(remaining / 1000000000ULL);
+        wakeTime.tv_nsec += (long)(remaining % 1000000000ULL);
+        if(wakeTime.tv_nsec >= 1000000000L)
+        {
+            wakeTime.tv_sec++;
+            wakeTime.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&watchdog->condition, &watchdog->mutex, &wakeTime);
+    }
+}
+
+/** Sample a hang until the ping is answered. Must be called with the mutex held.
+ */
+static void sampleHang(VicrabCrashWatchdog* watchdog)
+{
+    const VicrabCrashWatchdogConfig* config = &watchdog->config;
+    uint64_t sampleInterval = config->sampleIntervalNanoseconds;
+    int samplesAtInterval = 0;
+
+    if(config->onHangStarted != NULL)
+    {
+        pthread_mutex_unlock(&watchdog->mutex);
+        config->onHangStarted(config->userData);
+        pthread_mutex_lock(&watchdog->mutex);
+    }
+
+    while(!watchdog->isAnswered && !watchdog->isStopped)
+    {
+        uint64_t sampleTime = vicrabcrashdate_monotonicNanoseconds();
+        if(config->onSample != NULL)
+        {
+            pthread_mutex_unlock(&watchdog->mutex);
+            config->onSample(sampleTime - watchdog->pingTime, config->userData);
+            pthread_mutex_lock(&watchdog->mutex);
+        }
+        if(++samplesAtInterval == kSamplesPerInterval && sampleInterval < config->maxSampleIntervalNanoseconds)
+        {
+            samplesAtInterval = 0;
+            sampleInterval *= 2;
+            if(sampleInterval > config->maxSampleIntervalNanoseconds)
+            {
+                sampleInterval = config->maxSampleIntervalNanoseconds;
+            }
+        }
+        waitUntil(watchdog, sampleTime + sampleInterval, true);
+    }
+
+    if(watchdog->isAnswered && config->onHangEnded != NULL)
+    {
+        uint64_t duration = watchdog->answerTime - watchdog->pingTime;
+        pthread_mutex_unlock(&watchdog->mutex);
+        config->onHangEnded(duration, config->userData);
+        pthread_mutex_lock(&watchdog->mutex);
+    }
+}
+
+static void* runWatchdog(void* userData)
+{
+    VicrabCrashWatchdog* watchdog = userData;
+    const VicrabCrashWatchdogConfig* config = &watchdog->config;
+
+    pthread_mutex_lock(&watchdog->mutex);
+    while(!watchdog->isStopped)
+    {
+        watchdog->isAnswered = false;
+        watchdog->pingTime = vicrabcrashdate_monotonicNanoseconds();
+        watchdog->references++;
+        pthread_mutex_unlock(&watchdog->mutex);
+        config->postPing(watchdog, config->userData);
+        pthread_mutex_lock(&watchdog->mutex);
+
+        waitUntil(watchdog, watchdog->pingTime + config->hangThresholdNanoseconds, true);
+        if(!watchdog->isAnswered && !watchdog->isStopped)
+        {
+            VicrabCrashLOG_DEBUG("Ping unanswered for %llu ms", (unsigned long long)(config->hangThresholdNanoseconds / 1000000));
+            sampleHang(watchdog);
+        }
+        waitUntil(watchdog, vicrabcrashdate_monotonicNanoseconds() + config->pingIntervalNanoseconds, false);
+    }
+    pthread_mutex_unlock(&watchdog->mutex);
+    return NULL;
+}
+
+
+// ============================================================================
+#pragma mark - API -
+// ============================================================================
+
+VicrabCrashWatchdog* vicrabcrashwd_create(const VicrabCrashWatchdogConfig* config)
+{
+    VicrabCrashWatchdog* watchdog = calloc(1, sizeof(*watchdog));
+    if(watchdog == NULL)
+    {
+        return NULL;
+    }
+    watchdog->config = *config;
+    if(watchdog->config.maxSampleIntervalNanoseconds < watchdog->config.sampleIntervalNanoseconds)
+    {
+        watchdog->config.maxSampleIntervalNanoseconds = watchdog->config.sampleIntervalNanoseconds;
+    }
+    pthread_mutex_init(&watchdog->mutex, NULL);
+    pthread_cond_init(&watchdog->condition, NULL);
+    watchdog->references = 1;
+
+    int error = pthread_create(&watchdog->thread, NULL, &runWatchdog, watchdog);
+    if(error != 0)
+    {
+        VicrabCrashLOG_ERROR("pthread_create: %s", strerror(error));
+        pthread_cond_destroy(&watchdog->condition);
+        pthread_mutex_destroy(&watchdog->mutex);
+        free(watchdog);
+        return NULL;
+    }
+    return watchdog;
+}
+
+void vicrabcrashwd_destroy(VicrabCrashWatchdog* watchdog)
+{
+    if(watchdog == NULL)
+    {
+        return;
+    }
+    pthread_mutex_lock(&watchdog->mutex);
+    watchdog->isStopped = true;
+    pthread_cond_signal(&watchdog->condition);
+    pthread_mutex_unlock(&watchdog->mutex);
+    pthread_join(watchdog->thread, NULL);
+    release(watchdog);
+}
+
+void vicrabcrashwd_answer(VicrabCrashWatchdog* watchdog)
+{
+    pthread_mutex_lock(&watchdog->mutex);
+    if(!watchdog->isAnswered)
+    {
+        watchdog->isAnswered = true;
+        watchdog->answerTime = vicrabcrashdate_monotonicNanoseconds();
+        pthread_cond_signal(&watchdog->condition);
+    }
+    pthread_mutex_unlock(&watchdog->mutex);
+    release(watchdog);
+}
@@ -0,0 +1,123 @@
+//
+//  VicrabCrashWatchdog.h
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+/* Watches a thread's event loop for hangs.
+ *
+ * A background thread posts a ping to the watched event loop and waits for
+ * it to be answered. A ping left unanswered for longer than the hang
+ * threshold starts a hang: the watchdog reports samples periodically, backing
+ * off the more samples it takes, until the ping is finally answered and the
+ * hang's duration is known.
+ *
+ * The watchdog knows nothing about the event loop itself, so any loop that can
+ * run a callback (the main dispatch queue, a test's own loop) can be watched.
+ */
+
+
+#ifndef HDR_VicrabCrashWatchdog_h
+#define HDR_VicrabCrashWatchdog_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+typedef struct VicrabCrashWatchdog VicrabCrashWatchdog;
+
+typedef struct
+{
+    /** Arrange for vicrabcrashwd_answer() to be called from the watched event
+     * loop. Called on the watchdog thread.
+     */
+    void (*postPing)(VicrabCrashWatchdog* watchdog, void* userData);
+
+    /** Called on the watchdog thread once a ping has gone unanswered for
+     * hangThresholdNanoseconds (NULL = ignore).
+     */
+    void (*onHangStarted)(void* userData);
+
+    /** Called on the watchdog thread right after a hang starts, and then
+     * periodically until it ends (NULL = ignore).
+     */
+    void (*onSample)(uint64_t elapsedNanoseconds, void* userData);
+
+    /** Called on the watchdog thread once the watched loop answers again.
+     * Not called if the watchdog is destroyed during the hang (NULL = ignore).
+     */
+    void (*onHangEnded)(uint64_t durationNanoseconds, void* userData);
+
+    void* userData;
+
+    /** Time between an answered ping and the next one. */
+    uint64_t pingIntervalNanoseconds;
+
+    /** How long a ping may go unanswered before it counts as a hang. */
+    uint64_t hangThresholdNanoseconds;
+
+    /** Time between the first samples of a hang. It doubles every few samples,
+     * up to maxSampleIntervalNanoseconds, so long hangs don't sample without bound.
+     */
+    uint64_t sampleIntervalNanoseconds;
+
+    /** The longest time between samples. */
+    uint64_t maxSampleIntervalNanoseconds;
+} VicrabCrashWatchdogConfig;
+
+/** Start a watchdog on its own thread.
+ *
+ * @param config The configuration. It is copied.
+ *
+ * @return The watchdog, or NULL if it could not be started.
+ */
+VicrabCrashWatchdog* vicrabcrashwd_create(const VicrabCrashWatchdogConfig* config);
+
+/** Stop a watchdog and wait for its thread to exit, after which none of its
+ * callbacks will be called again. The watchdog itself is freed once any posted
+ * ping has been answered, so vicrabcrashwd_answer() stays safe to call.
+ * Must not be called from the watchdog's own callbacks.
+ *
+ * @param watchdog The watchdog to stop.
+ */
+void vicrabcrashwd_destroy(VicrabCrashWatchdog* watchdog);
+
+/** Answer a ping. Call exactly once for every postPing, from the watched
+ * event loop.
+ *
+ * @param watchdog The watchdog that posted the ping.
+ */
+void vicrabcrashwd_answer(VicrabCrashWatchdog* watchdog);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HDR_VicrabCrashWatchdog_h
@@ -277,8 +277,11 @@ typedef enum
  *                      performance penalty, so it's best to use only on fatal errors.
  *
  * @param terminateProgram If true, do not return from this function call. Terminate the program instead.
+ *
+ * @return YES if a report was written. Non-fatal repeats of a recent exception are counted
+ *         into its report instead, and non-fatal reports beyond the rate limit are dropped.
  */
-- (void) reportUserException:(NSString*) name
+- (BOOL) reportUserException:(NSString*) name
                       reason:(NSString*) reason
                     language:(NSString*) language
                   lineOfCode:(NSString*) lineOfCode
@@ -286,6 +289,52 @@ typedef enum
                logAllThreads:(BOOL) logAllThreads
             terminateProgram:(BOOL) terminateProgram;
 
+/** Report a non-fatal, user defined exception that is never deduplicated or
+ * rate limited, for callers that depend on the report being written (such as
+ * stack trace snapshots). Parameters are as for
+ * reportUserException:reason:language:lineOfCode:stackTrace:logAllThreads:terminateProgram:.
+ *
+ * @return YES if a report was written (NO only if crash reporting is not installed).
+ */
+- (BOOL) reportUserExceptionBypassingRateLimit:(NSString*) name
+                                        reason:(NSString*) reason
+                                      language:(NSString*) language
+                                    lineOfCode:(NSString*) lineOfCode
+                                    stackTrace:(NSArray*) stackTrace
+                                 logAllThreads:(BOOL) logAllThreads;
+
+/** Report a custom, user defined exception without writing the report on the
+ * calling thread.
+ *
+ * Backtraces are captured before this returns, suspending each other thread
+ * only briefly, and the report is written in the background.
+ *
+ * @param name The exception name (for namespacing exception types).
+ *
+ * @param reason A description of why the exception occurred.
+ *
+ * @param language A unique language identifier.
+ *
+ * @param lineOfCode A copy of the offending line of code (nil = ignore).
+ *
+ * @param stackTrace An array of frames (dictionaries or strings) representing the call stack leading to the exception (nil = ignore).
+ *
+ * @param logAllThreads If true, capture the backtraces of all threads.
+ *
+ * @param onCompletion Called on a background thread once the report has been
+ *                     stored, or could not be (nil = ignore).
+ *
+ * @return YES if the report was queued, NO if it was counted into an earlier
+ *         report or dropped.
+ */
+- (BOOL) reportUserException:(NSString*) name
+                      reason:(NSString*) reason
+                    language:(NSString*) language
+                  lineOfCode:(NSString*) lineOfCode
+                  stackTrace:(NSArray*) stackTrace
+               logAllThreads:(BOOL) logAllThreads
+                onCompletion:(void(^)(void)) onCompletion;
+
 @end
 
 
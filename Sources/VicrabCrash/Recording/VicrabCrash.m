@@ -244,6 +244,7 @@ static NSString* getBasePath()
 - (NSDictionary*) systemInfo
 {
     VicrabCrash_MonitorContext fakeEvent = {0};
+    vicrabcrashcm_system_waitForDeferredData();
     vicrabcrashcm_system_getAPI()->addContextualInfoToEvent(&fakeEvent);
     NSMutableDictionary* dict = [NSMutableDictionary new];
 
@@ -280,6 +281,7 @@ static NSString* getBasePath()
     COPY_PRIMITIVE(memorySize);
     COPY_PRIMITIVE(freeMemory);
     COPY_PRIMITIVE(usableMemory);
+    COPY_PRIMITIVE(freeStorage);
 
     return dict;
 }
@@ -372,7 +374,19 @@ static NSString* getBasePath()
     vicrabcrash_deleteReportWithID([reportID longValue]);
 }
 
-- (void) reportUserException:(NSString*) name
+static NSString* stackTraceJSONString(NSArray* stackTrace)
+{
+    NSError* error = nil;
+    NSData* jsonData = [VicrabCrashJSONCodec encode:stackTrace options:0 error:&error];
+    if(jsonData == nil || error != nil)
+    {
+        VicrabCrashLOG_ERROR(@"Error encoding stack trace to JSON: %@", error);
+        // Don't return, since we can still record other useful information.
+    }
+    return [[NSString alloc] initWithData:jsonData encoding:NSUTF8StringEncoding];
+}
+
+- (BOOL) reportUserException:(NSString*) name
                       reason:(NSString*) reason
                     language:(NSString*) language
                   lineOfCode:(NSString*) lineOfCode
@@ -384,23 +398,72 @@ static NSString* getBasePath()
     const char* cReason = [reason cStringUsingEncoding:NSUTF8StringEncoding];
     const char* cLanguage = [language cStringUsingEncoding:NSUTF8StringEncoding];
     const char* cLineOfCode = [lineOfCode cStringUsingEncoding:NSUTF8StringEncoding];
-    NSError* error = nil;
-    NSData* jsonData = [VicrabCrashJSONCodec encode:stackTrace options:0 error:&error];
-    if(jsonData == nil || error != nil)
+    NSString* jsonString = stackTraceJSONString(stackTrace);
+    const char* cStackTrace = [jsonString cStringUsingEncoding:NSUTF8StringEncoding];
+
+    return vicrabcrash_reportUserException(cName,
+                                       cReason,
+                                       cLanguage,
+                                       cLineOfCode,
+                                       cStackTrace,
+                                       logAllThreads,
+                                       terminateProgram);
+}
+
+- (BOOL) reportUserExceptionBypassingRateLimit:(NSString*) name
+                                        reason:(NSString*) reason
+                                      language:(NSString*) language
+                                    lineOfCode:(NSString*) lineOfCode
+                                    stackTrace:(NSArray*) stackTrace
+                                 logAllThreads:(BOOL) logAllThreads
+{
+    const char* cName = [name cStringUsingEncoding:NSUTF8StringEncoding];
+    const char* cReason = [reason cStringUsingEncoding:NSUTF8StringEncoding];
+    const char* cLanguage = [language cStringUsingEncoding:NSUTF8StringEncoding];
+    const char* cLineOfCode = [lineOfCode cStringUsingEncoding:NSUTF8StringEncoding];
+    NSString* jsonString = stackTraceJSONString(stackTrace);
+    const char* cStackTrace = [jsonString cStringUsingEncoding:NSUTF8StringEncoding];
+
+    return vicrabcrash_reportUserExceptionBypassingRateLimit(cName,
+                                                         cReason,
+                                                         cLanguage,
+                                                         cLineOfCode,
+                                                         cStackTrace,
+                                                         logAllThreads);
+}
+
+static void onUserExceptionReported(void* userData)
+{
+    void (^onCompletion)(void) = (__bridge_transfer void(^)(void))userData;
+    if(onCompletion != nil)
     {
-        VicrabCrashLOG_ERROR(@"Error encoding stack trace to JSON: %@", error);
-        // Don't return, since we can still record other useful information.
+        onCompletion();
     }
-    NSString* jsonString = [[NSString alloc] initWithData:jsonData encoding:NSUTF8StringEncoding];
+}
+
+- (BOOL) reportUserException:(NSString*) name
+                      reason:(NSString*) reason
+                    language:(NSString*) language
+                  lineOfCode:(NSString*) lineOfCode
+                  stackTrace:(NSArray*) stackTrace
+               logAllThreads:(BOOL) logAllThreads
+                onCompletion:(void(^)(void)) onCompletion
+{
+    const char* cName = [name cStringUsingEncoding:NSUTF8StringEncoding];
+    const char* cReason = [reason cStringUsingEncoding:NSUTF8StringEncoding];
+    const char* cLanguage = [language cStringUsingEncoding:NSUTF8StringEncoding];
+    const char* cLineOfCode = [lineOfCode cStringUsingEncoding:NSUTF8StringEncoding];
+    NSString* jsonString = stackTraceJSONString(stackTrace);
     const char* cStackTrace = [jsonString cStringUsingEncoding:NSUTF8StringEncoding];
 
-    vicrabcrash_reportUserException(cName,
-                                cReason,
-                                cLanguage,
-                                cLineOfCode,
-                                cStackTrace,
-                                logAllThreads,
-                                terminateProgram);
+    return vicrabcrash_reportUserExceptionAsync(cName,
+                                            cReason,
+                                            cLanguage,
+                                            cLineOfCode,
+                                            cStackTrace,
+                                            logAllThreads,
+                                            onUserExceptionReported,
+                                            (__bridge_retained void*)[onCompletion copy]);
 }
 
 // ============================================================================
@@ -28,10 +28,16 @@
 #include "VicrabCrashC.h"
 
 #include "VicrabCrashCachedData.h"
+#include "VicrabCrashConsoleCapture.h"
+#include "VicrabCrashContextRing.h"
 #include "VicrabCrashReport.h"
 #include "VicrabCrashReportFixer.h"
+#include "VicrabCrashReportHelper.h"
 #include "VicrabCrashReportStore.h"
 #include "VicrabCrashMonitor_Deadlock.h"
+#include "VicrabCrashMonitor_CPPExceptionStats.h"
+#include "VicrabCrashMonitor_Hang.h"
+#include "VicrabCrashMonitor_Profiler.h"
 #include "VicrabCrashMonitor_User.h"
 #include "VicrabCrashFileUtils.h"
 #include "VicrabCrashObjC.h"
@@ -40,7 +46,9 @@
 #include "VicrabCrashMonitor_Zombie.h"
 #include "VicrabCrashMonitor_AppState.h"
 #include "VicrabCrashMonitorContext.h"
+#include "VicrabCrashMonitorType.h"
 #include "VicrabCrashSystemCapabilities.h"
+#include "VicrabCrashSymbolCache.h"
 
 //#define VicrabCrashLogger_LocalLevel TRACE
 #include "VicrabCrashLogger.h"
@@ -49,6 +57,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 
 // ============================================================================
@@ -60,10 +69,16 @@ static volatile bool g_installed = 0;
 
 static bool g_shouldAddConsoleLogToReport = false;
 static bool g_shouldPrintPreviousLog = false;
+static bool g_shouldWriteReportsOutOfProcess = false;
+static bool g_shouldDeferLogging = false;
+static int g_consoleCaptureSize = 0;
 static char g_consoleLogPath[VicrabCrashFU_MAX_PATH_LENGTH];
 static VicrabCrashMonitorType g_monitoring = VicrabCrashMonitorTypeProductionSafeMinimal;
 static char g_lastCrashReportFilePath[VicrabCrashFU_MAX_PATH_LENGTH];
 
+/** Number of distinct return addresses the symbol cache can hold. */
+#define kSymbolCacheSize 2048
+
 
 // ============================================================================
 #pragma mark - Utility -
@@ -83,6 +98,35 @@ static void printPreviousLog(const char* filePath)
 }
 
 
+// ============================================================================
+#pragma mark - Context File -
+// ============================================================================
+
+/** Publish the app state to the context file.
+ */
+static void publishAppState(void)
+{
+    VicrabCrash_MonitorContext context;
+    memset(&context, 0, sizeof(context));
+    if(vicrabcrashcm_getActiveMonitors() & VicrabCrashMonitorTypeApplicationState)
+    {
+        vicrabcrashcm_addContextualInfo(&context, VicrabCrashMonitorTypeApplicationState);
+        vicrabcrashctx_setAppState(&context);
+    }
+}
+
+/** Publish the system info and app state to the context file.
+ */
+static void publishContext(void)
+{
+    VicrabCrash_MonitorContext context;
+    memset(&context, 0, sizeof(context));
+    vicrabcrashcm_addContextualInfo(&context, VicrabCrashMonitorTypeSystem);
+    vicrabcrashctx_setSystemInfo(&context);
+    publishAppState();
+}
+
+
 // ============================================================================
 #pragma mark - Callbacks -
 // ============================================================================
@@ -93,11 +137,24 @@ static void printPreviousLog(const char* filePath)
  */
 static void onCrash(struct VicrabCrash_MonitorContext* monitorContext)
 {
-    if (monitorContext->currentSnapshotUserReported == false) {
+    vicrabcrashctx_addEvent(vicrabcrashmonitortype_name(monitorContext->crashType),
+                            monitorContext->crashReason != NULL ? monitorContext->crashReason : monitorContext->exceptionName);
+    if (monitorContext->currentSnapshotUserReported == false &&
+        monitorContext->crashType != VicrabCrashMonitorTypeMainThreadHang &&
+        monitorContext->crashType != VicrabCrashMonitorTypeCPPExceptionStats) {
         VicrabCrashLOG_DEBUG("Updating application state to note crash.");
         vicrabcrashstate_notifyAppCrash();
     }
+    // Only an event that ends the launch explains its termination.
+    if(monitorContext->isFatal && !monitorContext->currentSnapshotUserReported)
+    {
+        vicrabcrashctx_notifyCrashHandled();
+    }
     monitorContext->consoleLogPath = g_shouldAddConsoleLogToReport ? g_consoleLogPath : NULL;
+    monitorContext->consoleCapture = vicrabcrashconsole_getCapture();
+    // The log writer thread may be suspended, so get queued log entries into the file ourselves.
+    vicrabcrashlog_flush();
+    vicrabcrashconsole_drainPipes();
 
     if(monitorContext->crashedDuringCrashHandling)
     {
@@ -108,8 +165,17 @@ static void onCrash(struct VicrabCrash_MonitorContext* monitorContext)
         char crashReportFilePath[VicrabCrashFU_MAX_PATH_LENGTH];
         vicrabcrashcrs_getNextCrashReportPath(crashReportFilePath);
         strncpy(g_lastCrashReportFilePath, crashReportFilePath, sizeof(g_lastCrashReportFilePath));
-        vicrabcrashreport_writeStandardReport(monitorContext, crashReportFilePath);
+        if(!vicrabcrashrh_writeStandardReport(monitorContext, crashReportFilePath))
+        {
+            vicrabcrashreport_writeStandardReport(monitorContext, crashReportFilePath);
+        }
+        if(monitorContext->reportPathBuffer != NULL)
+        {
+            strncpy(monitorContext->reportPathBuffer, crashReportFilePath, (size_t)monitorContext->reportPathBufferLength);
+            monitorContext->reportPathBuffer[monitorContext->reportPathBufferLength - 1] = '\0';
+        }
     }
+    vicrabcrashlog_flush();
 }
 
 
@@ -135,17 +201,42 @@ VicrabCrashMonitorType vicrabcrash_install(const char* appName, const char* cons
 
     snprintf(path, sizeof(path), "%s/Data", installPath);
     vicrabcrashfu_makePath(path);
-    snprintf(path, sizeof(path), "%s/Data/CrashState.json", installPath);
+    char legacyStatePath[VicrabCrashFU_MAX_PATH_LENGTH];
+    snprintf(legacyStatePath, sizeof(legacyStatePath), "%s/Data/CrashState.json", installPath);
+    snprintf(path, sizeof(path), "%s/Data/CrashState.bin", installPath);
+    if(access(path, F_OK) != 0)
+    {
+        // The state monitor migrates the JSON contents on load.
+        rename(legacyStatePath, path);
+    }
     vicrabcrashstate_initialize(path);
 
+    snprintf(path, sizeof(path), "%s/Data/CrashContext.bin", installPath);
+    vicrabcrashctx_initialize(path);
+
     snprintf(g_consoleLogPath, sizeof(g_consoleLogPath), "%s/Data/ConsoleLog.txt", installPath);
     if(g_shouldPrintPreviousLog)
     {
         printPreviousLog(g_consoleLogPath);
     }
     vicrabcrashlog_setLogFilename(g_consoleLogPath, true);
+    if(g_shouldDeferLogging)
+    {
+        vicrabcrashlog_setDeferredWriting(true);
+    }
+    if(g_consoleCaptureSize > 0)
+    {
+        vicrabcrashconsole_start(g_consoleCaptureSize);
+    }
 
     vicrabcrashccd_init(60);
+    vicrabcrashccd_initBinaryImages(NULL);
+    vicrabcrashsymcache_init(kSymbolCacheSize);
+
+    if(g_shouldWriteReportsOutOfProcess)
+    {
+        vicrabcrashrh_start();
+    }
 
     vicrabcrashcm_setEventCallback(onCrash);
     VicrabCrashMonitorType monitors = vicrabcrash_setMonitoring(g_monitoring);
@@ -161,6 +252,7 @@ VicrabCrashMonitorType vicrabcrash_setMonitoring(VicrabCrashMonitorType monitors
     if(g_installed)
     {
         vicrabcrashcm_setActiveMonitors(monitors);
+        publishContext();
         return vicrabcrashcm_getActiveMonitors();
     }
     // Return what we will be monitoring in future.
@@ -170,15 +262,75 @@ VicrabCrashMonitorType vicrabcrash_setMonitoring(VicrabCrashMonitorType monitors
 void vicrabcrash_setUserInfoJSON(const char* const userInfoJSON)
 {
     vicrabcrashreport_setUserInfoJSON(userInfoJSON);
+    vicrabcrashctx_setUserInfoJSON(userInfoJSON);
+}
+
+void vicrabcrash_addBreadcrumb(const char* category, const char* message)
+{
+    vicrabcrashctx_addEvent(category, message);
 }
 
-void vicrabcrash_setDeadlockWatchdogInterval(double deadlockWatchdogInterval)
+void vicrabcrash_setDeadlockWatchdogInterval(__unused double deadlockWatchdogInterval)
 {
 #if VicrabCrashCRASH_HAS_OBJC
     vicrabcrashcm_setDeadlockHandlerWatchdogInterval(deadlockWatchdogInterval);
 #endif
 }
 
+void vicrabcrash_setResourceSamplingInterval(__unused double resourceSamplingInterval)
+{
+#if VicrabCrashCRASH_HAS_OBJC
+    vicrabcrashcm_system_setResourceSamplingInterval(resourceSamplingInterval);
+#endif
+}
+
+void vicrabcrash_setZombieTracking(unsigned cacheSize, unsigned samplingRate)
+{
+    vicrabcrashzombie_setCacheSize(cacheSize);
+    vicrabcrashzombie_setSamplingRate(samplingRate);
+}
+
+void vicrabcrash_setHangThresholds(double hangThreshold, double sampleInterval)
+{
+    vicrabcrashcm_setHangThresholds(hangThreshold, sampleInterval);
+}
+
+void vicrabcrash_setProfilerOptions(int samplesPerSecond, bool sampleAllThreads)
+{
+    vicrabcrashcm_setProfilerOptions(samplesPerSecond, sampleAllThreads);
+}
+
+void vicrabcrash_setCPPExceptionStatsOptions(int sampleInterval, double reportInterval)
+{
+    vicrabcrashcm_setCPPExceptionStatsOptions(sampleInterval, reportInterval);
+}
+
+void vicrabcrash_setWriteReportsOutOfProcess(bool writeReportsOutOfProcess)
+{
+    g_shouldWriteReportsOutOfProcess = writeReportsOutOfProcess;
+    if(!g_installed)
+    {
+        return;
+    }
+    if(writeReportsOutOfProcess)
+    {
+        vicrabcrashrh_start();
+    }
+    else
+    {
+        vicrabcrashrh_stop();
+    }
+}
+
+void vicrabcrash_setDeferredLogging(bool deferLogging)
+{
+    g_shouldDeferLogging = deferLogging;
+    if(g_installed)
+    {
+        vicrabcrashlog_setDeferredWriting(deferLogging);
+    }
+}
+
 void vicrabcrash_setIntrospectMemory(bool introspectMemory)
 {
     vicrabcrashreport_setIntrospectMemory(introspectMemory);
@@ -199,6 +351,20 @@ void vicrabcrash_setAddConsoleLogToReport(bool shouldAddConsoleLogToReport)
     g_shouldAddConsoleLogToReport = shouldAddConsoleLogToReport;
 }
 
+void vicrabcrash_setConsoleCaptureSize(int captureSize)
+{
+    g_consoleCaptureSize = captureSize;
+    if(!g_installed)
+    {
+        return;
+    }
+    vicrabcrashconsole_stop();
+    if(captureSize > 0)
+    {
+        vicrabcrashconsole_start(captureSize);
+    }
+}
+
 void vicrabcrash_setPrintPreviousLog(bool shouldPrintPreviousLog)
 {
     g_shouldPrintPreviousLog = shouldPrintPreviousLog;
@@ -209,7 +375,36 @@ void vicrabcrash_setMaxReportCount(int maxReportCount)
     vicrabcrashcrs_setMaxReportCount(maxReportCount);
 }
 
-void vicrabcrash_reportUserException(const char* name,
+void vicrabcrash_setUserReportRateLimit(int maxBurst, double reportsPerSecond)
+{
+    vicrabcrashcm_setUserReportRateLimit(maxBurst, reportsPerSecond);
+}
+
+static bool reportUserException(const char* name,
+                                const char* reason,
+                                const char* language,
+                                const char* lineOfCode,
+                                const char* stackTrace,
+                                bool logAllThreads,
+                                bool terminateProgram,
+                                bool bypassRateLimit)
+{
+    bool isWritten = vicrabcrashcm_reportUserException(name,
+                                                       reason,
+                                                       language,
+                                                       lineOfCode,
+                                                       stackTrace,
+                                                       logAllThreads,
+                                                       terminateProgram,
+                                                       bypassRateLimit);
+    if(isWritten && g_shouldAddConsoleLogToReport)
+    {
+        vicrabcrashlog_clearLogFile();
+    }
+    return isWritten;
+}
+
+bool vicrabcrash_reportUserException(const char* name,
                                  const char* reason,
                                  const char* language,
                                  const char* lineOfCode,
@@ -217,32 +412,85 @@ void vicrabcrash_reportUserException(const char* name,
                                  bool logAllThreads,
                                  bool terminateProgram)
 {
-    vicrabcrashcm_reportUserException(name,
-                             reason,
-                             language,
-                             lineOfCode,
-                             stackTrace,
-                             logAllThreads,
-                             terminateProgram);
-    if(g_shouldAddConsoleLogToReport)
+    return reportUserException(name, reason, language, lineOfCode, stackTrace, logAllThreads, terminateProgram, false);
+}
+
+bool vicrabcrash_reportUserExceptionBypassingRateLimit(const char* name,
+                                                   const char* reason,
+                                                   const char* language,
+                                                   const char* lineOfCode,
+                                                   const char* stackTrace,
+                                                   bool logAllThreads)
+{
+    return reportUserException(name, reason, language, lineOfCode, stackTrace, logAllThreads, false, true);
+}
+
+typedef struct
+{
+    void (*onCompletion)(void* userData);
+    void* userData;
+} AsyncUserReportCompletion;
+
+static void onAsyncUserReportWritten(bool isWritten, void* userData)
+{
+    AsyncUserReportCompletion* completion = userData;
+    // Lines not in any report stay in the log for the next one.
+    if(isWritten && g_shouldAddConsoleLogToReport)
     {
         vicrabcrashlog_clearLogFile();
     }
+    if(completion->onCompletion != NULL)
+    {
+        completion->onCompletion(completion->userData);
+    }
+    free(completion);
+}
+
+bool vicrabcrash_reportUserExceptionAsync(const char* name,
+                                      const char* reason,
+                                      const char* language,
+                                      const char* lineOfCode,
+                                      const char* stackTrace,
+                                      bool logAllThreads,
+                                      void (*onCompletion)(void* userData),
+                                      void* userData)
+{
+    AsyncUserReportCompletion* completion = malloc(sizeof(*completion));
+    if(completion == NULL)
+    {
+        VicrabCrashLOG_ERROR("Could not allocate user report completion.");
+        return false;
+    }
+    completion->onCompletion = onCompletion;
+    completion->userData = userData;
+    return vicrabcrashcm_reportUserExceptionAsync(name,
+                                                  reason,
+                                                  language,
+                                                  lineOfCode,
+                                                  stackTrace,
+                                                  logAllThreads,
+                                                  false,
+                                                  onAsyncUserReportWritten,
+                                                  completion);
 }
 
 void vicrabcrash_notifyAppActive(bool isActive)
 {
     vicrabcrashstate_notifyAppActive(isActive);
+    // Also picks up the system info that was collected in the background.
+    publishContext();
 }
 
 void vicrabcrash_notifyAppInForeground(bool isInForeground)
 {
     vicrabcrashstate_notifyAppInForeground(isInForeground);
+    publishAppState();
 }
 
 void vicrabcrash_notifyAppTerminate(void)
 {
     vicrabcrashstate_notifyAppTerminate();
+    vicrabcrashctx_notifyCleanExit();
 }
 
 void vicrabcrash_notifyAppCrash(void)
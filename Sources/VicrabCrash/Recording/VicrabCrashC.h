@@ -72,6 +72,17 @@ VicrabCrashMonitorType vicrabcrash_setMonitoring(VicrabCrashMonitorType monitors
  */
 void vicrabcrash_setUserInfoJSON(const char* const userInfoJSON);
 
+/** Add a breadcrumb to the recent events kept in the context file.
+ * If the process is killed without a crash report, the next launch reports
+ * the termination along with the last 32 events.
+ * This function is async-safe.
+ *
+ * @param category What kind of event this is.
+ *
+ * @param message A short description, or NULL.
+ */
+void vicrabcrash_addBreadcrumb(const char* category, const char* message);
+
 /** Set the maximum time to allow the main thread to run without returning.
  * If a task occupies the main thread for longer than this interval, the
  * watchdog will consider the queue deadlocked and shut down the app and write a
@@ -89,6 +100,89 @@ void vicrabcrash_setUserInfoJSON(const char* const userInfoJSON);
  */
 void vicrabcrash_setDeadlockWatchdogInterval(double deadlockWatchdogInterval);
 
+/** Set how often the system monitor samples free memory, free storage and
+ * CPU load. Reports carry the latest samples, so the crash handler never
+ * has to query the system.
+ *
+ * 0 = Only sample once, when the system monitor is enabled.
+ *
+ * Default: 10
+ */
+void vicrabcrash_setResourceSamplingInterval(double resourceSamplingInterval);
+
+/** Configure the zombie monitor (VicrabCrashMonitorTypeZombie).
+ * Must be called before the monitor is enabled.
+ *
+ * @param cacheSize Number of deallocated objects to remember (rounded up to
+ *                  a power of 2).
+ *
+ * @param samplingRate Only remember about one in this many deallocated
+ *                     objects (1 = all). Exceptions are always remembered.
+ *
+ * Default: 32768, 1
+ */
+void vicrabcrash_setZombieTracking(unsigned cacheSize, unsigned samplingRate);
+
+/** Configure the main thread hang monitor (VicrabCrashMonitorTypeMainThreadHang).
+ *
+ * A hang is reported (non-fatally) once the main thread answers again, with
+ * its duration and the main thread's stacks sampled while it was blocked.
+ *
+ * @param hangThreshold Seconds the main thread must be unresponsive before it
+ *                      counts as a hang (0 = disabled).
+ *
+ * @param sampleInterval Seconds between the first stack samples of a hang.
+ *
+ * Default: 0.25, 0.05
+ */
+void vicrabcrash_setHangThresholds(double hangThreshold, double sampleInterval);
+
+/** Configure the sampling profiler (VicrabCrashMonitorTypeProfiler).
+ *
+ * While enabled, thread stacks are sampled in the background and the call tree
+ * of roughly the last minute is added to every report.
+ *
+ * @param samplesPerSecond The sampling rate (0 = disabled).
+ *
+ * @param sampleAllThreads If true, sample every thread rather than only the
+ *                         main thread.
+ *
+ * Default: 100, false
+ */
+void vicrabcrash_setProfilerOptions(int samplesPerSecond, bool sampleAllThreads);
+
+/** Configure C++ exception statistics (VicrabCrashMonitorTypeCPPExceptionStats).
+ *
+ * Throws are counted per exception type and throw site, whether or not they
+ * are caught, and the counts are reported (non-fatally) at each interval.
+ *
+ * @param sampleInterval Count one in this many throws.
+ *
+ * @param reportInterval Seconds between reports.
+ *
+ * Default: 10, 60
+ */
+void vicrabcrash_setCPPExceptionStatsOptions(int sampleInterval, double reportInterval);
+
+/** If true, write crash reports for fatal signals from a helper process that
+ * is forked at install, so that a corrupt heap in the crashed process can't
+ * break the report. The crashed process falls back to writing the report
+ * itself if the helper fails. Only supported on Linux.
+ *
+ * Default: false
+ */
+void vicrabcrash_setWriteReportsOutOfProcess(bool writeReportsOutOfProcess);
+
+/** If true, VicrabCrash's own log entries are queued in memory and written
+ * by a background thread, so that logging from a signal handler or a hot
+ * path costs a few stores instead of a write to the console log.
+ * Entries that are still queued when the process dies are lost, unless a
+ * crash report is being written, which flushes them first.
+ *
+ * Default: false
+ */
+void vicrabcrash_setDeferredLogging(bool deferLogging);
+
 /** If true, introspect memory contents during a crash.
  * Any Objective-C objects or C strings near the stack pointer or referenced by
  * cpu registers or exceptions will be recorded in the crash report, along with
@@ -125,6 +219,17 @@ void vicrabcrash_setCrashNotifyCallback(const VicrabCrashReportWriteCallback onC
  */
 void vicrabcrash_setAddConsoleLogToReport(bool shouldAddConsoleLogToReport);
 
+/** Capture the process's stdout and stderr into an in-memory ring, and put
+ * the newest lines in reports instead of the VicrabCrashLOG console log.
+ * Output still reaches the original stdout and stderr.
+ *
+ * @param captureSize How many bytes of output to keep (at most 256 KB).
+ *                    0 = don't capture.
+ *
+ * Default: 0
+ */
+void vicrabcrash_setConsoleCaptureSize(int captureSize);
+
 /** Set if VicrabCrash should print the previous log to the console on startup.
  *  This is for debugging purposes.
  */
@@ -136,6 +241,18 @@ void vicrabcrash_setPrintPreviousLog(bool shouldPrintPreviousLog);
  */
 void vicrabcrash_setMaxReportCount(int maxReportCount);
 
+/** Limit how fast non-fatal user reports get written.
+ * Repeats of an already reported exception are counted into the existing
+ * report instead of creating a new one.
+ *
+ * @param maxBurst The most reports written in a burst (0 = no rate limit).
+ *
+ * @param reportsPerSecond The rate at which the burst allowance refills.
+ *
+ * Default: 10 reports, refilling at one every 6 seconds.
+ */
+void vicrabcrash_setUserReportRateLimit(int maxBurst, double reportsPerSecond);
+
 /** Report a custom, user defined exception.
  * This can be useful when dealing with scripting languages.
  *
@@ -157,8 +274,12 @@ void vicrabcrash_setMaxReportCount(int maxReportCount);
  *                      performance penalty, so it's best to use only on fatal errors.
  *
  * @param terminateProgram If true, do not return from this function call. Terminate the program instead.
+ *
+ * @return true if a report was written. Non-fatal reports of an exception that was recently
+ *         reported from the same place are counted into that report instead, and non-fatal
+ *         reports beyond the rate limit (see vicrabcrash_setUserReportRateLimit()) are dropped.
  */
-void vicrabcrash_reportUserException(const char* name,
+bool vicrabcrash_reportUserException(const char* name,
                                  const char* reason,
                                  const char* language,
                                  const char* lineOfCode,
@@ -166,6 +287,56 @@ void vicrabcrash_reportUserException(const char* name,
                                  bool logAllThreads,
                                  bool terminateProgram);
 
+/** Like vicrabcrash_reportUserException(), but never deduplicated or rate limited.
+ * Use this when the caller depends on the report being written, for example to
+ * snapshot the current stack trace.
+ *
+ * @return true if a report was written (false only if the monitor is not installed).
+ */
+bool vicrabcrash_reportUserExceptionBypassingRateLimit(const char* name,
+                                                   const char* reason,
+                                                   const char* language,
+                                                   const char* lineOfCode,
+                                                   const char* stackTrace,
+                                                   bool logAllThreads);
+
+/** Report a custom, user defined exception without writing the report on the
+ * calling thread.
+ *
+ * Only the backtraces are captured before this returns. With logAllThreads,
+ * each other thread is suspended just long enough to copy its backtrace,
+ * rather than suspending the whole process while the report is written.
+ * The report is encoded and stored on a background thread.
+ *
+ * @param name The exception name (for namespacing exception types).
+ *
+ * @param reason A description of why the exception occurred.
+ *
+ * @param language A unique language identifier.
+ *
+ * @param lineOfCode A copy of the offending line of code (NULL = ignore).
+ *
+ * @param stackTrace JSON encoded array containing stack trace information (one frame per array entry).
+ *
+ * @param logAllThreads If true, capture the backtraces of all threads.
+ *
+ * @param onCompletion Called exactly once, after the report has been stored or
+ *                     as soon as it is known it will not be (NULL = ignore).
+ *
+ * @param userData Passed to onCompletion.
+ *
+ * @return true if the report was queued, false if it was counted into an
+ *         earlier report or dropped. onCompletion is called either way.
+ */
+bool vicrabcrash_reportUserExceptionAsync(const char* name,
+                                      const char* reason,
+                                      const char* language,
+                                      const char* lineOfCode,
+                                      const char* stackTrace,
+                                      bool logAllThreads,
+                                      void (*onCompletion)(void* userData),
+                                      void* userData);
+
 
 #pragma mark -- Notifications --
 
@@ -24,138 +24,484 @@
 
 
 #include "VicrabCrashCachedData.h"
+#include "VicrabCrashJSONCodec.h"
+#include "VicrabCrashReportFields.h"
 
 //#define VicrabCrashLogger_LocalLevel TRACE
 #include "VicrabCrashLogger.h"
 
+#include "VicrabCrashSystemCapabilities.h"
+
+#if VicrabCrashCRASH_HOST_APPLE
 #include <mach/mach.h>
+#include <mach-o/dyld.h>
+#endif
+#if VicrabCrashCRASH_HAS_THREAD_INTROSPECTION
+#include <pthread/introspection.h>
+#endif
+#if VicrabCrashCRASH_HOST_LINUX
+#include <dirent.h>
+#include <stddef.h>
+#include <link.h>
+#endif
+#include <dlfcn.h>
 #include <errno.h>
 #include <memory.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 
 
-#define SWAP_POINTERS(A, B) \
-{ \
-    void* temp = A; \
-    A = B; \
-    B = temp; \
-}
+/** Most threads the cache will track. Threads beyond this are not named in
+ * crash reports.
+ */
+#define kMaxCachedThreads 256
+
+/** Bytes reserved per thread name, including the terminator. */
+#define kMaxThreadNameLength 64
+
+/** Fastest polling interval when nothing tells us about thread changes. */
+#define kMinPollingIntervalInSeconds 1
+
+/** Delay between a thread event and the refresh it triggers, so that a burst
+ * of thread starts costs one refresh and new threads get to name themselves.
+ */
+#define kThreadEventCoalesceMicroseconds 50000
+
+/** Snapshots in the pool: the published one, one that may still be pinned by
+ * a reader of the previous epoch, and one to build the next list into.
+ */
+#define kThreadListSnapshotCount 3
+
+/** An immutable view of the thread list. Snapshots come from a pool that is
+ * allocated once, so refreshing the list never allocates and names live in a
+ * fixed arena instead of being strdup'd on every poll.
+ */
+typedef struct
+{
+    VicrabCrashThread machThreads[kMaxCachedThreads];
+    VicrabCrashThread pThreads[kMaxCachedThreads];
+    const char* threadNames[kMaxCachedThreads];
+    const char* queueNames[kMaxCachedThreads];
+    char nameArena[kMaxCachedThreads][kMaxThreadNameLength];
+    int count;
+    bool isRetired;
+    uint64_t retireEpoch;
+} ThreadListSnapshot;
 
 static int g_pollingIntervalInSeconds;
 static pthread_t g_cacheThread;
-static VicrabCrashThread* g_allMachThreads;
-static VicrabCrashThread* g_allPThreads;
-static const char** g_allThreadNames;
-static const char** g_allQueueNames;
-static int g_allThreadsCount;
-static _Atomic(int) g_semaphoreCount;
+static ThreadListSnapshot* g_threadListSnapshots;
+
+/** The published snapshot. Readers only ever see a complete list. */
+static ThreadListSnapshot* _Atomic g_currentThreadList;
 
-static void updateThreadList()
+/** Epoch-based reclamation. Readers register in the counter for the epoch's
+ * parity. The writer only advances the epoch once the readers of the epoch
+ * before the current one have left, so readers can only be active in the
+ * current and previous epochs, and anything retired in epoch E can be
+ * reused from epoch E+2 on.
+ */
+typedef struct
 {
-    const task_t thisTask = mach_task_self();
-    int oldThreadsCount = g_allThreadsCount;
-    VicrabCrashThread* allMachThreads = NULL;
-    VicrabCrashThread* allPThreads = NULL;
-    static const char** allThreadNames;
-    static const char** allQueueNames;
+    _Atomic(uint64_t) epoch;
+    _Atomic(int) readers[2];
+} ReclamationEpoch;
 
-    mach_msg_type_number_t allThreadsCount;
-    thread_act_array_t threads;
-    task_threads(thisTask, &threads, &allThreadsCount);
+static ReclamationEpoch g_threadListEpoch;
+
+/** State held between vicrabcrashccd_freeze() and vicrabcrashccd_unfreeze(). */
+static _Atomic(int) g_freezeCount;
+static ThreadListSnapshot* _Atomic g_frozenThreadList;
+static uint64_t g_frozenEpoch;
+
+static pthread_mutex_t g_threadEventMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_threadEventCondition = PTHREAD_COND_INITIALIZER;
+static bool g_hasPendingThreadEvent;
+static bool g_hasThreadEvents;
+
+/** Largest serialized size of a single binary image entry. */
+#define kMaxSerializedImageLength 2048
+
+typedef struct BinaryImageNode
+{
+    struct BinaryImageNode* _Atomic next;
+    uint64_t address;
+    int length;
+    /** Links removed nodes until they are freed. Leaves next intact for
+     * readers that are still on this node.
+     */
+    struct BinaryImageNode* nextRetired;
+    uint64_t retireEpoch;
+    char json[];
+} BinaryImageNode;
+
+/** Sentinel list head. Readers walk the list without taking a lock, inside
+ * g_binaryImagesEpoch. Removed images are unlinked and only freed once no
+ * reader can still be on them.
+ */
+static BinaryImageNode* _Atomic g_binaryImagesHead;
+static BinaryImageNode* g_binaryImagesTail;
+static BinaryImageNode* g_retiredBinaryImages;
+static ReclamationEpoch g_binaryImagesEpoch;
+static pthread_mutex_t g_binaryImagesMutex = PTHREAD_MUTEX_INITIALIZER;
+
+#if VicrabCrashCRASH_HOST_LINUX
+static void pollLoaderImages(void);
+#endif
+
+// ============================================================================
+#pragma mark - Epochs -
+// ============================================================================
+
+/** Register as a reader of the current epoch.
+ *
+ * @return The epoch to pass to leaveEpoch().
+ */
+static uint64_t enterEpoch(ReclamationEpoch* const state)
+{
+    for(;;)
+    {
+        uint64_t epoch = atomic_load(&state->epoch);
+        atomic_fetch_add(&state->readers[epoch & 1], 1);
+        if(atomic_load(&state->epoch) == epoch)
+        {
+            return epoch;
+        }
+        // The writer moved on before we were counted. Try again in the new epoch.
+        atomic_fetch_sub(&state->readers[epoch & 1], 1);
+    }
+}
+
+static void leaveEpoch(ReclamationEpoch* const state, uint64_t epoch)
+{
+    atomic_fetch_sub(&state->readers[epoch & 1], 1);
+}
+
+/** Move to the next epoch. Only one writer may call this at a time.
+ *
+ * @return false if readers from the previous epoch are still active, in which
+ *         case the epoch stays as it is.
+ */
+static bool advanceEpoch(ReclamationEpoch* const state)
+{
+    const uint64_t epoch = atomic_load(&state->epoch);
+    if(atomic_load(&state->readers[(epoch + 1) & 1]) != 0)
+    {
+        return false;
+    }
+    atomic_store(&state->epoch, epoch + 1);
+    return true;
+}
 
-    allMachThreads = calloc(allThreadsCount, sizeof(*allMachThreads));
-    allPThreads = calloc(allThreadsCount, sizeof(*allPThreads));
-    allThreadNames = calloc(allThreadsCount, sizeof(*allThreadNames));
-    allQueueNames = calloc(allThreadsCount, sizeof(*allQueueNames));
 
+// ============================================================================
+#pragma mark - Thread List -
+// ============================================================================
+
+#if VicrabCrashCRASH_HAS_THREAD_INTROSPECTION
+static pthread_introspection_hook_t g_previousIntrospectionHook;
+
+static void onThreadIntrospectionEvent(unsigned int event, pthread_t thread, void* addr, size_t size)
+{
+    if(event == PTHREAD_INTROSPECTION_THREAD_START || event == PTHREAD_INTROSPECTION_THREAD_TERMINATE)
+    {
+        pthread_mutex_lock(&g_threadEventMutex);
+        g_hasPendingThreadEvent = true;
+        pthread_cond_signal(&g_threadEventCondition);
+        pthread_mutex_unlock(&g_threadEventMutex);
+    }
+    if(g_previousIntrospectionHook != NULL)
+    {
+        g_previousIntrospectionHook(event, thread, addr, size);
+    }
+}
+#endif
+
+/** Install hooks that report thread starts and exits, if the platform has any.
+ *
+ * @return true if thread events will be delivered.
+ */
+static bool installThreadEventHooks()
+{
+#if VicrabCrashCRASH_HAS_THREAD_INTROSPECTION
+    static bool isInstalled = false;
+    if(!isInstalled)
+    {
+        isInstalled = true;
+        g_previousIntrospectionHook = pthread_introspection_hook_install(onThreadIntrospectionEvent);
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+/** Fill in the thread ids of all threads in the process.
+ *
+ * @return The number of threads stored.
+ */
+static int getAllThreads(VicrabCrashThread* const threads, const int maxThreads)
+{
+#if VicrabCrashCRASH_HOST_APPLE
+    const task_t thisTask = mach_task_self();
+    mach_msg_type_number_t allThreadsCount;
+    thread_act_array_t allThreads;
+    if(task_threads(thisTask, &allThreads, &allThreadsCount) != KERN_SUCCESS)
+    {
+        return 0;
+    }
+
+    int count = 0;
     for(mach_msg_type_number_t i = 0; i < allThreadsCount; i++)
     {
-        char buffer[1000];
-        thread_t thread = threads[i];
-        pthread_t pthread = pthread_from_mach_thread_np(thread);
-        allMachThreads[i] = (VicrabCrashThread)thread;
-        allPThreads[i] = (VicrabCrashThread)pthread;
-        if(pthread != 0 && pthread_getname_np(pthread, buffer, sizeof(buffer)) == 0 && buffer[0] != 0)
+        if(count < maxThreads)
         {
-            allThreadNames[i] = strdup(buffer);
+            threads[count++] = (VicrabCrashThread)allThreads[i];
         }
+        mach_port_deallocate(thisTask, allThreads[i]);
+    }
+    vm_deallocate(thisTask, (vm_address_t)allThreads, sizeof(thread_t) * allThreadsCount);
+    return count;
+#elif VicrabCrashCRASH_HOST_LINUX
+    DIR* dir = opendir("/proc/self/task");
+    if(dir == NULL)
+    {
+        VicrabCrashLOG_ERROR("Could not read /proc/self/task: %s", strerror(errno));
+        return 0;
     }
 
-    g_allThreadsCount = g_allThreadsCount < (int)allThreadsCount ? g_allThreadsCount : (int)allThreadsCount;
-    SWAP_POINTERS(g_allMachThreads, allMachThreads);
-    SWAP_POINTERS(g_allPThreads, allPThreads);
-    SWAP_POINTERS(g_allThreadNames, allThreadNames);
-    SWAP_POINTERS(g_allQueueNames, allQueueNames);
-    g_allThreadsCount = (int)allThreadsCount;
+    int count = 0;
+    struct dirent* entry;
+    while(count < maxThreads && (entry = readdir(dir)) != NULL)
+    {
+        if(entry->d_name[0] >= '0' && entry->d_name[0] <= '9')
+        {
+            threads[count++] = (VicrabCrashThread)strtoul(entry->d_name, NULL, 10);
+        }
+    }
+    closedir(dir);
+    return count;
+#else
+    return 0;
+#endif
+}
+
+static VicrabCrashThread pthreadForThread(__unused const VicrabCrashThread thread)
+{
+#if VicrabCrashCRASH_HOST_APPLE
+    return (VicrabCrashThread)pthread_from_mach_thread_np((thread_t)thread);
+#else
+    return 0;
+#endif
+}
 
-    if(allMachThreads != NULL)
+static bool readThreadName(__unused const VicrabCrashThread thread, __unused const VicrabCrashThread pthread, char* const buffer)
+{
+#if VicrabCrashCRASH_HOST_APPLE
+    return pthread != 0 && pthread_getname_np((pthread_t)pthread, buffer, kMaxThreadNameLength) == 0;
+#else
+    return vicrabcrashthread_getThreadName(thread, buffer, kMaxThreadNameLength);
+#endif
+}
+
+/** Find a thread in a snapshot, trying the index it is expected at first since
+ * thread order rarely changes between refreshes.
+ */
+static int indexOfThread(const ThreadListSnapshot* const buffer, const VicrabCrashThread thread, const int hint)
+{
+    if(hint < buffer->count && buffer->machThreads[hint] == thread)
     {
-        free(allMachThreads);
+        return hint;
     }
-    if(allPThreads != NULL)
+    for(int i = 0; i < buffer->count; i++)
     {
-        free(allPThreads);
+        if(buffer->machThreads[i] == thread)
+        {
+            return i;
+        }
     }
-    if(allThreadNames != NULL)
+    return -1;
+}
+
+/** Find a snapshot that no reader can still be looking at.
+ *
+ * @return The snapshot, or NULL if all of them may still be in use.
+ */
+static ThreadListSnapshot* reclaimThreadListSnapshot(const ThreadListSnapshot* const current, const uint64_t epoch)
+{
+    for(int i = 0; i < kThreadListSnapshotCount; i++)
     {
-        for(int i = 0; i < oldThreadsCount; i++)
+        ThreadListSnapshot* snapshot = &g_threadListSnapshots[i];
+        if(snapshot != current && (!snapshot->isRetired || snapshot->retireEpoch + 2 <= epoch))
         {
-            const char* name = allThreadNames[i];
-            if(name != NULL)
-            {
-                free((void*)name);
-            }
+            return snapshot;
         }
-        free(allThreadNames);
     }
-    if(allQueueNames != NULL)
+    return NULL;
+}
+
+/** Make a snapshot the current one and retire the previous one.
+ * Only the cached data thread publishes, so there is a single writer.
+ *
+ * @return false if readers from the previous epoch are still active, in which
+ *         case nothing was published.
+ */
+static bool publishThreadListSnapshot(ThreadListSnapshot* const snapshot)
+{
+    const uint64_t epoch = atomic_load(&g_threadListEpoch.epoch);
+    if(atomic_load(&g_threadListEpoch.readers[(epoch + 1) & 1]) != 0)
+    {
+        return false;
+    }
+
+    snapshot->isRetired = false;
+    ThreadListSnapshot* previous = atomic_exchange(&g_currentThreadList, snapshot);
+    if(previous != NULL)
+    {
+        previous->retireEpoch = epoch;
+        previous->isRetired = true;
+    }
+    advanceEpoch(&g_threadListEpoch);
+    return true;
+}
+
+/** Rebuild the thread list into a free snapshot and publish it.
+ * Names of threads that were already known are carried over unless
+ * refreshAllNames is set, since most platforms can't tell us about renames.
+ *
+ * @param refreshAllNames If true, re-read every thread's name.
+ *
+ * @return true if any thread appeared, exited, or was renamed.
+ */
+static bool updateThreadList(bool refreshAllNames)
+{
+    static const ThreadListSnapshot emptySnapshot;
+    const ThreadListSnapshot* current = atomic_load(&g_currentThreadList);
+    const ThreadListSnapshot* previous = current != NULL ? current : &emptySnapshot;
+    ThreadListSnapshot* next = reclaimThreadListSnapshot(current, atomic_load(&g_threadListEpoch.epoch));
+    if(next == NULL)
+    {
+        // A crash report is holding on to older snapshots. Try again later.
+        return false;
+    }
+
+    next->count = getAllThreads(next->machThreads, kMaxCachedThreads);
+    bool hasChanged = next->count != previous->count;
+
+    for(int i = 0; i < next->count; i++)
     {
-        for(int i = 0; i < oldThreadsCount; i++)
+        const VicrabCrashThread thread = next->machThreads[i];
+        const int previousIndex = indexOfThread(previous, thread, i);
+        char* name = next->nameArena[i];
+        next->pThreads[i] = previousIndex >= 0 ? previous->pThreads[previousIndex] : pthreadForThread(thread);
+        next->queueNames[i] = NULL;
+
+        const char* previousName = previousIndex >= 0 ? previous->threadNames[previousIndex] : NULL;
+        if(previousIndex < 0 || refreshAllNames || previousName == NULL)
         {
-            const char* name = allQueueNames[i];
-            if(name != NULL)
+            if(!readThreadName(thread, next->pThreads[i], name) || name[0] == 0)
+            {
+                name = NULL;
+            }
+            if(previousIndex < 0 ||
+               (name == NULL) != (previousName == NULL) ||
+               (name != NULL && strcmp(name, previousName) != 0))
             {
-                free((void*)name);
+                hasChanged = true;
             }
         }
-        free(allQueueNames);
+        else
+        {
+            memcpy(name, previousName, kMaxThreadNameLength);
+        }
+        next->threadNames[i] = name;
     }
-    
-    for(mach_msg_type_number_t i = 0; i < allThreadsCount; i++)
+
+    return publishThreadListSnapshot(next) && hasChanged;
+}
+
+/** Sleep until a thread event arrives or the timeout elapses.
+ *
+ * @return true if woken by a thread event.
+ */
+static bool waitForThreadEvent(unsigned timeoutInSeconds)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeoutInSeconds;
+
+    pthread_mutex_lock(&g_threadEventMutex);
+    while(!g_hasPendingThreadEvent)
     {
-        mach_port_deallocate(thisTask, threads[i]);
+        if(pthread_cond_timedwait(&g_threadEventCondition, &g_threadEventMutex, &deadline) == ETIMEDOUT)
+        {
+            break;
+        }
     }
-    vm_deallocate(thisTask, (vm_address_t)threads, sizeof(thread_t) * allThreadsCount);
+    bool hadEvent = g_hasPendingThreadEvent;
+    g_hasPendingThreadEvent = false;
+    pthread_mutex_unlock(&g_threadEventMutex);
+    return hadEvent;
 }
 
+/** With thread hooks, the list is refreshed on every thread start and exit,
+ * and the polling interval only matters for picking up renames. Without
+ * them, polling starts fast and backs off while nothing changes.
+ */
 static void* monitorCachedData(__unused void* const userData)
 {
-    static int quickPollCount = 4;
-    usleep(1);
+    unsigned pollingInterval = kMinPollingIntervalInSeconds;
+    bool refreshAllNames = true;
     for(;;)
     {
-        if(g_semaphoreCount <= 0)
+        bool hasChanged = updateThreadList(refreshAllNames);
+#if VicrabCrashCRASH_HOST_LINUX
+        pollLoaderImages();
+#endif
+
+        if(hasChanged || g_hasThreadEvents)
         {
-            updateThreadList();
+            pollingInterval = g_hasThreadEvents ? (unsigned)g_pollingIntervalInSeconds : kMinPollingIntervalInSeconds;
         }
-        unsigned pollintInterval = (unsigned)g_pollingIntervalInSeconds;
-        if(quickPollCount > 0)
+        else if(pollingInterval < (unsigned)g_pollingIntervalInSeconds)
         {
-            // Lots can happen in the first few seconds of operation.
-            quickPollCount--;
-            pollintInterval = 1;
+            pollingInterval *= 2;
+            if(pollingInterval > (unsigned)g_pollingIntervalInSeconds)
+            {
+                pollingInterval = (unsigned)g_pollingIntervalInSeconds;
+            }
         }
-        sleep(pollintInterval);
+
+        bool wasThreadEvent = waitForThreadEvent(pollingInterval);
+        if(wasThreadEvent)
+        {
+            usleep(kThreadEventCoalesceMicroseconds);
+        }
+        refreshAllNames = !wasThreadEvent;
     }
     return NULL;
 }
 
 void vicrabcrashccd_init(int pollingIntervalInSeconds)
 {
-    g_pollingIntervalInSeconds = pollingIntervalInSeconds;
+    g_pollingIntervalInSeconds = pollingIntervalInSeconds < kMinPollingIntervalInSeconds ? kMinPollingIntervalInSeconds : pollingIntervalInSeconds;
+    if(g_threadListSnapshots != NULL)
+    {
+        // Already running. The cache thread picks up the new interval.
+        return;
+    }
+    g_threadListSnapshots = calloc(kThreadListSnapshotCount, sizeof(*g_threadListSnapshots));
+    if(g_threadListSnapshots == NULL)
+    {
+        VicrabCrashLOG_ERROR("Could not allocate thread list snapshots");
+        return;
+    }
+    g_hasThreadEvents = installThreadEventHooks();
+
     pthread_attr_t attr;
     pthread_attr_init(&attr);
     pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
@@ -172,41 +518,60 @@ void vicrabcrashccd_init(int pollingIntervalInSeconds)
 
 void vicrabcrashccd_freeze()
 {
-    if(g_semaphoreCount++ <= 0)
+    if(atomic_fetch_add(&g_freezeCount, 1) == 0)
     {
-        // Sleep just in case the cached data thread is in the middle of an update.
-        usleep(1);
+        g_frozenEpoch = enterEpoch(&g_threadListEpoch);
+        atomic_store(&g_frozenThreadList, atomic_load(&g_currentThreadList));
     }
 }
 
 void vicrabcrashccd_unfreeze()
 {
-    if(--g_semaphoreCount < 0)
+    int freezeCount = atomic_load(&g_freezeCount);
+    do
+    {
+        if(freezeCount <= 0)
+        {
+            // Handle extra calls to unfreeze somewhat gracefully.
+            return;
+        }
+    } while(!atomic_compare_exchange_weak(&g_freezeCount, &freezeCount, freezeCount - 1));
+
+    if(freezeCount == 1)
     {
-        // Handle extra calls to unfreeze somewhat gracefully.
-        g_semaphoreCount++;
+        atomic_store(&g_frozenThreadList, NULL);
+        leaveEpoch(&g_threadListEpoch, g_frozenEpoch);
     }
 }
 
+/** The snapshot readers should use: the pinned one while frozen, otherwise
+ * whatever is current (which is only guaranteed until the next refresh).
+ */
+static const ThreadListSnapshot* readableThreadList()
+{
+    const ThreadListSnapshot* snapshot = atomic_load(&g_frozenThreadList);
+    return snapshot != NULL ? snapshot : atomic_load(&g_currentThreadList);
+}
+
 VicrabCrashThread* vicrabcrashccd_getAllThreads(int* threadCount)
 {
+    const ThreadListSnapshot* snapshot = readableThreadList();
     if(threadCount != NULL)
     {
-        *threadCount = g_allThreadsCount;
+        *threadCount = snapshot != NULL ? snapshot->count : 0;
     }
-    return g_allMachThreads;
+    return snapshot != NULL ? (VicrabCrashThread*)snapshot->machThreads : NULL;
 }
 
 const char* vicrabcrashccd_getThreadName(VicrabCrashThread thread)
 {
-    if(g_allThreadNames != NULL)
+    const ThreadListSnapshot* snapshot = readableThreadList();
+    if(snapshot != NULL)
     {
-        for(int i = 0; i < g_allThreadsCount; i++)
+        int index = indexOfThread(snapshot, thread, 0);
+        if(index >= 0)
         {
-            if(g_allMachThreads[i] == thread)
-            {
-                return g_allThreadNames[i];
-            }
+            return snapshot->threadNames[index];
         }
     }
     return NULL;
@@ -214,15 +579,410 @@ const char* vicrabcrashccd_getThreadName(VicrabCrashThread thread)
 
 const char* vicrabcrashccd_getQueueName(VicrabCrashThread thread)
 {
-    if(g_allQueueNames != NULL)
+    const ThreadListSnapshot* snapshot = readableThreadList();
+    if(snapshot != NULL)
+    {
+        int index = indexOfThread(snapshot, thread, 0);
+        if(index >= 0)
+        {
+            return snapshot->queueNames[index];
+        }
+    }
+    return NULL;
+}
+
+
+// ============================================================================
+#pragma mark - Binary Images -
+// ============================================================================
+
+typedef struct
+{
+    char* buffer;
+    int length;
+    int capacity;
+} SerializeBuffer;
+
+static int addSerializedData(const char* const data, const int length, void* const userData)
+{
+    SerializeBuffer* buffer = (SerializeBuffer*)userData;
+    if(buffer->length + length > buffer->capacity)
     {
-        for(int i = 0; i < g_allThreadsCount; i++)
+        return VicrabCrashJSON_ERROR_DATA_TOO_LONG;
+    }
+    memcpy(buffer->buffer + buffer->length, data, (size_t)length);
+    buffer->length += length;
+    return VicrabCrashJSON_OK;
+}
+
+static int formatUUID(const uint8_t* const uuid, char* const buffer37Chars)
+{
+    static const char hexNybbles[] = "0123456789ABCDEF";
+    char* dst = buffer37Chars;
+    for(int i = 0; i < 16; i++)
+    {
+        if(i == 4 || i == 6 || i == 8 || i == 10)
+        {
+            *dst++ = '-';
+        }
+        *dst++ = hexNybbles[(uuid[i] >> 4) & 15];
+        *dst++ = hexNybbles[uuid[i] & 15];
+    }
+    *dst = '\0';
+    return (int)(dst - buffer37Chars);
+}
+
+static int serializeBinaryImage(const VicrabCrashBinaryImage* const image, char* const buffer, const int bufferLength)
+{
+    SerializeBuffer serializeBuffer = {.buffer = buffer, .length = 0, .capacity = bufferLength};
+    VicrabCrashJSONEncodeContext context;
+    vicrabcrashjson_beginEncode(&context, false, addSerializedData, &serializeBuffer);
+    int result = vicrabcrashjson_beginObject(&context, NULL);
+    result |= vicrabcrashjson_addIntegerElement(&context, VicrabCrashField_ImageAddress, (int64_t)image->address);
+    result |= vicrabcrashjson_addIntegerElement(&context, VicrabCrashField_ImageVmAddress, (int64_t)image->vmAddress);
+    result |= vicrabcrashjson_addIntegerElement(&context, VicrabCrashField_ImageSize, (int64_t)image->size);
+    result |= vicrabcrashjson_addStringElement(&context, VicrabCrashField_Name, image->name, VicrabCrashJSON_SIZE_AUTOMATIC);
+    if(image->uuid == NULL)
+    {
+        result |= vicrabcrashjson_addNullElement(&context, VicrabCrashField_UUID);
+    }
+    else
+    {
+        char uuidBuffer[37];
+        int uuidLength = formatUUID(image->uuid, uuidBuffer);
+        result |= vicrabcrashjson_addStringElement(&context, VicrabCrashField_UUID, uuidBuffer, uuidLength);
+    }
+    result |= vicrabcrashjson_addIntegerElement(&context, VicrabCrashField_CPUType, image->cpuType);
+    result |= vicrabcrashjson_addIntegerElement(&context, VicrabCrashField_CPUSubType, image->cpuSubType);
+    result |= vicrabcrashjson_addIntegerElement(&context, VicrabCrashField_ImageMajorVersion, (int64_t)image->majorVersion);
+    result |= vicrabcrashjson_addIntegerElement(&context, VicrabCrashField_ImageMinorVersion, (int64_t)image->minorVersion);
+    result |= vicrabcrashjson_addIntegerElement(&context, VicrabCrashField_ImageRevisionVersion, (int64_t)image->revisionVersion);
+    result |= vicrabcrashjson_endEncode(&context);
+    return result == VicrabCrashJSON_OK ? serializeBuffer.length : -1;
+}
+
+static void onBinaryImageAdded(const VicrabCrashBinaryImage* const image)
+{
+    char buffer[kMaxSerializedImageLength];
+    int length = serializeBinaryImage(image, buffer, sizeof(buffer));
+    if(length <= 0)
+    {
+        VicrabCrashLOG_ERROR("Could not serialize binary image %s", image->name);
+        return;
+    }
+
+    BinaryImageNode* node = malloc(sizeof(*node) + (size_t)length);
+    if(node == NULL)
+    {
+        VicrabCrashLOG_ERROR("Could not allocate binary image node");
+        return;
+    }
+    node->next = NULL;
+    node->address = image->address;
+    node->length = length;
+    node->nextRetired = NULL;
+    node->retireEpoch = 0;
+    memcpy(node->json, buffer, (size_t)length);
+
+    pthread_mutex_lock(&g_binaryImagesMutex);
+    if(g_binaryImagesTail != NULL)
+    {
+        // Publish only after the node is fully initialized.
+        g_binaryImagesTail->next = node;
+        g_binaryImagesTail = node;
+    }
+    else
+    {
+        free(node);
+    }
+    pthread_mutex_unlock(&g_binaryImagesMutex);
+}
+
+/** Free the removed nodes that no reader can still be on.
+ * Call with g_binaryImagesMutex held.
+ */
+static void freeRetiredBinaryImages()
+{
+    // Two steps take every reader that could have seen a node retired in the
+    // current epoch out of the picture, if none of them is still walking.
+    advanceEpoch(&g_binaryImagesEpoch);
+    advanceEpoch(&g_binaryImagesEpoch);
+    const uint64_t epoch = atomic_load(&g_binaryImagesEpoch.epoch);
+
+    BinaryImageNode** link = &g_retiredBinaryImages;
+    while(*link != NULL)
+    {
+        BinaryImageNode* node = *link;
+        if(node->retireEpoch + 2 <= epoch)
+        {
+            *link = node->nextRetired;
+            free(node);
+        }
+        else
         {
-            if(g_allMachThreads[i] == thread)
+            link = &node->nextRetired;
+        }
+    }
+}
+
+static void onBinaryImageRemoved(const uint64_t imageAddress)
+{
+    pthread_mutex_lock(&g_binaryImagesMutex);
+    BinaryImageNode* previous = g_binaryImagesHead;
+    BinaryImageNode* node = previous == NULL ? NULL : previous->next;
+    for(; node != NULL; previous = node, node = node->next)
+    {
+        if(node->address == imageAddress)
+        {
+            // Readers already on the node carry on through its next pointer.
+            previous->next = node->next;
+            if(g_binaryImagesTail == node)
             {
-                return g_allQueueNames[i];
+                g_binaryImagesTail = previous;
             }
+            node->retireEpoch = atomic_load(&g_binaryImagesEpoch.epoch);
+            node->nextRetired = g_retiredBinaryImages;
+            g_retiredBinaryImages = node;
+            break;
         }
     }
-    return NULL;
+    freeRetiredBinaryImages();
+    pthread_mutex_unlock(&g_binaryImagesMutex);
+}
+
+#if VicrabCrashCRASH_HOST_APPLE
+static VicrabCrashBinaryImageAddedCallback g_dyldOnAdded;
+static VicrabCrashBinaryImageRemovedCallback g_dyldOnRemoved;
+
+static void onDyldImageAdded(const struct mach_header* header, __unused intptr_t slide)
+{
+    Dl_info info;
+    if(dladdr(header, &info) == 0)
+    {
+        return;
+    }
+    VicrabCrashBinaryImage image = {0};
+    if(vicrabcrashdl_getBinaryImageForHeader(header, info.dli_fname, &image))
+    {
+        g_dyldOnAdded(&image);
+    }
+}
+
+static void onDyldImageRemoved(const struct mach_header* header, __unused intptr_t slide)
+{
+    g_dyldOnRemoved((uint64_t)header);
+}
+
+static void startDyldProvider(VicrabCrashBinaryImageAddedCallback onAdded,
+                              VicrabCrashBinaryImageRemovedCallback onRemoved)
+{
+    static bool isRegistered = false;
+    g_dyldOnAdded = onAdded;
+    g_dyldOnRemoved = onRemoved;
+    if(!isRegistered)
+    {
+        // dyld calls back immediately for every image that is already loaded.
+        isRegistered = true;
+        _dyld_register_func_for_add_image(onDyldImageAdded);
+        _dyld_register_func_for_remove_image(onDyldImageRemoved);
+        return;
+    }
+
+    const uint32_t imageCount = _dyld_image_count();
+    for(uint32_t iImg = 0; iImg < imageCount; iImg++)
+    {
+        onDyldImageAdded(_dyld_get_image_header(iImg), 0);
+    }
+}
+
+static const VicrabCrashBinaryImageProvider g_dyldProvider =
+{
+    .start = startDyldProvider,
+};
+#elif VicrabCrashCRASH_HOST_LINUX
+/** The Linux loader has no add/remove notifications, so the provider diffs
+ * dl_iterate_phdr() against the images it has already reported whenever the
+ * loader's add/remove counters change. The cached data thread polls this.
+ */
+static VicrabCrashBinaryImageAddedCallback g_loaderOnAdded;
+static VicrabCrashBinaryImageRemovedCallback g_loaderOnRemoved;
+static pthread_mutex_t g_loaderMutex = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t* g_loaderImages;
+static bool* g_loaderImagesSeen;
+static int g_loaderImagesCount;
+static int g_loaderImagesCapacity;
+static unsigned long long g_loaderAdds;
+static unsigned long long g_loaderSubs;
+
+static int readLoaderCounters(struct dl_phdr_info* info, size_t size, void* data)
+{
+    unsigned long long* counters = data;
+    if(size >= offsetof(struct dl_phdr_info, dlpi_subs) + sizeof(info->dlpi_subs))
+    {
+        counters[0] = info->dlpi_adds;
+        counters[1] = info->dlpi_subs;
+    }
+    return 1;
+}
+
+static int onLoaderImage(struct dl_phdr_info* info, __attribute__((unused)) size_t size, __attribute__((unused)) void* data)
+{
+    uintptr_t header = 0;
+    for(int i = 0; i < info->dlpi_phnum; i++)
+    {
+        if(info->dlpi_phdr[i].p_type == PT_LOAD && info->dlpi_phdr[i].p_offset == 0)
+        {
+            header = (uintptr_t)(info->dlpi_addr + info->dlpi_phdr[i].p_vaddr);
+            break;
+        }
+    }
+    if(header == 0)
+    {
+        return 0;
+    }
+
+    for(int i = 0; i < g_loaderImagesCount; i++)
+    {
+        if(g_loaderImages[i] == header)
+        {
+            g_loaderImagesSeen[i] = true;
+            return 0;
+        }
+    }
+
+    if(g_loaderImagesCount == g_loaderImagesCapacity)
+    {
+        int capacity = g_loaderImagesCapacity == 0 ? 64 : g_loaderImagesCapacity * 2;
+        uint64_t* images = realloc(g_loaderImages, sizeof(*images) * (size_t)capacity);
+        if(images == NULL)
+        {
+            return 0;
+        }
+        g_loaderImages = images;
+        bool* seen = realloc(g_loaderImagesSeen, sizeof(*seen) * (size_t)capacity);
+        if(seen == NULL)
+        {
+            return 0;
+        }
+        g_loaderImagesSeen = seen;
+        g_loaderImagesCapacity = capacity;
+    }
+    g_loaderImages[g_loaderImagesCount] = header;
+    g_loaderImagesSeen[g_loaderImagesCount] = true;
+    g_loaderImagesCount++;
+
+    const char* name = info->dlpi_name;
+    if(name == NULL || name[0] == '\0')
+    {
+        name = program_invocation_name;
+    }
+    VicrabCrashBinaryImage image = {0};
+    if(vicrabcrashdl_getBinaryImageForHeader((const void*)header, name, &image))
+    {
+        g_loaderOnAdded(&image);
+    }
+    return 0;
+}
+
+static void rescanLoaderImages()
+{
+    for(int i = 0; i < g_loaderImagesCount; i++)
+    {
+        g_loaderImagesSeen[i] = false;
+    }
+    dl_iterate_phdr(onLoaderImage, NULL);
+
+    int liveCount = 0;
+    for(int i = 0; i < g_loaderImagesCount; i++)
+    {
+        if(g_loaderImagesSeen[i])
+        {
+            g_loaderImages[liveCount++] = g_loaderImages[i];
+        }
+        else
+        {
+            g_loaderOnRemoved(g_loaderImages[i]);
+        }
+    }
+    g_loaderImagesCount = liveCount;
+}
+
+static void pollLoaderImages()
+{
+    pthread_mutex_lock(&g_loaderMutex);
+    if(g_loaderOnAdded != NULL)
+    {
+        unsigned long long counters[2] = {0};
+        dl_iterate_phdr(readLoaderCounters, counters);
+        if(counters[0] != g_loaderAdds || counters[1] != g_loaderSubs)
+        {
+            g_loaderAdds = counters[0];
+            g_loaderSubs = counters[1];
+            rescanLoaderImages();
+        }
+    }
+    pthread_mutex_unlock(&g_loaderMutex);
+}
+
+static void startLoaderProvider(VicrabCrashBinaryImageAddedCallback onAdded,
+                                VicrabCrashBinaryImageRemovedCallback onRemoved)
+{
+    pthread_mutex_lock(&g_loaderMutex);
+    g_loaderOnAdded = onAdded;
+    g_loaderOnRemoved = onRemoved;
+    g_loaderImagesCount = 0;
+    unsigned long long counters[2] = {0};
+    dl_iterate_phdr(readLoaderCounters, counters);
+    g_loaderAdds = counters[0];
+    g_loaderSubs = counters[1];
+    rescanLoaderImages();
+    pthread_mutex_unlock(&g_loaderMutex);
+}
+
+static const VicrabCrashBinaryImageProvider g_dyldProvider =
+{
+    .start = startLoaderProvider,
+};
+#endif
+
+void vicrabcrashccd_initBinaryImages(const VicrabCrashBinaryImageProvider* provider)
+{
+    if(provider == NULL)
+    {
+        provider = &g_dyldProvider;
+    }
+
+    BinaryImageNode* head = calloc(1, sizeof(*head));
+    if(head == NULL)
+    {
+        VicrabCrashLOG_ERROR("Could not allocate binary image list");
+        return;
+    }
+
+    // Any previous list is abandoned rather than freed, since a crash handler
+    // may still be walking it.
+    pthread_mutex_lock(&g_binaryImagesMutex);
+    g_binaryImagesTail = head;
+    g_binaryImagesHead = head;
+    pthread_mutex_unlock(&g_binaryImagesMutex);
+
+    provider->start(onBinaryImageAdded, onBinaryImageRemoved);
+}
+
+bool vicrabcrashccd_enumerateBinaryImages(void (*callback)(const char* json, int length, void* userData),
+                                          void* userData)
+{
+    BinaryImageNode* head = g_binaryImagesHead;
+    if(head == NULL)
+    {
+        return false;
+    }
+
+    uint64_t epoch = enterEpoch(&g_binaryImagesEpoch);
+    for(BinaryImageNode* node = head->next; node != NULL; node = node->next)
+    {
+        callback(node->json, node->length, userData);
+    }
+    leaveEpoch(&g_binaryImagesEpoch, epoch);
+    return true;
 }
@@ -28,6 +28,7 @@
 
 
 #include "VicrabCrashThread.h"
+#include "VicrabCrashDynamicLinker.h"
 
 void vicrabcrashccd_init(int pollingIntervalInSeconds);
 
@@ -39,3 +40,44 @@ VicrabCrashThread* vicrabcrashccd_getAllThreads(int* threadCount);
 const char* vicrabcrashccd_getThreadName(VicrabCrashThread thread);
 
 const char* vicrabcrashccd_getQueueName(VicrabCrashThread thread);
+
+
+#pragma mark - Binary Images -
+
+typedef void (*VicrabCrashBinaryImageAddedCallback)(const VicrabCrashBinaryImage* image);
+typedef void (*VicrabCrashBinaryImageRemovedCallback)(uint64_t imageAddress);
+
+/** A source of binary image load and unload events.
+ * The default provider is backed by dyld. Tests can supply a stand-in.
+ */
+typedef struct
+{
+    /** Start delivering events. onAdded must also be called for every image
+     * that is already loaded at the time this is called.
+     */
+    void (*start)(VicrabCrashBinaryImageAddedCallback onAdded,
+                  VicrabCrashBinaryImageRemovedCallback onRemoved);
+} VicrabCrashBinaryImageProvider;
+
+/** Start maintaining a pre-serialized list of loaded binary images.
+ * Each image is encoded as a JSON object once, when it is loaded, so that
+ * writing the binary images section of a report only has to copy bytes.
+ *
+ * Calling this again replaces the cached list.
+ *
+ * @param provider The source of image events (NULL = use dyld).
+ */
+void vicrabcrashccd_initBinaryImages(const VicrabCrashBinaryImageProvider* provider);
+
+/** Visit every currently loaded binary image in load order.
+ *
+ * This function is async-safe.
+ *
+ * @param callback Called with each image's pre-serialized JSON object.
+ *
+ * @param userData Passed through to the callback.
+ *
+ * @return false if the binary image cache has not been initialized.
+ */
+bool vicrabcrashccd_enumerateBinaryImages(void (*callback)(const char* json, int length, void* userData),
+                                          void* userData);
@@ -0,0 +1,441 @@
+//
+//  VicrabCrashConsoleCapture.c
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#include "VicrabCrashConsoleCapture.h"
+
+#include "VicrabCrashMachineContext.h"
+#include "VicrabCrashMemory.h"
+#include "VicrabCrashThread.h"
+
+//#define VicrabCrashLogger_LocalLevel TRACE
+#include "VicrabCrashLogger.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+
+// ============================================================================
+#pragma mark - Constants -
+// ============================================================================
+
+/** Longest line passed to vicrabcrashconsole_forEachLine() callbacks. */
+#define kMaxLineLength 1024
+
+/** How much of the ring is copied out at a time. */
+#define kCopyChunkSize 4096
+
+/** How long the reader waits before checking whether it should stop. */
+#define kPollTimeoutMilliseconds 250
+
+
+// ============================================================================
+#pragma mark - Globals -
+// ============================================================================
+
+typedef struct
+{
+    /** The descriptor being captured (stdout or stderr). */
+    int capturedFD;
+    /** A duplicate of where capturedFD pointed before capturing. */
+    int originalFD;
+    /** The end of the pipe the reader thread reads from. */
+    int readFD;
+} CapturedStream;
+
+static char g_ringBytes[VicrabCrashCONSOLE_MAX_CAPTURE_SIZE];
+static VicrabCrashConsoleCapture g_capture = {.bytes = g_ringBytes};
+
+static CapturedStream g_streams[2];
+static bool g_isCapturing = false;
+static atomic_bool g_shouldStopReader;
+static pthread_t g_readerThread;
+static pthread_mutex_t g_captureMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** Held by whoever is adding to the ring. */
+static atomic_flag g_ringLock = ATOMIC_FLAG_INIT;
+
+/** The stream that last added to the ring, and whether it ended a line. */
+static const CapturedStream* g_lastStream;
+static bool g_isAtLineStart = true;
+
+
+// ============================================================================
+#pragma mark - Ring -
+// ============================================================================
+
+/** Add bytes to the ring. Must be called with g_ringLock held. */
+static void appendToRing(const char* bytes, int length)
+{
+    const uint32_t capacity = g_capture.capacity;
+    if((uint32_t)length > capacity)
+    {
+        bytes += (uint32_t)length - capacity;
+        length = (int)capacity;
+    }
+    uint64_t position = atomic_load_explicit(&g_capture.committed, memory_order_relaxed);
+    atomic_store_explicit(&g_capture.reserved, position + (uint64_t)length, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    while(length > 0)
+    {
+        const uint32_t offset = (uint32_t)(position % capacity);
+        int copyLength = (int)(capacity - offset);
+        if(copyLength > length)
+        {
+            copyLength = length;
+        }
+        memcpy(g_capture.bytes + offset, bytes, (size_t)copyLength);
+        bytes += copyLength;
+        length -= copyLength;
+        position += (uint64_t)copyLength;
+    }
+    atomic_store_explicit(&g_capture.committed, position, memory_order_release);
+}
+
+/** Pass output on to where the stream was going before we captured it. */
+static void writeToOriginal(const CapturedStream* const stream, const char* bytes, int length)
+{
+    while(length > 0)
+    {
+        ssize_t bytesWritten = write(stream->originalFD, bytes, (size_t)length);
+        if(bytesWritten < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            return;
+        }
+        bytes += bytesWritten;
+        length -= (int)bytesWritten;
+    }
+}
+
+/** Read whatever is available from a stream's pipe into the ring.
+ *
+ * @return false if the pipe was closed.
+ */
+static bool drainStream(const CapturedStream* const stream)
+{
+    char buffer[4096];
+    for(;;)
+    {
+        ssize_t bytesRead = read(stream->readFD, buffer, sizeof(buffer));
+        if(bytesRead > 0)
+        {
+            if(stream != g_lastStream && !g_isAtLineStart)
+            {
+                // Don't glue the other stream's unfinished line onto this one.
+                appendToRing("\n", 1);
+            }
+            g_lastStream = stream;
+            g_isAtLineStart = buffer[bytesRead - 1] == '\n';
+            appendToRing(buffer, (int)bytesRead);
+            writeToOriginal(stream, buffer, (int)bytesRead);
+            continue;
+        }
+        if(bytesRead < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        return bytesRead != 0;
+    }
+}
+
+
+// ============================================================================
+#pragma mark - Reader Thread -
+// ============================================================================
+
+static void* runReader(__unused void* userData)
+{
+    // Keep draining while a crash is handled, so that nothing writing to
+    // stdout or stderr blocks on a full pipe.
+    vicrabcrashmc_addReservedThread(vicrabcrashthread_self());
+
+    struct pollfd pollFDs[2];
+    for(int i = 0; i < 2; i++)
+    {
+        pollFDs[i].fd = g_streams[i].readFD;
+        pollFDs[i].events = POLLIN;
+    }
+
+    while(!atomic_load(&g_shouldStopReader))
+    {
+        int result = poll(pollFDs, 2, kPollTimeoutMilliseconds);
+        if(result <= 0)
+        {
+            continue;
+        }
+        for(int i = 0; i < 2; i++)
+        {
+            if(pollFDs[i].revents == 0)
+            {
+                continue;
+            }
+            while(atomic_flag_test_and_set_explicit(&g_ringLock, memory_order_acquire))
+            {
+                // A crash handler is draining the pipes.
+            }
+            bool isOpen = drainStream(&g_streams[i]);
+            atomic_flag_clear_explicit(&g_ringLock, memory_order_release);
+            if(!isOpen)
+            {
+                // Nothing more will come from this one.
+                pollFDs[i].fd = -1;
+            }
+        }
+    }
+
+    // Pick up whatever was written just before capturing stopped.
+    while(atomic_flag_test_and_set_explicit(&g_ringLock, memory_order_acquire))
+    {
+    }
+    drainStream(&g_streams[0]);
+    drainStream(&g_streams[1]);
+    atomic_flag_clear_explicit(&g_ringLock, memory_order_release);
+    return NULL;
+}
+
+/** Redirect a descriptor into a new pipe.
+ *
+ * @return true if the descriptor now writes to the pipe.
+ */
+static bool captureStream(CapturedStream* const stream, int fd)
+{
+    int pipeFDs[2];
+    if(pipe(pipeFDs) != 0)
+    {
+        VicrabCrashLOG_ERROR("pipe: %s", strerror(errno));
+        return false;
+    }
+    stream->capturedFD = fd;
+    stream->originalFD = dup(fd);
+    stream->readFD = pipeFDs[0];
+    if(stream->originalFD < 0 || dup2(pipeFDs[1], fd) < 0)
+    {
+        VicrabCrashLOG_ERROR("Could not redirect fd %d: %s", fd, strerror(errno));
+        if(stream->originalFD >= 0)
+        {
+            close(stream->originalFD);
+        }
+        close(pipeFDs[0]);
+        close(pipeFDs[1]);
+        return false;
+    }
+    close(pipeFDs[1]);
+    fcntl(stream->readFD, F_SETFD, FD_CLOEXEC);
+    fcntl(stream->originalFD, F_SETFD, FD_CLOEXEC);
+    // Crash handlers drain the pipe without blocking.
+    fcntl(stream->readFD, F_SETFL, fcntl(stream->readFD, F_GETFL) | O_NONBLOCK);
+    return true;
+}
+
+/** Point a descriptor back where it was and close the pipe's write end. */
+static void releaseStream(CapturedStream* const stream)
+{
+    dup2(stream->originalFD, stream->capturedFD);
+    close(stream->originalFD);
+}
+
+
+// ============================================================================
+#pragma mark - API -
+// ============================================================================
+
+bool vicrabcrashconsole_start(int captureSize)
+{
+    pthread_mutex_lock(&g_captureMutex);
+    if(!g_isCapturing && captureSize > 0)
+    {
+        if(captureSize > VicrabCrashCONSOLE_MAX_CAPTURE_SIZE)
+        {
+            captureSize = VicrabCrashCONSOLE_MAX_CAPTURE_SIZE;
+        }
+        g_capture.capacity = (uint32_t)captureSize;
+        atomic_store(&g_capture.committed, 0);
+        atomic_store(&g_capture.reserved, 0);
+        g_lastStream = NULL;
+        g_isAtLineStart = true;
+
+        fflush(stdout);
+        fflush(stderr);
+        if(captureStream(&g_streams[0], STDOUT_FILENO))
+        {
+            if(captureStream(&g_streams[1], STDERR_FILENO))
+            {
+                setvbuf(stdout, NULL, _IOLBF, 0);
+                atomic_store(&g_shouldStopReader, false);
+                int error = pthread_create(&g_readerThread, NULL, &runReader, NULL);
+                if(error == 0)
+                {
+                    g_isCapturing = true;
+                }
+                else
+                {
+                    releaseStream(&g_streams[1]);
+                    close(g_streams[1].readFD);
+                    releaseStream(&g_streams[0]);
+                    close(g_streams[0].readFD);
+                    VicrabCrashLOG_ERROR("pthread_create: %s", strerror(error));
+                }
+            }
+            else
+            {
+                releaseStream(&g_streams[0]);
+                close(g_streams[0].readFD);
+            }
+        }
+    }
+    bool isCapturing = g_isCapturing;
+    pthread_mutex_unlock(&g_captureMutex);
+    return isCapturing;
+}
+
+void vicrabcrashconsole_stop(void)
+{
+    pthread_mutex_lock(&g_captureMutex);
+    if(g_isCapturing)
+    {
+        fflush(stdout);
+        fflush(stderr);
+        // Closing the write ends lets the reader pick up the last of the
+        // output before it sees the stop flag.
+        releaseStream(&g_streams[0]);
+        releaseStream(&g_streams[1]);
+        atomic_store(&g_shouldStopReader, true);
+        pthread_join(g_readerThread, NULL);
+        close(g_streams[0].readFD);
+        close(g_streams[1].readFD);
+        g_isCapturing = false;
+    }
+    pthread_mutex_unlock(&g_captureMutex);
+}
+
+const VicrabCrashConsoleCapture* vicrabcrashconsole_getCapture(void)
+{
+    return g_isCapturing ? &g_capture : NULL;
+}
+
+void vicrabcrashconsole_drainPipes(void)
+{
+    if(!g_isCapturing || atomic_flag_test_and_set_explicit(&g_ringLock, memory_order_acquire))
+    {
+        return;
+    }
+    drainStream(&g_streams[0]);
+    drainStream(&g_streams[1]);
+    atomic_flag_clear_explicit(&g_ringLock, memory_order_release);
+}
+
+void vicrabcrashconsole_forEachLine(const VicrabCrashConsoleCapture* const capture,
+                                    void (*onLine)(const char* line, void* context),
+                                    void* const context)
+{
+    VicrabCrashConsoleCapture header;
+    if(capture == NULL || !vicrabcrashmem_copySafely(capture, &header, sizeof(header)) || header.capacity == 0)
+    {
+        return;
+    }
+    uint64_t end = atomic_load(&header.committed);
+    uint64_t position = end > header.capacity ? end - header.capacity : 0;
+    bool isSkippingPartialLine = position > 0;
+
+    char chunk[kCopyChunkSize];
+    char line[kMaxLineLength];
+    int lineLength = 0;
+    while(position < end)
+    {
+        const uint32_t offset = (uint32_t)(position % header.capacity);
+        uint64_t chunkLength = header.capacity - offset;
+        if(chunkLength > end - position)
+        {
+            chunkLength = end - position;
+        }
+        if(chunkLength > sizeof(chunk))
+        {
+            chunkLength = sizeof(chunk);
+        }
+        if(!vicrabcrashmem_copySafely(header.bytes + offset, chunk, (int)chunkLength))
+        {
+            return;
+        }
+
+        // If the writer has since lapped this part of the ring, what we
+        // copied is newer output. Resume at the oldest byte still intact,
+        // and take in what was added since.
+        VicrabCrashConsoleCapture latest;
+        if(!vicrabcrashmem_copySafely(capture, &latest, sizeof(latest)))
+        {
+            return;
+        }
+        const uint64_t reserved = atomic_load(&latest.reserved);
+        if(reserved > position + header.capacity)
+        {
+            position = reserved - header.capacity;
+            const uint64_t committed = atomic_load(&latest.committed);
+            if(committed > end)
+            {
+                end = committed;
+            }
+            lineLength = 0;
+            isSkippingPartialLine = true;
+            continue;
+        }
+
+        for(uint64_t i = 0; i < chunkLength; i++)
+        {
+            const char ch = chunk[i];
+            if(isSkippingPartialLine)
+            {
+                isSkippingPartialLine = ch != '\n';
+                continue;
+            }
+            if(ch == '\n' || lineLength == kMaxLineLength - 1)
+            {
+                line[lineLength] = '\0';
+                onLine(line, context);
+                lineLength = 0;
+                if(ch == '\n')
+                {
+                    continue;
+                }
+            }
+            line[lineLength++] = ch;
+        }
+        position += chunkLength;
+    }
+    if(lineLength > 0)
+    {
+        line[lineLength] = '\0';
+        onLine(line, context);
+    }
+}
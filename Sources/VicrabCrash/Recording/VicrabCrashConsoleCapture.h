@@ -0,0 +1,118 @@
+//
+//  VicrabCrashConsoleCapture.h
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+
+/* Tees the process's stdout and stderr into a fixed-size ring in memory.
+ *
+ * Both descriptors are redirected into pipes. A reader thread copies what
+ * arrives into the ring and on to the original descriptors, so the console
+ * still shows everything. At crash time the newest output can be taken
+ * straight from the ring, without touching the file system.
+ */
+
+
+#ifndef HDR_VicrabCrashConsoleCapture_h
+#define HDR_VicrabCrashConsoleCapture_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/** The largest ring that can be requested. */
+#define VicrabCrashCONSOLE_MAX_CAPTURE_SIZE (256 * 1024)
+
+typedef struct VicrabCrashConsoleCapture
+{
+    /** Total bytes ever written into the ring. The newest byte is at
+     * bytes[(committed - 1) % capacity]. */
+    _Atomic uint64_t committed;
+
+    /** Advanced before bytes are written, so a reader can tell which part of
+     * what it copied may have been overwritten in the meantime. */
+    _Atomic uint64_t reserved;
+
+    /** Size of the ring in bytes. */
+    uint32_t capacity;
+
+    /** The ring itself. */
+    char* bytes;
+} VicrabCrashConsoleCapture;
+
+/** Start capturing stdout and stderr. Does nothing if already capturing.
+ *
+ * stdout is switched to line buffering, since it would otherwise become
+ * fully buffered once it's a pipe.
+ *
+ * @param captureSize How many of the newest bytes to keep. Clamped to
+ *                    VicrabCrashCONSOLE_MAX_CAPTURE_SIZE.
+ *
+ * @return true if capturing.
+ */
+bool vicrabcrashconsole_start(int captureSize);
+
+/** Stop capturing, and give stdout and stderr back their original targets.
+ */
+void vicrabcrashconsole_stop(void);
+
+/** Get the ring being captured into.
+ *
+ * @return The ring, or NULL if not capturing.
+ */
+const VicrabCrashConsoleCapture* vicrabcrashconsole_getCapture(void);
+
+/** Move output still sitting in the pipes into the ring. Async-safe.
+ * Call this when handling a crash, since the reader thread may not get to it.
+ * Does nothing if the reader thread is in the middle of adding to the ring.
+ */
+void vicrabcrashconsole_drainPipes(void);
+
+/** Pass each line of a ring to a callback, oldest first. Async-safe.
+ * The ring is read with vicrabcrashmem_copySafely(), so it may belong to the
+ * process vicrabcrashmem is targeting. A line cut off by the start of the
+ * ring is skipped, and overlong lines are split.
+ *
+ * @param capture The ring, as returned by vicrabcrashconsole_getCapture().
+ *
+ * @param onLine Called with each line, without its newline.
+ *
+ * @param context Passed through to onLine.
+ */
+void vicrabcrashconsole_forEachLine(const VicrabCrashConsoleCapture* capture,
+                                    void (*onLine)(const char* line, void* context),
+                                    void* context);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HDR_VicrabCrashConsoleCapture_h
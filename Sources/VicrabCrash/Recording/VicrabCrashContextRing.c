@@ -0,0 +1,475 @@
+//
+//  VicrabCrashContextRing.c
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#include "VicrabCrashContextRing.h"
+
+#include "VicrabCrashDebug.h"
+#include "VicrabCrashID.h"
+#include "VicrabCrashMonitorContext.h"
+#include "VicrabCrashReport.h"
+#include "VicrabCrashReportFields.h"
+#include "VicrabCrashReportStore.h"
+#include "VicrabCrashReportWriter.h"
+
+//#define VicrabCrashLogger_LocalLevel TRACE
+#include "VicrabCrashLogger.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+
+// ============================================================================
+#pragma mark - Constants -
+// ============================================================================
+
+#define kMagic 0x78746376 // "vctx"
+#define kFormatVersion 1
+
+#define kStatusRunning 1
+#define kStatusExited 2
+#define kStatusHandled 3
+
+#define kMaxSystemStringLength 128
+#define kMaxUserInfoLength (16 * 1024)
+#define kEventCount 32
+#define kMaxEventCategoryLength 32
+#define kMaxEventMessageLength 216
+
+#define kTerminationReason "The process ended without running a crash handler, " \
+                           "for example because it was killed for using too much memory."
+
+#define SYSTEM_STRING_FIELDS(F) \
+    F(systemName) F(systemVersion) F(machine) F(model) F(kernelVersion) \
+    F(osVersion) F(bootTime) F(appStartTime) F(executablePath) \
+    F(executableName) F(bundleID) F(bundleName) F(bundleVersion) \
+    F(bundleShortVersion) F(appID) F(cpuArchitecture) F(timezone) \
+    F(processName) F(deviceAppHash) F(buildType)
+
+#define SYSTEM_VALUE_FIELDS(F) \
+    F(isJailbroken) F(cpuType) F(cpuSubType) F(binaryCPUType) \
+    F(binaryCPUSubType) F(processID) F(parentProcessID) F(storageSize) \
+    F(memorySize) F(freeMemory) F(usableMemory) F(freeStorage) F(cpuLoad)
+
+#define APP_STATE_FIELDS(F) \
+    F(activeDurationSinceLastCrash) F(backgroundDurationSinceLastCrash) \
+    F(launchesSinceLastCrash) F(sessionsSinceLastCrash) \
+    F(activeDurationSinceLaunch) F(backgroundDurationSinceLaunch) \
+    F(sessionsSinceLaunch) F(crashedLastLaunch) F(crashedThisLaunch) \
+    F(appStateTransitionTime) F(applicationIsActive) F(applicationIsInForeground)
+
+
+// ============================================================================
+#pragma mark - Types -
+// ============================================================================
+
+#define DECLARE_STRING(NAME) char NAME[kMaxSystemStringLength];
+#define DECLARE_VALUE(NAME) __typeof__(((VicrabCrash_MonitorContext*)0)->System.NAME) NAME;
+#define DECLARE_APP_STATE(NAME) __typeof__(((VicrabCrash_MonitorContext*)0)->AppState.NAME) NAME;
+
+typedef struct
+{
+    SYSTEM_STRING_FIELDS(DECLARE_STRING)
+    SYSTEM_VALUE_FIELDS(DECLARE_VALUE)
+} SystemSnapshot;
+
+typedef struct
+{
+    APP_STATE_FIELDS(DECLARE_APP_STATE)
+} AppStateSnapshot;
+
+/** Every section is guarded by a sequence number that is odd while the
+ * section is being written. A process that dies mid-write leaves it odd,
+ * and the section is then ignored.
+ */
+typedef struct
+{
+    _Atomic(uint32_t) sequence;
+    int64_t timestamp;
+    char category[kMaxEventCategoryLength];
+    char message[kMaxEventMessageLength];
+} ContextEvent;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    _Atomic(uint32_t) status;
+    int32_t processID;
+    bool isBeingTraced;
+    _Atomic(int64_t) lastUpdate;
+
+    _Atomic(uint32_t) systemSequence;
+    SystemSnapshot system;
+
+    _Atomic(uint32_t) appStateSequence;
+    bool hasAppState;
+    AppStateSnapshot appState;
+
+    _Atomic(uint32_t) userInfoSequence;
+    bool hasUserInfo;
+    char userInfo[kMaxUserInfoLength];
+
+    _Atomic(uint32_t) nextEvent;
+    ContextEvent events[kEventCount];
+} ContextRegion;
+
+
+// ============================================================================
+#pragma mark - Globals -
+// ============================================================================
+
+static ContextRegion* g_region = NULL;
+
+/** Serializes writers of each section within this process. */
+static atomic_flag g_systemLock = ATOMIC_FLAG_INIT;
+static atomic_flag g_appStateLock = ATOMIC_FLAG_INIT;
+static atomic_flag g_userInfoLock = ATOMIC_FLAG_INIT;
+
+/** The previous launch's region, while its report is being written. */
+static const ContextRegion* g_previousRegion = NULL;
+
+
+// ============================================================================
+#pragma mark - Utility -
+// ============================================================================
+
+static void lock(atomic_flag* flag)
+{
+    while(atomic_flag_test_and_set_explicit(flag, memory_order_acquire))
+    {
+    }
+}
+
+static void unlock(atomic_flag* flag)
+{
+    atomic_flag_clear_explicit(flag, memory_order_release);
+}
+
+static void beginWrite(_Atomic(uint32_t)* sequence)
+{
+    atomic_fetch_add_explicit(sequence, 1, memory_order_acq_rel);
+}
+
+static void endWrite(_Atomic(uint32_t)* sequence)
+{
+    atomic_fetch_add_explicit(sequence, 1, memory_order_acq_rel);
+    atomic_store_explicit(&g_region->lastUpdate, (int64_t)time(NULL), memory_order_relaxed);
+}
+
+static bool isComplete(const _Atomic(uint32_t)* sequence)
+{
+    return (atomic_load(sequence) & 1) == 0;
+}
+
+static void copyString(char* dst, const char* src, size_t dstLength)
+{
+    if(src == NULL)
+    {
+        dst[0] = '\0';
+        return;
+    }
+    size_t length = strnlen(src, dstLength - 1);
+    memcpy(dst, src, length);
+    dst[length] = '\0';
+}
+
+
+// ============================================================================
+#pragma mark - Previous Launch -
+// ============================================================================
+
+static void writeRecentEvents(const VicrabCrashReportWriter* writer)
+{
+    const ContextRegion* region = g_previousRegion;
+    uint32_t eventCount = atomic_load(&region->nextEvent);
+    uint32_t first = eventCount > kEventCount ? eventCount - kEventCount : 0;
+    for(uint32_t i = first; i < eventCount; i++)
+    {
+        const ContextEvent* event = &region->events[i % kEventCount];
+        if(!isComplete(&event->sequence) || event->category[0] == '\0')
+        {
+            continue;
+        }
+        writer->beginObject(writer, NULL);
+        {
+            writer->addIntegerElement(writer, VicrabCrashField_Timestamp, event->timestamp);
+            writer->addStringElement(writer, VicrabCrashField_EventCategory, event->category);
+            if(event->message[0] != '\0')
+            {
+                writer->addStringElement(writer, VicrabCrashField_EventMessage, event->message);
+            }
+        }
+        writer->endContainer(writer);
+    }
+}
+
+/** Decide whether the launch that left this region ended in a way that
+ * deserves a report.
+ */
+static bool endedUnexpectedly(const ContextRegion* region)
+{
+    if(region->magic != kMagic || region->version != kFormatVersion || region->size != sizeof(*region))
+    {
+        return false;
+    }
+    if(atomic_load(&region->status) != kStatusRunning || region->isBeingTraced)
+    {
+        return false;
+    }
+    // Background apps get killed all the time. Only a foreground kill is news.
+    bool hasAppState = isComplete(&region->appStateSequence) && region->hasAppState;
+    return !hasAppState || region->appState.applicationIsInForeground;
+}
+
+static void reportPreviousLaunch(ContextRegion* region)
+{
+    // Strings in the file may be unterminated if it was damaged.
+    ContextRegion* previous = malloc(sizeof(*previous));
+    if(previous == NULL)
+    {
+        return;
+    }
+    memcpy(previous, region, sizeof(*previous));
+
+    VicrabCrash_MonitorContext context;
+    memset(&context, 0, sizeof(context));
+    char eventID[37];
+    vicrabcrashid_generate(eventID);
+    context.eventID = eventID;
+    context.crashReason = kTerminationReason;
+
+    if(isComplete(&previous->systemSequence))
+    {
+#define LOAD_STRING(NAME) \
+        previous->system.NAME[kMaxSystemStringLength - 1] = '\0'; \
+        context.System.NAME = previous->system.NAME[0] != '\0' ? previous->system.NAME : NULL;
+#define LOAD_VALUE(NAME) context.System.NAME = previous->system.NAME;
+        SYSTEM_STRING_FIELDS(LOAD_STRING)
+        SYSTEM_VALUE_FIELDS(LOAD_VALUE)
+#undef LOAD_STRING
+#undef LOAD_VALUE
+    }
+    if(isComplete(&previous->appStateSequence) && previous->hasAppState)
+    {
+#define LOAD_APP_STATE(NAME) context.AppState.NAME = previous->appState.NAME;
+        APP_STATE_FIELDS(LOAD_APP_STATE)
+#undef LOAD_APP_STATE
+    }
+    const char* userInfoJSON = NULL;
+    if(isComplete(&previous->userInfoSequence) && previous->hasUserInfo)
+    {
+        previous->userInfo[kMaxUserInfoLength - 1] = '\0';
+        userInfoJSON = previous->userInfo;
+    }
+    for(int i = 0; i < kEventCount; i++)
+    {
+        previous->events[i].category[kMaxEventCategoryLength - 1] = '\0';
+        previous->events[i].message[kMaxEventMessageLength - 1] = '\0';
+    }
+
+    char path[VicrabCrashCRS_MAX_PATH_LENGTH];
+    vicrabcrashcrs_getNextCrashReportPath(path);
+    g_previousRegion = previous;
+    vicrabcrashreport_writeTerminationReport(&context,
+                                             atomic_load(&previous->lastUpdate),
+                                             userInfoJSON,
+                                             writeRecentEvents,
+                                             path);
+    g_previousRegion = NULL;
+    free(previous);
+}
+
+
+// ============================================================================
+#pragma mark - API -
+// ============================================================================
+
+static void onExit(void)
+{
+    vicrabcrashctx_notifyCleanExit();
+}
+
+bool vicrabcrashctx_initialize(const char* path)
+{
+    if(g_region != NULL)
+    {
+        return true;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if(fd < 0)
+    {
+        VicrabCrashLOG_ERROR("Could not open context file %s: %s", path, strerror(errno));
+        return false;
+    }
+    struct stat st;
+    bool hasPreviousRegion = fstat(fd, &st) == 0 && st.st_size == (off_t)sizeof(ContextRegion);
+    if(!hasPreviousRegion && ftruncate(fd, (off_t)sizeof(ContextRegion)) != 0)
+    {
+        VicrabCrashLOG_ERROR("Could not size context file %s: %s", path, strerror(errno));
+        close(fd);
+        return false;
+    }
+    void* mapping = mmap(NULL, sizeof(ContextRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED)
+    {
+        VicrabCrashLOG_ERROR("Could not map context file %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    ContextRegion* region = mapping;
+    if(hasPreviousRegion && endedUnexpectedly(region))
+    {
+        VicrabCrashLOG_INFO("Previous launch ended unexpectedly. Writing a report for it.");
+        reportPreviousLaunch(region);
+    }
+
+    memset(region, 0, sizeof(*region));
+    region->magic = kMagic;
+    region->version = kFormatVersion;
+    region->size = sizeof(*region);
+    region->processID = (int32_t)getpid();
+    region->isBeingTraced = vicrabcrashdebug_isBeingTraced();
+    atomic_store(&region->lastUpdate, (int64_t)time(NULL));
+    atomic_store(&region->status, kStatusRunning);
+    g_region = region;
+    static bool isExitHandlerInstalled = false;
+    if(!isExitHandlerInstalled)
+    {
+        atexit(onExit);
+        isExitHandlerInstalled = true;
+    }
+    return true;
+}
+
+void vicrabcrashctx_close(void)
+{
+    if(g_region != NULL)
+    {
+        ContextRegion* region = g_region;
+        g_region = NULL;
+        munmap(region, sizeof(*region));
+    }
+}
+
+void vicrabcrashctx_setSystemInfo(const VicrabCrash_MonitorContext* context)
+{
+    if(g_region == NULL)
+    {
+        return;
+    }
+    lock(&g_systemLock);
+    beginWrite(&g_region->systemSequence);
+#define STORE_STRING(NAME) copyString(g_region->system.NAME, context->System.NAME, kMaxSystemStringLength);
+#define STORE_VALUE(NAME) g_region->system.NAME = context->System.NAME;
+    SYSTEM_STRING_FIELDS(STORE_STRING)
+    SYSTEM_VALUE_FIELDS(STORE_VALUE)
+#undef STORE_STRING
+#undef STORE_VALUE
+    endWrite(&g_region->systemSequence);
+    unlock(&g_systemLock);
+}
+
+void vicrabcrashctx_setAppState(const VicrabCrash_MonitorContext* context)
+{
+    if(g_region == NULL)
+    {
+        return;
+    }
+    lock(&g_appStateLock);
+    beginWrite(&g_region->appStateSequence);
+#define STORE_APP_STATE(NAME) g_region->appState.NAME = context->AppState.NAME;
+    APP_STATE_FIELDS(STORE_APP_STATE)
+#undef STORE_APP_STATE
+    g_region->hasAppState = true;
+    endWrite(&g_region->appStateSequence);
+    unlock(&g_appStateLock);
+}
+
+void vicrabcrashctx_setUserInfoJSON(const char* userInfoJSON)
+{
+    if(g_region == NULL)
+    {
+        return;
+    }
+    lock(&g_userInfoLock);
+    beginWrite(&g_region->userInfoSequence);
+    // Truncated JSON would corrupt the report, so leave out what doesn't fit.
+    g_region->hasUserInfo = userInfoJSON != NULL && strlen(userInfoJSON) < kMaxUserInfoLength;
+    copyString(g_region->userInfo, g_region->hasUserInfo ? userInfoJSON : NULL, kMaxUserInfoLength);
+    endWrite(&g_region->userInfoSequence);
+    unlock(&g_userInfoLock);
+}
+
+void vicrabcrashctx_addEvent(const char* category, const char* message)
+{
+    if(g_region == NULL || category == NULL)
+    {
+        return;
+    }
+    uint32_t index = atomic_fetch_add(&g_region->nextEvent, 1) % kEventCount;
+    ContextEvent* event = &g_region->events[index];
+    // Claim the slot. If the ring wrapped onto a writer that is still
+    // copying, drop this event rather than interleave with it (or wait for
+    // a writer that may have crashed).
+    uint32_t sequence = atomic_load(&event->sequence);
+    if((sequence & 1) != 0 || !atomic_compare_exchange_strong(&event->sequence, &sequence, sequence + 1))
+    {
+        return;
+    }
+    event->timestamp = (int64_t)time(NULL);
+    copyString(event->category, category, kMaxEventCategoryLength);
+    copyString(event->message, message, kMaxEventMessageLength);
+    endWrite(&event->sequence);
+}
+
+void vicrabcrashctx_notifyCrashHandled()
+{
+    if(g_region != NULL)
+    {
+        atomic_store(&g_region->status, kStatusHandled);
+    }
+}
+
+void vicrabcrashctx_notifyCleanExit()
+{
+    if(g_region != NULL)
+    {
+        uint32_t running = kStatusRunning;
+        atomic_compare_exchange_strong(&g_region->status, &running, kStatusExited);
+    }
+}
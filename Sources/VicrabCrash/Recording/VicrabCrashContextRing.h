@@ -0,0 +1,109 @@
+//
+//  VicrabCrashContextRing.h
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+/* Keeps the latest crash context in a file-backed shared mapping.
+ *
+ * System info, app state, user info and the last few events are published
+ * into the mapping as they change, so they survive the process even when no
+ * crash handler gets to run (SIGKILL, out of memory, a crash inside the
+ * handler). On the next launch, a previous process that ended that way while
+ * in the foreground is turned into a report.
+ */
+
+
+#ifndef HDR_VicrabCrashContextRing_h
+#define HDR_VicrabCrashContextRing_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdbool.h>
+
+struct VicrabCrash_MonitorContext;
+
+/** Map the context file. If the launch that last used it ended without
+ * running a crash handler, write a report for it first.
+ * The report store must be initialized before calling this.
+ *
+ * @param path The context file. It is created if it doesn't exist.
+ *
+ * @return true if the context file is mapped.
+ */
+bool vicrabcrashctx_initialize(const char* path);
+
+/** Unmap the context file, leaving it as it is. The next call to
+ * vicrabcrashctx_initialize() treats it as the previous launch's.
+ * Only for testing: nothing may publish to the context concurrently.
+ */
+void vicrabcrashctx_close(void);
+
+/** Publish the system info part of a monitor context.
+ *
+ * @param context A context filled in by the system monitor.
+ */
+void vicrabcrashctx_setSystemInfo(const struct VicrabCrash_MonitorContext* context);
+
+/** Publish the app state part of a monitor context.
+ *
+ * @param context A context filled in by the app state monitor.
+ */
+void vicrabcrashctx_setAppState(const struct VicrabCrash_MonitorContext* context);
+
+/** Publish the user info.
+ *
+ * @param userInfoJSON The user info, in JSON format, or NULL.
+ */
+void vicrabcrashctx_setUserInfoJSON(const char* userInfoJSON);
+
+/** Add an event to the ring of recent events, overwriting the oldest.
+ * This function is async-safe.
+ *
+ * @param category What kind of event this is.
+ *
+ * @param message A short description, or NULL.
+ */
+void vicrabcrashctx_addEvent(const char* category, const char* message);
+
+/** Note that a crash handler has written a report for this launch.
+ * Only call this for fatal events: once it has been called, the next launch
+ * won't report this one as an unexpected termination.
+ * This function is async-safe.
+ */
+void vicrabcrashctx_notifyCrashHandled(void);
+
+/** Note that this launch is ending normally.
+ */
+void vicrabcrashctx_notifyCleanExit(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HDR_VicrabCrashContextRing_h
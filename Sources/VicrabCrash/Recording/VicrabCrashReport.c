@@ -43,8 +43,10 @@
 #include "VicrabCrashReportVersion.h"
 #include "VicrabCrashStackCursor_Backtrace.h"
 #include "VicrabCrashStackCursor_MachineContext.h"
+#include "VicrabCrashSymbolCache.h"
 #include "VicrabCrashSystemCapabilities.h"
 #include "VicrabCrashCachedData.h"
+#include "VicrabCrashConsoleCapture.h"
 
 //#define VicrabCrashLogger_LocalLevel TRACE
 #include "VicrabCrashLogger.h"
@@ -68,6 +70,7 @@
 /** How far to search the stack (in pointer sized jumps) for notable data. */
 #define kStackNotableSearchBackDistance 20
 #define kStackNotableSearchForwardDistance 10
+#define kStackNotableSearchTotalDistance (kStackNotableSearchBackDistance + kStackNotableSearchForwardDistance)
 
 /** How much of the stack to dump (in pointer sized jumps). */
 #define kStackContentsPushedDistance 20
@@ -77,6 +80,9 @@
 /** The minimum length for a valid string. */
 #define kMinStringLength 4
 
+/** Longest user info that will be loaded from another process. */
+#define kMaxUserInfoJSONLength (1024 * 1024)
+
 
 // ============================================================================
 #pragma mark - JSON Encoding -
@@ -820,10 +826,21 @@ static bool isNotableAddress(const uintptr_t address)
         return true;
     }
 
+    // One range check spares unmapped values the object and string probes.
+    if(!vicrabcrashobjc_isTaggedPointer(object) && !vicrabcrashmem_isMemoryReadable(object, 1))
+    {
+        return false;
+    }
+
     if(vicrabcrashobjc_objectType(object) != VicrabCrashObjCTypeUnknown)
     {
         return true;
     }
+#else
+    if(!vicrabcrashmem_isMemoryReadable(object, 1))
+    {
+        return false;
+    }
 #endif
 
     if(isValidString(object))
@@ -834,6 +851,43 @@ static bool isNotableAddress(const uintptr_t address)
     return false;
 }
 
+/** Decide which of a batch of addresses point to notable data.
+ * Values that can't be pointers are ruled out before any memory is probed,
+ * and a value that appears more than once is only probed the first time.
+ *
+ * @param addresses The addresses to check.
+ *
+ * @param isPresent Which entries in addresses hold a value.
+ *
+ * @param count The number of addresses.
+ *
+ * @param isNotable Receives the result for each address.
+ */
+static void findNotableAddresses(const uintptr_t* const addresses,
+                                 const bool* const isPresent,
+                                 const int count,
+                                 bool* const isNotable)
+{
+    for(int i = 0; i < count; i++)
+    {
+        isNotable[i] = isPresent[i] && isValidPointer(addresses[i]);
+    }
+
+    for(int i = 0; i < count; i++)
+    {
+        if(!isNotable[i])
+        {
+            continue;
+        }
+        int previous = 0;
+        while(previous < i && !(isPresent[previous] && addresses[previous] == addresses[i]))
+        {
+            previous++;
+        }
+        isNotable[i] = previous < i ? isNotable[previous] : isNotableAddress(addresses[i]);
+    }
+}
+
 /** Write the contents of a memory location only if it contains notable data.
  * Also writes meta information about the data.
  *
@@ -1004,14 +1058,34 @@ static void writeNotableStackContents(const VicrabCrashReportWriter* const write
         lowAddress = highAddress;
         highAddress = tmp;
     }
-    uintptr_t contentsAsPointer;
+    uintptr_t contents[kStackNotableSearchTotalDistance];
+    bool isCopied[kStackNotableSearchTotalDistance];
+    bool isNotable[kStackNotableSearchTotalDistance];
+    int wordCount = (int)((highAddress - lowAddress) / sizeof(*contents));
+    if(wordCount > kStackNotableSearchTotalDistance)
+    {
+        wordCount = kStackNotableSearchTotalDistance;
+    }
+
+    // Copy the whole range at once. Only if it runs off the end of the
+    // stack mapping do we fall back to copying word by word.
+    bool isRangeCopied = vicrabcrashmem_copySafely((void*)lowAddress, contents, wordCount * (int)sizeof(*contents));
+    for(int i = 0; i < wordCount; i++)
+    {
+        isCopied[i] = isRangeCopied ||
+            vicrabcrashmem_copySafely((void*)(lowAddress + (uintptr_t)i * sizeof(*contents)), &contents[i], sizeof(*contents));
+    }
+
+    findNotableAddresses(contents, isCopied, wordCount, isNotable);
+
     char nameBuffer[40];
-    for(uintptr_t address = lowAddress; address < highAddress; address += sizeof(address))
+    for(int i = 0; i < wordCount; i++)
     {
-        if(vicrabcrashmem_copySafely((void*)address, &contentsAsPointer, sizeof(contentsAsPointer)))
+        if(isNotable[i])
         {
-            sprintf(nameBuffer, "stack@%p", (void*)address);
-            writeMemoryContentsIfNotable(writer, nameBuffer, contentsAsPointer);
+            sprintf(nameBuffer, "stack@%p", (void*)(lowAddress + (uintptr_t)i * sizeof(*contents)));
+            int limit = kDefaultMemorySearchDepth;
+            writeMemoryContents(writer, nameBuffer, contents[i], &limit);
         }
     }
 }
@@ -1218,6 +1292,51 @@ static void writeThread(const VicrabCrashReportWriter* const writer,
     writer->endContainer(writer);
 }
 
+/** Write a thread whose backtrace was captured before the report was started.
+ * Only the backtrace survives capture, so no registers or stack contents.
+ *
+ * @param writer The writer.
+ *
+ * @param key The object key, if needed.
+ *
+ * @param capturedThread The captured thread.
+ *
+ * @param threadIndex The thread's index relative to all threads.
+ */
+static void writeCapturedThread(const VicrabCrashReportWriter* const writer,
+                                const char* const key,
+                                const VicrabCrashCapturedThread* const capturedThread,
+                                const int threadIndex)
+{
+    VicrabCrashThread thread = capturedThread->thread;
+    VicrabCrashLOG_DEBUG("Writing captured thread %x (index %d)", thread, threadIndex);
+
+    VicrabCrashStackCursor stackCursor;
+    vicrabcrashsc_initWithBacktrace(&stackCursor, capturedThread->backtrace, capturedThread->backtraceLength, 0);
+
+    writer->beginObject(writer, key);
+    {
+        if(capturedThread->backtraceLength > 0)
+        {
+            writeBacktrace(writer, VicrabCrashField_Backtrace, &stackCursor);
+        }
+        writer->addIntegerElement(writer, VicrabCrashField_Index, threadIndex);
+        const char* name = vicrabcrashccd_getThreadName(thread);
+        if(name != NULL)
+        {
+            writer->addStringElement(writer, VicrabCrashField_Name, name);
+        }
+        name = vicrabcrashccd_getQueueName(thread);
+        if(name != NULL)
+        {
+            writer->addStringElement(writer, VicrabCrashField_DispatchQueue, name);
+        }
+        writer->addBooleanElement(writer, VicrabCrashField_Crashed, capturedThread->crashed);
+        writer->addBooleanElement(writer, VicrabCrashField_CurrentThread, false);
+    }
+    writer->endContainer(writer);
+}
+
 /** Write information about all threads to the report.
  *
  * @param writer The writer.
@@ -1233,6 +1352,28 @@ static void writeAllThreads(const VicrabCrashReportWriter* const writer,
 {
     const struct VicrabCrashMachineContext* const context = crash->offendingMachineContext;
     VicrabCrashThread offendingThread = vicrabcrashmc_getThreadFromContext(context);
+    if(crash->capturedThreads != NULL)
+    {
+        writer->beginArray(writer, key);
+        {
+            VicrabCrashLOG_DEBUG("Writing %d captured threads.", crash->capturedThreadCount);
+            for(int i = 0; i < crash->capturedThreadCount; i++)
+            {
+                const VicrabCrashCapturedThread* capturedThread = &crash->capturedThreads[i];
+                if(capturedThread->thread == offendingThread)
+                {
+                    writeThread(writer, NULL, crash, context, i, writeNotableAddresses);
+                }
+                else
+                {
+                    writeCapturedThread(writer, NULL, capturedThread, i);
+                }
+            }
+        }
+        writer->endContainer(writer);
+        return;
+    }
+
     int threadCount = vicrabcrashmc_getThreadCount(context);
     VicrabCrashMC_NEW_CONTEXT(machineContext);
 
@@ -1293,7 +1434,18 @@ static void writeBinaryImage(const VicrabCrashReportWriter* const writer,
     writer->endContainer(writer);
 }
 
+/** Append one pre-serialized binary image to the current array.
+ */
+static void writeSerializedBinaryImage(const char* const json, const int length, void* const userData)
+{
+    const VicrabCrashReportWriter* const writer = (const VicrabCrashReportWriter*)userData;
+    vicrabcrashjson_beginElement(getJsonContext(writer), NULL);
+    vicrabcrashjson_addRawJSONData(getJsonContext(writer), json, length);
+}
+
 /** Write information about all images to the report.
+ * Uses the pre-serialized images from the cached data if available, and
+ * falls back to querying dyld for each image otherwise.
  *
  * @param writer The writer.
  *
@@ -1301,13 +1453,15 @@ static void writeBinaryImage(const VicrabCrashReportWriter* const writer,
  */
 static void writeBinaryImages(const VicrabCrashReportWriter* const writer, const char* const key)
 {
-    const int imageCount = vicrabcrashdl_imageCount();
-
     writer->beginArray(writer, key);
     {
-        for(int iImg = 0; iImg < imageCount; iImg++)
+        if(!vicrabcrashccd_enumerateBinaryImages(writeSerializedBinaryImage, (void*)writer))
         {
-            writeBinaryImage(writer, NULL, iImg);
+            const int imageCount = vicrabcrashdl_imageCount();
+            for(int iImg = 0; iImg < imageCount; iImg++)
+            {
+                writeBinaryImage(writer, NULL, iImg);
+            }
         }
     }
     writer->endContainer(writer);
@@ -1328,10 +1482,157 @@ static void writeMemoryInfo(const VicrabCrashReportWriter* const writer,
         writer->addUIntegerElement(writer, VicrabCrashField_Size, monitorContext->System.memorySize);
         writer->addUIntegerElement(writer, VicrabCrashField_Usable, monitorContext->System.usableMemory);
         writer->addUIntegerElement(writer, VicrabCrashField_Free, monitorContext->System.freeMemory);
+        if(monitorContext->System.resourceSampleCount > 0)
+        {
+            writer->beginArray(writer, VicrabCrashField_MemorySamples);
+            for(int i = 0; i < monitorContext->System.resourceSampleCount; i++)
+            {
+                const VicrabCrash_ResourceSample* sample = &monitorContext->System.resourceSamples[i];
+                writer->beginObject(writer, NULL);
+                {
+                    writer->addFloatingPointElement(writer, VicrabCrashField_Timestamp, sample->timestamp);
+                    writer->addUIntegerElement(writer, VicrabCrashField_Usable, sample->usableMemory);
+                    writer->addUIntegerElement(writer, VicrabCrashField_Free, sample->freeMemory);
+                    writer->addUIntegerElement(writer, VicrabCrashField_FreeStorage, sample->freeStorage);
+                    writer->addFloatingPointElement(writer, VicrabCrashField_CPULoad, sample->cpuLoad);
+                }
+                writer->endContainer(writer);
+            }
+            writer->endContainer(writer);
+        }
     }
     writer->endContainer(writer);
 }
 
+/** Write the duration of a main thread hang and the backtraces sampled during it.
+ *
+ * @param writer The writer.
+ *
+ * @param key The object key.
+ *
+ * @param crash The crash handler context.
+ */
+static void writeHang(const VicrabCrashReportWriter* const writer,
+                      const char* const key,
+                      const VicrabCrash_MonitorContext* const crash)
+{
+    writer->beginObject(writer, key);
+    {
+        writer->addUIntegerElement(writer, VicrabCrashField_HangDuration, crash->hang.durationNanoseconds / 1000000);
+        writer->addIntegerElement(writer, VicrabCrashField_HangSampleCount, crash->hang.totalSampleCount);
+        writer->beginArray(writer, VicrabCrashField_HangSamples);
+        {
+            for(int i = 0; i < crash->hang.sampleCount; i++)
+            {
+                const VicrabCrashHangSample* sample = &crash->hang.samples[i];
+                VicrabCrashStackCursor stackCursor;
+                vicrabcrashsc_initWithBacktrace(&stackCursor, sample->backtrace, sample->backtraceLength, 0);
+                writer->beginObject(writer, NULL);
+                {
+                    writer->addIntegerElement(writer, VicrabCrashField_HangSampleOccurrences, sample->count);
+                    writeBacktrace(writer, VicrabCrashField_Backtrace, &stackCursor);
+                }
+                writer->endContainer(writer);
+            }
+        }
+        writer->endContainer(writer);
+    }
+    writer->endContainer(writer);
+}
+
+/** Write how often C++ exceptions were thrown from each throw site.
+ *
+ * @param writer The writer.
+ *
+ * @param key The object key.
+ *
+ * @param crash The crash handler context.
+ */
+static void writeCPPExceptionStats(const VicrabCrashReportWriter* const writer,
+                                   const char* const key,
+                                   const VicrabCrash_MonitorContext* const crash)
+{
+    writer->beginObject(writer, key);
+    {
+        writer->addIntegerElement(writer, VicrabCrashField_CPPExceptionSampling, crash->CPPExceptionStats.sampleInterval);
+        writer->addUIntegerElement(writer, VicrabCrashField_CPPExceptionThrows, crash->CPPExceptionStats.throwCount);
+        writer->addUIntegerElement(writer, VicrabCrashField_CPPExceptionDropped, crash->CPPExceptionStats.droppedCount);
+        writer->addUIntegerElement(writer, VicrabCrashField_CPPExceptionDuration, crash->CPPExceptionStats.durationNanoseconds / 1000000);
+        writer->beginArray(writer, VicrabCrashField_CPPExceptionSites);
+        {
+            for(int i = 0; i < crash->CPPExceptionStats.siteCount; i++)
+            {
+                const VicrabCrashThrowSiteCount* site = &crash->CPPExceptionStats.sites[i];
+                writer->beginObject(writer, NULL);
+                {
+                    writer->addStringElement(writer, VicrabCrashField_Name, site->name);
+                    writer->addUIntegerElement(writer, VicrabCrashField_Address, site->address);
+                    writer->addUIntegerElement(writer, VicrabCrashField_CPPExceptionCount, site->count);
+                }
+                writer->endContainer(writer);
+            }
+        }
+        writer->endContainer(writer);
+    }
+    writer->endContainer(writer);
+}
+
+/** Write the call tree aggregated by the profiler. Each node is written as
+ * [parent index, address, self samples, total samples].
+ *
+ * @param writer The writer.
+ *
+ * @param key The object key.
+ *
+ * @param crash The crash handler context.
+ */
+static void writeProfile(const VicrabCrashReportWriter* const writer,
+                         const char* const key,
+                         const VicrabCrash_MonitorContext* const crash)
+{
+    writer->beginObject(writer, key);
+    {
+        writer->addIntegerElement(writer, VicrabCrashField_ProfileSampleRate, crash->profile.samplesPerSecond);
+        writer->addUIntegerElement(writer, VicrabCrashField_ProfileDuration, crash->profile.durationNanoseconds / 1000000);
+        writer->addIntegerElement(writer, VicrabCrashField_ProfileSampleCount, crash->profile.sampleCount);
+        writer->addIntegerElement(writer, VicrabCrashField_ProfileDroppedSamples, crash->profile.droppedSampleCount);
+        writer->beginArray(writer, VicrabCrashField_ProfileNodes);
+        {
+            for(int i = 0; i < crash->profile.nodeCount; i++)
+            {
+                const VicrabCrashProfileNode* node = &crash->profile.nodes[i];
+                writer->beginArray(writer, NULL);
+                {
+                    writer->addIntegerElement(writer, NULL, node->parent);
+                    writer->addUIntegerElement(writer, NULL, node->address);
+                    writer->addUIntegerElement(writer, NULL, node->selfCount);
+                    writer->addUIntegerElement(writer, NULL, node->totalCount);
+                }
+                writer->endContainer(writer);
+            }
+        }
+        writer->endContainer(writer);
+    }
+    writer->endContainer(writer);
+}
+
+/** Write a user report's occurrence count, padded to a fixed width so that
+ * it can later be overwritten in place.
+ *
+ * @param writer The writer.
+ *
+ * @param key The object key.
+ *
+ * @param occurrences The number of occurrences.
+ */
+static void writeOccurrences(const VicrabCrashReportWriter* const writer, const char* const key, const int occurrences)
+{
+    char buffer[VicrabCrashCM_OCCURRENCES_WIDTH + 1];
+    snprintf(buffer, sizeof(buffer), "%-*d", VicrabCrashCM_OCCURRENCES_WIDTH, occurrences);
+    vicrabcrashjson_beginElement(getJsonContext(writer), key);
+    vicrabcrashjson_addRawJSONData(getJsonContext(writer), buffer, VicrabCrashCM_OCCURRENCES_WIDTH);
+}
+
 /** Write information about the error leading to the crash to the report.
  *
  * @param writer The writer.
@@ -1395,6 +1696,16 @@ static void writeError(const VicrabCrashReportWriter* const writer,
                 writer->addStringElement(writer, VicrabCrashField_Type, VicrabCrashExcType_Deadlock);
                 break;
 
+            case VicrabCrashMonitorTypeMainThreadHang:
+                writer->addStringElement(writer, VicrabCrashField_Type, VicrabCrashExcType_Hang);
+                writeHang(writer, VicrabCrashField_Hang, crash);
+                break;
+
+            case VicrabCrashMonitorTypeCPPExceptionStats:
+                writer->addStringElement(writer, VicrabCrashField_Type, VicrabCrashExcType_CPPExceptionStats);
+                writeCPPExceptionStats(writer, VicrabCrashField_CPPExceptionStats, crash);
+                break;
+
             case VicrabCrashMonitorTypeMachException:
                 writer->addStringElement(writer, VicrabCrashField_Type, VicrabCrashExcType_Mach);
                 break;
@@ -1430,6 +1741,10 @@ static void writeError(const VicrabCrashReportWriter* const writer,
                 writer->addStringElement(writer, VicrabCrashField_Type, VicrabCrashExcType_User);
                 writer->beginObject(writer, VicrabCrashField_UserReported);
                 {
+                    if(crash->userException.occurrences > 0)
+                    {
+                        writeOccurrences(writer, VicrabCrashField_Occurrences, crash->userException.occurrences);
+                    }
                     writer->addStringElement(writer, VicrabCrashField_Name, crash->userException.name);
                     if(crash->userException.language != NULL)
                     {
@@ -1450,6 +1765,7 @@ static void writeError(const VicrabCrashReportWriter* const writer,
             case VicrabCrashMonitorTypeSystem:
             case VicrabCrashMonitorTypeApplicationState:
             case VicrabCrashMonitorTypeZombie:
+            case VicrabCrashMonitorTypeProfiler:
                 VicrabCrashLOG_ERROR("Crash monitor type 0x%x shouldn't be able to cause events!", crash->crashType);
                 break;
         }
@@ -1602,6 +1918,7 @@ void vicrabcrashreport_writeRecrashReport(const VicrabCrash_MonitorContext* cons
     }
 
     vicrabcrashccd_freeze();
+    vicrabcrashmem_beginCachedProbing();
 
     VicrabCrashJSONEncodeContext jsonContext;
     jsonContext.userData = &bufferedWriter;
@@ -1646,6 +1963,7 @@ void vicrabcrashreport_writeRecrashReport(const VicrabCrash_MonitorContext* cons
 
     vicrabcrashjson_endEncode(getJsonContext(writer));
     vicrabcrashfu_closeBufferedWriter(&bufferedWriter);
+    vicrabcrashmem_endCachedProbing();
     vicrabcrashccd_unfreeze();
 }
 
@@ -1683,6 +2001,8 @@ static void writeSystemInfo(const VicrabCrashReportWriter* const writer,
         writer->addStringElement(writer, VicrabCrashField_DeviceAppHash, monitorContext->System.deviceAppHash);
         writer->addStringElement(writer, VicrabCrashField_BuildType, monitorContext->System.buildType);
         writer->addIntegerElement(writer, VicrabCrashField_Storage, (int64_t)monitorContext->System.storageSize);
+        writer->addIntegerElement(writer, VicrabCrashField_FreeStorage, (int64_t)monitorContext->System.freeStorage);
+        writer->addFloatingPointElement(writer, VicrabCrashField_CPULoad, monitorContext->System.cpuLoad);
 
         writeMemoryInfo(writer, VicrabCrashField_Memory, monitorContext);
         writeAppStats(writer, VicrabCrashField_AppStats, monitorContext);
@@ -1691,16 +2011,84 @@ static void writeSystemInfo(const VicrabCrashReportWriter* const writer,
 
 }
 
+/** Write symbol cache statistics gathered while writing this report.
+ *
+ * @param writer The writer.
+ *
+ * @param key The object key, if needed.
+ */
+static void writeSymbolCacheStats(const VicrabCrashReportWriter* const writer, const char* const key)
+{
+    VicrabCrashSymbolCacheStats stats;
+    vicrabcrashsymcache_getStats(&stats);
+    if(stats.capacity == 0)
+    {
+        return;
+    }
+
+    writer->beginObject(writer, key);
+    {
+        writer->addUIntegerElement(writer, VicrabCrashField_Hits, stats.hits);
+        writer->addUIntegerElement(writer, VicrabCrashField_Misses, stats.misses);
+        writer->addUIntegerElement(writer, VicrabCrashField_MissTime, stats.missNanoseconds);
+        writer->addUIntegerElement(writer, VicrabCrashField_SavedTime, stats.savedNanoseconds);
+    }
+    writer->endContainer(writer);
+}
+
+static void addConsoleLine(const char* const line, void* const userData)
+{
+    const VicrabCrashReportWriter* const writer = userData;
+    if(vicrabcrashstring_isNullTerminatedUTF8String(line, 0, (int)strlen(line) + 1))
+    {
+        writer->addStringElement(writer, NULL, line);
+        return;
+    }
+    // Console output can be anything. Keep the report valid JSON.
+    char sanitized[1024];
+    int length = 0;
+    for(; line[length] != '\0' && length < (int)sizeof(sanitized) - 1; length++)
+    {
+        sanitized[length] = (line[length] & 0x80) ? '?' : line[length];
+    }
+    sanitized[length] = '\0';
+    writer->addStringElement(writer, NULL, sanitized);
+}
+
+/** Add the lines of captured console output as an array of strings.
+ *
+ * @param writer The writer.
+ *
+ * @param key The object key.
+ *
+ * @param capture The console capture ring (possibly in another process).
+ */
+static void addTextLinesFromConsoleCapture(const VicrabCrashReportWriter* const writer,
+                                           const char* const key,
+                                           const struct VicrabCrashConsoleCapture* const capture)
+{
+    writer->beginArray(writer, key);
+    {
+        vicrabcrashconsole_forEachLine(capture, addConsoleLine, (void*)writer);
+    }
+    writer->endContainer(writer);
+}
+
 static void writeDebugInfo(const VicrabCrashReportWriter* const writer,
                             const char* const key,
                             const VicrabCrash_MonitorContext* const monitorContext)
 {
     writer->beginObject(writer, key);
     {
-        if(monitorContext->consoleLogPath != NULL)
+        if(monitorContext->consoleCapture != NULL)
+        {
+            addTextLinesFromConsoleCapture(writer, VicrabCrashField_ConsoleLog, monitorContext->consoleCapture);
+        }
+        else if(monitorContext->consoleLogPath != NULL)
         {
             addTextLinesFromFile(writer, VicrabCrashField_ConsoleLog, monitorContext->consoleLogPath);
         }
+        writeSymbolCacheStats(writer, VicrabCrashField_SymbolCache);
     }
     writer->endContainer(writer);
 
@@ -1718,6 +2106,9 @@ void vicrabcrashreport_writeStandardReport(const VicrabCrash_MonitorContext* con
     }
 
     vicrabcrashccd_freeze();
+    vicrabcrashmem_beginCachedProbing();
+    vicrabcrashsymcache_resetStats();
+    vicrabcrashobjc_beginClassCache();
 
     VicrabCrashJSONEncodeContext jsonContext;
     jsonContext.userData = &bufferedWriter;
@@ -1757,6 +2148,12 @@ void vicrabcrashreport_writeStandardReport(const VicrabCrash_MonitorContext* con
         }
         writer->endContainer(writer);
 
+        if(monitorContext->profile.nodeCount > 0)
+        {
+            writeProfile(writer, VicrabCrashField_Profile, monitorContext);
+            vicrabcrashfu_flushBufferedWriter(&bufferedWriter);
+        }
+
         if(g_userInfoJSON != NULL)
         {
             addJSONElement(writer, VicrabCrashField_User, g_userInfoJSON, false);
@@ -1782,9 +2179,76 @@ void vicrabcrashreport_writeStandardReport(const VicrabCrash_MonitorContext* con
 
     vicrabcrashjson_endEncode(getJsonContext(writer));
     vicrabcrashfu_closeBufferedWriter(&bufferedWriter);
+    vicrabcrashobjc_endClassCache();
+    vicrabcrashmem_endCachedProbing();
     vicrabcrashccd_unfreeze();
 }
 
+void vicrabcrashreport_writeTerminationReport(const VicrabCrash_MonitorContext* const monitorContext,
+                                              int64_t lastUpdate,
+                                              const char* userInfoJSON,
+                                              VicrabCrashReportWriteCallback writeRecentEvents,
+                                              const char* const path)
+{
+    VicrabCrashLOG_INFO("Writing termination report to %s", path);
+    char writeBuffer[1024];
+    VicrabCrashBufferedWriter bufferedWriter;
+
+    if(!vicrabcrashfu_openBufferedWriter(&bufferedWriter, path, writeBuffer, sizeof(writeBuffer)))
+    {
+        return;
+    }
+
+    VicrabCrashJSONEncodeContext jsonContext;
+    jsonContext.userData = &bufferedWriter;
+    VicrabCrashReportWriter concreteWriter;
+    VicrabCrashReportWriter* writer = &concreteWriter;
+    prepareReportWriter(writer, &jsonContext);
+
+    vicrabcrashjson_beginEncode(getJsonContext(writer), true, addJSONData, &bufferedWriter);
+
+    writer->beginObject(writer, VicrabCrashField_Report);
+    {
+        writeReportInfo(writer,
+                        VicrabCrashField_Report,
+                        VicrabCrashReportType_Standard,
+                        monitorContext->eventID,
+                        monitorContext->System.processName);
+
+        writeSystemInfo(writer, VicrabCrashField_System, monitorContext);
+
+        writer->beginObject(writer, VicrabCrashField_Crash);
+        {
+            writer->beginObject(writer, VicrabCrashField_Error);
+            {
+                writer->addStringElement(writer, VicrabCrashField_Type, VicrabCrashExcType_Termination);
+                writer->addStringElement(writer, VicrabCrashField_Reason, monitorContext->crashReason);
+                writer->addIntegerElement(writer, VicrabCrashField_LastUpdate, lastUpdate);
+            }
+            writer->endContainer(writer);
+            writer->beginArray(writer, VicrabCrashField_Threads);
+            writer->endContainer(writer);
+        }
+        writer->endContainer(writer);
+
+        if(writeRecentEvents != NULL)
+        {
+            writer->beginArray(writer, VicrabCrashField_RecentEvents);
+            writeRecentEvents(writer);
+            writer->endContainer(writer);
+        }
+
+        if(userInfoJSON != NULL)
+        {
+            addJSONElement(writer, VicrabCrashField_User, userInfoJSON, true);
+        }
+    }
+    writer->endContainer(writer);
+
+    vicrabcrashjson_endEncode(getJsonContext(writer));
+    vicrabcrashfu_closeBufferedWriter(&bufferedWriter);
+}
+
 
 
 void vicrabcrashreport_setUserInfoJSON(const char* const userInfoJSON)
@@ -1813,6 +2277,48 @@ void vicrabcrashreport_setIntrospectMemory(bool shouldIntrospectMemory)
     g_introspectionRules.enabled = shouldIntrospectMemory;
 }
 
+void vicrabcrashreport_loadSettingsFromTargetProcess()
+{
+    bool introspectMemory = false;
+    if(vicrabcrashmem_copySafely(&g_introspectionRules.enabled, &introspectMemory, sizeof(introspectMemory)))
+    {
+        g_introspectionRules.enabled = introspectMemory;
+    }
+
+    const char* remoteUserInfoJSON = NULL;
+    if(!vicrabcrashmem_copySafely(&g_userInfoJSON, &remoteUserInfoJSON, sizeof(remoteUserInfoJSON)))
+    {
+        return;
+    }
+    char* userInfoJSON = NULL;
+    int length = 0;
+    bool isComplete = remoteUserInfoJSON == NULL;
+    for(int capacity = 4096; !isComplete && capacity <= kMaxUserInfoJSONLength; capacity *= 2)
+    {
+        char* grown = realloc(userInfoJSON, (size_t)capacity);
+        if(grown == NULL)
+        {
+            break;
+        }
+        userInfoJSON = grown;
+        int bytesToCopy = capacity - length - 1;
+        int copied = vicrabcrashmem_copyMaxPossible(remoteUserInfoJSON + length, userInfoJSON + length, bytesToCopy);
+        userInfoJSON[length + copied] = '\0';
+        if((int)strlen(userInfoJSON + length) < copied)
+        {
+            isComplete = true;
+        }
+        else if(copied < bytesToCopy)
+        {
+            break;
+        }
+        length += copied;
+    }
+    // Truncated JSON would corrupt the report, so drop it instead.
+    vicrabcrashreport_setUserInfoJSON(isComplete ? userInfoJSON : NULL);
+    free(userInfoJSON);
+}
+
 void vicrabcrashreport_setDoNotIntrospectClasses(const char** doNotIntrospectClasses, int length)
 {
     const char** oldClasses = g_introspectionRules.restrictedClasses;
@@ -59,6 +59,13 @@ void vicrabcrashreport_setUserInfoJSON(const char* const userInfoJSON);
  */
 void vicrabcrashreport_setIntrospectMemory(bool shouldIntrospectMemory);
 
+/** Replace the user info and introspection settings with the ones held by
+ * the process set through vicrabcrashmem_setTargetProcess(). That process
+ * must be running the same image, so that our globals are at the same
+ * addresses there.
+ */
+void vicrabcrashreport_loadSettingsFromTargetProcess(void);
+
 /** Specify which objective-c classes should not be introspected.
  *
  * @param doNotIntrospectClasses Array of class names.
@@ -99,6 +106,26 @@ void vicrabcrashreport_writeStandardReport(const struct VicrabCrash_MonitorConte
 void vicrabcrashreport_writeRecrashReport(const struct VicrabCrash_MonitorContext* const monitorContext,
                                       const char* path);
 
+/** Write a report for a previous launch that ended without running a crash
+ * handler, rebuilt from what it published while it ran.
+ *
+ * @param monitorContext The system info and app state of that launch, plus
+ *                       eventID and crashReason.
+ *
+ * @param lastUpdate When that launch last published anything (unix time).
+ *
+ * @param userInfoJSON That launch's user info, or NULL.
+ *
+ * @param writeRecentEvents Adds that launch's recent events to an open array.
+ *
+ * @param path The file to write to.
+ */
+void vicrabcrashreport_writeTerminationReport(const struct VicrabCrash_MonitorContext* const monitorContext,
+                                              int64_t lastUpdate,
+                                              const char* userInfoJSON,
+                                              VicrabCrashReportWriteCallback writeRecentEvents,
+                                              const char* path);
+
 
 #ifdef __cplusplus
 }
@@ -49,10 +49,13 @@
 #pragma mark - Exception Types -
 
 #define VicrabCrashExcType_CPPException        "cpp_exception"
+#define VicrabCrashExcType_CPPExceptionStats   "cpp_exception_stats"
 #define VicrabCrashExcType_Deadlock            "deadlock"
+#define VicrabCrashExcType_Hang                "hang"
 #define VicrabCrashExcType_Mach                "mach"
 #define VicrabCrashExcType_NSException         "nsexception"
 #define VicrabCrashExcType_Signal              "signal"
+#define VicrabCrashExcType_Termination         "unexpected_termination"
 #define VicrabCrashExcType_User                "user"
 
 
@@ -130,6 +133,7 @@
 
 #define VicrabCrashField_Free                  "free"
 #define VicrabCrashField_Usable                "usable"
+#define VicrabCrashField_MemorySamples         "samples"
 
 
 #pragma mark - Error -
@@ -138,13 +142,37 @@
 #define VicrabCrashField_Code                  "code"
 #define VicrabCrashField_CodeName              "code_name"
 #define VicrabCrashField_CPPException          "cpp_exception"
+#define VicrabCrashField_CPPExceptionStats     "cpp_exception_stats"
+#define VicrabCrashField_CPPExceptionSites     "sites"
+#define VicrabCrashField_CPPExceptionThrows    "throw_count"
+#define VicrabCrashField_CPPExceptionDropped   "dropped_count"
+#define VicrabCrashField_CPPExceptionCount     "count"
+#define VicrabCrashField_CPPExceptionDuration  "duration_ms"
+#define VicrabCrashField_CPPExceptionSampling  "sample_interval"
 #define VicrabCrashField_ExceptionName         "exception_name"
+#define VicrabCrashField_Hang                  "hang"
+#define VicrabCrashField_HangDuration          "duration_ms"
+#define VicrabCrashField_HangSamples           "samples"
+#define VicrabCrashField_HangSampleCount       "sample_count"
+#define VicrabCrashField_HangSampleOccurrences "count"
 #define VicrabCrashField_Mach                  "mach"
 #define VicrabCrashField_NSException           "nsexception"
+#define VicrabCrashField_Occurrences           "occurrences"
 #define VicrabCrashField_Reason                "reason"
 #define VicrabCrashField_Signal                "signal"
 #define VicrabCrashField_Subcode               "subcode"
 #define VicrabCrashField_UserReported          "user_reported"
+#define VicrabCrashField_LastUpdate            "last_update"
+
+
+#pragma mark - Profile -
+
+#define VicrabCrashField_Profile               "profile"
+#define VicrabCrashField_ProfileDroppedSamples "dropped_samples"
+#define VicrabCrashField_ProfileDuration       "duration_ms"
+#define VicrabCrashField_ProfileNodes          "nodes"
+#define VicrabCrashField_ProfileSampleCount    "sample_count"
+#define VicrabCrashField_ProfileSampleRate     "sample_rate"
 
 
 #pragma mark - Process State -
@@ -166,6 +194,15 @@
 #define VicrabCrashField_SessionsSinceLaunch   "sessions_since_launch"
 
 
+#pragma mark - Debug -
+
+#define VicrabCrashField_Hits                  "hits"
+#define VicrabCrashField_Misses                "misses"
+#define VicrabCrashField_MissTime              "miss_time_ns"
+#define VicrabCrashField_SavedTime             "saved_time_ns"
+#define VicrabCrashField_SymbolCache           "symbol_cache"
+
+
 #pragma mark - Report -
 
 #define VicrabCrashField_Crash                 "crash"
@@ -189,6 +226,11 @@
 #define VicrabCrashField_User                  "user"
 #define VicrabCrashField_ConsoleLog            "console_log"
 
+#pragma mark Termination
+#define VicrabCrashField_RecentEvents          "recent_events"
+#define VicrabCrashField_EventCategory         "category"
+#define VicrabCrashField_EventMessage          "message"
+
 #pragma mark Incomplete
 #define VicrabCrashField_Incomplete            "incomplete"
 #define VicrabCrashField_RecrashReport         "recrash_report"
@@ -219,6 +261,8 @@
 #define VicrabCrashField_ProcessName           "process_name"
 #define VicrabCrashField_Size                  "size"
 #define VicrabCrashField_Storage               "storage"
+#define VicrabCrashField_FreeStorage           "free_storage"
+#define VicrabCrashField_CPULoad               "cpu_load"
 #define VicrabCrashField_SystemName            "system_name"
 #define VicrabCrashField_SystemVersion         "system_version"
 #define VicrabCrashField_TimeZone              "time_zone"
@@ -0,0 +1,424 @@
+//
+//  VicrabCrashReportHelper.c
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#include "VicrabCrashReportHelper.h"
+
+#include "VicrabCrashFileUtils.h"
+#include "VicrabCrashMachineContext.h"
+#include "VicrabCrashMemory.h"
+#include "VicrabCrashMonitorContext.h"
+#include "VicrabCrashReport.h"
+#include "VicrabCrashSignalInfo.h"
+#include "VicrabCrashStackCursor_MachineContext.h"
+#include "VicrabCrashSystemCapabilities.h"
+
+//#define VicrabCrashLogger_LocalLevel TRACE
+#include "VicrabCrashLogger.h"
+
+#if VicrabCrashCRASH_HOST_LINUX
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+/** How long the crashed process waits for the helper to write its report. */
+#define kReplyTimeoutMilliseconds 5000
+
+/** Space for the strings copied out of the crashed process. */
+#define kStringArenaSize (64 * 1024)
+
+/** Longest string copied out of the crashed process. */
+#define kMaxStringLength 4096
+
+#define kReplySuccess 1
+#define kReplyFailure 0
+
+
+// ============================================================================
+#pragma mark - Globals -
+// ============================================================================
+
+/** Layout of the records returned by getdents64. glibc doesn't export it. */
+struct linux_dirent64
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+/** A request from the crashed process. Sent as a single packet. */
+typedef struct
+{
+    /** Address of the monitor context in the crashed process. */
+    uintptr_t monitorContext;
+    char reportPath[VicrabCrashFU_MAX_PATH_LENGTH];
+} ReportRequest;
+
+static pid_t g_helperPid = 0;
+
+/** Our end of the socket. The helper has the other. */
+static int g_socket = -1;
+
+/** Helper only: strings copied out of the crashed process. */
+static char g_stringArena[kStringArenaSize];
+static int g_stringArenaUsed = 0;
+
+
+// ============================================================================
+#pragma mark - Helper Process -
+// ============================================================================
+
+/** Copy a string out of the crashed process.
+ *
+ * @param remoteString The string's address in the crashed process.
+ *
+ * @return A local copy, or NULL if it was NULL, unreadable or out of space.
+ */
+static const char* copyString(const char* remoteString)
+{
+    int available = kStringArenaSize - g_stringArenaUsed - 1;
+    if(remoteString == NULL || available <= 0)
+    {
+        return NULL;
+    }
+    if(available > kMaxStringLength)
+    {
+        available = kMaxStringLength;
+    }
+
+    char* localString = g_stringArena + g_stringArenaUsed;
+    int copied = vicrabcrashmem_copyMaxPossible(remoteString, localString, available);
+    if(copied <= 0)
+    {
+        return NULL;
+    }
+    localString[copied] = '\0';
+    g_stringArenaUsed += (int)strlen(localString) + 1;
+    return localString;
+}
+
+/** Replace every string in a monitor context with a local copy.
+ */
+static void copyStrings(VicrabCrash_MonitorContext* context)
+{
+#define COPY_STRING(FIELD) context->FIELD = copyString(context->FIELD)
+    g_stringArenaUsed = 0;
+    COPY_STRING(eventID);
+    COPY_STRING(exceptionName);
+    COPY_STRING(crashReason);
+    COPY_STRING(NSException.name);
+    COPY_STRING(NSException.userInfo);
+    COPY_STRING(CPPException.name);
+    COPY_STRING(userException.name);
+    COPY_STRING(userException.language);
+    COPY_STRING(userException.lineOfCode);
+    COPY_STRING(userException.customStackTrace);
+    COPY_STRING(System.systemName);
+    COPY_STRING(System.systemVersion);
+    COPY_STRING(System.machine);
+    COPY_STRING(System.model);
+    COPY_STRING(System.kernelVersion);
+    COPY_STRING(System.osVersion);
+    COPY_STRING(System.bootTime);
+    COPY_STRING(System.appStartTime);
+    COPY_STRING(System.executablePath);
+    COPY_STRING(System.executableName);
+    COPY_STRING(System.bundleID);
+    COPY_STRING(System.bundleName);
+    COPY_STRING(System.bundleVersion);
+    COPY_STRING(System.bundleShortVersion);
+    COPY_STRING(System.appID);
+    COPY_STRING(System.cpuArchitecture);
+    COPY_STRING(System.timezone);
+    COPY_STRING(System.processName);
+    COPY_STRING(System.deviceAppHash);
+    COPY_STRING(System.buildType);
+    COPY_STRING(ZombieException.name);
+    COPY_STRING(ZombieException.reason);
+    COPY_STRING(consoleLogPath);
+#undef COPY_STRING
+}
+
+/** Write the report for a request, reading the crash from the crashed process.
+ *
+ * @return true if the report was written.
+ */
+static bool writeRequestedReport(const ReportRequest* const request)
+{
+    VicrabCrash_MonitorContext context;
+    if(!vicrabcrashmem_copySafely((const void*)request->monitorContext, &context, sizeof(context)))
+    {
+        VicrabCrashLOG_ERROR("Could not read the crashed process's monitor context.");
+        return false;
+    }
+
+    VicrabCrashMC_NEW_CONTEXT(machineContext);
+    if(context.offendingMachineContext == NULL ||
+       !vicrabcrashmem_copySafely(context.offendingMachineContext, machineContext, vicrabcrashmc_contextSize()))
+    {
+        VicrabCrashLOG_ERROR("Could not read the crashed process's machine context.");
+        return false;
+    }
+    VicrabCrashStackCursor stackCursor;
+    vicrabcrashsc_initWithMachineContext(&stackCursor, 100, machineContext);
+
+    copyStrings(&context);
+    context.offendingMachineContext = machineContext;
+    context.stackCursor = &stackCursor;
+    context.signal.userContext = NULL;
+    context.capturedThreads = NULL;
+    context.capturedThreadCount = 0;
+    context.hang.samples = NULL;
+    context.hang.sampleCount = 0;
+    context.profile.nodes = NULL;
+    context.profile.nodeCount = 0;
+    context.CPPExceptionStats.sites = NULL;
+    context.CPPExceptionStats.siteCount = 0;
+    context.reportPathBuffer = NULL;
+
+    vicrabcrashreport_loadSettingsFromTargetProcess();
+    unlink(request->reportPath);
+    vicrabcrashreport_writeStandardReport(&context, request->reportPath);
+    return access(request->reportPath, F_OK) == 0;
+}
+
+/** Close every descriptor inherited from the app except stdio, the helper's
+ * socket and the log file, so that the helper doesn't hold the app's files,
+ * pipes and sockets open.
+ * Uses the raw getdents64 syscall since opendir() allocates, and the app may
+ * have forked while another thread held the allocator's lock.
+ *
+ * @param helperSocket The helper's end of the socket.
+ */
+static void closeInheritedDescriptors(int helperSocket)
+{
+    int logFD = vicrabcrashlog_getLogFileDescriptor();
+    int dirFD = open("/proc/self/fd", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(dirFD < 0)
+    {
+        VicrabCrashLOG_ERROR("Could not open /proc/self/fd");
+        return;
+    }
+
+    char buffer[4096];
+    long bytesRead;
+    while((bytesRead = syscall(SYS_getdents64, dirFD, buffer, sizeof(buffer))) > 0)
+    {
+        for(long offset = 0; offset < bytesRead;)
+        {
+            struct linux_dirent64* entry = (struct linux_dirent64*)(buffer + offset);
+            offset += entry->d_reclen;
+            if(entry->d_name[0] < '0' || entry->d_name[0] > '9')
+            {
+                continue;
+            }
+            int fd = (int)strtol(entry->d_name, NULL, 10);
+            if(fd > STDERR_FILENO && fd != helperSocket && fd != logFD && fd != dirFD)
+            {
+                close(fd);
+            }
+        }
+    }
+    close(dirFD);
+}
+
+/** The helper's main loop. Serves requests until the other end closes.
+ */
+static void runHelper(pid_t crashedProcess, int helperSocket)
+{
+    // A crash in the helper must not be reported as the app's.
+    const int* fatalSignals = vicrabcrashsignal_fatalSignals();
+    int fatalSignalsCount = vicrabcrashsignal_numFatalSignals();
+    for(int i = 0; i < fatalSignalsCount; i++)
+    {
+        signal(fatalSignals[i], SIG_DFL);
+    }
+    vicrabcrashmem_setTargetProcess(crashedProcess);
+
+    for(;;)
+    {
+        ReportRequest request;
+        ssize_t bytesRead = recv(helperSocket, &request, sizeof(request), 0);
+        if(bytesRead < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if(bytesRead != sizeof(request))
+        {
+            return;
+        }
+        request.reportPath[sizeof(request.reportPath) - 1] = '\0';
+        char reply = writeRequestedReport(&request) ? kReplySuccess : kReplyFailure;
+        send(helperSocket, &reply, sizeof(reply), MSG_NOSIGNAL);
+    }
+}
+
+
+// ============================================================================
+#pragma mark - API -
+// ============================================================================
+
+bool vicrabcrashrh_start()
+{
+    if(g_helperPid > 0)
+    {
+        return true;
+    }
+
+    int sockets[2];
+    if(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sockets) != 0)
+    {
+        VicrabCrashLOG_ERROR("socketpair: %s", strerror(errno));
+        return false;
+    }
+
+    pid_t crashedProcess = getpid();
+    pid_t pid = fork();
+    if(pid < 0)
+    {
+        VicrabCrashLOG_ERROR("fork: %s", strerror(errno));
+        close(sockets[0]);
+        close(sockets[1]);
+        return false;
+    }
+    if(pid == 0)
+    {
+        closeInheritedDescriptors(sockets[1]);
+        runHelper(crashedProcess, sockets[1]);
+        _exit(0);
+    }
+
+    close(sockets[1]);
+    // Yama only lets ancestors read a process's memory unless it opts in.
+    // This fails harmlessly when Yama isn't present.
+    prctl(PR_SET_PTRACER, (unsigned long)pid, 0, 0, 0);
+    g_socket = sockets[0];
+    g_helperPid = pid;
+    VicrabCrashLOG_DEBUG("Started report helper process %d.", pid);
+    return true;
+}
+
+/** Disconnect from the helper and reap it. Async-safe.
+ *
+ * @param shouldKill If true, kill the helper rather than wait for it to
+ *                   finish its current request.
+ */
+static void stopHelper(bool shouldKill)
+{
+    if(g_helperPid <= 0)
+    {
+        return;
+    }
+    if(shouldKill)
+    {
+        kill(g_helperPid, SIGKILL);
+    }
+    close(g_socket);
+    g_socket = -1;
+    while(waitpid(g_helperPid, NULL, 0) < 0 && errno == EINTR)
+    {
+    }
+    g_helperPid = 0;
+}
+
+void vicrabcrashrh_stop()
+{
+    stopHelper(false);
+}
+
+bool vicrabcrashrh_isRunning()
+{
+    return g_helperPid > 0;
+}
+
+bool vicrabcrashrh_writeStandardReport(const VicrabCrash_MonitorContext* const monitorContext, const char* const path)
+{
+    if(g_helperPid <= 0 || monitorContext->crashType != VicrabCrashMonitorTypeSignal)
+    {
+        return false;
+    }
+
+    ReportRequest request = {0};
+    request.monitorContext = (uintptr_t)monitorContext;
+    strncpy(request.reportPath, path, sizeof(request.reportPath) - 1);
+    if(send(g_socket, &request, sizeof(request), MSG_NOSIGNAL) != sizeof(request))
+    {
+        VicrabCrashLOG_ERROR("Could not reach report helper: %s", strerror(errno));
+        stopHelper(true);
+        return false;
+    }
+
+    struct pollfd pollDescriptor = { .fd = g_socket, .events = POLLIN };
+    char reply = kReplyFailure;
+    if(poll(&pollDescriptor, 1, kReplyTimeoutMilliseconds) != 1 ||
+       recv(g_socket, &reply, sizeof(reply), 0) != sizeof(reply))
+    {
+        // Make sure a late helper can't write over the in-process report,
+        // and that later crashes don't wait on it again.
+        VicrabCrashLOG_ERROR("Report helper did not respond.");
+        stopHelper(true);
+        return false;
+    }
+    return reply == kReplySuccess;
+}
+
+#else
+
+bool vicrabcrashrh_start()
+{
+    VicrabCrashLOG_WARN("Out-of-process reporting is not supported on this platform.");
+    return false;
+}
+
+void vicrabcrashrh_stop()
+{
+}
+
+bool vicrabcrashrh_isRunning()
+{
+    return false;
+}
+
+bool vicrabcrashrh_writeStandardReport(__unused const struct VicrabCrash_MonitorContext* const monitorContext,
+                                       __unused const char* const path)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,87 @@
+//
+//  VicrabCrashReportHelper.h
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+/* Writes crash reports from a helper process.
+ *
+ * The helper is forked at install and waits on a socket. When the process
+ * crashes, the signal handler passes it the address of the monitor context
+ * and the report path, and the helper reads everything else out of the
+ * crashed process's memory. The crashed process only has to wait for the
+ * reply, so a corrupt heap can no longer derail the report.
+ *
+ * The helper is a copy of the process as it was at install, so binary
+ * images loaded and threads named after that are missing from its reports.
+ */
+
+
+#ifndef HDR_VicrabCrashReportHelper_h
+#define HDR_VicrabCrashReportHelper_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdbool.h>
+
+struct VicrabCrash_MonitorContext;
+
+/** Start the helper process, unless it is already running.
+ * Only supported on Linux.
+ *
+ * @return true if the helper is running.
+ */
+bool vicrabcrashrh_start(void);
+
+/** Stop the helper process and wait for it to exit.
+ */
+void vicrabcrashrh_stop(void);
+
+/** Check if the helper process is running.
+ */
+bool vicrabcrashrh_isRunning(void);
+
+/** Have the helper write a standard report for a crash.
+ * Only crashes with a signal machine context can be handed over.
+ * This function is async-safe.
+ *
+ * @param monitorContext Contextual information about the crash.
+ *
+ * @param path The file to write to.
+ *
+ * @return true if the helper wrote the report. Otherwise the caller should
+ *         write it in-process.
+ */
+bool vicrabcrashrh_writeStandardReport(const struct VicrabCrash_MonitorContext* const monitorContext,
+                                       const char* const path);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HDR_VicrabCrashReportHelper_h
@@ -35,6 +35,10 @@
 #define VicrabCrashCRASH_HOST_ANDROID 1
 #endif
 
+#if defined(__linux__) && !defined(__ANDROID__)
+#define VicrabCrashCRASH_HOST_LINUX 1
+#endif
+
 #define VicrabCrashCRASH_HOST_IOS (VicrabCrashCRASH_HOST_APPLE && TARGET_OS_IOS)
 #define VicrabCrashCRASH_HOST_TV (VicrabCrashCRASH_HOST_APPLE && TARGET_OS_TV)
 #define VicrabCrashCRASH_HOST_WATCH (VicrabCrashCRASH_HOST_APPLE && TARGET_OS_WATCH)
@@ -127,13 +131,13 @@
 #endif
 
 // WatchOS signal is broken as of 3.1
-#if VicrabCrashCRASH_HOST_ANDROID || VicrabCrashCRASH_HOST_IOS || VicrabCrashCRASH_HOST_MAC || VicrabCrashCRASH_HOST_TV
+#if VicrabCrashCRASH_HOST_ANDROID || VicrabCrashCRASH_HOST_LINUX || VicrabCrashCRASH_HOST_IOS || VicrabCrashCRASH_HOST_MAC || VicrabCrashCRASH_HOST_TV
 #define VicrabCrashCRASH_HAS_SIGNAL 1
 #else
 #define VicrabCrashCRASH_HAS_SIGNAL 0
 #endif
 
-#if VicrabCrashCRASH_HOST_ANDROID || VicrabCrashCRASH_HOST_MAC || VicrabCrashCRASH_HOST_IOS
+#if VicrabCrashCRASH_HOST_ANDROID || VicrabCrashCRASH_HOST_LINUX || VicrabCrashCRASH_HOST_MAC || VicrabCrashCRASH_HOST_IOS
 #define VicrabCrashCRASH_HAS_SIGNAL_STACK 1
 #else
 #define VicrabCrashCRASH_HAS_SIGNAL_STACK 0
@@ -145,6 +149,12 @@
 #define VicrabCrashCRASH_HAS_THREADS_API 0
 #endif
 
+#if VicrabCrashCRASH_HOST_MAC || VicrabCrashCRASH_HOST_IOS || VicrabCrashCRASH_HOST_TV
+#define VicrabCrashCRASH_HAS_THREAD_INTROSPECTION 1
+#else
+#define VicrabCrashCRASH_HAS_THREAD_INTROSPECTION 0
+#endif
+
 #if VicrabCrashCRASH_HOST_MAC || VicrabCrashCRASH_HOST_IOS || VicrabCrashCRASH_HOST_TV
 #define VicrabCrashCRASH_HAS_REACHABILITY 1
 #else
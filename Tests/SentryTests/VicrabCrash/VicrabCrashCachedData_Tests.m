@@ -29,6 +29,47 @@
 #import "TestThread.h"
 
 
+static VicrabCrashBinaryImageAddedCallback g_testOnAdded;
+static VicrabCrashBinaryImageRemovedCallback g_testOnRemoved;
+static const uint8_t g_testUUID[16] = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF,
+                                       0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF};
+
+static VicrabCrashBinaryImage testImage(uint64_t address, const char* name)
+{
+    VicrabCrashBinaryImage image = {0};
+    image.address = address;
+    image.vmAddress = 0x1000;
+    image.size = 0x2000;
+    image.name = name;
+    image.uuid = g_testUUID;
+    image.cpuType = 7;
+    image.cpuSubType = 3;
+    image.majorVersion = 1;
+    image.minorVersion = 2;
+    image.revisionVersion = 3;
+    return image;
+}
+
+static void startTestProvider(VicrabCrashBinaryImageAddedCallback onAdded,
+                              VicrabCrashBinaryImageRemovedCallback onRemoved)
+{
+    g_testOnAdded = onAdded;
+    g_testOnRemoved = onRemoved;
+    VicrabCrashBinaryImage first = testImage(0x100000, "/usr/lib/first.dylib");
+    VicrabCrashBinaryImage second = testImage(0x200000, "/usr/lib/second.dylib");
+    onAdded(&first);
+    onAdded(&second);
+}
+
+static void collectSerializedImage(const char* json, int length, void* userData)
+{
+    NSMutableArray* images = (__bridge NSMutableArray*)userData;
+    NSData* data = [NSData dataWithBytes:json length:(NSUInteger)length];
+    id image = [NSJSONSerialization JSONObjectWithData:data options:0 error:nil];
+    [images addObject:image != nil ? image : [NSNull null]];
+}
+
+
 @interface VicrabCrashCachedData_Tests : XCTestCase @end
 
 
@@ -52,4 +93,118 @@
     vicrabcrashccd_unfreeze();
 }
 
+- (void) testThreadStartedAfterInitIsCached
+{
+    vicrabcrashccd_init(60);
+    [NSThread sleepForTimeInterval:0.1];
+    TestThread* thread = [TestThread new];
+    thread.name = @"Started after init";
+    [thread start];
+    [NSThread sleepForTimeInterval:0.3];
+
+    vicrabcrashccd_freeze();
+    int threadCount = 0;
+    VicrabCrashThread* threads = vicrabcrashccd_getAllThreads(&threadCount);
+    bool isFound = false;
+    for(int i = 0; i < threadCount; i++)
+    {
+        if(threads[i] == (VicrabCrashThread)thread.thread)
+        {
+            isFound = true;
+        }
+    }
+    vicrabcrashccd_unfreeze();
+    [thread cancel];
+    XCTAssertTrue(isFound);
+}
+
+- (void) testFrozenThreadListDoesNotChange
+{
+    vicrabcrashccd_init(60);
+    [NSThread sleepForTimeInterval:0.1];
+
+    vicrabcrashccd_freeze();
+    int frozenCount = 0;
+    VicrabCrashThread* frozenThreads = vicrabcrashccd_getAllThreads(&frozenCount);
+    TestThread* thread = [TestThread new];
+    [thread start];
+    [NSThread sleepForTimeInterval:0.3];
+    int count = 0;
+    VicrabCrashThread* threads = vicrabcrashccd_getAllThreads(&count);
+    vicrabcrashccd_unfreeze();
+    [thread cancel];
+
+    XCTAssertTrue(threads == frozenThreads);
+    XCTAssertEqual(count, frozenCount);
+}
+
+- (void) testBinaryImagesFromProvider
+{
+    VicrabCrashBinaryImageProvider provider = {.start = startTestProvider};
+    vicrabcrashccd_initBinaryImages(&provider);
+
+    NSMutableArray* images = [NSMutableArray array];
+    XCTAssertTrue(vicrabcrashccd_enumerateBinaryImages(collectSerializedImage, (__bridge void*)images));
+    XCTAssertEqual((int)images.count, 2);
+    NSDictionary* image = images[0];
+    XCTAssertEqualObjects(image[@"name"], @"/usr/lib/first.dylib");
+    XCTAssertEqualObjects(image[@"image_addr"], @(0x100000));
+    XCTAssertEqualObjects(image[@"image_vmaddr"], @(0x1000));
+    XCTAssertEqualObjects(image[@"image_size"], @(0x2000));
+    XCTAssertEqualObjects(image[@"uuid"], @"01234567-89AB-CDEF-0123-456789ABCDEF");
+    XCTAssertEqualObjects(image[@"cpu_type"], @7);
+    XCTAssertEqualObjects(image[@"cpu_subtype"], @3);
+    XCTAssertEqualObjects(image[@"major_version"], @1);
+    XCTAssertEqualObjects(image[@"minor_version"], @2);
+    XCTAssertEqualObjects(image[@"revision_version"], @3);
+    XCTAssertEqualObjects(images[1][@"name"], @"/usr/lib/second.dylib");
+}
+
+- (void) testBinaryImagesUpdateIncrementally
+{
+    VicrabCrashBinaryImageProvider provider = {.start = startTestProvider};
+    vicrabcrashccd_initBinaryImages(&provider);
+
+    VicrabCrashBinaryImage third = testImage(0x300000, "/usr/lib/third.dylib");
+    g_testOnAdded(&third);
+    g_testOnRemoved(0x100000);
+
+    NSMutableArray* images = [NSMutableArray array];
+    XCTAssertTrue(vicrabcrashccd_enumerateBinaryImages(collectSerializedImage, (__bridge void*)images));
+    XCTAssertEqual((int)images.count, 2);
+    XCTAssertEqualObjects(images[0][@"name"], @"/usr/lib/second.dylib");
+    XCTAssertEqualObjects(images[1][@"name"], @"/usr/lib/third.dylib");
+}
+
+- (void) testBinaryImagesReloadedRepeatedly
+{
+    VicrabCrashBinaryImageProvider provider = {.start = startTestProvider};
+    vicrabcrashccd_initBinaryImages(&provider);
+
+    VicrabCrashBinaryImage plugin = testImage(0x300000, "/usr/lib/plugin.dylib");
+    for(int i = 0; i < 1000; i++)
+    {
+        g_testOnAdded(&plugin);
+        g_testOnRemoved(0x300000);
+    }
+    g_testOnAdded(&plugin);
+    g_testOnRemoved(0x200000);
+
+    NSMutableArray* images = [NSMutableArray array];
+    XCTAssertTrue(vicrabcrashccd_enumerateBinaryImages(collectSerializedImage, (__bridge void*)images));
+    XCTAssertEqual((int)images.count, 2);
+    XCTAssertEqualObjects(images[0][@"name"], @"/usr/lib/first.dylib");
+    XCTAssertEqualObjects(images[1][@"name"], @"/usr/lib/plugin.dylib");
+}
+
+- (void) testBinaryImagesFromDyld
+{
+    vicrabcrashccd_initBinaryImages(NULL);
+
+    NSMutableArray* images = [NSMutableArray array];
+    XCTAssertTrue(vicrabcrashccd_enumerateBinaryImages(collectSerializedImage, (__bridge void*)images));
+    XCTAssertEqual((int)images.count, vicrabcrashdl_imageCount());
+    XCTAssertFalse([images containsObject:[NSNull null]]);
+}
+
 @end
@@ -0,0 +1,100 @@
+//
+//  VicrabCrashConsoleCapture_Tests.m
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#import <XCTest/XCTest.h>
+
+#import "VicrabCrashConsoleCapture.h"
+
+
+@interface VicrabCrashConsoleCapture_Tests : XCTestCase @end
+
+
+@implementation VicrabCrashConsoleCapture_Tests
+
+static void collectLine(const char* line, void* context)
+{
+    [(__bridge NSMutableArray*)context addObject:[NSString stringWithUTF8String:line]];
+}
+
+static NSArray* linesInRing(char* bytes, uint32_t capacity, uint64_t committed)
+{
+    VicrabCrashConsoleCapture capture = {.capacity = capacity, .bytes = bytes};
+    atomic_store(&capture.committed, committed);
+    atomic_store(&capture.reserved, committed);
+    NSMutableArray* lines = [NSMutableArray array];
+    vicrabcrashconsole_forEachLine(&capture, collectLine, (__bridge void*)lines);
+    return lines;
+}
+
+- (void) testLinesBeforeRingFills
+{
+    char bytes[32] = "one\ntwo\nthree";
+    NSArray* lines = linesInRing(bytes, sizeof(bytes), strlen(bytes));
+    NSArray* expected = @[@"one", @"two", @"three"];
+    XCTAssertEqualObjects(lines, expected, @"");
+}
+
+- (void) testSkipsLineCutOffByRingStart
+{
+    // 23 bytes were written to a 16 byte ring: "0123456789abcdef\nshort\n".
+    // The last 7 wrapped to the front, leaving "\nshort\n" + "789abcdef".
+    char bytes[16];
+    memcpy(bytes, "\nshort\n789abcdef", sizeof(bytes));
+    NSArray* lines = linesInRing(bytes, sizeof(bytes), 23);
+    NSArray* expected = @[@"short"];
+    XCTAssertEqualObjects(lines, expected, @"");
+}
+
+- (void) testSplitsOverlongLines
+{
+    char bytes[3000];
+    memset(bytes, 'x', sizeof(bytes));
+    NSArray* lines = linesInRing(bytes, sizeof(bytes), sizeof(bytes));
+    XCTAssertEqual(lines.count, 3U, @"");
+    XCTAssertEqual([lines[0] length], 1023U, @"");
+}
+
+- (void) testCapturesStdout
+{
+    XCTAssertTrue(vicrabcrashconsole_start(64 * 1024), @"");
+    NSString* marker = [NSString stringWithFormat:@"console capture test %@", [NSUUID UUID].UUIDString];
+    printf("%s\n", marker.UTF8String);
+
+    NSArray* lines = nil;
+    for(int i = 0; i < 50 && ![lines containsObject:marker]; i++)
+    {
+        [NSThread sleepForTimeInterval:0.05];
+        lines = [NSMutableArray array];
+        vicrabcrashconsole_forEachLine(vicrabcrashconsole_getCapture(), collectLine, (__bridge void*)lines);
+    }
+    vicrabcrashconsole_stop();
+
+    XCTAssertTrue([lines containsObject:marker], @"");
+    XCTAssertTrue(vicrabcrashconsole_getCapture() == NULL, @"");
+}
+
+@end
@@ -0,0 +1,146 @@
+//
+//  VicrabCrashContextRing_Tests.m
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+
+#import "FileBasedTestCase.h"
+
+#import "VicrabCrashContextRing.h"
+#import "VicrabCrashDebug.h"
+#import "VicrabCrashReportStore.h"
+
+
+@interface VicrabCrashContextRing_Tests : FileBasedTestCase
+
+@property(nonatomic,readwrite,retain) NSString* contextPath;
+
+@end
+
+
+@implementation VicrabCrashContextRing_Tests
+
+@synthesize contextPath = _contextPath;
+
+- (void) setUp
+{
+    [super setUp];
+    NSString* reportsPath = [self.tempPath stringByAppendingPathComponent:@"Reports"];
+    vicrabcrashcrs_initialize("myapp", reportsPath.UTF8String);
+    self.contextPath = [self.tempPath stringByAppendingPathComponent:@"Context"];
+}
+
+- (void) tearDown
+{
+    vicrabcrashctx_close();
+    [super tearDown];
+}
+
+/** End the current "launch" without touching its context, then start the next. */
+- (void) relaunch
+{
+    vicrabcrashctx_close();
+    XCTAssertTrue(vicrabcrashctx_initialize(self.contextPath.UTF8String), @"");
+}
+
+- (NSDictionary*) onlyReport
+{
+    int64_t reportID = 0;
+    XCTAssertEqual(vicrabcrashcrs_getReportIDs(&reportID, 1), 1, @"");
+    char* reportBytes = vicrabcrashcrs_readReport(reportID);
+    XCTAssertTrue(reportBytes != NULL, @"");
+    if(reportBytes == NULL)
+    {
+        return nil;
+    }
+    NSData* data = [NSData dataWithBytesNoCopy:reportBytes length:strlen(reportBytes) freeWhenDone:YES];
+    return [NSJSONSerialization JSONObjectWithData:data options:0 error:nil];
+}
+
+- (void) testCleanExitIsNotReported
+{
+    XCTAssertTrue(vicrabcrashctx_initialize(self.contextPath.UTF8String), @"");
+    vicrabcrashctx_addEvent("test", "an event");
+    vicrabcrashctx_notifyCleanExit();
+    [self relaunch];
+    XCTAssertEqual(vicrabcrashcrs_getReportCount(), 0, @"");
+}
+
+- (void) testUncleanExitIsReported
+{
+    if(vicrabcrashdebug_isBeingTraced())
+    {
+        // Launches under a debugger are never reported.
+        return;
+    }
+    XCTAssertTrue(vicrabcrashctx_initialize(self.contextPath.UTF8String), @"");
+    vicrabcrashctx_setUserInfoJSON("{\"a\":1}");
+    vicrabcrashctx_addEvent("first", "an event");
+    vicrabcrashctx_addEvent("second", NULL);
+    [self relaunch];
+    XCTAssertEqual(vicrabcrashcrs_getReportCount(), 1, @"");
+
+    NSDictionary* report = [self onlyReport];
+    XCTAssertEqualObjects(report[@"crash"][@"error"][@"type"], @"unexpected_termination", @"");
+    XCTAssertEqualObjects(report[@"user"], @{@"a": @1}, @"");
+    NSArray* events = report[@"recent_events"];
+    XCTAssertEqual(events.count, 2u, @"");
+    XCTAssertEqualObjects(events[0][@"category"], @"first", @"");
+    XCTAssertEqualObjects(events[0][@"message"], @"an event", @"");
+    XCTAssertEqualObjects(events[1][@"category"], @"second", @"");
+    XCTAssertNil(events[1][@"message"], @"");
+
+    // The new launch starts out clean, so it isn't reported again.
+    vicrabcrashctx_notifyCleanExit();
+    [self relaunch];
+    XCTAssertEqual(vicrabcrashcrs_getReportCount(), 1, @"");
+}
+
+- (void) testHandledCrashIsNotReportedAgain
+{
+    XCTAssertTrue(vicrabcrashctx_initialize(self.contextPath.UTF8String), @"");
+    vicrabcrashctx_addEvent("test", "an event");
+    vicrabcrashctx_notifyCrashHandled();
+    // A clean exit after the crash handler ran doesn't change anything either.
+    vicrabcrashctx_notifyCleanExit();
+    [self relaunch];
+    XCTAssertEqual(vicrabcrashcrs_getReportCount(), 0, @"");
+}
+
+- (void) testDamagedContextFileIsNotReported
+{
+    // A damaged file is never reported.
+    NSString* contextPath = [self generateFileWithString:@"not a context file"];
+    XCTAssertTrue(vicrabcrashctx_initialize(contextPath.UTF8String), @"");
+    XCTAssertEqual(vicrabcrashcrs_getReportCount(), 0, @"");
+
+    vicrabcrashctx_addEvent("test", "an event");
+    vicrabcrashctx_addEvent("test", NULL);
+    vicrabcrashctx_setUserInfoJSON("{\"a\":1}");
+    vicrabcrashctx_notifyCleanExit();
+    XCTAssertEqual(vicrabcrashcrs_getReportCount(), 0, @"");
+}
+
+@end
@@ -30,6 +30,9 @@
 
 #import "VicrabCrashLogger.h"
 
+// The C logger isn't visible from Objective-C.
+void i_vicrabcrashlog_logC(const char* level, const char* file, int line, const char* function, const char* fmt, ...);
+
 
 @interface VicrabCrashLogger_Tests : XCTestCase
 
@@ -118,4 +121,50 @@
     XCTAssertEqualObjects(result, expected, @"");
 }
 
+- (NSString*) logContentsOfFile:(NSString*) filename afterLogging:(void (^)(void)) block
+{
+    NSString* logFileName = [self.tempDir stringByAppendingPathComponent:filename];
+    vicrabcrashlog_setLogFilename([logFileName UTF8String], true);
+    block();
+    vicrabcrashlog_setLogFilename(nil, true);
+    return [NSString stringWithContentsOfFile:logFileName encoding:NSUTF8StringEncoding error:nil];
+}
+
+- (void) testDeferredWritingMatchesImmediate
+{
+    void (^logEntries)(void) = ^{
+        i_vicrabcrashlog_logC("INFO ", __FILE__, __LINE__, __PRETTY_FUNCTION__,
+                              "%d %5u %llx %s [%-4s] %.2f %p %%", -1, 2u, 0xabcULL, "str", "ab", 1.5, (void*)0x10);
+        i_vicrabcrashlog_logC("WARN ", __FILE__, __LINE__, __PRETTY_FUNCTION__, "[%*d] [%.*s]", 4, 7, 2, "xyz");
+    };
+    vicrabcrashlog_setDeferredWriting(false);
+    NSString* immediate = [self logContentsOfFile:@"immediate.txt" afterLogging:logEntries];
+
+    XCTAssertTrue(vicrabcrashlog_setDeferredWriting(true), @"");
+    NSString* deferred = [self logContentsOfFile:@"deferred.txt" afterLogging:^{
+        logEntries();
+        vicrabcrashlog_flush();
+    }];
+    vicrabcrashlog_setDeferredWriting(false);
+
+    XCTAssertTrue(immediate.length > 0, @"");
+    XCTAssertEqualObjects(deferred, immediate, @"");
+}
+
+- (void) testDeferredWritingCopiesStrings
+{
+    XCTAssertTrue(vicrabcrashlog_setDeferredWriting(true), @"");
+    NSString* result = [self logContentsOfFile:@"log.txt" afterLogging:^{
+        char buffer[20];
+        strcpy(buffer, "original");
+        i_vicrabcrashlog_logC("INFO ", __FILE__, __LINE__, __PRETTY_FUNCTION__, "%s", buffer);
+        strcpy(buffer, "overwritten");
+        vicrabcrashlog_flush();
+    }];
+    vicrabcrashlog_setDeferredWriting(false);
+
+    XCTAssertTrue([result containsString:@"original"], @"");
+    XCTAssertFalse([result containsString:@"overwritten"], @"");
+}
+
 @end
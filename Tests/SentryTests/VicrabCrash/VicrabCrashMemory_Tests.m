@@ -27,9 +27,12 @@
 
 #import <XCTest/XCTest.h>
 
+#import "VicrabCrashMachineContext.h"
 #import "VicrabCrashMemory.h"
 #import "TestThread.h"
 
+#include <sys/mman.h>
+
 
 @interface VicrabCrashMemory_Tests : XCTestCase @end
 
@@ -93,4 +96,71 @@
     XCTAssertTrue(copied == 0, @"");
 }
 
+- (void) testCachedProbingStopsAtProtectedPage
+{
+    int pageSize = getpagesize();
+    char* pages = mmap(NULL, (size_t)pageSize * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    XCTAssertTrue(pages != MAP_FAILED, @"");
+    memset(pages, 'x', (size_t)pageSize);
+    mprotect(pages + pageSize, (size_t)pageSize, PROT_NONE);
+    char* buff = malloc((size_t)pageSize * 2);
+
+    // No asserts while other threads are suspended: they may hold locks.
+    vicrabcrashmc_suspendEnvironment();
+    vicrabcrashmem_beginCachedProbing();
+    bool isPageReadable = vicrabcrashmem_isMemoryReadable(pages, pageSize);
+    bool isPastPageReadable = vicrabcrashmem_isMemoryReadable(pages, pageSize + 1);
+    int maxReadable = vicrabcrashmem_maxReadableBytes(pages, pageSize * 2);
+    int copied = vicrabcrashmem_copyMaxPossible(pages, buff, pageSize * 2);
+    bool isProtectedCopied = vicrabcrashmem_copySafely(pages + pageSize, buff, 1);
+    bool isNullCopied = vicrabcrashmem_copySafely(NULL, buff, 1);
+    vicrabcrashmem_endCachedProbing();
+    vicrabcrashmc_resumeEnvironment();
+
+    XCTAssertTrue(isPageReadable, @"");
+    XCTAssertFalse(isPastPageReadable, @"");
+    XCTAssertEqual(maxReadable, pageSize, @"");
+    XCTAssertEqual(copied, pageSize, @"");
+    XCTAssertFalse(isProtectedCopied, @"");
+    XCTAssertFalse(isNullCopied, @"");
+
+    free(buff);
+    munmap(pages, (size_t)pageSize * 2);
+}
+
+- (void) testCachedProbingNoticesUnmap
+{
+    int pageSize = getpagesize();
+    char* page = mmap(NULL, (size_t)pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    XCTAssertTrue(page != MAP_FAILED, @"");
+    char buff[16];
+
+    // No asserts while other threads are suspended: they may hold locks.
+    vicrabcrashmc_suspendEnvironment();
+    vicrabcrashmem_beginCachedProbing();
+    bool isReadableBefore = vicrabcrashmem_isMemoryReadable(page, sizeof(buff));
+    munmap(page, (size_t)pageSize);
+    bool isCopied = vicrabcrashmem_copySafely(page, buff, sizeof(buff));
+    bool isReadableAfter = vicrabcrashmem_isMemoryReadable(page, sizeof(buff));
+    vicrabcrashmem_endCachedProbing();
+    vicrabcrashmc_resumeEnvironment();
+
+    XCTAssertTrue(isReadableBefore, @"");
+    XCTAssertFalse(isCopied, @"");
+    XCTAssertFalse(isReadableAfter, @"");
+}
+
+- (void) testProbingIsNotCachedWhileThreadsRun
+{
+    int pageSize = getpagesize();
+    char* page = mmap(NULL, (size_t)pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    XCTAssertTrue(page != MAP_FAILED, @"");
+
+    vicrabcrashmem_beginCachedProbing();
+    XCTAssertTrue(vicrabcrashmem_isMemoryReadable(page, pageSize), @"");
+    munmap(page, (size_t)pageSize);
+    XCTAssertFalse(vicrabcrashmem_isMemoryReadable(page, pageSize), @"");
+    vicrabcrashmem_endCachedProbing();
+}
+
 @end
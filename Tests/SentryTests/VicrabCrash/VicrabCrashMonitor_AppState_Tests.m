@@ -635,4 +635,43 @@
     XCTAssertTrue(context.crashedLastLaunch, @"");
 }
 
+- (void) testMigrateJSONState
+{
+    NSString* stateFile = [self.tempPath stringByAppendingPathComponent:@"state.json"];
+    NSString* json = @"{\"version\":1,\"crashedLastLaunch\":false,"
+                     @"\"activeDurationSinceLastCrash\":12.5,\"backgroundDurationSinceLastCrash\":3,"
+                     @"\"launchesSinceLastCrash\":7,\"sessionsSinceLastCrash\":9}";
+    [json writeToFile:stateFile atomically:YES encoding:NSUTF8StringEncoding error:nil];
+
+    [self initializeCrashState];
+    VicrabCrash_AppState context = *vicrabcrashstate_currentState();
+
+    XCTAssertEqual(context.activeDurationSinceLastCrash, 12.5, @"");
+    XCTAssertEqual(context.backgroundDurationSinceLastCrash, 3.0, @"");
+    XCTAssertEqual(context.launchesSinceLastCrash, 8, @"");
+    XCTAssertEqual(context.sessionsSinceLastCrash, 10, @"");
+    XCTAssertFalse(context.crashedLastLaunch, @"");
+
+    NSData* data = [NSData dataWithContentsOfFile:stateFile];
+    XCTAssertNotEqual(((const char*)data.bytes)[0], '{', @"");
+
+    [self initializeCrashState];
+    context = *vicrabcrashstate_currentState();
+
+    XCTAssertEqual(context.activeDurationSinceLastCrash, 12.5, @"");
+    XCTAssertEqual(context.launchesSinceLastCrash, 9, @"");
+}
+
+- (void) testCorruptStateStartsOver
+{
+    NSString* stateFile = [self.tempPath stringByAppendingPathComponent:@"state.json"];
+    [@"not a state file" writeToFile:stateFile atomically:YES encoding:NSUTF8StringEncoding error:nil];
+
+    [self initializeCrashState];
+    VicrabCrash_AppState context = *vicrabcrashstate_currentState();
+
+    XCTAssertEqual(context.launchesSinceLastCrash, 1, @"");
+    XCTAssertFalse(context.crashedLastLaunch, @"");
+}
+
 @end
@@ -0,0 +1,142 @@
+//
+//  VicrabCrashMonitor_Hang_Tests.m
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#import <XCTest/XCTest.h>
+
+#import "VicrabCrashMonitor.h"
+#import "VicrabCrashMonitorContext.h"
+#import "VicrabCrashMonitor_Hang.h"
+#import "VicrabCrashThread.h"
+
+
+static int g_eventCount;
+static int g_crashType;
+static bool g_isFatal;
+static uint64_t g_durationNanoseconds;
+static int g_capturedThreadCount;
+static VicrabCrashThread g_capturedThread;
+static bool g_isCapturedThreadCrashed;
+static int g_sampleCount;
+static int g_totalSampleCount;
+static int g_firstSampleCount;
+
+static void onEvent(struct VicrabCrash_MonitorContext* monitorContext)
+{
+    g_crashType = monitorContext->crashType;
+    g_isFatal = monitorContext->isFatal;
+    g_durationNanoseconds = monitorContext->hang.durationNanoseconds;
+    g_capturedThreadCount = monitorContext->capturedThreadCount;
+    if(g_capturedThreadCount > 0)
+    {
+        g_capturedThread = monitorContext->capturedThreads[0].thread;
+        g_isCapturedThreadCrashed = monitorContext->capturedThreads[0].crashed;
+    }
+    g_sampleCount = monitorContext->hang.sampleCount;
+    g_totalSampleCount = monitorContext->hang.totalSampleCount;
+    g_firstSampleCount = g_sampleCount > 0 ? monitorContext->hang.samples[0].count : 0;
+    g_eventCount++;
+}
+
+static void runMainLoop(NSTimeInterval seconds)
+{
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:seconds]];
+}
+
+
+@interface VicrabCrashMonitor_Hang_Tests : XCTestCase @end
+
+
+@implementation VicrabCrashMonitor_Hang_Tests
+
+- (void) setUp
+{
+    [super setUp];
+    g_eventCount = 0;
+    g_sampleCount = 0;
+    g_totalSampleCount = 0;
+    vicrabcrashcm_setEventCallback(onEvent);
+    vicrabcrashcm_setHangThresholds(0.1, 0.01);
+}
+
+- (void) tearDown
+{
+    vicrabcrashcm_hang_getAPI()->setEnabled(false);
+    vicrabcrashcm_setHangThresholds(0.25, 0.05);
+    [super tearDown];
+}
+
+- (void) testInstallAndRemove
+{
+    VicrabCrashMonitorAPI* api = vicrabcrashcm_hang_getAPI();
+    api->setEnabled(true);
+    XCTAssertTrue(api->isEnabled());
+    api->setEnabled(false);
+    XCTAssertFalse(api->isEnabled());
+}
+
+- (void) testStalledPingIsReportedOnce
+{
+    VicrabCrashMonitorAPI* api = vicrabcrashcm_hang_getAPI();
+    api->setEnabled(true);
+    // Answer a few pings, so the monitor knows which thread to sample.
+    runMainLoop(0.3);
+    XCTAssertEqual(g_eventCount, 0);
+
+    // The main thread can't answer the outstanding ping while it sleeps.
+    VicrabCrashThread mainThread = vicrabcrashthread_self();
+    [NSThread sleepForTimeInterval:0.5];
+
+    // Answering ends the hang. Later pings are answered promptly, so there
+    // must not be a second report for the same stall.
+    runMainLoop(0.5);
+    api->setEnabled(false);
+
+    XCTAssertEqual(g_eventCount, 1);
+    XCTAssertEqual(g_crashType, VicrabCrashMonitorTypeMainThreadHang);
+    XCTAssertFalse(g_isFatal);
+    XCTAssertTrue(g_durationNanoseconds >= 400000000ULL);
+    XCTAssertTrue(g_durationNanoseconds < 2000000000ULL);
+    XCTAssertEqual(g_capturedThreadCount, 1);
+    XCTAssertEqual(g_capturedThread, mainThread);
+    XCTAssertTrue(g_isCapturedThreadCrashed);
+
+    // The main thread sat in the same sleep for every sample, so they all
+    // collapse into one backtrace.
+    XCTAssertTrue(g_totalSampleCount > 1);
+    XCTAssertEqual(g_sampleCount, 1);
+    XCTAssertEqual(g_firstSampleCount, g_totalSampleCount);
+}
+
+- (void) testResponsiveMainThreadIsNotReported
+{
+    VicrabCrashMonitorAPI* api = vicrabcrashcm_hang_getAPI();
+    api->setEnabled(true);
+    runMainLoop(0.5);
+    api->setEnabled(false);
+
+    XCTAssertEqual(g_eventCount, 0);
+}
+
+@end
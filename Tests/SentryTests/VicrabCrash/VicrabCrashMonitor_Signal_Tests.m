@@ -29,6 +29,42 @@
 
 #import "VicrabCrashMonitorContext.h"
 #import "VicrabCrashMonitor_Signal.h"
+#import "VicrabCrashMachineContext.h"
+#import "VicrabCrashReport.h"
+#import "VicrabCrashStackCursor_MachineContext.h"
+
+#import <pthread.h>
+#import <signal.h>
+
+#define kStackFillByte 0xa5
+
+static VicrabCrash_MonitorContext g_monitorContext;
+static VicrabCrashStackCursor g_stackCursor;
+static const char* g_reportPath;
+
+static void writeReportFromSignal(int sigNum, siginfo_t* signalInfo, void* userContext)
+{
+    VicrabCrashMC_NEW_CONTEXT(machineContext);
+    vicrabcrashmc_getContextForSignal(userContext, machineContext);
+    vicrabcrashsc_initWithMachineContext(&g_stackCursor, 100, machineContext);
+
+    memset(&g_monitorContext, 0, sizeof(g_monitorContext));
+    g_monitorContext.crashType = VicrabCrashMonitorTypeSignal;
+    g_monitorContext.eventID = "00000000-0000-0000-0000-000000000000";
+    g_monitorContext.offendingMachineContext = machineContext;
+    g_monitorContext.registersAreValid = true;
+    g_monitorContext.signal.userContext = userContext;
+    g_monitorContext.signal.signum = sigNum;
+    g_monitorContext.signal.sigcode = signalInfo->si_code;
+    g_monitorContext.stackCursor = &g_stackCursor;
+    vicrabcrashreport_writeStandardReport(&g_monitorContext, g_reportPath);
+}
+
+static void* readSignalStack(void* userData)
+{
+    sigaltstack(NULL, (stack_t*)userData);
+    return NULL;
+}
 
 
 @interface VicrabCrashMonitor_Signal_Tests : XCTestCase @end
@@ -61,4 +97,56 @@
     XCTAssertFalse(api->isEnabled());
 }
 
+- (void) testNewThreadGetsSignalStack
+{
+    VicrabCrashMonitorAPI* api = vicrabcrashcm_signal_getAPI();
+    api->setEnabled(true);
+
+    stack_t threadStack = {0};
+    pthread_t thread;
+    pthread_create(&thread, NULL, readSignalStack, &threadStack);
+    pthread_join(thread, NULL);
+    api->setEnabled(false);
+
+    XCTAssertFalse(threadStack.ss_flags & SS_DISABLE);
+    XCTAssertEqual(threadStack.ss_size, vicrabcrashcm_signal_stackSize());
+}
+
+- (void) testSignalStackFitsReportWriter
+{
+    VicrabCrashMonitorAPI* api = vicrabcrashcm_signal_getAPI();
+    api->setEnabled(true);
+
+    stack_t stack = {0};
+    sigaltstack(NULL, &stack);
+    XCTAssertFalse(stack.ss_flags & SS_DISABLE);
+    XCTAssertEqual(stack.ss_size, vicrabcrashcm_signal_stackSize());
+    memset(stack.ss_sp, kStackFillByte, stack.ss_size);
+
+    NSString* reportPath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"signal-stack-report.json"];
+    g_reportPath = reportPath.fileSystemRepresentation;
+    struct sigaction action = {{0}};
+    struct sigaction previous = {{0}};
+    action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+    action.sa_sigaction = writeReportFromSignal;
+    sigaction(SIGUSR2, &action, &previous);
+    raise(SIGUSR2);
+    sigaction(SIGUSR2, &previous, NULL);
+    api->setEnabled(false);
+
+    // The stack grows down, so everything above the first untouched byte was used.
+    const uint8_t* bytes = stack.ss_sp;
+    size_t untouched = 0;
+    while(untouched < stack.ss_size && bytes[untouched] == kStackFillByte)
+    {
+        untouched++;
+    }
+    size_t used = stack.ss_size - untouched;
+    XCTAssertTrue([[NSFileManager defaultManager] fileExistsAtPath:reportPath]);
+    XCTAssertGreaterThan(used, 0);
+    XCTAssertLessThan(used, stack.ss_size / 2, @"Report writer used %zu bytes of signal stack", used);
+    [[NSFileManager defaultManager] removeItemAtPath:reportPath error:nil];
+}
+
 @end
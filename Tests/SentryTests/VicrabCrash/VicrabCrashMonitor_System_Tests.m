@@ -0,0 +1,104 @@
+//
+//  VicrabCrashMonitor_System_Tests.m
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+
+#import <XCTest/XCTest.h>
+
+#import "VicrabCrashMonitor.h"
+#import "VicrabCrashMonitorContext.h"
+#import "VicrabCrashMonitor_System.h"
+
+
+@interface VicrabCrashMonitor_System_Tests : XCTestCase @end
+
+
+@implementation VicrabCrashMonitor_System_Tests
+
+- (void) testDeferredDataIsReportedOnceReady
+{
+    VicrabCrashMonitorAPI* api = vicrabcrashcm_system_getAPI();
+    api->setEnabled(true);
+    vicrabcrashcm_system_waitForDeferredData();
+
+    VicrabCrash_MonitorContext context = {0};
+    api->addContextualInfoToEvent(&context);
+    XCTAssertTrue(context.System.appStartTime != NULL, @"");
+    XCTAssertTrue(context.System.cpuArchitecture != NULL, @"");
+    XCTAssertTrue(context.System.deviceAppHash != NULL, @"");
+    XCTAssertTrue(context.System.buildType != NULL, @"");
+    XCTAssertTrue(context.System.storageSize > 0, @"");
+}
+
+- (void) testLazyCollectionIsFasterThanEager
+{
+    vicrabcrashcm_system_getAPI()->setEnabled(true);
+    vicrabcrashcm_system_waitForDeferredData();
+
+    double essentialSeconds = 0;
+    double deferredSeconds = 0;
+    vicrabcrashcm_system_getCollectionTimes(&essentialSeconds, &deferredSeconds);
+    double eagerSeconds = essentialSeconds + deferredSeconds;
+    NSLog(@"System info: install blocks for %.2f ms (lazy), would block for %.2f ms (eager)",
+          essentialSeconds * 1000, eagerSeconds * 1000);
+    XCTAssertGreaterThan(deferredSeconds, 0.0, @"");
+    XCTAssertLessThan(essentialSeconds, eagerSeconds, @"");
+}
+
+- (void) testResourceSamplesAreCopied
+{
+    VicrabCrashMonitorAPI* api = vicrabcrashcm_system_getAPI();
+    api->setEnabled(true);
+    vicrabcrashcm_system_sampleResourcesNow();
+    vicrabcrashcm_system_sampleResourcesNow();
+
+    VicrabCrash_MonitorContext context = {0};
+    api->addContextualInfoToEvent(&context);
+    int count = context.System.resourceSampleCount;
+    XCTAssertGreaterThanOrEqual(count, 2, @"");
+    XCTAssertLessThanOrEqual(count, VicrabCrashCM_MAX_RESOURCE_SAMPLES, @"");
+    XCTAssertGreaterThanOrEqual(context.System.resourceSamples[count - 1].timestamp,
+                                context.System.resourceSamples[count - 2].timestamp, @"");
+    XCTAssertEqual(context.System.freeMemory, context.System.resourceSamples[count - 1].freeMemory, @"");
+    XCTAssertGreaterThan(context.System.freeMemory, 0ull, @"");
+    XCTAssertGreaterThan(context.System.freeStorage, 0ull, @"");
+}
+
+- (void) testSamplesWrapAround
+{
+    VicrabCrashMonitorAPI* api = vicrabcrashcm_system_getAPI();
+    api->setEnabled(true);
+    for(int i = 0; i < VicrabCrashCM_MAX_RESOURCE_SAMPLES * 2; i++)
+    {
+        vicrabcrashcm_system_sampleResourcesNow();
+    }
+
+    VicrabCrash_MonitorContext context = {0};
+    api->addContextualInfoToEvent(&context);
+    XCTAssertEqual(context.System.resourceSampleCount, VicrabCrashCM_MAX_RESOURCE_SAMPLES, @"");
+}
+
+@end
@@ -0,0 +1,182 @@
+//
+//  VicrabCrashMonitor_User_Tests.m
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#import <XCTest/XCTest.h>
+
+#import "VicrabCrashMonitor.h"
+#import "VicrabCrashMonitorContext.h"
+#import "VicrabCrashMonitor_User.h"
+
+
+static int g_crashType;
+static int g_capturedThreadCount;
+static char g_name[100];
+static int g_eventCount;
+static bool g_isFatal;
+static const char* g_reportPath;
+
+static void onEvent(struct VicrabCrash_MonitorContext* monitorContext)
+{
+    g_crashType = monitorContext->crashType;
+    g_capturedThreadCount = monitorContext->capturedThreadCount;
+    g_isFatal = monitorContext->isFatal;
+    strlcpy(g_name, monitorContext->userException.name, sizeof(g_name));
+    g_eventCount++;
+    if(g_reportPath != NULL && monitorContext->reportPathBuffer != NULL)
+    {
+        NSString* report = [NSString stringWithFormat:@"{\"user_reported\": {\"occurrences\": %-10d, \"name\": \"%s\"}}",
+                            monitorContext->userException.occurrences,
+                            monitorContext->userException.name];
+        [report writeToFile:@(g_reportPath) atomically:NO encoding:NSUTF8StringEncoding error:nil];
+        strlcpy(monitorContext->reportPathBuffer, g_reportPath, (size_t)monitorContext->reportPathBufferLength);
+    }
+}
+
+static bool reportFromSameSite(const char* name)
+{
+    return vicrabcrashcm_reportUserException(name, "a reason", "C", NULL, "[]", false, false, false);
+}
+
+static bool snapshotFromSameSite(void)
+{
+    return vicrabcrashcm_reportUserException("Snapshot", "a reason", "C", NULL, "[]", false, false, true);
+}
+
+static bool g_isWritten;
+
+static void onCompletion(bool isWritten, void* userData)
+{
+    g_isWritten = isWritten;
+    dispatch_semaphore_signal((__bridge dispatch_semaphore_t)userData);
+}
+
+
+@interface VicrabCrashMonitor_User_Tests : XCTestCase @end
+
+
+@implementation VicrabCrashMonitor_User_Tests
+
+- (void) setUp
+{
+    [super setUp];
+    g_eventCount = 0;
+    g_reportPath = NULL;
+    g_isWritten = false;
+    vicrabcrashcm_setUserReportRateLimit(10, 1);
+}
+
+- (void) testReportAsync
+{
+    VicrabCrashMonitorAPI* api = vicrabcrashcm_user_getAPI();
+    vicrabcrashcm_setEventCallback(onEvent);
+    api->setEnabled(true);
+
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    vicrabcrashcm_reportUserExceptionAsync("TestName", "a reason", "C", NULL, "[]", true, false,
+                                           onCompletion, (__bridge void*)semaphore);
+    long result = dispatch_semaphore_wait(semaphore, dispatch_time(DISPATCH_TIME_NOW, 5 * NSEC_PER_SEC));
+
+    api->setEnabled(false);
+    XCTAssertEqual(result, 0);
+    XCTAssertTrue(g_isWritten);
+    XCTAssertEqual(g_crashType, VicrabCrashMonitorTypeUserReported);
+    XCTAssertFalse(g_isFatal);
+    XCTAssertTrue(g_capturedThreadCount >= 1);
+    XCTAssertEqual(strcmp(g_name, "TestName"), 0);
+}
+
+- (void) testReportAsyncWhenDisabledStillCompletes
+{
+    VicrabCrashMonitorAPI* api = vicrabcrashcm_user_getAPI();
+    api->setEnabled(false);
+    g_isWritten = true;
+
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    vicrabcrashcm_reportUserExceptionAsync("TestName", "a reason", "C", NULL, "[]", false, false,
+                                           onCompletion, (__bridge void*)semaphore);
+    XCTAssertEqual(dispatch_semaphore_wait(semaphore, DISPATCH_TIME_NOW), 0);
+    XCTAssertFalse(g_isWritten);
+}
+
+- (void) testDuplicatesAreCountedIntoExistingReport
+{
+    NSString* path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"user-report.json"];
+    g_reportPath = path.UTF8String;
+    VicrabCrashMonitorAPI* api = vicrabcrashcm_user_getAPI();
+    vicrabcrashcm_setEventCallback(onEvent);
+    api->setEnabled(true);
+
+    for(int i = 0; i < 5; i++)
+    {
+        reportFromSameSite("Duplicate");
+    }
+
+    api->setEnabled(false);
+    XCTAssertEqual(g_eventCount, 1);
+    NSData* data = [NSData dataWithContentsOfFile:path];
+    NSDictionary* report = [NSJSONSerialization JSONObjectWithData:data options:0 error:nil];
+    XCTAssertEqualObjects(report[@"user_reported"][@"occurrences"], @5);
+    XCTAssertEqualObjects(report[@"user_reported"][@"name"], @"Duplicate");
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+- (void) testRateLimitDropsExcessReports
+{
+    vicrabcrashcm_setUserReportRateLimit(2, 0);
+    VicrabCrashMonitorAPI* api = vicrabcrashcm_user_getAPI();
+    vicrabcrashcm_setEventCallback(onEvent);
+    api->setEnabled(true);
+
+    XCTAssertTrue(reportFromSameSite("First"));
+    XCTAssertTrue(reportFromSameSite("Second"));
+    XCTAssertFalse(reportFromSameSite("Third"));
+    XCTAssertFalse(reportFromSameSite("Fourth"));
+
+    api->setEnabled(false);
+    XCTAssertEqual(g_eventCount, 2);
+    XCTAssertFalse(g_isFatal);
+}
+
+- (void) testBypassingRateLimitAlwaysWrites
+{
+    vicrabcrashcm_setUserReportRateLimit(1, 0);
+    VicrabCrashMonitorAPI* api = vicrabcrashcm_user_getAPI();
+    vicrabcrashcm_setEventCallback(onEvent);
+    api->setEnabled(true);
+
+    XCTAssertTrue(reportFromSameSite("First"));
+    XCTAssertFalse(reportFromSameSite("Second"));
+    for(int i = 0; i < 3; i++)
+    {
+        XCTAssertTrue(snapshotFromSameSite());
+    }
+
+    api->setEnabled(false);
+    XCTAssertEqual(g_eventCount, 4);
+}
+
+@end
@@ -0,0 +1,89 @@
+//
+//  VicrabCrashMonitor_Zombie_Tests.m
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+
+#import <XCTest/XCTest.h>
+
+#import "VicrabCrashMonitor_Zombie.h"
+
+
+#define kDeallocCount 200000
+
+
+@interface VicrabCrashMonitor_Zombie_Tests : XCTestCase @end
+
+
+@implementation VicrabCrashMonitor_Zombie_Tests
+
+- (double) secondsToDeallocObjects
+{
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    for(int i = 0; i < kDeallocCount; i++)
+    {
+        @autoreleasepool
+        {
+            NSObject* object = [NSObject new];
+            (void)object;
+        }
+    }
+    return CFAbsoluteTimeGetCurrent() - startTime;
+}
+
+- (void) testDeallocThroughput
+{
+    VicrabCrashMonitorAPI* api = vicrabcrashcm_zombie_getAPI();
+    // The dealloc hooks can't be removed, so the baseline only exists before the first install.
+    double disabledSeconds = api->isEnabled() ? 0 : [self secondsToDeallocObjects];
+
+    api->setEnabled(true);
+    vicrabcrashzombie_setSamplingRate(1);
+    double enabledSeconds = [self secondsToDeallocObjects];
+    vicrabcrashzombie_setSamplingRate(16);
+    double sampledSeconds = [self secondsToDeallocObjects];
+    vicrabcrashzombie_setSamplingRate(1);
+
+    NSLog(@"%d deallocs: %.1f ms disabled, %.1f ms enabled, %.1f ms sampling 1 in 16",
+          kDeallocCount, disabledSeconds * 1000, enabledSeconds * 1000, sampledSeconds * 1000);
+    XCTAssertGreaterThan(enabledSeconds, 0.0, @"");
+}
+
+- (void) testTracksDeallocatedObject
+{
+    vicrabcrashzombie_setSamplingRate(1);
+    vicrabcrashcm_zombie_getAPI()->setEnabled(true);
+
+    const void* address = NULL;
+    @autoreleasepool
+    {
+        NSObject* object = [NSObject new];
+        address = (__bridge const void*)object;
+    }
+    const char* className = vicrabcrashzombie_className(address);
+    XCTAssertTrue(className != NULL && strcmp(className, "NSObject") == 0, @"");
+}
+
+@end
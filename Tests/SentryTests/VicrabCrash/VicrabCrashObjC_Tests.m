@@ -28,6 +28,7 @@
 #import <XCTest/XCTest.h>
 #import <objc/runtime.h>
 
+#import "VicrabCrashMachineContext.h"
 #import "VicrabCrashObjC.h"
 
 
@@ -759,6 +760,32 @@ static NSArray* g_test_strings;
     XCTAssertTrue(isValid, @"Not a class");
 }
 
+- (void) testCachedClassAnswersTheSame
+{
+    NSString* string = [NSString stringWithFormat:@"%@", [NSDate date]];
+    void* stringPtr = (__bridge void*)string;
+    void* classPtr = (__bridge void*)[SomeSubclass class];
+    bool isSameEveryTime = true;
+
+    // No asserts while other threads are suspended: they may hold locks.
+    vicrabcrashmc_suspendEnvironment();
+    vicrabcrashobjc_beginClassCache();
+    for(int i = 0; i < 3; i++)
+    {
+        isSameEveryTime = isSameEveryTime &&
+                          vicrabcrashobjc_objectType(classPtr) == VicrabCrashObjCTypeClass &&
+                          vicrabcrashobjc_isValidObject(stringPtr) &&
+                          vicrabcrashobjc_objectClassType(stringPtr) == VicrabCrashObjCClassTypeString &&
+                          vicrabcrashobjc_isKindOfClass(classPtr, "NSObject");
+    }
+    vicrabcrashobjc_endClassCache();
+    vicrabcrashmc_resumeEnvironment();
+
+    XCTAssertTrue(isSameEveryTime, @"");
+    XCTAssertEqual(vicrabcrashobjc_objectType(classPtr), VicrabCrashObjCTypeClass, @"");
+    XCTAssertEqual(vicrabcrashobjc_objectClassType(stringPtr), VicrabCrashObjCClassTypeString, @"");
+}
+
 - (void) testUntrackedClassDescription
 {
     SomeObjCClass* instance = [[SomeObjCClass alloc] init];
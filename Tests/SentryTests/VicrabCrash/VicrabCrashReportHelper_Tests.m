@@ -0,0 +1,110 @@
+//
+//  VicrabCrashReportHelper_Tests.m
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#import <XCTest/XCTest.h>
+
+#import "VicrabCrashMachineContext.h"
+#import "VicrabCrashMemory.h"
+#import "VicrabCrashMonitorContext.h"
+#import "VicrabCrashReportHelper.h"
+#import "VicrabCrashSystemCapabilities.h"
+
+
+@interface VicrabCrashReportHelper_Tests : XCTestCase @end
+
+
+@implementation VicrabCrashReportHelper_Tests
+
+#if VicrabCrashCRASH_HOST_LINUX
+
+- (BOOL) writeSignalReportToPath:(NSString*) path
+{
+    VicrabCrashMC_NEW_CONTEXT(machineContext);
+    vicrabcrashmc_getContextForThread(vicrabcrashthread_self(), machineContext, false);
+    VicrabCrash_MonitorContext context = {0};
+    context.crashType = VicrabCrashMonitorTypeSignal;
+    context.eventID = "00000000-0000-0000-0000-000000000001";
+    context.crashReason = "test";
+    context.offendingMachineContext = machineContext;
+    context.signal.signum = SIGSEGV;
+    return vicrabcrashrh_writeStandardReport(&context, path.UTF8String);
+}
+
+- (void) testHelperWritesSignalReport
+{
+    NSString* path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"helper-report.json"];
+    XCTAssertTrue(vicrabcrashrh_start(), @"");
+    XCTAssertTrue(vicrabcrashrh_isRunning(), @"");
+    XCTAssertTrue([self writeSignalReportToPath:path], @"");
+    vicrabcrashrh_stop();
+    XCTAssertFalse(vicrabcrashrh_isRunning(), @"");
+
+    NSData* data = [NSData dataWithContentsOfFile:path];
+    NSDictionary* report = [NSJSONSerialization JSONObjectWithData:data options:0 error:nil];
+    XCTAssertEqualObjects(report[@"crash"][@"error"][@"type"], @"signal", @"");
+    XCTAssertEqualObjects(report[@"crash"][@"error"][@"signal"][@"name"], @"SIGSEGV", @"");
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+- (void) testHelperDoesNotKeepInheritedDescriptors
+{
+    int fds[2];
+    XCTAssertEqual(pipe(fds), 0, @"");
+    XCTAssertTrue(vicrabcrashrh_start(), @"");
+    close(fds[1]);
+    // If the helper still held the write end, this would block.
+    char byte;
+    XCTAssertEqual(read(fds[0], &byte, 1), 0, @"");
+    close(fds[0]);
+    vicrabcrashrh_stop();
+}
+
+#else
+
+- (void) testStartIsUnsupported
+{
+    XCTAssertFalse(vicrabcrashrh_start(), @"");
+    XCTAssertFalse(vicrabcrashrh_isRunning(), @"");
+    vicrabcrashrh_stop();
+}
+
+#endif
+
+- (void) testWriteFallsBackWithoutHelper
+{
+    VicrabCrash_MonitorContext context = {0};
+    context.crashType = VicrabCrashMonitorTypeSignal;
+    XCTAssertFalse(vicrabcrashrh_writeStandardReport(&context, "/nonexistent/report.json"), @"");
+}
+
+- (void) testOnlyOwnMemoryCanBeTargeted
+{
+    XCTAssertTrue(vicrabcrashmem_setTargetProcess(0), @"");
+    XCTAssertFalse(vicrabcrashmem_setTargetProcess(getppid()), @"");
+}
+
+@end
@@ -0,0 +1,122 @@
+//
+//  VicrabCrashRingBuffer_Tests.m
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#import <XCTest/XCTest.h>
+
+#import "VicrabCrashRingBuffer.h"
+
+
+@interface VicrabCrashRingBuffer_Tests : XCTestCase @end
+
+
+@implementation VicrabCrashRingBuffer_Tests
+
+- (void) testReadsRecordsInOrder
+{
+    uintptr_t storage[16];
+    VicrabCrashRingBuffer ring;
+    vicrabcrashring_init(&ring, storage, 16);
+
+    uintptr_t first[] = {1, 2, 3};
+    uintptr_t second[] = {4};
+    XCTAssertTrue(vicrabcrashring_write(&ring, first, 3), @"");
+    XCTAssertTrue(vicrabcrashring_write(&ring, second, 1), @"");
+
+    uintptr_t words[8];
+    XCTAssertEqual(vicrabcrashring_read(&ring, words, 8), 3, @"");
+    XCTAssertEqual(words[0], (uintptr_t)1, @"");
+    XCTAssertEqual(words[2], (uintptr_t)3, @"");
+    XCTAssertEqual(vicrabcrashring_read(&ring, words, 8), 1, @"");
+    XCTAssertEqual(words[0], (uintptr_t)4, @"");
+    XCTAssertEqual(vicrabcrashring_read(&ring, words, 8), -1, @"");
+}
+
+- (void) testEmptyRecord
+{
+    uintptr_t storage[4];
+    VicrabCrashRingBuffer ring;
+    vicrabcrashring_init(&ring, storage, 4);
+
+    uintptr_t words[1];
+    XCTAssertTrue(vicrabcrashring_write(&ring, words, 0), @"");
+    XCTAssertEqual(vicrabcrashring_read(&ring, words, 1), 0, @"");
+    XCTAssertEqual(vicrabcrashring_read(&ring, words, 1), -1, @"");
+}
+
+- (void) testWrapsAround
+{
+    uintptr_t storage[8];
+    VicrabCrashRingBuffer ring;
+    vicrabcrashring_init(&ring, storage, 8);
+
+    uintptr_t words[3];
+    for(uintptr_t i = 0; i < 100; i++)
+    {
+        uintptr_t record[] = {i, i + 1, i + 2};
+        XCTAssertTrue(vicrabcrashring_write(&ring, record, 3), @"");
+        XCTAssertEqual(vicrabcrashring_read(&ring, words, 3), 3, @"");
+        XCTAssertEqual(words[0], i, @"");
+        XCTAssertEqual(words[2], i + 2, @"");
+    }
+}
+
+- (void) testTruncatesLongRecords
+{
+    uintptr_t storage[16];
+    VicrabCrashRingBuffer ring;
+    vicrabcrashring_init(&ring, storage, 16);
+
+    uintptr_t record[] = {1, 2, 3, 4, 5};
+    uintptr_t next[] = {6};
+    vicrabcrashring_write(&ring, record, 5);
+    vicrabcrashring_write(&ring, next, 1);
+
+    uintptr_t words[2];
+    XCTAssertEqual(vicrabcrashring_read(&ring, words, 2), 2, @"");
+    XCTAssertEqual(words[1], (uintptr_t)2, @"");
+    XCTAssertEqual(vicrabcrashring_read(&ring, words, 2), 1, @"");
+    XCTAssertEqual(words[0], (uintptr_t)6, @"");
+}
+
+- (void) testDropsWhenFull
+{
+    uintptr_t storage[8];
+    VicrabCrashRingBuffer ring;
+    vicrabcrashring_init(&ring, storage, 8);
+
+    uintptr_t record[] = {1, 2, 3};
+    XCTAssertTrue(vicrabcrashring_write(&ring, record, 3), @"");
+    XCTAssertTrue(vicrabcrashring_write(&ring, record, 3), @"");
+    XCTAssertFalse(vicrabcrashring_write(&ring, record, 3), @"");
+    XCTAssertEqual(atomic_load(&ring.droppedCount), (uint32_t)1, @"");
+
+    uintptr_t words[3];
+    XCTAssertEqual(vicrabcrashring_read(&ring, words, 3), 3, @"");
+    XCTAssertTrue(vicrabcrashring_write(&ring, record, 3), @"");
+}
+
+@end
@@ -0,0 +1,83 @@
+//
+//  VicrabCrashStackCursor_SelfThread_Tests.m
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#import <XCTest/XCTest.h>
+
+#import "VicrabCrashStackCursor_SelfThread.h"
+
+#include <execinfo.h>
+
+
+@interface VicrabCrashStackCursor_SelfThread_Tests : XCTestCase @end
+
+
+typedef struct
+{
+    uintptr_t framePointerBacktrace[20];
+    int framePointerLength;
+    void* backtrace[21];
+    int backtraceLength;
+} Backtraces;
+
+static __attribute__((noinline)) void captureBacktraces(Backtraces* backtraces, int skipEntries)
+{
+    backtraces->framePointerLength = vicrabcrashsc_copyFramePointerBacktrace(backtraces->framePointerBacktrace, 20, skipEntries);
+    backtraces->backtraceLength = backtrace(backtraces->backtrace, 21);
+}
+
+@implementation VicrabCrashStackCursor_SelfThread_Tests
+
+- (void) testFramePointerBacktraceMatchesBacktrace
+{
+    Backtraces backtraces;
+    captureBacktraces(&backtraces, 0);
+
+    // backtrace() also includes the frame inside captureBacktraces.
+    XCTAssertGreaterThan(backtraces.framePointerLength, 2, @"");
+    XCTAssertEqual(backtraces.framePointerLength, backtraces.backtraceLength - 1, @"");
+    for(int i = 0; i < backtraces.framePointerLength; i++)
+    {
+        XCTAssertEqual(backtraces.framePointerBacktrace[i], (uintptr_t)backtraces.backtrace[i + 1], @"Entry %d", i);
+    }
+}
+
+- (void) testSkipsEntries
+{
+    Backtraces backtraces;
+    captureBacktraces(&backtraces, 2);
+
+    XCTAssertGreaterThan(backtraces.framePointerLength, 0, @"");
+    XCTAssertEqual(backtraces.framePointerBacktrace[0], (uintptr_t)backtraces.backtrace[3], @"");
+}
+
+- (void) testStopsAtMaxLength
+{
+    uintptr_t addresses[2];
+    XCTAssertEqual(vicrabcrashsc_copyFramePointerBacktrace(addresses, 2, 0), 2, @"");
+}
+
+@end
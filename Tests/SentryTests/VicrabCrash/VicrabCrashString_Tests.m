@@ -29,6 +29,9 @@
 
 #import "VicrabCrashString.h"
 
+#define kFuzzIterations 200000
+#define kBenchmarkIterations 100000
+
 
 @interface VicrabCrashString_Tests : XCTestCase @end
 
@@ -179,4 +182,91 @@
     XCTAssertFalse(success, @"");
 }
 
+- (void) testIsNullTerminatedUTF8StringAcrossBlocks
+{
+    const char* string = "A long string with テスト characters beyond the first sixteen bytes";
+    bool success = vicrabcrashstring_isNullTerminatedUTF8String(string, 2, (int)strlen(string) + 1);
+    XCTAssertTrue(success, @"");
+}
+
+- (void) testIsNullTerminatedUTF8StringControlCharInLaterBlock
+{
+    const char* string = "A long string that is fine for a while\x01 until here";
+    bool success = vicrabcrashstring_isNullTerminatedUTF8String(string, 2, (int)strlen(string) + 1);
+    XCTAssertFalse(success, @"");
+}
+
+- (void) testIsNullTerminatedUTF8StringNoTerminatorInLongBuffer
+{
+    char buffer[100];
+    memset(buffer, 'a', sizeof(buffer));
+    bool success = vicrabcrashstring_isNullTerminatedUTF8String(buffer, 2, sizeof(buffer));
+    XCTAssertFalse(success, @"");
+}
+
+static unsigned char randomStringByte(void)
+{
+    switch(arc4random_uniform(8))
+    {
+        case 0: return 0;
+        case 1: return (unsigned char)arc4random_uniform(0x20);
+        case 2: return (unsigned char)(0x80 | arc4random_uniform(0x40));
+        case 3: return (unsigned char)(0xc0 | arc4random_uniform(0x40));
+        default: return (unsigned char)(0x20 + arc4random_uniform(0x60));
+    }
+}
+
+- (void) testIsNullTerminatedUTF8StringMatchesScalar
+{
+    unsigned char buffer[100];
+    for(int i = 0; i < kFuzzIterations; i++)
+    {
+        int length = (int)arc4random_uniform(sizeof(buffer));
+        // Long printable runs exercise the vector path, random bytes the rest.
+        bool mostlyPrintable = arc4random_uniform(2);
+        for(int j = 0; j < length; j++)
+        {
+            buffer[j] = mostlyPrintable && arc4random_uniform(16) ? (unsigned char)(0x20 + arc4random_uniform(0x5f)) : randomStringByte();
+        }
+        int minLength = (int)arc4random_uniform(8);
+        bool expected = vicrabcrashstring_isNullTerminatedUTF8StringScalar(buffer, minLength, length);
+        bool actual = vicrabcrashstring_isNullTerminatedUTF8String(buffer, minLength, length);
+        if(actual != expected)
+        {
+            XCTFail(@"Mismatch for %@ (minLength %d)", [NSData dataWithBytes:buffer length:(NSUInteger)length], minLength);
+            return;
+        }
+    }
+}
+
+- (void) testIsNullTerminatedUTF8StringThroughput
+{
+    // Same size as the buffer the report writer checks for each notable address.
+    char buffer[500];
+    for(int i = 0; i < (int)sizeof(buffer); i++)
+    {
+        buffer[i] = (char)('a' + i % 26);
+    }
+    buffer[300] = 0;
+
+    volatile int validCount = 0;
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    for(int i = 0; i < kBenchmarkIterations; i++)
+    {
+        validCount += vicrabcrashstring_isNullTerminatedUTF8StringScalar(buffer, 4, sizeof(buffer));
+    }
+    double scalarSeconds = CFAbsoluteTimeGetCurrent() - startTime;
+
+    startTime = CFAbsoluteTimeGetCurrent();
+    for(int i = 0; i < kBenchmarkIterations; i++)
+    {
+        validCount += vicrabcrashstring_isNullTerminatedUTF8String(buffer, 4, sizeof(buffer));
+    }
+    double vectorSeconds = CFAbsoluteTimeGetCurrent() - startTime;
+
+    NSLog(@"%d validations: %.1f ms scalar, %.1f ms vectorized",
+          kBenchmarkIterations, scalarSeconds * 1000, vectorSeconds * 1000);
+    XCTAssertEqual(validCount, kBenchmarkIterations * 2, @"");
+}
+
 @end
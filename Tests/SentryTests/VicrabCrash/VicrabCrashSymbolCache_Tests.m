@@ -0,0 +1,92 @@
+//
+//  VicrabCrashSymbolCache_Tests.m
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#import <XCTest/XCTest.h>
+
+#import "VicrabCrashSymbolCache.h"
+#import "VicrabCrashDynamicLinker.h"
+
+
+@interface VicrabCrashSymbolCache_Tests : XCTestCase @end
+
+
+@implementation VicrabCrashSymbolCache_Tests
+
+- (void) testMatchesUncachedLookup
+{
+    vicrabcrashsymcache_init(64);
+    uintptr_t address = (uintptr_t)vicrabcrashsymcache_dladdr + 4;
+
+    Dl_info expected;
+    XCTAssertTrue(vicrabcrashdl_dladdr(address, &expected), @"");
+
+    for(int i = 0; i < 3; i++)
+    {
+        Dl_info actual;
+        XCTAssertTrue(vicrabcrashsymcache_dladdr(address, &actual), @"");
+        XCTAssertEqual(actual.dli_fbase, expected.dli_fbase, @"");
+        XCTAssertEqual(actual.dli_saddr, expected.dli_saddr, @"");
+        XCTAssertEqual(actual.dli_fname, expected.dli_fname, @"");
+        XCTAssertEqual(actual.dli_sname, expected.dli_sname, @"");
+    }
+}
+
+- (void) testStatsCountHitsAndMisses
+{
+    vicrabcrashsymcache_init(64);
+    vicrabcrashsymcache_invalidate();
+    vicrabcrashsymcache_resetStats();
+    uintptr_t address = (uintptr_t)vicrabcrashsymcache_getStats + 4;
+
+    Dl_info info;
+    vicrabcrashsymcache_dladdr(address, &info);
+    vicrabcrashsymcache_dladdr(address, &info);
+    vicrabcrashsymcache_dladdr(address, &info);
+
+    VicrabCrashSymbolCacheStats stats;
+    vicrabcrashsymcache_getStats(&stats);
+    XCTAssertEqual(stats.misses, 1ULL, @"");
+    XCTAssertEqual(stats.hits, 2ULL, @"");
+    XCTAssertTrue(stats.capacity >= 64, @"");
+}
+
+- (void) testInvalidateForcesLookup
+{
+    vicrabcrashsymcache_init(64);
+    uintptr_t address = (uintptr_t)vicrabcrashsymcache_resetStats + 4;
+
+    Dl_info info;
+    vicrabcrashsymcache_dladdr(address, &info);
+    vicrabcrashsymcache_invalidate();
+    vicrabcrashsymcache_resetStats();
+    vicrabcrashsymcache_dladdr(address, &info);
+
+    VicrabCrashSymbolCacheStats stats;
+    vicrabcrashsymcache_getStats(&stats);
+    XCTAssertEqual(stats.misses, 1ULL, @"");
+    XCTAssertEqual(stats.hits, 0ULL, @"");
+}
+
+@end
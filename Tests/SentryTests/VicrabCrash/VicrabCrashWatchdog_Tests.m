@@ -0,0 +1,118 @@
+//
+//  VicrabCrashWatchdog_Tests.m
+//
+//  Copyright (c) 2019 Vicrab. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall remain in place
+// in this source code.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+#import <XCTest/XCTest.h>
+
+#import "VicrabCrashWatchdog.h"
+
+
+typedef struct
+{
+    dispatch_queue_t queue;
+    dispatch_semaphore_t hangEnded;
+    int hangsStarted;
+    int samples;
+    uint64_t duration;
+} WatchedQueue;
+
+static void answerPing(void* watchdog)
+{
+    vicrabcrashwd_answer(watchdog);
+}
+
+static void postPing(VicrabCrashWatchdog* watchdog, void* userData)
+{
+    WatchedQueue* watched = userData;
+    dispatch_async_f(watched->queue, watchdog, answerPing);
+}
+
+static void onHangStarted(void* userData)
+{
+    ((WatchedQueue*)userData)->hangsStarted++;
+}
+
+static void onSample(__unused uint64_t elapsedNanoseconds, void* userData)
+{
+    ((WatchedQueue*)userData)->samples++;
+}
+
+static void onHangEnded(uint64_t durationNanoseconds, void* userData)
+{
+    WatchedQueue* watched = userData;
+    watched->duration = durationNanoseconds;
+    dispatch_semaphore_signal(watched->hangEnded);
+}
+
+
+@interface VicrabCrashWatchdog_Tests : XCTestCase @end
+
+
+@implementation VicrabCrashWatchdog_Tests
+
+- (VicrabCrashWatchdog*) watchdogForQueue:(WatchedQueue*) watched
+{
+    VicrabCrashWatchdogConfig config =
+    {
+        .postPing = postPing,
+        .onHangStarted = onHangStarted,
+        .onSample = onSample,
+        .onHangEnded = onHangEnded,
+        .userData = watched,
+        .pingIntervalNanoseconds = 20 * NSEC_PER_MSEC,
+        .hangThresholdNanoseconds = 100 * NSEC_PER_MSEC,
+        .sampleIntervalNanoseconds = 10 * NSEC_PER_MSEC,
+        .maxSampleIntervalNanoseconds = 40 * NSEC_PER_MSEC,
+    };
+    return vicrabcrashwd_create(&config);
+}
+
+- (void) testResponsiveQueueDoesNotHang
+{
+    WatchedQueue watched = {dispatch_queue_create("watched", DISPATCH_QUEUE_SERIAL), dispatch_semaphore_create(0)};
+    VicrabCrashWatchdog* watchdog = [self watchdogForQueue:&watched];
+    [NSThread sleepForTimeInterval:0.3];
+    vicrabcrashwd_destroy(watchdog);
+    XCTAssertEqual(watched.hangsStarted, 0);
+    XCTAssertEqual(watched.samples, 0);
+}
+
+- (void) testBlockedQueueIsSampledUntilItAnswers
+{
+    WatchedQueue watched = {dispatch_queue_create("watched", DISPATCH_QUEUE_SERIAL), dispatch_semaphore_create(0)};
+    VicrabCrashWatchdog* watchdog = [self watchdogForQueue:&watched];
+    dispatch_async(watched.queue, ^{ [NSThread sleepForTimeInterval:0.5]; });
+
+    long result = dispatch_semaphore_wait(watched.hangEnded, dispatch_time(DISPATCH_TIME_NOW, 5 * NSEC_PER_SEC));
+    vicrabcrashwd_destroy(watchdog);
+    XCTAssertEqual(result, 0);
+    XCTAssertEqual(watched.hangsStarted, 1);
+    XCTAssertTrue(watched.samples >= 3);
+    XCTAssertTrue(watched.duration >= 300 * NSEC_PER_MSEC);
+    XCTAssertTrue(watched.duration < 2 * NSEC_PER_SEC);
+}
+
+@end